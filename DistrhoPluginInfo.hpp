@@ -18,19 +18,32 @@
 #ifndef DISTRHO_PLUGIN_INFO_H_INCLUDED
 #define DISTRHO_PLUGIN_INFO_H_INCLUDED
 
+#ifdef BUFFEROVERRIDE_STEREO
+#define DISTRHO_PLUGIN_NAME "DestroyFX Buffer Override (stereo)"
+#else
 #define DISTRHO_PLUGIN_NAME "DestroyFX Buffer Override"
+#endif
 
 #define DISTRHO_PLUGIN_HAS_UI        1
 #define DISTRHO_PLUGIN_IS_SYNTH      0
 
+#ifdef BUFFEROVERRIDE_STEREO
+#define DISTRHO_PLUGIN_NUM_INPUTS    2
+#define DISTRHO_PLUGIN_NUM_OUTPUTS   2
+#else
 #define DISTRHO_PLUGIN_NUM_INPUTS    1
 #define DISTRHO_PLUGIN_NUM_OUTPUTS   1
+#endif
 
 #define DISTRHO_PLUGIN_WANT_LATENCY  0
 #define DISTRHO_PLUGIN_WANT_PROGRAMS 1
-#define DISTRHO_PLUGIN_WANT_STATE    0
+#define DISTRHO_PLUGIN_WANT_STATE    1
 #define DISTRHO_PLUGIN_WANT_TIMEPOS  0
 
+#ifdef BUFFEROVERRIDE_STEREO
+#define DISTRHO_PLUGIN_URI "https://github.com/aaltman/dfx_buffer_override#stereo"
+#else
 #define DISTRHO_PLUGIN_URI "https://github.com/aaltman/dfx_buffer_override"
+#endif
 
 #endif // DISTRHO_PLUGIN_INFO_H_INCLUDED
@@ -18,21 +18,27 @@
 
 //--------------------------------------------------------------------------
 // this holds the beat scalar values & textual displays for the tempo rates
+// (it's all constant data, so every plugin instance shares the same table)
+// The scalars are stored as exact ratios (cycles per beat) so that things like triplets
+// can be scheduled without any rounding error; getScalar() gives the float version.
 class TempoRateTable
 {
 public:
-	TempoRateTable();
-	~TempoRateTable();
-
-	float getScalar(float paramValue) {
-		return scalars[float2index(paramValue)];
+	static float getScalar(float paramValue) {
+		const TempoRate &rate = rates[float2index(paramValue)];
+		return (float)rate.numerator / (float)rate.denominator;
+	}
+	static void getRatio(float paramValue, long *numerator, long *denominator) {
+		const TempoRate &rate = rates[float2index(paramValue)];
+		*numerator = rate.numerator;
+		*denominator = rate.denominator;
 	}
-	char * getDisplay(float paramValue) {
-		return displays[float2index(paramValue)];
+	static const char * getDisplay(float paramValue) {
+		return rates[float2index(paramValue)].display;
 	}
 
 protected:
-	int float2index(float f) {
+	static int float2index(float f) {
 		if (f < 0.0f)
 			f = 0.0f;
 		else if (f > 1.0f)
@@ -40,8 +46,11 @@ protected:
 		return (int) (f * ((float)NUM_TEMPO_RATES-0.9f));
 	}
 
-	float *scalars;
-	char **displays;
+	struct TempoRate {
+		long numerator, denominator;
+		const char *display;
+	};
+	static const TempoRate rates[NUM_TEMPO_RATES];
 };
 
 
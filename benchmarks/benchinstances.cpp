@@ -0,0 +1,183 @@
+// how many instances fit on this machine:  for 10 to 10,000 instances at each sample rate, how long
+// they take to make & get rid of, how much resident memory each one costs, & how much audio all of
+// them together get through with every instance active, shared out over one thread per CPU
+// (usage:  benchinstances [most instances])
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+#include "bufferOverride.hpp"
+#include "dfxbench.h"
+
+using namespace DISTRHO;
+
+
+#define BENCH_BLOCK_SIZE 256
+#define BENCH_RUN_SECONDS 1.0	// how long the throughput part goes for, in real (not audio) time
+
+// the resident memory of the whole process, in bytes
+static size_t getResidentBytes()
+{
+	long numPages = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm) {
+		if (fscanf(statm, "%*ld %ld", &numPages) != 1)
+			numPages = 0;
+		fclose(statm);
+	}
+	return (size_t)numPages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// how much memory there is to go around, in bytes (0 if it's not known)
+static size_t getAvailableBytes()
+{
+	size_t availableKB = 0;
+	char line[256];
+	FILE *meminfo = fopen("/proc/meminfo", "r");
+	if (meminfo) {
+		while (fgets(line, sizeof(line), meminfo)) {
+			if (sscanf(line, "MemAvailable: %zu kB", &availableKB) == 1)
+				break;
+		}
+		fclose(meminfo);
+	}
+	return availableKB * 1024;
+}
+
+//-----------------------------------------------------------------------------
+// one thread's share of the instances, which it runs block after block until the time is up
+struct BenchThreadJob
+{
+	BufferOverride **instances;
+	long numInstances;
+	const float *input;
+	double endTime;
+	long numBlocks;	// (out) how many blocks each of its instances got through
+};
+
+static void * benchThread(void *arg)
+{
+	BenchThreadJob *job = (BenchThreadJob*) arg;
+	std::vector<float> output(BENCH_BLOCK_SIZE);
+	float *inputs[1] = { const_cast<float*>(job->input) };
+	float *outputs[1] = { &output[0] };
+	job->numBlocks = 0;
+	do {
+		for (long i = 0; i < job->numInstances; i++) {
+			memset(&output[0], 0, BENCH_BLOCK_SIZE * sizeof(float));
+			job->instances[i]->run((const float**)inputs, outputs, BENCH_BLOCK_SIZE);
+			benchKeep(&output[0]);
+		}
+		job->numBlocks++;
+	} while (benchSeconds() < job->endTime);
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+static void benchmarkInstances(long numInstances, double sampleRate, long numThreads, const float *input)
+{
+	// (there's no point in going somewhere that would just end up swapping, or getting killed)
+	BufferOverride *probe = new BufferOverride;
+	probe->setSampleRate(sampleRate);
+	probe->activate();
+	size_t bytesEach = probe->getMemoryUsage();
+	probe->deactivate();
+	delete probe;
+	CapturePool::get()->trim(0);
+	malloc_trim(0);
+	size_t availableBytes = getAvailableBytes();
+	if ( (availableBytes > 0) && ((double)bytesEach * (double)numInstances > (double)availableBytes * 0.5) ) {
+		printf("%6ld instances at %6.1f kHz:  skipped (they'd want about %.0f MB, & there's %.0f MB available)\n",
+			   numInstances, sampleRate * 0.001, (double)bytesEach * (double)numInstances / 1.0e6, (double)availableBytes / 1.0e6);
+		return;
+	}
+
+	std::vector<BufferOverride*> instances(numInstances);
+	size_t startBytes = getResidentBytes();
+	double startTime = benchSeconds();
+	for (long i = 0; i < numInstances; i++) {
+		instances[i] = new BufferOverride;
+		instances[i]->setSampleRate(sampleRate);
+		instances[i]->activate();
+	}
+	double constructionTime = benchSeconds() - startTime;
+	size_t constructedBytes = getResidentBytes();
+
+	// every instance running, with each thread taking an even share of them
+	std::vector<pthread_t> threads(numThreads);
+	std::vector<BenchThreadJob> jobs(numThreads);
+	double endTime = benchSeconds() + BENCH_RUN_SECONDS;
+	startTime = benchSeconds();
+	for (long t = 0; t < numThreads; t++) {
+		long first = (numInstances * t) / numThreads;
+		jobs[t].instances = &instances[first];
+		jobs[t].numInstances = ((numInstances * (t + 1)) / numThreads) - first;
+		jobs[t].input = input;
+		jobs[t].endTime = endTime;
+		jobs[t].numBlocks = 0;
+		if (pthread_create(&threads[t], NULL, benchThread, &jobs[t]) != 0) {
+			benchThread(&jobs[t]);
+			threads[t] = 0;
+		}
+	}
+	double numSamples = 0.0;
+	for (long t = 0; t < numThreads; t++) {
+		if (threads[t] != 0)
+			pthread_join(threads[t], NULL);
+		numSamples += (double)jobs[t].numBlocks * (double)jobs[t].numInstances * BENCH_BLOCK_SIZE;
+	}
+	double runTime = benchSeconds() - startTime;
+	size_t runningBytes = getResidentBytes();
+
+	startTime = benchSeconds();
+	for (long i = 0; i < numInstances; i++) {
+		instances[i]->deactivate();
+		delete instances[i];
+	}
+	double destructionTime = benchSeconds() - startTime;
+	// (the capture buffers go back to the pool, so let go of those too, & have the allocator hand
+	// everything back to the system, so that the next run's resident memory starts from scratch)
+	CapturePool::get()->trim(0);
+	malloc_trim(0);
+
+	// the real-time instances are how many instances' worth of audio got processed each second
+	printf("%6ld instances at %6.1f kHz:  make %8.2f us, destroy %8.2f us, RSS %7.1f kB (%7.1f kB running), %10.1f real-time instances\n",
+		   numInstances, sampleRate * 0.001,
+		   constructionTime * 1.0e6 / (double)numInstances, destructionTime * 1.0e6 / (double)numInstances,
+		   ((double)constructedBytes - (double)startBytes) / 1024.0 / (double)numInstances,
+		   ((double)runningBytes - (double)startBytes) / 1024.0 / (double)numInstances,
+		   numSamples / (runTime * sampleRate));
+}
+
+int main(int argc, char **argv)
+{
+	long maxInstances = (argc > 1) ? atol(argv[1]) : 10000;
+	long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (numThreads < 1)
+		numThreads = 1;
+	// glibc raises its mmap threshold as big blocks get freed, so later runs' capture buffers would come from
+	// memory that's already resident; pinning it keeps every run's resident memory down to what it touches
+	mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+	// (the host's tempo isn't known, so the instances follow their own)
+	getTestHost().canDoTimeInfo = 0;
+	getTestHost().timeInfo = NULL;
+
+	// noise, so that nothing goes idle
+	std::vector<float> input(BENCH_BLOCK_SIZE);
+	uint32_t noiseState = 1;
+	for (long i = 0; i < BENCH_BLOCK_SIZE; i++)
+		input[i] = randomFloatXorshift(&noiseState) - 0.5f;
+
+	printf("%ld threads, %d-sample blocks, mono\n", numThreads, BENCH_BLOCK_SIZE);
+	const double sampleRates[] = { 44100.0, 96000.0, 192000.0 };
+	for (long s = 0; s < 3; s++) {
+		for (long numInstances = 10; numInstances <= maxInstances; numInstances *= 10)
+			benchmarkInstances(numInstances, sampleRates[s], numThreads, &input[0]);
+	}
+	return 0;
+}
@@ -0,0 +1,60 @@
+// how fast each DSP kernel goes, for the kernels picked for this CPU & for the reference ones
+
+#include <stdio.h>
+#include <vector>
+
+#include "dfxkernels.h"
+#include "dfxbench.h"
+
+
+#define BENCH_SAMPLES 128	// the same as CAPTURE_SPAN_MAX, which is the longest run that the engine hands them
+#define BENCH_REPEATS 4096
+
+static void benchmarkKernels(const DFXkernels *kernels)
+{
+	std::vector<float> a(BENCH_SAMPLES), b(BENCH_SAMPLES), c(BENCH_SAMPLES), d(BENCH_SAMPLES);
+	std::vector<int16_t> int16s(BENCH_SAMPLES);
+	std::vector<uint16_t> bfloat16s(BENCH_SAMPLES);
+	for (long i = 0; i < BENCH_SAMPLES; i++) {
+		a[i] = (float)((i * 37) % 101) * 0.0198f - 1.0f;
+		b[i] = (float)((i * 53) % 97) * 0.0206f - 1.0f;
+		c[i] = (float)i / (float)BENCH_SAMPLES;
+		d[i] = 1.0f - c[i];
+	}
+	uint32_t positions[8] = { 0 }, stepSizes[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, cycles[8];
+	const double numSamples = (double)BENCH_SAMPLES * BENCH_REPEATS;
+	double seconds;
+
+	printf("%s:\n", kernels->name);
+#define BENCH_KERNEL(label, call)   \
+	BENCH_BEST_TIME(seconds, 0.2, for (long r = 0; r < BENCH_REPEATS; r++) { call; benchKeep(&a[0]); });   \
+	printf("\t%-18s %8.3f ns/sample\n", label, seconds * 1.0e9 / numSamples);
+
+	BENCH_KERNEL("captureInt16", kernels->captureInt16(&int16s[0], &a[0], BENCH_SAMPLES, 8191.75f))
+	BENCH_KERNEL("readbackInt16", kernels->readbackInt16(&a[0], &int16s[0], BENCH_SAMPLES, 1.0f / 8191.75f))
+	BENCH_KERNEL("captureBfloat16", kernels->captureBfloat16(&bfloat16s[0], &b[0], BENCH_SAMPLES))
+	BENCH_KERNEL("readbackBfloat16", kernels->readbackBfloat16(&b[0], &bfloat16s[0], BENCH_SAMPLES))
+	BENCH_KERNEL("crossfade", kernels->crossfade(&a[0], &b[0], &c[0], &d[0], BENCH_SAMPLES))
+	BENCH_KERNEL("mixGain", kernels->mixGain(&a[0], &b[0], 0.5f, BENCH_SAMPLES))
+	BENCH_KERNEL("mixWetDry", kernels->mixWetDry(&a[0], &b[0], &c[0], 0.5f, 0.5f, BENCH_SAMPLES))
+	float peak = 0.0f;
+	BENCH_KERNEL("peak", peak = kernels->peak(&b[0], BENCH_SAMPLES, peak); benchKeep(&peak))
+	BENCH_BEST_TIME(seconds, 0.2, for (long r = 0; r < BENCH_REPEATS; r++) { kernels->advancePhases(positions, stepSizes, cycles, 8, 32); benchKeep(positions); });
+	printf("\t%-18s %8.3f ns/phase update\n", "advancePhases", seconds * 1.0e9 / (BENCH_REPEATS * 8.0));
+	BENCH_KERNEL("renderLFOtable", kernels->renderLFOtable(&c[0], &d[0], positions[0], 0x01234567, 25, 0.5f, 0.75f, BENCH_SAMPLES))
+	std::vector<uint8_t> hashInput(DFX_HASH_CHUNKS_MAX * 1024);
+	for (size_t i = 0; i < hashInput.size(); i++)
+		hashInput[i] = (uint8_t) (i * 7);
+	uint32_t chainingValues[DFX_HASH_CHUNKS_MAX * 8];
+	BENCH_BEST_TIME(seconds, 0.2, for (long r = 0; r < 256; r++) { kernels->hashChunks(chainingValues, &hashInput[0], DFX_HASH_CHUNKS_MAX, r); benchKeep(chainingValues); });
+	printf("\t%-18s %8.3f GB/s\n", "hashChunks", (double)hashInput.size() * 256.0 / seconds * 1.0e-9);
+#undef BENCH_KERNEL
+}
+
+int main()
+{
+	benchmarkKernels(getDFXkernels());
+	if (getDFXkernels() != getDFXreferenceKernels())
+		benchmarkKernels(getDFXreferenceKernels());
+	return 0;
+}
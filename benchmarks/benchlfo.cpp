@@ -0,0 +1,101 @@
+// what the LFOs cost:  rendering one on its own, a block at a time (the table waveforms) or update by
+// update (the random ones), at audio rate & at control rate, & then the whole engine with its LFOs off,
+// & on at audio rate & at control rate
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "bufferOverride.hpp"
+#include "dfxbench.h"
+
+using namespace DISTRHO;
+
+
+#define BENCH_BLOCK_SIZE 256
+#define BENCH_ENGINE_SAMPLES (44100 * 10)
+
+//-----------------------------------------------------------------------------
+static void benchmarkLFO(long shape, long granularity, const DFXkernels *kernels)
+{
+	LFO lfo;
+	lfo.fShape = LFOshapeUnscaled(shape);
+	lfo.fDepth = 0.7f;
+	lfo.pickTheLFOwaveform();
+	lfo.setGranularity(granularity);
+	lfo.setKernels(kernels);
+	lfo.reset();
+	lfo.setStepSize(3.3f * LFO_PHASE_RANGE / 44100.0f);
+
+	// (the engine renders its LFOs in chunks that fit into the modulation buffers, so this does too)
+	const long numSamples = 44100;
+	long chunkSize = (LFO_MOD_BUFFER_SIZE - 1) * granularity;
+	double seconds;
+	BENCH_BEST_TIME(seconds, 0.2,
+		for (long done = 0; done < numSamples; done += chunkSize) {
+			lfo.renderModBuffer(0, (chunkSize < (numSamples - done)) ? chunkSize : (numSamples - done));
+			benchKeep(lfo.modBuffer);
+		});
+	char shapeName[64];
+	lfo.getShapeName(shapeName);
+	printf("\t%-22s granularity %2ld:  %7.3f ns/sample\n", shapeName, granularity, seconds * 1.0e9 / (double)numSamples);
+}
+
+//-----------------------------------------------------------------------------
+// ns per sample for the whole engine, with its divisor & buffer LFOs at depth (0 is off)
+static double benchmarkEngine(float depth, long granularity, const std::vector<float> &input)
+{
+	BufferOverride *engine = new BufferOverride;
+	engine->setSampleRate(44100.0);
+	engine->setParameterValue(BufferOverride::kDivisor, 0.3f);
+	engine->setParameterValue(BufferOverride::kBufferTempoSync, 0.0f);
+	engine->setParameterValue(BufferOverride::kDivisorLFOrate, 0.6f);
+	engine->setParameterValue(BufferOverride::kDivisorLFOdepth, depth);
+	engine->setParameterValue(BufferOverride::kBufferLFOrate, 0.4f);
+	engine->setParameterValue(BufferOverride::kBufferLFOdepth, depth);
+	engine->setLFOgranularity(granularity);
+	engine->deactivate();
+	engine->activate();
+
+	std::vector<float> output(BENCH_BLOCK_SIZE);
+	float *outputs[1] = { &output[0] };
+	double seconds;
+	BENCH_BEST_TIME(seconds, 0.5,
+		for (long done = 0; done + BENCH_BLOCK_SIZE <= BENCH_ENGINE_SAMPLES; done += BENCH_BLOCK_SIZE) {
+			const float *inputs[1] = { &input[done] };
+			engine->run(inputs, outputs, BENCH_BLOCK_SIZE);
+			benchKeep(&output[0]);
+		});
+	delete engine;
+	return seconds * 1.0e9 / (double)BENCH_ENGINE_SAMPLES;
+}
+
+int main()
+{
+	const long granularities[] = { 1, 4, 32 };
+	const long shapes[] = { kSineLFO, kSquareLFO, kRandomInterpolatingLFO };
+	const DFXkernels *kernelSets[2] = { getDFXkernels(), getDFXreferenceKernels() };
+	for (long k = 0; k < ((kernelSets[0] == kernelSets[1]) ? 1 : 2); k++) {
+		printf("one LFO, %s kernels:\n", kernelSets[k]->name);
+		for (long s = 0; s < 3; s++) {
+			for (long g = 0; g < 3; g++)
+				benchmarkLFO(shapes[s], granularities[g], kernelSets[k]);
+		}
+	}
+
+	// (the host's tempo isn't known, so the engine follows its own)
+	getTestHost().canDoTimeInfo = 0;
+	getTestHost().timeInfo = NULL;
+	std::vector<float> input(BENCH_ENGINE_SAMPLES);
+	uint32_t noiseState = 1;
+	for (long i = 0; i < BENCH_ENGINE_SAMPLES; i++)
+		input[i] = randomFloatXorshift(&noiseState) - 0.5f;
+	printf("the engine:\n");
+	printf("\t%-30s %7.3f ns/sample\n", "LFOs off", benchmarkEngine(0.0f, LFO_DEFAULT_GRANULARITY, input));
+	for (long g = 0; g < 3; g++) {
+		char label[64];
+		snprintf(label, sizeof(label), "LFOs on, granularity %ld", granularities[g]);
+		printf("\t%-30s %7.3f ns/sample\n", label, benchmarkEngine(0.6f, granularities[g], input));
+	}
+	return 0;
+}
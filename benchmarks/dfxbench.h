@@ -0,0 +1,39 @@
+#ifndef __dfxbench
+#define __dfxbench
+
+#include <stdint.h>
+#include <time.h>
+
+
+//-----------------------------------------------------------------------------
+// the monotonic clock, in seconds
+static inline double benchSeconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + ((double)now.tv_nsec * 1.0e-9);
+}
+
+// keeps the compiler from throwing away work whose result nothing looks at
+static inline void benchKeep(const void *data)
+{
+	__asm__ __volatile__("" : : "g"(data) : "memory");
+}
+
+// runs body over & over for at least minSeconds & returns the best time for one run, in seconds
+// (the best rather than the average, since anything slower is the machine doing something else)
+#define BENCH_BEST_TIME(result, minSeconds, body)   \
+	do {   \
+		double benchStart = benchSeconds(), benchBest = 1.0e30;   \
+		do {   \
+			double benchRunStart = benchSeconds();   \
+			body;   \
+			double benchRunTime = benchSeconds() - benchRunStart;   \
+			if (benchRunTime < benchBest)   \
+				benchBest = benchRunTime;   \
+		} while ((benchSeconds() - benchStart) < (minSeconds));   \
+		(result) = benchBest;   \
+	} while (0)
+
+
+#endif
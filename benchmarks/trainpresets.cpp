@@ -0,0 +1,86 @@
+// the training run for profile-guided optimization (see the top-level CMakeLists.txt):  renders some
+// seconds of noise & tones through each of the factory programs, at a couple of sample rates, with the
+// host's tempo coming in, in the sorts of block sizes that hosts use, so that the profiles come from
+// what the plugin actually spends its time doing rather than from the benchmarks' corner cases
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "bufferOverride.hpp"
+
+using namespace DISTRHO;
+
+#define TRAIN_SECONDS   6
+
+
+//-----------------------------------------------------------------------------
+// a playing host at 120 bpm, in 4/4, moving along with each block
+static void setPosition(VstTimeInfo *timeInfo, double samplePos)
+{
+	timeInfo->samplePos = samplePos;
+	timeInfo->ppqPos = (samplePos / timeInfo->sampleRate) * (timeInfo->tempo / 60.0);
+	timeInfo->barStartPos = floor(timeInfo->ppqPos / 4.0) * 4.0;
+}
+
+static void renderProgram(long program, double sampleRate, const std::vector<float> &input)
+{
+	VstTimeInfo timeInfo;
+	memset(&timeInfo, 0, sizeof(timeInfo));
+	timeInfo.sampleRate = sampleRate;
+	timeInfo.tempo = 120.0;
+	timeInfo.timeSigNumerator = timeInfo.timeSigDenominator = 4;
+	timeInfo.flags = kVstTempoValid | kVstPpqPosValid | kVstBarsValid | kVstTimeSigValid | kVstTransportPlaying | kVstTransportChanged;
+	setPosition(&timeInfo, 0.0);
+	getTestHost().canDoTimeInfo = 1;
+	getTestHost().timeInfo = &timeInfo;
+
+	BufferOverride *engine = new BufferOverride;
+	engine->setSampleRate(sampleRate);
+	engine->setProgram(program);
+	engine->deactivate();
+	engine->activate();
+
+	const long blockSizes[] = { 64, 256, 512, 1024 };
+	long numSamples = (long)sampleRate * TRAIN_SECONDS;
+	if (numSamples > (long)input.size())
+		numSamples = (long)input.size();
+	std::vector<float> output(1024);
+	float *outputs[1] = { &output[0] };
+	long block = 0;
+	for (long start = 0; start < numSamples; block++) {
+		long blockSize = blockSizes[block % 4];
+		if (blockSize > (numSamples - start))
+			blockSize = numSamples - start;
+		const float *inputs[1] = { &input[start] };
+		memset(&output[0], 0, blockSize * sizeof(float));
+		engine->run(inputs, outputs, blockSize);
+		start += blockSize;
+		timeInfo.flags &= ~kVstTransportChanged;
+		setPosition(&timeInfo, (double)start);
+	}
+
+	delete engine;
+	getTestHost().timeInfo = NULL;
+}
+
+int main()
+{
+	const double sampleRates[] = { 44100.0, 96000.0 };
+	std::vector<float> input(96000 * TRAIN_SECONDS);
+	uint32_t noiseState = 1;
+	for (size_t i = 0; i < input.size(); i++) {
+		// (tones with noise on them, & a gap of silence every so often)
+		float tone = 0.6f * sinf((float)i * 0.03f) * sinf((float)i * 0.0001f);
+		input[i] = tone + (0.1f * (randomFloatXorshift(&noiseState) - 0.5f));
+		if ( ((i / 30000) % 5) == 4 )
+			input[i] = 0.0f;
+	}
+	for (long r = 0; r < 2; r++) {
+		for (long program = 0; program < NUM_PROGRAMS; program++)
+			renderProgram(program, sampleRates[r], input);
+	}
+	printf("rendered the %d factory programs at %ld sample rates\n", NUM_PROGRAMS, 2L);
+	return 0;
+}
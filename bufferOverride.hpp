@@ -5,11 +5,20 @@
 #define __bufferOverride
 
 #include "DistrhoPlugin.hpp"
-START_NAMESPACE_DISTRHO
-
+#include "dfxhost.h"
+// (the DSP core is built on its own, outside of the Distrho namespace)
 #include "dfxmisc.h"
+#include "dfxhash.h"
 #include "lfo.h"
+#include "lfobank.h"
 #include "TempoRateTable.h"
+#include "capturebuffer.h"
+#include "spscring.h"
+#include "sharedtransport.h"
+#include "midiqueue.h"
+#include "rtaudit.h"
+
+START_NAMESPACE_DISTRHO
 
 //-----------------------------------------------------------------------------
 // constants & macros
@@ -18,11 +27,13 @@ START_NAMESPACE_DISTRHO
 #define DIVISOR_MAX 222.0f
 #define bufferDivisorScaled(A) ( paramRangeSquaredScaled((A), DIVISOR_MIN, DIVISOR_MAX) )
 #define bufferDivisorUnscaled(A) ( paramRangeSquaredUnscaled((A), DIVISOR_MIN, DIVISOR_MAX) )
+#define bufferDivisorUnscaledConst(A) ( paramRangeSquaredUnscaledConst((A), DIVISOR_MIN, DIVISOR_MAX) )
 
 #define BUFFER_MIN 1.0f
 #define BUFFER_MAX 999.0f
 #define forcedBufferSizeScaled(A) ( paramRangeSquaredScaled((1.0f-(A)), BUFFER_MIN, BUFFER_MAX) )
 #define forcedBufferSizeUnscaled(A) ( 1.0f - paramRangeSquaredUnscaled((A), BUFFER_MIN, BUFFER_MAX) )
+#define forcedBufferSizeUnscaledConst(A) ( 1.0f - paramRangeSquaredUnscaledConst((A), BUFFER_MIN, BUFFER_MAX) )
 #define forcedBufferSizeSamples(A) ( (long)(forcedBufferSizeScaled((A)) * SAMPLERATE * 0.001f) )
 
 #define TEMPO_MIN 57.0f
@@ -34,28 +45,266 @@ START_NAMESPACE_DISTRHO
 #define LFO_RATE_MAX 21.0f
 #define LFOrateScaled(A)   ( paramRangeSquaredScaled((A), LFO_RATE_MIN, LFO_RATE_MAX) )
 #define LFOrateUnscaled(A)   ( paramRangeSquaredUnscaled((A), LFO_RATE_MIN, LFO_RATE_MAX) )
+// (the Const versions work out the values at compile time, for the factory presets)
+#define LFOrateUnscaledConst(A)   ( paramRangeSquaredUnscaledConst((A), LFO_RATE_MIN, LFO_RATE_MAX) )
+
+// 1 sample in the 32.32 fixed-point units that tempo-synced forced buffer sizes are worked out in
+#define FORCED_BUFFER_FIXED_ONE 4294967296.0
 
 // you need this stuff to get some maximum buffer size & allocate for that
 // this is 42 bpm - should be sufficient
 #define MIN_ALLOWABLE_BPS 0.7f
 
 #define NUM_PROGRAMS 16
+#define PROGRAM_NAME_LENGTH 32
 #define PLUGIN_VERSION 2000
 #define PLUGIN_ID 'bufS'
 
+// the most stutter layers that can run on top of the main one
+#define MAX_EXTRA_LAYERS 3
+
+// the most samples that get captured, read back & mixed in one go
+#define CAPTURE_SPAN_MAX 128
+
+// the alignment that keeps the audio state of different instances from sharing cache lines
+#define CACHE_LINE_SIZE 64
+
+// the longest parameter display string, including the terminating null
+#define PARAMETER_DISPLAY_LENGTH 32
+
+// the number of records that the GUI telemetry ring holds
+#define TELEMETRY_RING_SIZE 64
+// how many min/max pairs each telemetry record sums up the captured audio with,
+// & how many stretches of the forced buffer the capture keeps its own min/max for, that those come from
+#define TELEMETRY_SUMMARY_POINTS 16
+#define TELEMETRY_CAPTURE_BINS 128
+
+// for the saved state chunk
+#define STATE_CHUNK_KEY "chunk"
+#define STATE_CHUNK_MAGIC 0x624F6368	// 'bOch'
+#define STATE_CHUNK_VERSION 2
+#define STATE_CHUNK_TEXT_SIZE ((sizeof(BufferOverrideStateChunk) * 2) + 1)	// the hex string, with its terminating null
+// what's going on with the staged state chunk (& the staged modulation matrix changes)
+enum {
+	kStagedStateEmpty,	// nothing is waiting
+	kStagedStateWriting,	// d_setState() (or setModulation()) is filling it in
+	kStagedStateReady,	// it's waiting to be applied
+	kStagedStateApplying	// it's going in
+};
+
+// for the render cache:  bump BUFFEROVERRIDE_RENDER_VERSION whenever a change to the engine changes
+// what the same input & settings render to, so that the renders from before don't get used
+#define BUFFEROVERRIDE_RENDER_VERSION 4
+#define RENDER_CACHE_MAGIC 0x624F7263	// 'bOrc'
+
+
+struct BufferOverrideProgram;
+struct BufferOverrideStateChunk;
+struct BufferOverrideStagedState;
 
 //-----------------------------------------------------------------------------
-class BufferOverrideProgram
+// An extra stutter layer.  It divides up the same forced buffers as the main layer
+// & reads from the same capture buffer, but it has its own divisor, LFO & gain, so
+// several polyrhythmic stutters cost one capture & one extra read per layer.
+struct BufferOverrideLayer
 {
-	friend class BufferOverride;
-public:
-	BufferOverrideProgram();
-	~BufferOverrideProgram();
-private:
-	float *param;
-	char *name;
+	float fDivisor;	// 0.0 - 1.0 parameter value for the divisor
+	float fGain;	// the linear gain of this layer in the mix
+	float currentBufferDivisor;	// the current divisor with the LFO applied
+
+	long minibufferSize, prevMinibufferSize;	// the current & previous sizes of this layer's minibuffers
+	long readPos;	// the current sample position within this layer's minibuffer
+
+	long smoothcount, smoothDur;	// the minibuffer transition smoothing, just like the main layer's
+	float fadeOutGain, fadeInGain, realFadePart, imaginaryFadePart;
+	long captureReach;	// how far into the forced buffer this layer might still read (see getCaptureReach())
+
+	// (this is down here so that the fields above, which the audio loop uses, stay together)
+	LFO divisorLFO;
+};
+
+//-----------------------------------------------------------------------------
+// The state that the audio loop works on for every span, as opposed to the parameters,
+// programs, MIDI & host stuff that only get looked at every now & then.  It's packed
+// together & starts on its own cache line, so the inner loop touches just two
+// lines of it (three in stereo), & instances running on different threads never share any.
+// (the counters are 32-bit so that, with the gains & the kernels, they fill exactly the
+// first line; the forced buffer is never anywhere near 2^31 samples long, & the capture
+// limits go on the second line, alongside the capture buffer that they're for)
+struct alignas(CACHE_LINE_SIZE) BufferOverrideDSP
+{
+	int32_t writePos;	// the current sample position within the forced buffer
+	int32_t readPos;	// the current sample position within the minibuffer
+	int32_t minibufferSize, prevMinibufferSize;	// the current & previous sizes of the divided "mini" buffer
+	int32_t currentForcedBufferSize;	// the size of the larger, imposed buffer
+	int32_t smoothcount;	// sample counter for the minibuffer transition smoothing period
+	int32_t numExtraLayers;	// how many of the extra stutter layers are on
+
+	float fadeOutGain, fadeInGain, realFadePart, imaginaryFadePart;	// for trig crossfading
+	float inputGain, outputGain;	// the dry & wet gains, for equal power mixing
+
+	const DFXkernels *kernels;	// the DSP loops for this CPU
+
+	// nothing ever reads the captured audio past a certain point in the forced buffer, so capture stops there
+	int32_t captureLimit;	// where capturing stops in the current forced buffer
+	int32_t captureEnd;	// how far it's actually gotten in the current forced buffer
+
+	// these store the forced buffer
+	CaptureBuffer buffer1;
+#ifdef BUFFEROVERRIDE_STEREO
+	CaptureBuffer buffer2;
+#endif
+};
+
+//-----------------------------------------------------------------------------
+// what the audio thread tells the GUI at each minibuffer boundary
+struct BufferOverrideTelemetry
+{
+	float divisor;	// the current divisor, with the LFO & MIDI applied
+	int32_t minibufferSize;	// in samples
+	int32_t forcedBufferSize;	// in samples
+	float divisorLFOvalue, bufferLFOvalue;	// the LFO outputs, 0.0 - 2.0
+	// a decimated outline of the captured audio that the minibuffer that just ended played back
+	// (each point is the lowest & highest sample captured in its stretch of the minibuffer, give or take
+	// the width of a capture bin, or 0 & 0 if none of it got captured)
+	float summaryMin[TELEMETRY_SUMMARY_POINTS], summaryMax[TELEMETRY_SUMMARY_POINTS];
+};
+
+
+//-----------------------------------------------------------------------------
+// A snapshot of the engine taken just as a forced buffer starts.  Restoring one & rendering
+// on from its samplePosition gives exactly the same output as the original render did from
+// there (given the same input, parameters & host info from there on), so a re-render after
+// an edit only has to go back as far as the last checkpoint before the edit.
+struct BufferOverrideCheckpoint
+{
+	int64_t samplePosition;	// where this was taken, counting from the last d_deactivate()
+
+	// the audio loop state
+	int32_t writePos, readPos;
+	int32_t captureEnd;
+	int64_t forcedBufferStart;
+	int32_t minibufferSize, prevMinibufferSize;
+	int32_t currentForcedBufferSize;
+	int32_t smoothcount;
+	float fadeOutGain, fadeInGain, realFadePart, imaginaryFadePart;
+	float inputGain, outputGain;
+	// & the rest of what carries on from one forced buffer to the next
+	uint32_t forcedBufferFraction;
+	long lastForcedBufferSize;
+	long smoothDur;
+	float currentBufferDivisor;
+	bool needResync;
+	double pitchbend;
+	bool divisorWasChangedByHand;
+	int lastNoteOn, lastPitchbend;
+
+	LFOstate divisorLFO, bufferLFO;
+	LFObankState modBank;
+	struct {
+		float currentBufferDivisor;
+		long minibufferSize, prevMinibufferSize, readPos;
+		long smoothcount, smoothDur;
+		float fadeOutGain, fadeInGain, realFadePart, imaginaryFadePart;
+		LFOstate divisorLFO;
+	} layers[MAX_EXTRA_LAYERS];
+
+	// the captured audio that the next forced buffer can still read back, as it's stored (in captureFormat),
+	// from historyStart on (anything outside of that is silence); the channels come one after the other
+	long captureFormat;
+	float int16Headroom;
+	long historyStart, historyLength;
+	void *history;
+
+	BufferOverrideCheckpoint *next;	// the next later one
+};
+
+
+//-----------------------------------------------------------------------------
+// where a forced buffer started & how long it was, as logged for renderOffline()
+struct BufferOverrideForcedBuffer
+{
+	int64_t start;	// the sample position where it started
+	long size;	// its final size, in samples
+	long maxSizeBefore;	// the longest of all of the forced buffers before it
+};
+
+//-----------------------------------------------------------------------------
+// One of the reads from the captured audio that go into a segment of output.  Everything that
+// gets read was captured from the input at some point, so the reads are given as input positions.
+struct BufferOverrideSegmentRead
+{
+	int64_t source;	// the input position that the read starts from
+	float gain;	// its level in the mix (the main layer's is the base that the others get mixed into)
+	long fadeLength;	// how many samples at the start get crossfaded with the overlap (the smoothing)
+	int64_t overlapSource;	// the input position that the overlap starts from
+	float fadeInGain, fadeOutGain, realFadePart, imaginaryFadePart;	// the crossfade's gain recurrence, as of the start
+};
+
+//-----------------------------------------------------------------------------
+// A run of output with no minibuffer boundaries in it, & where its audio comes from:
+// output[start + i] = (the reads mixed together at i) * wetGain + input[start + i] * dryGain
+struct BufferOverrideSegment
+{
+	int64_t start;	// the output position, counting from a d_deactivate()
+	long length;
+	float wetGain, dryGain;
+	long numReads;	// the main layer's read & then one for each extra layer that's on
+	BufferOverrideSegmentRead reads[1 + MAX_EXTRA_LAYERS];
+};
+
+//-----------------------------------------------------------------------------
+// One dimension of a parameter sweep:  a parameter & the 0.0 - 1.0 values that it takes.
+struct BufferOverrideSweepAxis
+{
+	long parameter;	// kDivisor, kBuffer, kSmooth, or whichever
+	const float *values;
+	long numValues;
 };
 
+// where a sweep's output goes, a tile at a time; this gets called from the render threads, but only
+// one at a time for each point, & in order, so position goes up by numSamples each time for a point
+typedef void (*BufferOverrideSweepWriter)(void *userData, long pointIndex, int64_t position, float **outputs, long numSamples);
+
+
+//-----------------------------------------------------------------------------
+// how a parameter's 0.0 - 1.0 value maps onto its range
+enum {
+	kParamScaleLinear,
+	kParamScaleSquared,
+	kParamScaleSquaredReversed,	// squared, but from the top of the range down (like the forced buffer size)
+	kParamScaleInteger,	// whole numbers from min to max
+	kParamScaleToggle	// min if it's off, max if it's on
+};
+
+// how a parameter's display string gets made
+enum {
+	kParamFormatDivisor,	// 3 decimal places, & anything below 2 (which doesn't divide anything) shows as 1
+	kParamFormatBufferSize,	// 1 decimal place, or the tempo rate when it's tempo synced
+	kParamFormatLFOrate,	// the same, but for an LFO
+	kParamFormatYesNo,
+	kParamFormatPercent,	// whole percents
+	kParamFormatPercentFine,	// percents to 1 decimal place
+	kParamFormatLFOshape,
+	kParamFormatPitchbend,	// +/- 2 decimal places
+	kParamFormatMidiMode,
+	kParamFormatTempo	// 3 decimal places, or "auto" when it comes from the host
+};
+
+//-----------------------------------------------------------------------------
+// Everything about a parameter that doesn't change:  what it's called, what its
+// value means & how it gets shown.  There's one of these for each parameter.
+struct BufferOverrideParameterInfo
+{
+	const char *name;
+	const char *symbol;	// a short name that's okay as an identifier, for hosts that want one
+	float min, max;	// the range that the 0.0 - 1.0 value gets scaled onto
+	long scaling;	// kParamScaleLinear, etc.
+	const char *unit;
+	const char *tempoSyncUnit;	// the unit while tempoSyncParameter is on
+	long format;	// kParamFormatDivisor, etc.
+	long tempoSyncParameter;	// the parameter that switches this one to tempo rates (-1 if there isn't one)
+};
 
 //-----------------------------------------------------------------------------
 class BufferOverride : public Plugin
@@ -64,6 +313,9 @@ class BufferOverride : public Plugin
 public:
 	BufferOverride();
 	~BufferOverride();
+	// these keep the DSP state on its own cache lines, which a plain new doesn't promise to do
+	static void * operator new(size_t size);
+	static void operator delete(void *ptr);
 
 	enum Parameters {
 	    kDivisor = 0,
@@ -91,59 +343,297 @@ public:
 	    NUM_PARAMETERS
 	};
 
-	virtual void d_deactivate();
-	virtual void d_activate();
+	// the saved state in binary form (see BufferOverrideStateChunk below); a chunk that gets set only
+	// goes into the programs at the next d_activate() or d_run(), so it's okay to do while processing
+	// (except that a new capture format has to wait for the next d_activate(), since it reallocates)
+	void getStateChunk(BufferOverrideStateChunk *chunk);
+	bool setStateChunk(const BufferOverrideStateChunk *chunk);
+
+	// MIDI for the next d_run(), frame samples into that block (notes pick the divisor, pitchbend bends it,
+	// & all-notes-off lets go of them); whatever thread the host sends MIDI from calls this (just the one),
+	// & it never waits on the audio thread.  It returns false if the event got dropped because too many are
+	// waiting.  The events take effect at the minibuffer boundaries, since that's when the divisor gets used.
+	bool queueMidiEvent(uint32_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+		return midistuff->push(frame, status, data1, data2);
+	}
+
+	// sets how many samples go by between control-rate LFO updates (1 means audio rate)
+	void setLFOgranularity(long newGranularity);
+	// routes a slot of the modulation matrix to a parameter (or to kNoModDestination to unroute it);
+	// rate, depth, shape & tempoSync are 0.0 - 1.0 values just like the divisor & buffer LFO parameters.
+	// The destination can only be kDivisor, kBuffer, kSmooth or kDryWetMix, which pick up the modulation
+	// at each minibuffer boundary; anything else returns false & leaves the slot how it was.
+	// The change waits for the start of the next d_run() (or d_activate(), or an offline render),
+	// so it's okay to do while processing.
+	bool setModulation(long slot, long destination, float rate, float depth, float shape, float tempoSync);
+	// whether any slot of the modulation matrix is routed to a parameter (as of the last block)
+	bool isModulated(long index) {
+		return modBank->isRouted(index);
+	}
+	// turns on the extra stutter layers (0 to MAX_EXTRA_LAYERS of them; 0 is the normal single-layer mode)
+	void setNumExtraLayers(long newNumLayers);
+	// sets up an extra layer; all of these are 0.0 - 1.0 values, the divisor & LFO ones
+	// working like the kDivisor & divisor LFO parameters, & gain being a linear mix level
+	void setLayer(long layer, float divisor, float LFOrate, float LFOdepth, float LFOshape, float LFOtempoSync, float gain);
+	// picks how the captured audio gets stored (kCaptureFloat32, kCaptureInt16 or kCaptureBfloat16)
+	// & how much headroom the int16 format leaves above 0 dB (see CaptureBuffer::setInt16Headroom());
+	// this reallocates the capture buffers, so only do it while the plugin isn't processing
+	void setCaptureFormat(long newFormat, float newInt16Headroom = CAPTURE_INT16_HEADROOM);
+	long getCaptureFormat() {
+		return captureFormat;
+	}
+	// The capture buffers come from the process-wide CapturePool at d_activate() & go back to it at
+	// d_deactivate().  With this, an instance that has had nothing but silence coming in for
+	// max(idleSamples, 2 * SUPER_MAX_BUFFER) samples gives them back while it's still running, & takes
+	// some from the pool again when there's input.  That floor is twice the longest possible forced
+	// buffer at the current sample rate (about 11.4 seconds, at any rate), so that nothing it captured
+	// can still be heard.  While any instance has this on, the pool's housekeeping thread frees the
+	// spares past CAPTURE_POOL_SPARES & allocates more for instances that come back to find none there.
+	// The audio thread never allocates, so until that happens (within CAPTURE_POOL_HOUSEKEEPING_MS or so,
+	// plus the allocation), the instance passes just its dry signal.  0 turns this off (the default).
+	void setIdleRelease(long idleSamples);
+	// how much memory this instance has allocated for itself, in bytes, for working out how many
+	// instances fit on a machine (it's mostly the capture buffers, which go with the sample rate & format)
+	size_t getMemoryUsage();
+
+	// The reference engine, for checking the fast paths against:  this turns off everything that's only there
+	// for speed, going one sample at a time with the plain reference kernels, capturing all of every forced
+	// buffer, asking the host for the transport itself instead of going through SharedTransport, & rendering
+	// offline with just the one thread.  The output should come out exactly the same either way, so anything
+	// that differs from this with the same settings, input & automation is a bug in one of the fast paths.
+	void setReferenceMode(bool newReferenceMode);
+	bool getReferenceMode() {
+		return referenceMode;
+	}
+#ifdef BUFFEROVERRIDE_RT_AUDIT
+	// runs every factory program, in each of the MIDI modes & with both the user's & the host's tempo,
+	// through numSamples of d_run() with the real-time audit on (see rtaudit.h), with MIDI notes, pitchbend
+	// & parameter changes coming in between the blocks (which get audited as well); returns how many
+	// violations there were.  This leaves the current program's parameters changed.
+	long auditRealTimeSafety(long numSamples);
+#endif
+
+	// for offline rendering:  keeps a checkpoint at the start of a forced buffer whenever at least
+	// minSamples have gone by since the last one (0 turns them off & throws away the ones so far);
+	// they get allocated in the audio thread, so this isn't meant for real-time use
+	void setCheckpointInterval(long minSamples);
+	long getNumCheckpoints() {
+		return numCheckpoints;
+	}
+	// goes back to the last checkpoint at or before samplePosition & forgets about any later ones;
+	// this returns where the checkpoint was, which is where rendering needs to start again
+	// (or -1 if there isn't one, in which case nothing changes)
+	int64_t restoreCheckpoint(int64_t samplePosition);
+	void clearCheckpoints();
+
+	// renders a whole file's worth of input in one go, with the work spread across up to numThreads threads;
+	// the output is exactly what d_deactivate() & then d_run() on all of it would give (the outputs get
+	// overwritten, not added to), & there's no host timeline, so the tempo comes from the kTempo parameter.
+	// This uses the checkpoints, so it throws away any that there were, & leaves the engine deactivated.
+	// The inputs & outputs can't be the same memory.  If it can't get the memory or the threads that
+	// it wants, it renders with fewer threads (all the way down to just the calling one).
+	void renderOffline(float **inputs, float **outputs, int64_t numSamples, long numThreads);
+
+	// makes the random LFO shapes reproducible:  from each d_deactivate() on (& so from the start of every
+	// renderOffline()), all of the LFOs' random sequences start over from this seed (0 goes back to the
+	// usual unpredictable ones, carrying on from wherever they are)
+	void setRandomSeed(uint32_t newSeed) {
+		randomSeed = newSeed;
+	}
+	uint32_t getRandomSeed() {
+		return randomSeed;
+	}
+	// a hash of everything that decides what renderOffline() would give for this input:  the audio,
+	// all of the settings, the random seed, the sample rate & the engine version (it's the BLAKE3 digest,
+	// so key gets BLAKE3_DIGEST_SIZE bytes)
+	void getRenderKey(float **inputs, int64_t numSamples, uint8_t *key);
+	// renderOffline(), but looking in cacheDirectory first for a render with the same getRenderKey(),
+	// & saving the render there if there isn't one yet; this returns true if it came from the cache
+	// (if the random LFO shapes are in use with no random seed, the output can't be reused, so this just renders)
+	bool renderOfflineCached(const char *cacheDirectory, float **inputs, float **outputs, int64_t numSamples, long numThreads);
+
+	// Renders the same input with every combination of the axes' values (the last axis changes the
+	// fastest from one point to the next, like nested loops), each one coming out exactly as renderOffline()
+	// would with these settings & just those parameters changed.  The points are spread across up to
+	// numThreads threads, each of which runs a batch of engines over the input together, a tile at a time
+	// (so each bit of input gets reused while it's still in the cache), & hands each tile of output to
+	// writer as soon as it's done.  This doesn't change this engine; it returns false if it couldn't
+	// get the memory for any engines at all (in which case nothing gets rendered).
+	bool renderSweep(float **inputs, int64_t numSamples, const BufferOverrideSweepAxis *axes, long numAxes,
+					BufferOverrideSweepWriter writer, void *userData, long numThreads);
+
+	// The edit decision list for rendering numSamples from a d_deactivate(), worked out without touching any
+	// audio (just the divisor, the LFOs, tempo sync & all of that, with the tempo from kTempo like renderOffline()).
+	// This returns how many segments there are & puts them into a malloc()ed array in *segments (free() it
+	// when you're done), or returns -1 if it ran out of memory.  It leaves the engine deactivated.
+	long makeSegmentList(int64_t numSamples, BufferOverrideSegment **segments);
+	// renders a segment list from makeSegmentList() (as long as the settings haven't changed since), which
+	// gives exactly what renderOffline() would, but just copies & mixes input audio to do it
+	// (the outputs get overwritten, & they can't be the same memory as the inputs)
+	void renderSegmentList(const BufferOverrideSegment *segments, long numSegments, float **inputs, float **outputs);
+
+	// what each parameter is; index is one of the parameters above
+	static const BufferOverrideParameterInfo * getParameterInfo(long index);
+	// maps a 0.0 - 1.0 parameter value onto the parameter's range
+	static float getParameterScaled(long index, float value);
+	// the host-style parameter strings (the display one gets remade only when the value has changed)
+	void getParameterName(long index, char *label);
+	void getParameterDisplay(long index, char *text);
+	void getParameterLabel(long index, char *label);
+
+	// the GUI calls this from its own thread to drain the telemetry, one record at a time;
+	// returns false when there's nothing new
+	bool readTelemetry(BufferOverrideTelemetry *record) {
+		return telemetry.pop(record);
+	}
 protected:
-	void d_run(float **inputs, float **outputs, long sampleFrames, bool replacing);
+	void d_run(float **inputs, float **outputs, uint32_t sampleFrames);
 	void updateBuffer(long samplePos);
-
-	void initPresets();
+	void heedBufferOverrideEvents(long samplePos);
+	double getPitchbendScalar();
+	void summarizeCapture(BufferOverrideTelemetry *record);
+	void binCapture(float **inputs, long offset, long numSamples);
+	void resetCaptureBins();
+	void updateLayer(BufferOverrideLayer *layer, long samplePos, float smoothParam);
+	void processSpan(float **inputs, float **outputs, long offset, long numSamples);
+	void resetLayer(BufferOverrideLayer *layer);
+	void skipSpan(long offset, long numSamples);
+	void updateCaptureLimit(bool newForcedBuffer);
+	// whether there might be any smoothing (if not, the next forced buffer's opening crossfade reads nothing)
+	bool canSmooth() {
+		return (fSmooth > 0.0f) || modBank->isRouted(kSmooth);
+	}
+	long getMaxNextSmooth();
+	// raises the capture limit to the end of the forced buffer if getMaxNextSmooth() has gone past what it was
+	void allowForNextSmooth(long oldMaxNextSmooth) {
+		if (getMaxNextSmooth() > oldMaxNextSmooth)
+			dsp.captureLimit = dsp.currentForcedBufferSize;
+	}
+	void saveCheckpoint(long samplePos);
+	void forgetCheckpointsAfter(int64_t samplePosition);
+	bool applyCheckpoint(const BufferOverrideCheckpoint *checkpoint);
+	void logForcedBuffer(long samplePos);
+	void logSegment(long offset, long numSamples);
+	void setSegmentRead(BufferOverrideSegmentRead *read, long readPos, long prevMinibufferSize, long smoothcount, long numSamples);
+	void copySettings(BufferOverride *source);
+	bool usesRandomShapes();
+	void applyRandomSeed();
+	void restartLFOs();
+	void rebuildHistory(float **inputs, const BufferOverrideForcedBuffer *log, long forcedBufferIndex);
+	void renderRange(float **inputs, float **outputs, int64_t start, int64_t end);
+	static void * renderOfflineThread(void *job);
+	static void * renderSweepThread(void *job);
+	float modulatedParameter(long index, float baseValue, long samplePos);
+	void calculateDryWetGains(float dryWetMix);
+	bool createAudioBuffers();
+	bool leaseAudioBuffers();
+	void releaseAudioBuffers();
+	bool updateIdleState(float **inputs, long numSamples);
+
+	const BufferOverrideProgram * getProgram(long index);
+	void loadProgram(long programNum);
 	void d_sampleRateChanged(double newSampleRate);
 
+	BufferOverrideDSP dsp;	// everything that the audio loop touches, kept first & away from the rest
+
 	// the parameters
 	float fDivisor, fBuffer, fBufferTempoSync, fBufferInterrupt, fSmooth, fDryWetMix, fPitchbend, fMidiMode, fTempo;
 
-	BufferOverrideProgram *programs;	// presets / program slots
-
-	long currentForcedBufferSize;	// the size of the larger, imposed buffer
-	// these store the forced buffer
-	float *buffer1;
-#ifdef BUFFEROVERRIDE_STEREO
-	float *buffer2;
-#endif
-	long writePos;	// the current sample position within the forced buffer
-
-	long minibufferSize;	// the current size of the divided "mini" buffer
-	long prevMinibufferSize;	// the previous size
-	long readPos;	// the current sample position within the minibuffer
+	// our own copies of the program slots that have been changed from the factory presets, plus the current
+	// one (NULL for the rest); d_setProgram() makes them, & setStateChunk() makes the ones that a state chunk
+	// needs ahead of time, so that applying it just swaps them in
+	BufferOverrideProgram *userPrograms[NUM_PROGRAMS];
+
+	uint32_t forcedBufferFraction;	// the fraction of a sample (in 32.32 fixed-point) that tempo sync carries over into the next forced buffer
+	long captureFormat;	// the storage format of the forced buffer
+	float int16Headroom;	// where the int16 format clips
+	// a capture format from a state chunk that got applied in d_run(), for the next d_activate() (-1 if there isn't one)
+	long pendingCaptureFormat;
+	float pendingInt16Headroom;
 	float currentBufferDivisor;	// the current value of the divisor with LFO possibly applied
 
-	float numLFOpointsDivSR;	// the number of LFO table points divided by the sampling rate
+	float LFOphaseRangeDivSR;	// the LFO phase units in one cycle divided by the sampling rate
 
-	VstTimeInfo *timeInfo;
-	float currentTempoBPS;	// tempo in beats per second
-	TempoRateTable *tempoRateTable;	// a table of tempo rate values
+	double currentTempoBPS;	// tempo in beats per second (double, like the host's, all the way to the forced buffer size)
 	long hostCanDoTempo;	// my semi-booly dude who knows something about the host's VstTimeInfo implementation
 	bool needResync;
+	long hostSamplesToBar;	// from the start of the current block to the next bar, as of the host's transport
+	// where the next block should start on the host's timeline, for finding this cycle's SharedTransport
+	// snapshot (only while the transport is playing, since otherwise the position doesn't tell cycles apart)
+	double nextHostSamplePos;
+	bool hostPositionKnown;
 
 	long SUPER_MAX_BUFFER;
-	float SAMPLERATE;
+	double SAMPLERATE;
 
-	long smoothDur, smoothcount;	// total duration & sample counter for the minibuffer transition smoothing period
+	long smoothDur;	// total duration of the minibuffer transition smoothing period
 	float smoothStep;	// the gain increment for each sample "step" during the smoothing period
 	float sqrtFadeIn, sqrtFadeOut;	// square root of the smoothing gains, for equal power crossfading
 	float smoothFract;
 
-	double pitchbend, oldPitchbend;	// pitchbending scalar values
-	VstMidi *midistuff;	// all of the MIDI everythings
-	bool oldNote;	// says if there was an old, unnatended note-on or note-off from a previous block
+	double pitchbend;	// pitchbending scalar value
+	MIDIqueue *midistuff;	// all of the MIDI everythings
 	int lastNoteOn, lastPitchbend;	// these carry over the last events from a previous processing block
 	bool divisorWasChangedByHand;	// for MIDI trigger mode - tells us to respect the fDivisor value
 	bool divisorWasChangedByMIDI;	// tells the GUI that the divisor displays need updating
 
-	LFO *divisorLFO, *bufferLFO;
-
-	float fadeOutGain, fadeInGain, realFadePart, imaginaryFadePart;	// for trig crossfading
+	LFO divisorLFO, bufferLFO;
+	long LFOgranularity;	// the number of samples between control-rate LFO updates
+	LFObank *modBank;	// the modulation matrix LFOs, which can be routed to the parameters that setModulation() takes
+	uint32_t randomSeed;	// where the LFOs' random sequences start at each d_deactivate() (0 if they don't start over)
+	bool referenceMode;	// all of the fast paths are off (see setReferenceMode())
+
+	BufferOverrideLayer layers[MAX_EXTRA_LAYERS];	// the extra stutter layers
+	long lastForcedBufferSize;	// the size of the forced buffer before the current one, for the layers' smoothing
+	long lastCaptureEnd;	// how much of the forced buffer before the current one got captured, for the smoothing
+	long captureReach;	// how far into the forced buffer the main layer might still read (see getCaptureReach())
+
+	SPSCring<BufferOverrideTelemetry, TELEMETRY_RING_SIZE> telemetry;	// minibuffer info for the GUI
+	// the lowest & highest samples captured so far in each stretch of the forced buffer, for the telemetry
+	// (see binCapture()), & how many samples of the forced buffer each of those stretches is
+	float captureBinMin[TELEMETRY_CAPTURE_BINS], captureBinMax[TELEMETRY_CAPTURE_BINS];
+	long captureBinSize;
+
+	int64_t renderPosition;	// the number of samples processed since the last d_deactivate(), up to the current block
+	long checkpointInterval;	// the least number of samples between checkpoints (0 if they're off)
+	BufferOverrideCheckpoint *firstCheckpoint, *lastCheckpoint;	// the checkpoints so far, in order
+	long numCheckpoints;
+
+	// for renderOffline()
+	bool scheduleOnly;	// d_run() works out the boundaries & the LFOs, but doesn't touch any audio
+	bool renderingOffline;	// there's no host timeline to follow
+	BufferOverrideForcedBuffer *forcedBufferLog;	// every forced buffer so far, if it's not NULL
+	long forcedBufferLogSize, forcedBufferLogCapacity;
+	// for makeSegmentList()
+	int64_t forcedBufferStart, lastForcedBufferStart;	// where the current & previous forced buffers started
+	BufferOverrideSegment *segmentList;	// the segments so far, if it's not NULL
+	long segmentListSize, segmentListCapacity;
+
+	// a state chunk that's been loaded but not put into the programs yet, which d_run() or d_activate()
+	// takes care of (see stagedStateStatus), so that d_setState() never changes anything under d_run()
+	// (NULL until the first one comes along)
+	BufferOverrideStagedState *stagedState;
+	std::atomic<int> stagedStateStatus;
+	bool applyStagedState();
+
+	// the modulation matrix slots that setModulation() has changed since the last block, which d_run()
+	// puts into the bank, along with what the routing does to the capture limit (see stagedModulationStatus)
+	struct {
+		long destination;
+		float rate, depth, shape, tempoSync;
+		bool changed;
+	} stagedModulation[NUM_MOD_SLOTS];
+	std::atomic<int> stagedModulationStatus;
+	void applyStagedModulation();
+	void applyModulation(long slot, long destination, float rate, float depth, float shape, float tempoSync);
+
+	long idleReleaseSamples;	// how long the input has to be silent before the capture buffers go back to the pool (0 for never)
+	int64_t silentSamples;	// how long the input has been silent for so far
+
+	// the parameter display strings as of the last time that each was asked for, & what they were made from
+	char displayCache[NUM_PARAMETERS][PARAMETER_DISPLAY_LENGTH];
+	float displayCacheValue[NUM_PARAMETERS], displayCacheTempoSync[NUM_PARAMETERS];
+	bool displayCacheValid[NUM_PARAMETERS];
 
 	// Distrho plugin functions
 	const char* d_getLabel() const noexcept override {
@@ -171,6 +661,7 @@ protected:
 
 	void d_initParameter(uint32_t index, Parameter& parameter) override;
 	void d_initProgramName(uint32_t index, d_string& programName) override;
+	void d_initStateKey(uint32_t index, d_string& stateKey) override;
 
 	// -------------------------------------------------------------------
 	// Internal data
@@ -178,6 +669,7 @@ protected:
 	float d_getParameterValue(uint32_t index) const override;
 	void  d_setParameterValue(uint32_t index, float value) override;
 	void  d_setProgram(uint32_t index) override;
+	void  d_setState(const char* key, const char* value) override;
 
 	// -------------------------------------------------------------------
 	// Process
@@ -187,6 +679,60 @@ protected:
 	void d_run(const float** inputs, float** outputs, uint32_t frames) override;
 };
 
+
+//-----------------------------------------------------------------------------
+// A program slot.  The factory presets are one constant table of these that every
+// instance shares, & an instance only fills in its own copy of a slot once it's changed.
+struct BufferOverrideProgram
+{
+	char name[PROGRAM_NAME_LENGTH];
+	float param[BufferOverride::NUM_PARAMETERS];
+};
+
+
+//-----------------------------------------------------------------------------
+// The complete saved state:  all of the programs & which one is current, plus the settings that
+// aren't parameters (the modulation matrix, the extra layers & the capture format).
+// This is a fixed layout in native byte order, so a whole chunk gets checked once
+// & then copied in bulk.  (The magic number reads wrong if the byte order differs.)
+// It travels through the DISTRHO state as a hex string under STATE_CHUNK_KEY.
+struct BufferOverrideStateChunk
+{
+	int32_t magic;	// STATE_CHUNK_MAGIC
+	int32_t version;	// STATE_CHUNK_VERSION
+	int32_t numPrograms;	// NUM_PROGRAMS
+	int32_t numParameters;	// BufferOverride::NUM_PARAMETERS
+	int32_t currentProgram;
+	int32_t reserved;	// keeps the rest 8-byte aligned; always 0
+	char programNames[NUM_PROGRAMS][PROGRAM_NAME_LENGTH];
+	float programParams[NUM_PROGRAMS][BufferOverride::NUM_PARAMETERS];
+	// the modulation matrix (see setModulation())
+	int32_t numModSlots;	// NUM_MOD_SLOTS
+	int32_t modDestination[NUM_MOD_SLOTS];	// kNoModDestination for the slots that aren't routed
+	float modRate[NUM_MOD_SLOTS], modDepth[NUM_MOD_SLOTS], modShape[NUM_MOD_SLOTS], modTempoSync[NUM_MOD_SLOTS];
+	// the extra stutter layers (see setNumExtraLayers() & setLayer())
+	int32_t numLayers;	// MAX_EXTRA_LAYERS
+	int32_t numExtraLayers;	// how many of them are on
+	float layerDivisor[MAX_EXTRA_LAYERS], layerLFOrate[MAX_EXTRA_LAYERS], layerLFOdepth[MAX_EXTRA_LAYERS];
+	float layerLFOshape[MAX_EXTRA_LAYERS], layerLFOtempoSync[MAX_EXTRA_LAYERS], layerGain[MAX_EXTRA_LAYERS];
+	// how the captured audio gets stored (see setCaptureFormat())
+	int32_t captureFormat;
+	float int16Headroom;
+};
+
+// a state chunk waiting for applyStagedState(), with the program slots that it wants already copied out
+struct BufferOverrideStagedState
+{
+	BufferOverrideStateChunk chunk;
+	// NULL for the slots that are the factory presets; applying the chunk swaps these with the
+	// instance's own, so afterwards these are the old ones, for the next setStateChunk() to reuse or delete
+	BufferOverrideProgram *programs[NUM_PROGRAMS];
+};
+
+// writes a chunk as the hex string that goes with STATE_CHUNK_KEY, for whatever saves it (the UI passes it back
+// through setState(), or a host can save it directly); text needs room for STATE_CHUNK_TEXT_SIZE characters
+void encodeStateChunk(const BufferOverrideStateChunk *chunk, char *text);
+
 END_NAMESPACE_DISTRHO
 
 #endif
@@ -4,11 +4,14 @@
 #include "bufferOverride.hpp"
 #endif
 
-START_NAMESPACE_DISTRHO
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
 #include <math.h>
+#include <float.h>
+#include <new>
+
+START_NAMESPACE_DISTRHO
 
 
 #pragma mark _________init_________
@@ -17,20 +20,30 @@ START_NAMESPACE_DISTRHO
 // initializations & such
 
 BufferOverride::BufferOverride()
-	: Plugin(paramCount, NUM_PROGRAMS, NUM_PARAMETERS) // 16 programs, 17 parameters
+	: Plugin(NUM_PARAMETERS, NUM_PROGRAMS, 1) // 17 parameters, 16 programs, 1 state (the chunk)
 {
-	// set default values
-	d_setProgram(0);
+	stagedState = NULL;
+	stagedStateStatus.store(kStagedStateEmpty);
+	for (long i=0; i < NUM_MOD_SLOTS; i++)
+		stagedModulation[i].changed = false;
+	stagedModulationStatus.store(kStagedStateEmpty);
+	// every program slot starts out as its factory preset
+	for (long i=0; i < NUM_PROGRAMS; i++)
+		userPrograms[i] = NULL;
+	curProgram = 0;
+	// none of the parameter display strings have been made yet
+	for (long i=0; i < NUM_PARAMETERS; i++)
+		displayCacheValid[i] = false;
 
-	// reset
-	d_deactivate();
-
-	buffer1 = NULL;
-#ifdef BUFFEROVERRIDE_STEREO
-	buffer2 = NULL;
-#endif
-	// default this to something, for the sake of getTailSize()
-	SUPER_MAX_BUFFER = (long) ((44100.0f / MIN_ALLOWABLE_BPS) * 4.0f);
+	captureFormat = kCaptureFloat32;
+	int16Headroom = CAPTURE_INT16_HEADROOM;
+	pendingCaptureFormat = -1;
+	pendingInt16Headroom = CAPTURE_INT16_HEADROOM;
+	dsp.kernels = getDFXkernels();
+	// default these to something, for the sake of getTailSize() & getMaxNextSmooth()
+	SAMPLERATE = 44100.0;
+	SUPER_MAX_BUFFER = (long) ((SAMPLERATE / MIN_ALLOWABLE_BPS) * 4.0f);
+	currentTempoBPS = 0.0;
 
 #ifdef BUFFEROVERRIDE_STEREO
 	setNumInputs(2);	// stereo inputs; not a synth
@@ -38,7 +51,6 @@ BufferOverride::BufferOverride()
 #else
 	setNumInputs(1);	// mono inputs; not a synth
 #endif
-#endif
 
 #ifdef BUFFEROVERRIDE_STEREO
 	setNumOutputs(2);	// stereo out
@@ -50,174 +62,118 @@ BufferOverride::BufferOverride()
 	canProcessReplacing();	// supports both accumulating and replacing output
 
 	// allocate memory for these structures
-	tempoRateTable = new TempoRateTable;
-	divisorLFO = new LFO;
-	bufferLFO = new LFO;
+	midistuff = new MIDIqueue;
+	modBank = new LFObank;
+	randomSeed = 0;	// the random LFOs are as unpredictable as usual unless somebody asks otherwise
+	referenceMode = false;
+	// no checkpoints unless somebody asks for them
+	checkpointInterval = 0;
+	firstCheckpoint = lastCheckpoint = NULL;
+	numCheckpoints = 0;
+	scheduleOnly = renderingOffline = false;
+	// the capture buffers stay with the instance for as long as it's active, unless somebody asks otherwise
+	idleReleaseSamples = 0;
+	silentSamples = 0;
+	forcedBufferLog = NULL;
+	forcedBufferLogSize = forcedBufferLogCapacity = 0;
+	segmentList = NULL;
+	segmentListSize = segmentListCapacity = 0;
+	// the extra stutter layers start out off
+	dsp.numExtraLayers = 0;
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++)
+		setLayer(n, 0.0f, LFOrateUnscaled(0.3f), 0.0f, 0.0f, 0.0f, 1.0f);
+	setLFOgranularity(LFO_DEFAULT_GRANULARITY);
 
-	chunk = new VstChunk(NUM_PARAMETERS, NUM_PROGRAMS, PLUGIN_ID, this);
-	programs = new BufferOverrideProgram[NUM_PROGRAMS];
-	setProgram(0);
-	strcpy(programs[0].name, "self-determined");	// default program name
-	initPresets();
+	// d_setParameterValue() compares some of the new values with the old ones, so there have to be old ones
+	fDivisor = fBuffer = fBufferTempoSync = fBufferInterrupt = 0.0f;
+	fSmooth = fDryWetMix = fPitchbend = fMidiMode = fTempo = 0.0f;
+	lastPitchbend = kInvalidMidi;	// (the pitchbend range goes by the last bend)
+	// set default values
+	d_setProgram(0);
 
-	suspend();
+	// reset
+	d_deactivate();
 
 	// check to see if the host supports sending tempo & time information to VST plugins
 	hostCanDoTempo = canHostDo("sendVstTimeInfo");
 	// default the tempo to something more reasonable than 39 bmp
 	// also give currentTempoBPS a value in case that's useful for a freshly opened GUI
 	if (hostCanDoTempo == 1)
-		currentTempoBPS = (float)tempoAt(0) / 600000.0f;
-	if ( (hostCanDoTempo != 1) || (currentTempoBPS <= 0.0f) ) {
-		setParameter( kTempo, tempoUnscaled(120.0f) );
-		currentTempoBPS = tempoScaled(fTempo) / 60.0f;
-	}
-
-	// Set up the programs.
-	int i = 1;
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(4.0f);
-	programs[i].param[kBuffer] = paramSteppedUnscaled(8.7f, NUM_TEMPO_RATES);
-	programs[i].param[kBufferTempoSync] = 1.0f;
-	programs[i].param[kSmooth] = 0.09f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(37.0f);
-	programs[i].param[kBuffer] = forcedBufferSizeUnscaled(444.0f);
-	programs[i].param[kBufferTempoSync] = 0.0f;
-	programs[i].param[kBufferInterrupt] = 1.0f;
-	programs[i].param[kDivisorLFOrate] = LFOrateUnscaled(0.3f);
-	programs[i].param[kDivisorLFOdepth] = 0.72f;
-	programs[i].param[kDivisorLFOshape] = LFOshapeUnscaled(kSawLFO);
-	programs[i].param[kDivisorLFOtempoSync] = 0.0f;
-	programs[i].param[kBufferLFOrate] = LFOrateUnscaled(0.27f);
-	programs[i].param[kBufferLFOdepth] = 0.63f;
-	programs[i].param[kBufferLFOshape] = LFOshapeUnscaled(kSawLFO);
-	programs[i].param[kBufferLFOtempoSync] = 0.0f;
-	programs[i].param[kSmooth] = 0.042f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-	i++;
-
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(170.0f);
-	programs[i].param[kBuffer] = forcedBufferSizeUnscaled(128.0f);
-	programs[i].param[kBufferTempoSync] = 0.0f;
-	programs[i].param[kBufferInterrupt] = 1.0f;
-	programs[i].param[kDivisorLFOrate] = LFOrateUnscaled(9.0f);
-	programs[i].param[kDivisorLFOdepth] = 0.87f;
-	programs[i].param[kDivisorLFOshape] = LFOshapeUnscaled(kThornLFO);
-	programs[i].param[kDivisorLFOtempoSync] = 0.0f;
-	programs[i].param[kBufferLFOrate] = LFOrateUnscaled(5.55f);
-	programs[i].param[kBufferLFOdepth] = 0.69f;
-	programs[i].param[kBufferLFOshape] = LFOshapeUnscaled(kReverseSawLFO);
-	programs[i].param[kBufferLFOtempoSync] = 0.0f;
-	programs[i].param[kSmooth] = 0.201f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-	i++;
-
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(42.0f);
-	programs[i].param[kBuffer] = forcedBufferSizeUnscaled(210.0f);
-	programs[i].param[kBufferTempoSync] = 0.0f;
-	programs[i].param[kBufferInterrupt] = 1.0f;
-	programs[i].param[kDivisorLFOrate] = LFOrateUnscaled(3.78f);
-	programs[i].param[kDivisorLFOdepth] = 0.9f;
-	programs[i].param[kDivisorLFOshape] = LFOshapeUnscaled(kRandomLFO);
-	programs[i].param[kDivisorLFOtempoSync] = 0.0f;
-	programs[i].param[kBufferLFOdepth] = 0.0f;
-	programs[i].param[kSmooth] = 0.039f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-	i++;
-
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(9.0f);
-	programs[i].param[kBuffer] = forcedBufferSizeUnscaled(747.0f);
-	programs[i].param[kBufferTempoSync] = 0.0f;
-	programs[i].param[kDivisorLFOrate] = 0.0f;
-	programs[i].param[kDivisorLFOdepth] = 0.0f;
-	programs[i].param[kDivisorLFOshape] = LFOshapeUnscaled(kTriangleLFO);
-	programs[i].param[kDivisorLFOtempoSync] = 0.0f;
-	programs[i].param[kBufferLFOrate] = LFOrateUnscaled(0.174f);
-	programs[i].param[kBufferLFOdepth] = 0.21f;
-	programs[i].param[kBufferLFOshape] = LFOshapeUnscaled(kTriangleLFO);
-	programs[i].param[kBufferLFOtempoSync] = 0.0f;
-	programs[i].param[kSmooth] = 0.081f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-	i++;
-
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(2.001f);
-	programs[i].param[kBuffer] = forcedBufferSizeUnscaled(603.0f);
-	programs[i].param[kBufferTempoSync] = 0.0f;
-	programs[i].param[kDivisorLFOdepth] = 0.0f;
-	programs[i].param[kBufferLFOdepth] = 0.0f;
-	programs[i].param[kSmooth] = 1.0f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-	i++;
-
-	programs[i].param[kDivisor] = bufferDivisorUnscaled(27.0f);
-	programs[i].param[kBuffer] = forcedBufferSizeUnscaled(81.0f);
-	programs[i].param[kBufferTempoSync] = 0.0f;
-	programs[i].param[kBufferInterrupt] = 1.0f;
-	programs[i].param[kDivisorLFOrate] = paramSteppedUnscaled(6.6f, NUM_TEMPO_RATES);
-	programs[i].param[kDivisorLFOdepth] = 0.333f;
-	programs[i].param[kDivisorLFOshape] = LFOshapeUnscaled(kSineLFO);
-	programs[i].param[kDivisorLFOtempoSync] = 1.0f;
-	programs[i].param[kBufferLFOrate] = 0.0f;
-	programs[i].param[kBufferLFOdepth] = 0.06f;
-	programs[i].param[kBufferLFOshape] = LFOshapeUnscaled(kSawLFO);
-	programs[i].param[kBufferLFOtempoSync] = 1.0f;
-	programs[i].param[kSmooth] = 0.06f;
-	programs[i].param[kDryWetMix] = 1.0f;
-	programs[i].param[kMidiMode] = 0.0f;
-	programs[i].param[kTempo] = 0.0f;
+		currentTempoBPS = (double)tempoAt(0) / 600000.0;
+	if ( (hostCanDoTempo != 1) || (currentTempoBPS <= 0.0) ) {
+		// (this doesn't go into the program slot)
+		fTempo = tempoUnscaled(120.0f);
+		currentTempoBPS = tempoScaled(fTempo) / 60.0;
+	}
 }
 
 //-------------------------------------------------------------------------
 BufferOverride::~BufferOverride()
 {
-	if (programs)
-		delete[] programs;
-	if (chunk)
-		delete chunk;
+	for (long i=0; i < NUM_PROGRAMS; i++)
+		delete userPrograms[i];
+	if (stagedState) {
+		for (long i=0; i < NUM_PROGRAMS; i++)
+			delete stagedState->programs[i];
+		delete stagedState;
+	}
 
-	// deallocate the memory from these arrays
-	if (buffer1)
-		delete[] buffer1;
-#ifdef BUFFEROVERRIDE_STEREO
-	if (buffer2)
-		delete[] buffer2;
-#endif
+	// give back the memory from these arrays
+	releaseAudioBuffers();
+	setIdleRelease(0);
 	if (midistuff)
 		delete midistuff;
-	if (tempoRateTable)
-		delete tempoRateTable;
-	if (divisorLFO)
-		delete divisorLFO;
-	if (bufferLFO)
-		delete bufferLFO;
+	if (modBank)
+		delete modBank;
+	clearCheckpoints();
+}
+
+//-------------------------------------------------------------------------
+// new only has to line things up for the basic types, but the DSP state wants whole cache lines
+void * BufferOverride::operator new(size_t size)
+{
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::operator delete(void *ptr)
+{
+	free(ptr);
 }
 
 //-------------------------------------------------------------------------
 void BufferOverride::d_deactivate()
 {
 	// setting the values like this will restart the forced buffer in the next process()
-	currentForcedBufferSize = 1;
-	writePos = readPos = 1;
-	minibufferSize = 1;
-	prevMinibufferSize = 0;
-	smoothcount = smoothDur = 0;
+	dsp.currentForcedBufferSize = 1;
+	forcedBufferFraction = 0;
+	dsp.writePos = dsp.readPos = 1;
+	dsp.minibufferSize = 1;
+	dsp.prevMinibufferSize = 0;
+	dsp.smoothcount = smoothDur = 0;
 	sqrtFadeIn = sqrtFadeOut = 1.0f;
+	dsp.captureLimit = dsp.captureEnd = dsp.currentForcedBufferSize;	// (as if all of that 1 sample got captured)
+	captureReach = lastCaptureEnd = 0;
+	resetCaptureBins();
+	// (the checkpoints stay, since a render can still go back to one, but positions start over)
+	renderPosition = 0;
+	forcedBufferStart = lastForcedBufferStart = 0;
+	// (& whatever the host's transport was up to before doesn't say anything about what comes next)
+	hostPositionKnown = false;
+	hostSamplesToBar = 0;
+	// (& the capture buffers go back to the pool until they're wanted again)
+	releaseAudioBuffers();
+	silentSamples = 0;
 
-	divisorLFO->reset();
-	bufferLFO->reset();
+	restartLFOs();
+	lastForcedBufferSize = 0;
 
-	oldNote = false;
 	lastNoteOn = kInvalidMidi;
 	lastPitchbend = kInvalidMidi;
 	pitchbend = 1.0;
-	oldPitchbend = 1.0;
 	divisorWasChangedByMIDI = divisorWasChangedByHand = false;
 	midistuff->reset();
 }
@@ -229,6 +185,17 @@ void BufferOverride::d_activate()
 	needResync = true;	// some hosts may call resume when restarting playback
 	wantEvents();
 
+	// now is the time to apply a state chunk that got loaded while we were inactive
+	// (or the capture format of one that got applied while we were running)
+	applyStagedModulation();
+	bool newState = applyStagedState();
+	if (pendingCaptureFormat >= 0)
+		setCaptureFormat(pendingCaptureFormat, pendingInt16Headroom);
+	// (that reset the layers' LFOs again, so start them all over like d_deactivate() did,
+	// as if the state had been there before then)
+	if (newState)
+		restartLFOs();
+
 	createAudioBuffers();
 }
 
@@ -238,111 +205,1124 @@ void BufferOverride::d_sampleRateChanged(double newSampleRate)
 	// update the sample rate value
 	SAMPLERATE = newSampleRate;
 	// just in case the host responds with something wacky
-	if (SAMPLERATE <= 0.0f)
-		SAMPLERATE = 44100.0f;
-	long oldMax = SUPER_MAX_BUFFER;
+	if (SAMPLERATE <= 0.0)
+		SAMPLERATE = 44100.0;
 	SUPER_MAX_BUFFER = (long) ((SAMPLERATE / MIN_ALLOWABLE_BPS) * 4.0f);
 
 	// if the sampling rate (& therefore the max buffer size) has changed,
-	// then delete & reallocate the buffers according to the sampling rate
-	if (SUPER_MAX_BUFFER != oldMax) {
-		if (buffer1 != NULL)
-			delete[] buffer1;
-		buffer1 = NULL;
+	// then reallocate the buffers according to the sampling rate, if there are any right now
+	// (otherwise they'll get made that size when they're wanted)
+	if (dsp.buffer1.isAllocated())
+		createAudioBuffers();
+}
+
+//-------------------------------------------------------------------------
+// gets the capture buffers if they aren't already there (this doesn't do anything if they're already the right size)
+bool BufferOverride::createAudioBuffers()
+{
+	bool success = dsp.buffer1.allocate(SUPER_MAX_BUFFER, captureFormat);
+#ifdef BUFFEROVERRIDE_STEREO
+	success = dsp.buffer2.allocate(SUPER_MAX_BUFFER, captureFormat) && success;
+#endif
+	return success;
+}
+
+//-------------------------------------------------------------------------
+// the same, but only with spares from the CapturePool, for the audio thread
+// (a channel that got one goes back if the other one didn't, so that they can't get stuck half-allocated)
+bool BufferOverride::leaseAudioBuffers()
+{
+	bool success = dsp.buffer1.allocateFromPool(SUPER_MAX_BUFFER, captureFormat);
+#ifdef BUFFEROVERRIDE_STEREO
+	success = dsp.buffer2.allocateFromPool(SUPER_MAX_BUFFER, captureFormat) && success;
+	if (!success) {
+		dsp.buffer1.releaseToPool();
+		dsp.buffer2.releaseToPool();
+	}
+#endif
+	return success;
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::releaseAudioBuffers()
+{
+	dsp.buffer1.release();
+#ifdef BUFFEROVERRIDE_STEREO
+	dsp.buffer2.release();
+#endif
+	// idle instances can fill the pool up past its usual number of spares without freeing anything,
+	// so this is a good time to let go of the extras
+	CapturePool::get()->trim(CAPTURE_POOL_SPARES);
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::setIdleRelease(long idleSamples)
+{
+	if (idleSamples < 0)
+		idleSamples = 0;
+	// (the pool's housekeeping thread runs while any instance is doing this)
+	if ( (idleSamples > 0) && (idleReleaseSamples <= 0) )
+		CapturePool::get()->startHousekeeping();
+	else if ( (idleSamples <= 0) && (idleReleaseSamples > 0) )
+		CapturePool::get()->stopHousekeeping();
+	idleReleaseSamples = idleSamples;
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::setLFOgranularity(long newGranularity)
+{
+	if (newGranularity < 1)
+		newGranularity = 1;
+	LFOgranularity = newGranularity;
+	divisorLFO.setGranularity(LFOgranularity);
+	bufferLFO.setGranularity(LFOgranularity);
+	modBank->setGranularity(LFOgranularity);
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++)
+		layers[n].divisorLFO.setGranularity(LFOgranularity);
+}
+
+//-------------------------------------------------------------------------
+// only these pick up the modulation (see updateBuffer()), so a slot routed anywhere
+// else would just get rendered every block for nothing
+static bool isModDestination(long destination)
+{
+	switch (destination) {
+	case kNoModDestination :
+	case BufferOverride::kDivisor :
+	case BufferOverride::kBuffer :
+	case BufferOverride::kSmooth :
+	case BufferOverride::kDryWetMix :
+		return true;
+	default :
+		return false;
+	}
+}
+
+//-------------------------------------------------------------------------
+// claims a staging area to fill in (a new change joins one that's still waiting, but one that's
+// being applied right now has to be finished first, which doesn't take long)
+static void claimStaging(std::atomic<int> *status)
+{
+	int expected = kStagedStateEmpty;
+	while ( !status->compare_exchange_weak(expected, kStagedStateWriting, std::memory_order_acquire) ) {
+		if ( (expected == kStagedStateApplying) || (expected == kStagedStateWriting) ) {
+			std::this_thread::yield();
+			expected = kStagedStateEmpty;
+		}
+	}
+}
+
+//-------------------------------------------------------------------------
+bool BufferOverride::setModulation(long slot, long destination, float rate, float depth, float shape, float tempoSync)
+{
+	if ( (slot < 0) || (slot >= NUM_MOD_SLOTS) || !isModDestination(destination) )
+		return false;
+
+	claimStaging(&stagedModulationStatus);
+	stagedModulation[slot].destination = destination;
+	stagedModulation[slot].rate = rate;
+	stagedModulation[slot].depth = depth;
+	stagedModulation[slot].shape = shape;
+	stagedModulation[slot].tempoSync = tempoSync;
+	stagedModulation[slot].changed = true;
+	stagedModulationStatus.store(kStagedStateReady, std::memory_order_release);
+	return true;
+}
+
+//-------------------------------------------------------------------------
+// puts the slots that setModulation() has changed into the bank (this is for d_run() & d_activate(),
+// & for the offline renders before they start, so it doesn't allocate anything)
+void BufferOverride::applyStagedModulation()
+{
+	int status = kStagedStateReady;
+	if ( !stagedModulationStatus.compare_exchange_strong(status, kStagedStateApplying, std::memory_order_acquire) )
+		return;
+	for (long slot = 0; slot < NUM_MOD_SLOTS; slot++) {
+		if (stagedModulation[slot].changed) {
+			applyModulation(slot, stagedModulation[slot].destination, stagedModulation[slot].rate,
+							stagedModulation[slot].depth, stagedModulation[slot].shape, stagedModulation[slot].tempoSync);
+			stagedModulation[slot].changed = false;
+		}
+	}
+	stagedModulationStatus.store(kStagedStateEmpty, std::memory_order_release);
+}
+
+//-------------------------------------------------------------------------
+// what setModulation() does, right away (only for when nothing is processing, or from d_run() itself)
+void BufferOverride::applyModulation(long slot, long destination, float rate, float depth, float shape, float tempoSync)
+{
+	modBank->fRate[slot] = rate;
+	modBank->fTempoSync[slot] = tempoSync;
+	modBank->setShape(slot, shape);
+	modBank->setDepth(slot, depth);
+	// (see d_setParameterValue())
+	long oldMaxNextSmooth = getMaxNextSmooth();
+	modBank->setRouting(slot, destination);
+	allowForNextSmooth(oldMaxNextSmooth);
+}
+
+
+//-------------------------------------------------------------------------
+size_t BufferOverride::getMemoryUsage()
+{
+	size_t numBytes = sizeof(BufferOverride) + sizeof(LFObank);
+	for (long i=0; i < NUM_PROGRAMS; i++) {
+		if (userPrograms[i])
+			numBytes += sizeof(BufferOverrideProgram);
+	}
+	if (stagedState) {
+		numBytes += sizeof(BufferOverrideStagedState);
+		for (long i=0; i < NUM_PROGRAMS; i++) {
+			if (stagedState->programs[i])
+				numBytes += sizeof(BufferOverrideProgram);
+		}
+	}
+	numBytes += dsp.buffer1.getAllocatedBytes();
 #ifdef BUFFEROVERRIDE_STEREO
-		if (buffer2 != NULL)
-			delete[] buffer2;
-		buffer2 = NULL;
+	numBytes += dsp.buffer2.getAllocatedBytes();
+	const long numChannels = 2;
+#else
+	const long numChannels = 1;
 #endif
+	for (BufferOverrideCheckpoint *checkpoint = firstCheckpoint; checkpoint != NULL; checkpoint = checkpoint->next) {
+		numBytes += sizeof(BufferOverrideCheckpoint) + 1;	// (see saveCheckpoint())
+		numBytes += checkpoint->historyLength * CaptureBuffer::bytesPerSample(checkpoint->captureFormat) * numChannels;
 	}
-	if (buffer1 == NULL)
-		buffer1 = new float[SUPER_MAX_BUFFER];
+	numBytes += forcedBufferLogCapacity * sizeof(BufferOverrideForcedBuffer);
+	numBytes += segmentListCapacity * sizeof(BufferOverrideSegment);
+	return numBytes;
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::setCaptureFormat(long newFormat, float newInt16Headroom)
+{
+	if ( (newFormat < 0) || (newFormat >= numCaptureFormats) )
+		return;
+	captureFormat = newFormat;
+	pendingCaptureFormat = -1;
+	dsp.buffer1.setInt16Headroom(newInt16Headroom);
+#ifdef BUFFEROVERRIDE_STEREO
+	dsp.buffer2.setInt16Headroom(newInt16Headroom);
+#endif
+	// (the buffers leave out a value that doesn't make sense)
+	int16Headroom = dsp.buffer1.getInt16Headroom();
+	// reformat the buffers if they're already allocated; otherwise they'll get made this way
+	if (dsp.buffer1.isAllocated())
+		dsp.buffer1.allocate(SUPER_MAX_BUFFER, captureFormat);
+#ifdef BUFFEROVERRIDE_STEREO
+	if (dsp.buffer2.isAllocated())
+		dsp.buffer2.allocate(SUPER_MAX_BUFFER, captureFormat);
+#endif
+	// whatever was captured is gone now, so start a new forced buffer
+	dsp.currentForcedBufferSize = 1;
+	dsp.writePos = dsp.readPos = 1;
+	dsp.minibufferSize = 1;
+	dsp.prevMinibufferSize = 0;
+	dsp.smoothcount = smoothDur = 0;
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++)
+		resetLayer(&(layers[n]));
+	resetCaptureBins();
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::setReferenceMode(bool newReferenceMode)
+{
+	referenceMode = newReferenceMode;
+	const DFXkernels *kernels = referenceMode ? getDFXreferenceKernels() : getDFXkernels();
+	dsp.kernels = kernels;
+	dsp.buffer1.setKernels(kernels);
 #ifdef BUFFEROVERRIDE_STEREO
-	if (buffer2 == NULL)
-		buffer2 = new float[SUPER_MAX_BUFFER];
+	dsp.buffer2.setKernels(kernels);
 #endif
+	modBank->setKernels(kernels);
+	divisorLFO.setKernels(kernels);
+	bufferLFO.setKernels(kernels);
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++)
+		layers[n].divisorLFO.setKernels(kernels);
+}
+
+#ifdef BUFFEROVERRIDE_RT_AUDIT
+//-------------------------------------------------------------------------
+long BufferOverride::auditRealTimeSafety(long numSamples)
+{
+	// odd block sizes, so that the boundaries land all over the place
+	const uint32_t blockSizes[] = { 1, 37, 64, 256, 511, 1024 };
+	const long numBlockSizes = sizeof(blockSizes) / sizeof(blockSizes[0]);
+	long startViolations = rtAuditGetViolations();
+
+	// (all of the setting up happens outside of d_run(), so it doesn't count)
+	float *input = new float[numSamples];
+	float *output1 = new float[numSamples];
+	float *output2 = new float[numSamples];
+	uint32_t noiseState = 1;
+	for (long i = 0; i < numSamples; i++)
+		input[i] = (0.5f * sinf((float)i * 0.01f)) + (0.25f * randomFloatXorshift(&noiseState)) - 0.125f;
+
+	for (long program = 0; program < NUM_PROGRAMS; program++) {
+		for (long midiMode = 0; midiMode < 2; midiMode++) {
+			for (long hostTempo = 0; hostTempo < 2; hostTempo++) {
+				d_setProgram(program);
+				d_setParameterValue(kMidiMode, (float)midiMode);
+				if (hostTempo)
+					d_setParameterValue(kTempo, 0.0f);	// (0 means follow the host)
+				// (restart the way a host would, which is also when the capture buffers get leased)
+				d_deactivate();
+				d_activate();
+				long blockIndex = program + midiMode + hostTempo;
+				for (long done = 0; done < numSamples; blockIndex++) {
+					uint32_t blockSize = blockSizes[blockIndex % numBlockSizes];
+					if (blockSize > (uint32_t)(numSamples - done))
+						blockSize = numSamples - done;
+					// MIDI & automation come in on the audio thread with some hosts, so they're audited too
+					{
+						RT_AUDIT_SCOPE(true);
+						uint32_t frame = randomXorshift(&noiseState) % blockSize;
+						uint8_t note = 36 + (randomXorshift(&noiseState) % 60);
+						switch (randomXorshift(&noiseState) % 8) {
+						case 0 :
+							queueMidiEvent(frame, kMidiNoteOn, note, 100);
+							break;
+						case 1 :
+							queueMidiEvent(frame, kMidiNoteOff, note, 0);
+							break;
+						case 2 :
+							queueMidiEvent(frame, kMidiPitchbend, randomXorshift(&noiseState) & 0x7F, randomXorshift(&noiseState) & 0x7F);
+							break;
+						case 3 :
+							queueMidiEvent(frame, kMidiCC, kMidiCCallNotesOff, 0);
+							break;
+						case 4 :
+							// (not the MIDI mode or the tempo, since this is going through each of those)
+							d_setParameterValue(randomXorshift(&noiseState) % kMidiMode, randomFloatXorshift(&noiseState));
+							break;
+						default :
+							break;
+						}
+					}
+					float *inputs[2] = { input + done, input + done };
+					float *outputs[2] = { output1 + done, output2 + done };
+					d_run(inputs, outputs, blockSize);
+					done += blockSize;
+				}
+			}
+		}
+	}
+
+	delete[] input;
+	delete[] output1;
+	delete[] output2;
+	d_deactivate();
+	return rtAuditGetViolations() - startViolations;
+}
+#endif
+
+//-------------------------------------------------------------------------
+void BufferOverride::setNumExtraLayers(long newNumLayers)
+{
+	if (newNumLayers < 0)
+		newNumLayers = 0;
+	else if (newNumLayers > MAX_EXTRA_LAYERS)
+		newNumLayers = MAX_EXTRA_LAYERS;
+	// layers that are just coming on start over with a new minibuffer right away
+	for (long n = dsp.numExtraLayers; n < newNumLayers; n++)
+		resetLayer(&(layers[n]));
+	// the capture limit didn't allow for them, so capture the rest of this forced buffer
+	if (newNumLayers > dsp.numExtraLayers)
+		dsp.captureLimit = dsp.currentForcedBufferSize;
+	dsp.numExtraLayers = newNumLayers;
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::setLayer(long layer, float divisor, float LFOrate, float LFOdepth, float LFOshape, float LFOtempoSync, float gain)
+{
+	if ( (layer < 0) || (layer >= MAX_EXTRA_LAYERS) )
+		return;
+
+	layers[layer].fDivisor = divisor;
+	layers[layer].fGain = gain;
+	layers[layer].divisorLFO.fRate = LFOrate;
+	layers[layer].divisorLFO.fDepth = LFOdepth;
+	layers[layer].divisorLFO.fShape = LFOshape;
+	layers[layer].divisorLFO.pickTheLFOwaveform();
+	layers[layer].divisorLFO.fTempoSync = LFOtempoSync;
 }
 
+//-------------------------------------------------------------------------
+// all of the LFOs start over, from the random seed if there is one
+void BufferOverride::restartLFOs()
+{
+	if (randomSeed != 0)
+		applyRandomSeed();
+	divisorLFO.reset();
+	bufferLFO.reset();
+	modBank->reset();
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++)
+		resetLayer(&(layers[n]));
+}
+
+//-------------------------------------------------------------------------
+// every LFO gets its own stream of the seed, so that they don't all wander together
+// (the bank takes a seed of its own that it splits up among its slots)
+void BufferOverride::applyRandomSeed()
+{
+	divisorLFO.setRandomState(randomSeedFromValue(randomSeed, 0));
+	bufferLFO.setRandomState(randomSeedFromValue(randomSeed, 1));
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++)
+		layers[n].divisorLFO.setRandomState(randomSeedFromValue(randomSeed, (uint32_t)(2 + n)));
+	modBank->setRandomSeed(randomSeedFromValue(randomSeed, 2 + MAX_EXTRA_LAYERS));
+}
+
+//-------------------------------------------------------------------------
+// a layer with an empty minibuffer gets updated on its very next sample
+void BufferOverride::resetLayer(BufferOverrideLayer *layer)
+{
+	layer->readPos = layer->minibufferSize = layer->prevMinibufferSize = 0;
+	layer->smoothcount = layer->smoothDur = 0;
+	layer->fadeInGain = layer->fadeOutGain = 0.0f;
+	layer->currentBufferDivisor = 1.0f;
+	layer->captureReach = 0;
+	layer->divisorLFO.reset();
+}
 
 #pragma mark _________programs_________
 
 //-----------------------------------------------------------------------------
-BufferOverrideProgram::BufferOverrideProgram()
-{
-	name = new char[32];
-	param = new float[NUM_PARAMETERS];
-
-	param[kDivisor] = 0.0f;
-	param[kBuffer] = forcedBufferSizeUnscaled(90.0f);
-	param[kBufferTempoSync] = 0.0f;	// default to no tempo sync
-	param[kBufferInterrupt] = 1.0f;	// default to on, use new forced buffer behaviour
-	param[kDivisorLFOrate] = LFOrateUnscaled(0.3f);
-	param[kDivisorLFOdepth] = 0.0f;
-	param[kDivisorLFOshape] = 0.0f;
-	param[kDivisorLFOtempoSync] = 0.0f;
-	param[kBufferLFOrate] = LFOrateUnscaled(3.0f);
-	param[kBufferLFOdepth] = 0.0f;
-	param[kBufferLFOshape] = 0.0f;
-	param[kBufferLFOtempoSync] = 0.0f;
-	param[kSmooth] = 0.09f;
-	param[kDryWetMix] = 1.0f;	// default to all wet
-	param[kPitchbend] = 6.0f / (float)PITCHBEND_MAX;
-	param[kMidiMode] = 0.0f;	// default to "nudge" mode
-	param[kTempo] = 0.0f;	// default to "auto" (i.e. get it from the host)
-	strcpy(name, "default");
+// the parameter values for a program slot that isn't anything in particular
+#define DEFAULT_PROGRAM_PARAMETERS \
+	0.0f,	/* kDivisor */ \
+	forcedBufferSizeUnscaledConst(90.0f),	/* kBuffer */ \
+	0.0f,	/* kBufferTempoSync:  default to no tempo sync */ \
+	1.0f,	/* kBufferInterrupt:  default to on, use new forced buffer behaviour */ \
+	LFOrateUnscaledConst(0.3f),	/* kDivisorLFOrate */ \
+	0.0f,	/* kDivisorLFOdepth */ \
+	0.0f,	/* kDivisorLFOshape */ \
+	0.0f,	/* kDivisorLFOtempoSync */ \
+	LFOrateUnscaledConst(3.0f),	/* kBufferLFOrate */ \
+	0.0f,	/* kBufferLFOdepth */ \
+	0.0f,	/* kBufferLFOshape */ \
+	0.0f,	/* kBufferLFOtempoSync */ \
+	0.09f,	/* kSmooth */ \
+	1.0f,	/* kDryWetMix:  default to all wet */ \
+	6.0f / (float)PITCHBEND_MAX,	/* kPitchbend */ \
+	0.0f,	/* kMidiMode:  default to "nudge" mode */ \
+	0.0f	/* kTempo:  default to "auto" (i.e. get it from the host) */
+
+//-----------------------------------------------------------------------------
+// The factory presets.  These are worked out at compile time & shared by every instance;
+// the values are in parameter order (see the Parameters enum).
+
+static constexpr BufferOverrideProgram factoryPrograms[NUM_PROGRAMS] =
+{
+	{ "self-determined", { DEFAULT_PROGRAM_PARAMETERS } },
+
+	{ "drum roll", {
+		bufferDivisorUnscaledConst(4.0f),	// kDivisor
+		paramSteppedUnscaled(8.7f, NUM_TEMPO_RATES),	// kBuffer
+		1.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		LFOrateUnscaledConst(0.3f),	// kDivisorLFOrate
+		0.0f,	// kDivisorLFOdepth
+		0.0f,	// kDivisorLFOshape
+		0.0f,	// kDivisorLFOtempoSync
+		LFOrateUnscaledConst(3.0f),	// kBufferLFOrate
+		0.0f,	// kBufferLFOdepth
+		0.0f,	// kBufferLFOshape
+		0.0f,	// kBufferLFOtempoSync
+		0.09f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "arpeggio", {
+		bufferDivisorUnscaledConst(37.0f),	// kDivisor
+		forcedBufferSizeUnscaledConst(444.0f),	// kBuffer
+		0.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		LFOrateUnscaledConst(0.3f),	// kDivisorLFOrate
+		0.72f,	// kDivisorLFOdepth
+		LFOshapeUnscaled(kSawLFO),	// kDivisorLFOshape
+		0.0f,	// kDivisorLFOtempoSync
+		LFOrateUnscaledConst(0.27f),	// kBufferLFOrate
+		0.63f,	// kBufferLFOdepth
+		LFOshapeUnscaled(kSawLFO),	// kBufferLFOshape
+		0.0f,	// kBufferLFOtempoSync
+		0.042f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "laser", {
+		bufferDivisorUnscaledConst(170.0f),	// kDivisor
+		forcedBufferSizeUnscaledConst(128.0f),	// kBuffer
+		0.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		LFOrateUnscaledConst(9.0f),	// kDivisorLFOrate
+		0.87f,	// kDivisorLFOdepth
+		LFOshapeUnscaled(kThornLFO),	// kDivisorLFOshape
+		0.0f,	// kDivisorLFOtempoSync
+		LFOrateUnscaledConst(5.55f),	// kBufferLFOrate
+		0.69f,	// kBufferLFOdepth
+		LFOshapeUnscaled(kReverseSawLFO),	// kBufferLFOshape
+		0.0f,	// kBufferLFOtempoSync
+		0.201f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "sour melodies", {
+		bufferDivisorUnscaledConst(42.0f),	// kDivisor
+		forcedBufferSizeUnscaledConst(210.0f),	// kBuffer
+		0.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		LFOrateUnscaledConst(3.78f),	// kDivisorLFOrate
+		0.9f,	// kDivisorLFOdepth
+		LFOshapeUnscaled(kRandomLFO),	// kDivisorLFOshape
+		0.0f,	// kDivisorLFOtempoSync
+		LFOrateUnscaledConst(3.0f),	// kBufferLFOrate
+		0.0f,	// kBufferLFOdepth
+		0.0f,	// kBufferLFOshape
+		0.0f,	// kBufferLFOtempoSync
+		0.039f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "rerun", {
+		bufferDivisorUnscaledConst(9.0f),	// kDivisor
+		forcedBufferSizeUnscaledConst(747.0f),	// kBuffer
+		0.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		0.0f,	// kDivisorLFOrate
+		0.0f,	// kDivisorLFOdepth
+		LFOshapeUnscaled(kTriangleLFO),	// kDivisorLFOshape
+		0.0f,	// kDivisorLFOtempoSync
+		LFOrateUnscaledConst(0.174f),	// kBufferLFOrate
+		0.21f,	// kBufferLFOdepth
+		LFOshapeUnscaled(kTriangleLFO),	// kBufferLFOshape
+		0.0f,	// kBufferLFOtempoSync
+		0.081f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "\"echo\"", {
+		bufferDivisorUnscaledConst(2.001f),	// kDivisor
+		forcedBufferSizeUnscaledConst(603.0f),	// kBuffer
+		0.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		LFOrateUnscaledConst(0.3f),	// kDivisorLFOrate
+		0.0f,	// kDivisorLFOdepth
+		0.0f,	// kDivisorLFOshape
+		0.0f,	// kDivisorLFOtempoSync
+		LFOrateUnscaledConst(3.0f),	// kBufferLFOrate
+		0.0f,	// kBufferLFOdepth
+		0.0f,	// kBufferLFOshape
+		0.0f,	// kBufferLFOtempoSync
+		1.0f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "squeegee", {
+		bufferDivisorUnscaledConst(27.0f),	// kDivisor
+		forcedBufferSizeUnscaledConst(81.0f),	// kBuffer
+		0.0f,	// kBufferTempoSync
+		1.0f,	// kBufferInterrupt
+		paramSteppedUnscaled(6.6f, NUM_TEMPO_RATES),	// kDivisorLFOrate
+		0.333f,	// kDivisorLFOdepth
+		LFOshapeUnscaled(kSineLFO),	// kDivisorLFOshape
+		1.0f,	// kDivisorLFOtempoSync
+		0.0f,	// kBufferLFOrate
+		0.06f,	// kBufferLFOdepth
+		LFOshapeUnscaled(kSawLFO),	// kBufferLFOshape
+		1.0f,	// kBufferLFOtempoSync
+		0.06f,	// kSmooth
+		1.0f,	// kDryWetMix
+		6.0f / (float)PITCHBEND_MAX,	// kPitchbend
+		0.0f,	// kMidiMode
+		0.0f	// kTempo
+	} },
+
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } },
+	{ "default", { DEFAULT_PROGRAM_PARAMETERS } }
+};
+
+//-----------------------------------------------------------------------------
+// gets our own copy of a program slot if there is one, or else the factory preset
+const BufferOverrideProgram * BufferOverride::getProgram(long index)
+{
+	if (userPrograms[index])
+		return userPrograms[index];
+	return &(factoryPrograms[index]);
 }
 
 //-----------------------------------------------------------------------------
-BufferOverrideProgram::~BufferOverrideProgram()
+// whether these are just the factory preset's values & name
+static bool isFactoryProgram(long index, const float *param, const char *name)
 {
-	if (name)
-		delete[] name;
-	if (param)
-		delete[] param;
+	return (memcmp(param, factoryPrograms[index].param, sizeof(factoryPrograms[index].param)) == 0)
+			&& (strncmp(name, factoryPrograms[index].name, PROGRAM_NAME_LENGTH-1) == 0);
 }
 
+//-----------------------------------------------------------------------------
 void BufferOverride::d_initProgramName(uint32_t index, d_string& programName)
 {
-	switch (index) {
-		case 1:	
-			programName = "drum roll";
-			break;
-		case 2:
-			programName = "arpeggio";
-			break;
-		case 3:
-			programName = "laser";
-			break;
-		case 4:
-			programName = "sour melodies";
-			break;
-		case 5:
-			programName = "rerun";
-			break;
-		case 6:
-			programName = "\"echo\"";
-			break;
-		case 7:
-			programName = "squeegee";
-			break;
-	}
+	if (index < NUM_PROGRAMS)
+		programName = factoryPrograms[index].name;
 }
 
 //-----------------------------------------------------------------------------
+// The slot that we're leaving only keeps its own copy if it's been changed, & the one that we're going to
+// gets one if it doesn't have one yet, so that automation never has to allocate (see d_setParameterValue()).
 void BufferOverride::d_setProgram(uint32_t programNum)
 {
 	if ( (programNum < NUM_PROGRAMS) && (programNum >= 0) ) {
-		for (int i=0; i < NUM_PARAMETERS; i++) {
-			this->d_setParameterValue(i, programs[programNum].param[i]);
+		BufferOverrideProgram *oldProgram = userPrograms[curProgram];
+		if ( ((long)programNum != curProgram) && oldProgram && isFactoryProgram(curProgram, oldProgram->param, oldProgram->name) ) {
+			delete oldProgram;
+			userPrograms[curProgram] = NULL;
+		}
+		if (userPrograms[programNum] == NULL)
+			userPrograms[programNum] = new BufferOverrideProgram(factoryPrograms[programNum]);
+		loadProgram(programNum);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// makes a program slot, which has to have its own copy already, the current one
+void BufferOverride::loadProgram(long programNum)
+{
+	curProgram = programNum;
+	const BufferOverrideProgram *program = userPrograms[programNum];
+	for (int i=0; i < NUM_PARAMETERS; i++) {
+		this->d_setParameterValue(i, program->param[i]);
+	}
+}
+
+#pragma mark _________state_________
+
+//-----------------------------------------------------------------------------
+void BufferOverride::d_initStateKey(uint32_t index, d_string& stateKey)
+{
+	if (index == 0)
+		stateKey = STATE_CHUNK_KEY;
+}
+
+//-----------------------------------------------------------------------------
+void BufferOverride::getStateChunk(BufferOverrideStateChunk *chunk)
+{
+	memset(chunk, 0, sizeof(BufferOverrideStateChunk));
+	chunk->magic = STATE_CHUNK_MAGIC;
+	chunk->version = STATE_CHUNK_VERSION;
+	chunk->numPrograms = NUM_PROGRAMS;
+	chunk->numParameters = NUM_PARAMETERS;
+	chunk->currentProgram = curProgram;
+	for (int i=0; i < NUM_PROGRAMS; i++) {
+		const BufferOverrideProgram *program = getProgram(i);
+		memcpy(chunk->programParams[i], program->param, sizeof(chunk->programParams[i]));
+		strncpy(chunk->programNames[i], program->name, PROGRAM_NAME_LENGTH-1);
+	}
+
+	chunk->numModSlots = NUM_MOD_SLOTS;
+	for (int i=0; i < NUM_MOD_SLOTS; i++) {
+		chunk->modDestination[i] = modBank->destination[i];
+		chunk->modRate[i] = modBank->fRate[i];
+		chunk->modDepth[i] = modBank->fDepth[i];
+		chunk->modShape[i] = modBank->fShape[i];
+		chunk->modTempoSync[i] = modBank->fTempoSync[i];
+	}
+	chunk->numLayers = MAX_EXTRA_LAYERS;
+	chunk->numExtraLayers = dsp.numExtraLayers;
+	for (int i=0; i < MAX_EXTRA_LAYERS; i++) {
+		chunk->layerDivisor[i] = layers[i].fDivisor;
+		chunk->layerLFOrate[i] = layers[i].divisorLFO.fRate;
+		chunk->layerLFOdepth[i] = layers[i].divisorLFO.fDepth;
+		chunk->layerLFOshape[i] = layers[i].divisorLFO.fShape;
+		chunk->layerLFOtempoSync[i] = layers[i].divisorLFO.fTempoSync;
+		chunk->layerGain[i] = layers[i].fGain;
+	}
+	// (one that's waiting for d_activate() is what we've been told to have)
+	chunk->captureFormat = (pendingCaptureFormat >= 0) ? pendingCaptureFormat : captureFormat;
+	chunk->int16Headroom = (pendingCaptureFormat >= 0) ? pendingInt16Headroom : int16Headroom;
+}
+
+//-----------------------------------------------------------------------------
+// (this also catches NaNs)
+static inline bool isParameterValue(float value)
+{
+	return (value >= 0.0f) && (value <= 1.0f);
+}
+
+//-----------------------------------------------------------------------------
+// Checks the whole chunk in one pass & then stages it for applyStagedState().
+// None of it goes into the programs until d_activate() (or the start of the next d_run()
+// if we're already running).  Returns false & leaves everything alone if the chunk is no good.
+bool BufferOverride::setStateChunk(const BufferOverrideStateChunk *chunk)
+{
+	if ( (chunk->magic != STATE_CHUNK_MAGIC) || (chunk->version != STATE_CHUNK_VERSION) )
+		return false;
+	if ( (chunk->numPrograms != NUM_PROGRAMS) || (chunk->numParameters != NUM_PARAMETERS) )
+		return false;
+	if ( (chunk->currentProgram < 0) || (chunk->currentProgram >= NUM_PROGRAMS) )
+		return false;
+	const float *param = &(chunk->programParams[0][0]);
+	for (int i=0; i < (NUM_PROGRAMS * NUM_PARAMETERS); i++) {
+		if ( !isParameterValue(param[i]) )
+			return false;
+	}
+	if (chunk->numModSlots != NUM_MOD_SLOTS)
+		return false;
+	for (int i=0; i < NUM_MOD_SLOTS; i++) {
+		if ( !isModDestination(chunk->modDestination[i]) || !isParameterValue(chunk->modRate[i]) || !isParameterValue(chunk->modDepth[i])
+				|| !isParameterValue(chunk->modShape[i]) || !isParameterValue(chunk->modTempoSync[i]) )
+			return false;
+	}
+	if ( (chunk->numLayers != MAX_EXTRA_LAYERS) || (chunk->numExtraLayers < 0) || (chunk->numExtraLayers > MAX_EXTRA_LAYERS) )
+		return false;
+	for (int i=0; i < MAX_EXTRA_LAYERS; i++) {
+		if ( !isParameterValue(chunk->layerDivisor[i]) || !isParameterValue(chunk->layerLFOrate[i]) || !isParameterValue(chunk->layerLFOdepth[i])
+				|| !isParameterValue(chunk->layerLFOshape[i]) || !isParameterValue(chunk->layerLFOtempoSync[i]) )
+			return false;
+		// (the gain is a linear level, not a parameter value, but it can't be negative or infinite)
+		if ( !((chunk->layerGain[i] >= 0.0f) && (chunk->layerGain[i] <= FLT_MAX)) )
+			return false;
+	}
+	if ( (chunk->captureFormat < 0) || (chunk->captureFormat >= numCaptureFormats) )
+		return false;
+	if ( !((chunk->int16Headroom > 0.0f) && (chunk->int16Headroom <= FLT_MAX)) )
+		return false;
+
+	// (a new chunk replaces one that's still waiting)
+	claimStaging(&stagedStateStatus);
+	if (stagedState == NULL) {
+		stagedState = new BufferOverrideStagedState;
+		for (int i=0; i < NUM_PROGRAMS; i++)
+			stagedState->programs[i] = NULL;
+	}
+	memcpy(&(stagedState->chunk), chunk, sizeof(BufferOverrideStateChunk));
+	// copy out the slots that aren't the factory presets (& the current one, see d_setProgram()) here,
+	// rather than in d_run() (what's left from the last chunk gets reused, or deleted if this one doesn't need it)
+	for (int i=0; i < NUM_PROGRAMS; i++) {
+		if ( (i != chunk->currentProgram) && isFactoryProgram(i, chunk->programParams[i], chunk->programNames[i]) ) {
+			delete stagedState->programs[i];
+			stagedState->programs[i] = NULL;
+			continue;
 		}
+		if (stagedState->programs[i] == NULL)
+			stagedState->programs[i] = new BufferOverrideProgram;
+		memcpy(stagedState->programs[i]->param, chunk->programParams[i], sizeof(chunk->programParams[i]));
+		memcpy(stagedState->programs[i]->name, chunk->programNames[i], PROGRAM_NAME_LENGTH);
+		stagedState->programs[i]->name[PROGRAM_NAME_LENGTH-1] = 0;
+	}
+	stagedStateStatus.store(kStagedStateReady, std::memory_order_release);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// copies a staged state chunk, if there is one, into the programs in bulk & applies the current one,
+// along with the rest of the settings in it (this is for d_run() & d_activate(), so it doesn't allocate anything,
+// which is why the capture format only gets noted for d_activate() to take care of); returns whether there was one
+bool BufferOverride::applyStagedState()
+{
+	int status = kStagedStateReady;
+	if ( !stagedStateStatus.compare_exchange_strong(status, kStagedStateApplying, std::memory_order_acquire) )
+		return false;
+
+	const BufferOverrideStateChunk *chunk = &(stagedState->chunk);
+	for (int i=0; i < NUM_PROGRAMS; i++) {
+		BufferOverrideProgram *oldProgram = userPrograms[i];
+		userPrograms[i] = stagedState->programs[i];
+		stagedState->programs[i] = oldProgram;
 	}
+	for (int i=0; i < NUM_MOD_SLOTS; i++)
+		applyModulation(i, chunk->modDestination[i], chunk->modRate[i], chunk->modDepth[i], chunk->modShape[i], chunk->modTempoSync[i]);
+	for (int i=0; i < MAX_EXTRA_LAYERS; i++)
+		setLayer(i, chunk->layerDivisor[i], chunk->layerLFOrate[i], chunk->layerLFOdepth[i], chunk->layerLFOshape[i], chunk->layerLFOtempoSync[i], chunk->layerGain[i]);
+	setNumExtraLayers(chunk->numExtraLayers);
+	if ( (chunk->captureFormat != captureFormat) || (chunk->int16Headroom != int16Headroom) ) {
+		pendingCaptureFormat = chunk->captureFormat;
+		pendingInt16Headroom = chunk->int16Headroom;
+	} else
+		pendingCaptureFormat = -1;
+	long newProgram = chunk->currentProgram;
+	stagedStateStatus.store(kStagedStateEmpty, std::memory_order_release);
+	loadProgram(newProgram);
+	return true;
 }
 
+//-----------------------------------------------------------------------------
+// the state chunk comes to us as a string of hex digits
+static inline int hexDigitValue(char c)
+{
+	if ( (c >= '0') && (c <= '9') )
+		return c - '0';
+	if ( (c >= 'A') && (c <= 'F') )
+		return c - 'A' + 10;
+	if ( (c >= 'a') && (c <= 'f') )
+		return c - 'a' + 10;
+	return -1;
+}
+
+void BufferOverride::d_setState(const char* key, const char* value)
+{
+	if ( (key == NULL) || (value == NULL) || (strcmp(key, STATE_CHUNK_KEY) != 0) )
+		return;
+	if ( strlen(value) != (sizeof(BufferOverrideStateChunk) * 2) )
+		return;
+
+	BufferOverrideStateChunk chunk;
+	unsigned char *chunkBytes = (unsigned char*) &chunk;
+	for (size_t i=0; i < sizeof(BufferOverrideStateChunk); i++) {
+		int high = hexDigitValue(value[i*2]);
+		int low = hexDigitValue(value[(i*2)+1]);
+		if ( (high < 0) || (low < 0) )
+			return;
+		chunkBytes[i] = (unsigned char) ((high << 4) | low);
+	}
+	setStateChunk(&chunk);
+}
+
+//-----------------------------------------------------------------------------
+// this makes the string that d_setState() wants
+void encodeStateChunk(const BufferOverrideStateChunk *chunk, char *text)
+{
+	static const char hexDigits[] = "0123456789ABCDEF";
+	const unsigned char *chunkBytes = (const unsigned char*) chunk;
+	for (size_t i=0; i < sizeof(BufferOverrideStateChunk); i++) {
+		text[i*2] = hexDigits[chunkBytes[i] >> 4];
+		text[(i*2)+1] = hexDigits[chunkBytes[i] & 0x0F];
+	}
+	text[sizeof(BufferOverrideStateChunk) * 2] = 0;
+}
+
+
+#pragma mark _________checkpoints_________
+
+//-----------------------------------------------------------------------------
+void BufferOverride::setCheckpointInterval(long minSamples)
+{
+	if (minSamples <= 0) {
+		checkpointInterval = 0;
+		clearCheckpoints();
+	} else
+		checkpointInterval = minSamples;
+}
+
+//-----------------------------------------------------------------------------
+void BufferOverride::clearCheckpoints()
+{
+	while (firstCheckpoint) {
+		BufferOverrideCheckpoint *next = firstCheckpoint->next;
+		free(firstCheckpoint->history);
+		delete firstCheckpoint;
+		firstCheckpoint = next;
+	}
+	lastCheckpoint = NULL;
+	numCheckpoints = 0;
+}
+
+//-----------------------------------------------------------------------------
+// drops the checkpoints past samplePosition, since anything rendered from there on is being done over
+void BufferOverride::forgetCheckpointsAfter(int64_t samplePosition)
+{
+	BufferOverrideCheckpoint *keep = NULL;
+	for (BufferOverrideCheckpoint *checkpoint = firstCheckpoint; checkpoint; checkpoint = checkpoint->next) {
+		if (checkpoint->samplePosition > samplePosition)
+			break;
+		keep = checkpoint;
+	}
+	BufferOverrideCheckpoint *forget = keep ? keep->next : firstCheckpoint;
+	while (forget) {
+		BufferOverrideCheckpoint *next = forget->next;
+		free(forget->history);
+		delete forget;
+		numCheckpoints--;
+		forget = next;
+	}
+	if (keep)
+		keep->next = NULL;
+	else
+		firstCheckpoint = NULL;
+	lastCheckpoint = keep;
+}
+
+//-----------------------------------------------------------------------------
+// d_run() calls this just before updateBuffer() starts a new forced buffer at samplePos
+void BufferOverride::saveCheckpoint(long samplePos)
+{
+	int64_t position = renderPosition + samplePos;
+
+	// if we've gone back (a restart, or a re-render from an earlier checkpoint), the later ones are stale
+	forgetCheckpointsAfter(position);
+	if ( lastCheckpoint && ((position - lastCheckpoint->samplePosition) < checkpointInterval) )
+		return;
+
+	// The forced buffer that's ending can only be read by the smoothing out of its last minibuffer (of any of
+	// the layers), which starts where that minibuffer ends & can't go past what was captured, so that's all
+	// that needs saving.  The new forced buffer's input gets written from the start before anything reads it.
+	long historyStart = dsp.minibufferSize;
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		if (layers[n].minibufferSize < historyStart)
+			historyStart = layers[n].minibufferSize;
+	}
+	long historyEnd = (dsp.captureEnd < dsp.currentForcedBufferSize) ? dsp.captureEnd : dsp.currentForcedBufferSize;
+	if (historyStart < 0)
+		historyStart = 0;
+	long historyLength = historyEnd - historyStart;
+	// (buffers that aren't there, like in the schedule-only pass, haven't captured anything to save)
+	if ( (historyLength < 0) || !dsp.buffer1.isAllocated() )
+		historyLength = 0;
+#ifdef BUFFEROVERRIDE_STEREO
+	long numChannels = 2;
+#else
+	long numChannels = 1;
+#endif
+	long channelBytes = historyLength * CaptureBuffer::bytesPerSample(captureFormat);
+	BufferOverrideCheckpoint *checkpoint = new BufferOverrideCheckpoint;
+	checkpoint->history = malloc((channelBytes * numChannels) + 1);	// (+1 so that there's always something)
+	if (checkpoint->history == NULL) {
+		delete checkpoint;
+		return;
+	}
+	dsp.buffer1.saveHistory(checkpoint->history, historyStart, historyLength);
+#ifdef BUFFEROVERRIDE_STEREO
+	dsp.buffer2.saveHistory((char*)checkpoint->history + channelBytes, historyStart, historyLength);
+#endif
+	checkpoint->captureFormat = captureFormat;
+	checkpoint->int16Headroom = int16Headroom;
+	checkpoint->historyStart = historyStart;
+	checkpoint->historyLength = historyLength;
+
+	checkpoint->samplePosition = position;
+	checkpoint->writePos = dsp.writePos;
+	checkpoint->readPos = dsp.readPos;
+	checkpoint->captureEnd = dsp.captureEnd;
+	checkpoint->forcedBufferStart = forcedBufferStart;
+	checkpoint->minibufferSize = dsp.minibufferSize;
+	checkpoint->prevMinibufferSize = dsp.prevMinibufferSize;
+	checkpoint->currentForcedBufferSize = dsp.currentForcedBufferSize;
+	checkpoint->smoothcount = dsp.smoothcount;
+	checkpoint->fadeOutGain = dsp.fadeOutGain;
+	checkpoint->fadeInGain = dsp.fadeInGain;
+	checkpoint->realFadePart = dsp.realFadePart;
+	checkpoint->imaginaryFadePart = dsp.imaginaryFadePart;
+	checkpoint->inputGain = dsp.inputGain;
+	checkpoint->outputGain = dsp.outputGain;
+	checkpoint->forcedBufferFraction = forcedBufferFraction;
+	checkpoint->lastForcedBufferSize = lastForcedBufferSize;
+	checkpoint->smoothDur = smoothDur;
+	checkpoint->currentBufferDivisor = currentBufferDivisor;
+	checkpoint->needResync = needResync;
+	checkpoint->pitchbend = pitchbend;
+	checkpoint->divisorWasChangedByHand = divisorWasChangedByHand;
+	checkpoint->lastNoteOn = lastNoteOn;
+	checkpoint->lastPitchbend = lastPitchbend;
+
+	// the LFOs have been rendered ahead to the end of the modulation block, so they need winding back
+	divisorLFO.getStateAt(samplePos, &(checkpoint->divisorLFO));
+	bufferLFO.getStateAt(samplePos, &(checkpoint->bufferLFO));
+	modBank->getStateAt(samplePos, &(checkpoint->modBank));
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		checkpoint->layers[n].currentBufferDivisor = layer->currentBufferDivisor;
+		checkpoint->layers[n].minibufferSize = layer->minibufferSize;
+		checkpoint->layers[n].prevMinibufferSize = layer->prevMinibufferSize;
+		checkpoint->layers[n].readPos = layer->readPos;
+		checkpoint->layers[n].smoothcount = layer->smoothcount;
+		checkpoint->layers[n].smoothDur = layer->smoothDur;
+		checkpoint->layers[n].fadeOutGain = layer->fadeOutGain;
+		checkpoint->layers[n].fadeInGain = layer->fadeInGain;
+		checkpoint->layers[n].realFadePart = layer->realFadePart;
+		checkpoint->layers[n].imaginaryFadePart = layer->imaginaryFadePart;
+		// (the layers that are off haven't been rendered, so they're already where they stopped)
+		if (n < dsp.numExtraLayers)
+			layer->divisorLFO.getStateAt(samplePos, &(checkpoint->layers[n].divisorLFO));
+		else
+			layer->divisorLFO.getState(&(checkpoint->layers[n].divisorLFO));
+	}
+
+	checkpoint->next = NULL;
+	if (lastCheckpoint)
+		lastCheckpoint->next = checkpoint;
+	else
+		firstCheckpoint = checkpoint;
+	lastCheckpoint = checkpoint;
+	numCheckpoints++;
+}
+
+//-----------------------------------------------------------------------------
+int64_t BufferOverride::restoreCheckpoint(int64_t samplePosition)
+{
+	BufferOverrideCheckpoint *checkpoint = NULL;
+	for (BufferOverrideCheckpoint *c = firstCheckpoint; c && (c->samplePosition <= samplePosition); c = c->next)
+		checkpoint = c;
+	if (checkpoint == NULL)
+		return -1;
+	if (!applyCheckpoint(checkpoint))
+		return -1;
+	forgetCheckpointsAfter(checkpoint->samplePosition);
+	return renderPosition;
+}
+
+//-----------------------------------------------------------------------------
+// puts the engine into a checkpoint's state (it can be from another instance with the same settings)
+bool BufferOverride::applyCheckpoint(const BufferOverrideCheckpoint *checkpoint)
+{
+	// the capture buffers have to still be able to hold what the checkpoint has
+	if (!createAudioBuffers())
+		return false;
+	if ( (checkpoint->captureFormat != captureFormat) || (checkpoint->int16Headroom != int16Headroom) ||
+			((checkpoint->historyStart + checkpoint->historyLength) > dsp.buffer1.getNumSamples()) )
+		return false;
+
+	dsp.buffer1.restoreHistory(checkpoint->history, checkpoint->historyStart, checkpoint->historyLength);
+#ifdef BUFFEROVERRIDE_STEREO
+	long channelBytes = checkpoint->historyLength * CaptureBuffer::bytesPerSample(captureFormat);
+	dsp.buffer2.restoreHistory((char*)checkpoint->history + channelBytes, checkpoint->historyStart, checkpoint->historyLength);
+#endif
+
+	renderPosition = checkpoint->samplePosition;
+	dsp.writePos = checkpoint->writePos;
+	dsp.readPos = checkpoint->readPos;
+	dsp.captureEnd = checkpoint->captureEnd;
+	forcedBufferStart = checkpoint->forcedBufferStart;
+	dsp.minibufferSize = checkpoint->minibufferSize;
+	dsp.prevMinibufferSize = checkpoint->prevMinibufferSize;
+	dsp.currentForcedBufferSize = checkpoint->currentForcedBufferSize;
+	resetCaptureBins();	// (the GUI's outline only starts over from here)
+	dsp.smoothcount = checkpoint->smoothcount;
+	dsp.fadeOutGain = checkpoint->fadeOutGain;
+	dsp.fadeInGain = checkpoint->fadeInGain;
+	dsp.realFadePart = checkpoint->realFadePart;
+	dsp.imaginaryFadePart = checkpoint->imaginaryFadePart;
+	dsp.inputGain = checkpoint->inputGain;
+	dsp.outputGain = checkpoint->outputGain;
+	forcedBufferFraction = checkpoint->forcedBufferFraction;
+	lastForcedBufferSize = checkpoint->lastForcedBufferSize;
+	smoothDur = checkpoint->smoothDur;
+	currentBufferDivisor = checkpoint->currentBufferDivisor;
+	needResync = checkpoint->needResync;
+	pitchbend = checkpoint->pitchbend;
+	divisorWasChangedByHand = checkpoint->divisorWasChangedByHand;
+	lastNoteOn = checkpoint->lastNoteOn;
+	lastPitchbend = checkpoint->lastPitchbend;
+
+	divisorLFO.setState(&(checkpoint->divisorLFO));
+	bufferLFO.setState(&(checkpoint->bufferLFO));
+	modBank->setState(&(checkpoint->modBank));
+	for (long n = 0; n < MAX_EXTRA_LAYERS; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		layer->currentBufferDivisor = checkpoint->layers[n].currentBufferDivisor;
+		layer->minibufferSize = checkpoint->layers[n].minibufferSize;
+		layer->prevMinibufferSize = checkpoint->layers[n].prevMinibufferSize;
+		layer->readPos = checkpoint->layers[n].readPos;
+		layer->smoothcount = checkpoint->layers[n].smoothcount;
+		layer->smoothDur = checkpoint->layers[n].smoothDur;
+		layer->fadeOutGain = checkpoint->layers[n].fadeOutGain;
+		layer->fadeInGain = checkpoint->layers[n].fadeInGain;
+		layer->realFadePart = checkpoint->layers[n].realFadePart;
+		layer->imaginaryFadePart = checkpoint->layers[n].imaginaryFadePart;
+		layer->divisorLFO.setState(&(checkpoint->layers[n].divisorLFO));
+	}
+
+	return true;
+}
+
+
 #pragma mark _________parameters_________
 
+//-----------------------------------------------------------------------------
+// what each parameter is, in the order of the parameter indices
+static constexpr BufferOverrideParameterInfo parameterInfo[BufferOverride::NUM_PARAMETERS] =
+{
+	// name, symbol, min, max, scaling, unit, tempo sync unit, format, tempo sync parameter
+	{ "buffer divisor", "divisor", DIVISOR_MIN, DIVISOR_MAX, kParamScaleSquared, " ", " ", kParamFormatDivisor, -1 },
+	{ "forced buffer size", "buffer", BUFFER_MIN, BUFFER_MAX, kParamScaleSquaredReversed, "samples", "buffers/beat", kParamFormatBufferSize, BufferOverride::kBufferTempoSync },
+	{ "forced buffer tempo sync", "bufferTempoSync", 0.0f, 1.0f, kParamScaleToggle, " ", " ", kParamFormatYesNo, -1 },
+	{ "stuck buffer", "bufferInterrupt", 0.0f, 1.0f, kParamScaleToggle, " ", " ", kParamFormatYesNo, -1 },
+	{ "divisor LFO rate", "divisorLFOrate", LFO_RATE_MIN, LFO_RATE_MAX, kParamScaleSquared, "Hz", "Hz", kParamFormatLFOrate, BufferOverride::kDivisorLFOtempoSync },
+	{ "divisor LFO depth", "divisorLFOdepth", 0.0f, 100.0f, kParamScaleLinear, " ", " ", kParamFormatPercent, -1 },
+	{ "divisor LFO shape", "divisorLFOshape", 0.0f, (float)(numLFOshapes-1), kParamScaleInteger, " ", " ", kParamFormatLFOshape, -1 },
+	{ "divisor LFO tempo sync", "divisorLFOtempoSync", 0.0f, 1.0f, kParamScaleToggle, " ", " ", kParamFormatYesNo, -1 },
+	{ "buffer LFO rate", "bufferLFOrate", LFO_RATE_MIN, LFO_RATE_MAX, kParamScaleSquared, "Hz", "Hz", kParamFormatLFOrate, BufferOverride::kBufferLFOtempoSync },
+	{ "buffer LFO depth", "bufferLFOdepth", 0.0f, 100.0f, kParamScaleLinear, " ", " ", kParamFormatPercent, -1 },
+	{ "buffer LFO shape", "bufferLFOshape", 0.0f, (float)(numLFOshapes-1), kParamScaleInteger, " ", " ", kParamFormatLFOshape, -1 },
+	{ "buffer LFO tempo sync", "bufferLFOtempoSync", 0.0f, 1.0f, kParamScaleToggle, " ", " ", kParamFormatYesNo, -1 },
+	{ "smooth", "smooth", 0.0f, 100.0f, kParamScaleLinear, " ", " ", kParamFormatPercentFine, -1 },
+	{ "dry/wet mix", "dryWetMix", 0.0f, 100.0f, kParamScaleLinear, " ", " ", kParamFormatPercent, -1 },
+	{ "pitchbend", "pitchbend", 0.0f, (float)PITCHBEND_MAX, kParamScaleLinear, "semitones", "semitones", kParamFormatPitchbend, -1 },
+	{ "MIDI mode", "midiMode", 0.0f, 1.0f, kParamScaleToggle, " ", " ", kParamFormatMidiMode, -1 },
+	{ "tempo", "tempo", TEMPO_MIN, TEMPO_MAX, kParamScaleLinear, "bpm", "bpm", kParamFormatTempo, -1 }
+};
+
+//-----------------------------------------------------------------------------
+const BufferOverrideParameterInfo * BufferOverride::getParameterInfo(long index)
+{
+	if ( (index < 0) || (index >= NUM_PARAMETERS) )
+		return NULL;
+	return &(parameterInfo[index]);
+}
+
+//-----------------------------------------------------------------------------
+// the host works with the same 0.0 - 1.0 values that we do, & the defaults are the first factory preset's
+void BufferOverride::d_initParameter(uint32_t index, Parameter& parameter)
+{
+	const BufferOverrideParameterInfo *info = getParameterInfo(index);
+	if (info == NULL)
+		return;
+	parameter.hints = kParameterIsAutomable;
+	parameter.name = info->name;
+	parameter.symbol = info->symbol;
+	parameter.unit = info->unit;
+	parameter.ranges.def = factoryPrograms[0].param[index];
+	parameter.ranges.min = 0.0f;
+	parameter.ranges.max = 1.0f;
+}
+
+//-----------------------------------------------------------------------------
+float BufferOverride::getParameterScaled(long index, float value)
+{
+	const BufferOverrideParameterInfo *info = getParameterInfo(index);
+	if (info == NULL)
+		return value;
+	switch (info->scaling) {
+	case kParamScaleSquared :
+		return paramRangeSquaredScaled(value, info->min, info->max);
+	case kParamScaleSquaredReversed :
+		return paramRangeSquaredScaled(1.0f - value, info->min, info->max);
+	case kParamScaleInteger :
+		return (float) paramRangeIntScaled(value, info->min, info->max);
+	case kParamScaleToggle :
+		return onOffTest(value) ? info->max : info->min;
+	case kParamScaleLinear :
+	default :
+		return paramRangeScaled(value, info->min, info->max);
+	}
+}
+
 //-------------------------------------------------------------------------
 void BufferOverride::d_setParameterValue(uint32_t index, float value)
 {
+	long oldMaxNextSmooth = getMaxNextSmooth();
+
 	switch (index) {
 	case kDivisor :
 		fDivisor = value;
@@ -352,7 +1332,7 @@ void BufferOverride::d_setParameterValue(uint32_t index, float value)
 
 	case kBuffer:
 		// make sure the cycles match up if the tempo rate has changed
-		if (tempoRateTable->getScalar(fBuffer) != tempoRateTable->getScalar(value))
+		if (TempoRateTable::getScalar(fBuffer) != TempoRateTable::getScalar(value))
 			needResync = true;
 		fBuffer = value;
 		break;
@@ -365,31 +1345,36 @@ void BufferOverride::d_setParameterValue(uint32_t index, float value)
 		break;
 
 	case kBufferInterrupt     :
+		// the capture limit didn't allow for minibuffers growing, so capture the rest of this forced buffer
+		if ( !onOffTest(fBufferInterrupt) && onOffTest(value) )
+			dsp.captureLimit = dsp.currentForcedBufferSize;
 		fBufferInterrupt = value;
 		break;
 	case kDivisorLFOrate      :
-		divisorLFO->fRate = value;
+		divisorLFO.fRate = value;
 		break;
 	case kDivisorLFOdepth     :
-		divisorLFO->fDepth = value;
+		divisorLFO.fDepth = value;
 		break;
 	case kDivisorLFOshape     :
-		divisorLFO->fShape = value;
+		divisorLFO.fShape = value;
+		divisorLFO.pickTheLFOwaveform();
 		break;
 	case kDivisorLFOtempoSync :
-		divisorLFO->fTempoSync = value;
+		divisorLFO.fTempoSync = value;
 		break;
 	case kBufferLFOrate       :
-		bufferLFO->fRate = value;
+		bufferLFO.fRate = value;
 		break;
 	case kBufferLFOdepth      :
-		bufferLFO->fDepth = value;
+		bufferLFO.fDepth = value;
 		break;
 	case kBufferLFOshape      :
-		bufferLFO->fShape = value;
+		bufferLFO.fShape = value;
+		bufferLFO.pickTheLFOwaveform();
 		break;
 	case kBufferLFOtempoSync  :
-		bufferLFO->fTempoSync = value;
+		bufferLFO.fTempoSync = value;
 		break;
 	case kSmooth              :
 		fSmooth = value;
@@ -399,6 +1384,8 @@ void BufferOverride::d_setParameterValue(uint32_t index, float value)
 		break;
 	case kPitchbend           :
 		fPitchbend = value;
+		// the range changed, so the same bend goes a different distance
+		pitchbend = getPitchbendScalar();
 		break;
 	case kMidiMode :
 		// reset all notes to off if we're switching into MIDI trigger mode
@@ -416,12 +1403,18 @@ void BufferOverride::d_setParameterValue(uint32_t index, float value)
 		break;
 	}
 
-	if ( (index >= 0) && (index < NUM_PARAMETERS) )
-		programs[curProgram].param[index] = value;
+	// the capture limit didn't allow for the next forced buffer's opening crossfade being this long
+	// (or being there at all), so capture the rest of this forced buffer
+	allowForNextSmooth(oldMaxNextSmooth);
+
+	if ( (index >= 0) && (index < NUM_PARAMETERS) ) {
+		// (the current slot always has its own copy, see d_setProgram())
+		userPrograms[curProgram]->param[index] = value;
+	}
 }
 
 //-------------------------------------------------------------------------
-float BufferOverride::d_getParameterValue(uint32_t index)
+float BufferOverride::d_getParameterValue(uint32_t index) const
 {
 	switch (index) {
 	default:
@@ -434,21 +1427,21 @@ float BufferOverride::d_getParameterValue(uint32_t index)
 	case kBufferInterrupt     :
 		return fBufferInterrupt;
 	case kDivisorLFOrate      :
-		return divisorLFO->fRate;
+		return divisorLFO.fRate;
 	case kDivisorLFOdepth     :
-		return divisorLFO->fDepth;
+		return divisorLFO.fDepth;
 	case kDivisorLFOshape     :
-		return divisorLFO->fShape;
+		return divisorLFO.fShape;
 	case kDivisorLFOtempoSync :
-		return divisorLFO->fTempoSync;
+		return divisorLFO.fTempoSync;
 	case kBufferLFOrate       :
-		return bufferLFO->fRate;
+		return bufferLFO.fRate;
 	case kBufferLFOdepth      :
-		return bufferLFO->fDepth;
+		return bufferLFO.fDepth;
 	case kBufferLFOshape      :
-		return bufferLFO->fShape;
+		return bufferLFO.fShape;
 	case kBufferLFOtempoSync  :
-		return bufferLFO->fTempoSync;
+		return bufferLFO.fTempoSync;
 	case kSmooth              :
 		return fSmooth;
 	case kDryWetMix           :
@@ -459,224 +1452,97 @@ float BufferOverride::d_getParameterValue(uint32_t index)
 		return fMidiMode;
 	case kTempo               :
 		return fTempo;
+	}
 }
 
 //-------------------------------------------------------------------------
-// titles of each parameter
-
 void BufferOverride::getParameterName(long index, char *label)
 {
-	switch (index) {
-	case kDivisor             :
-		strcpy(label, "buffer divisor");
-		break;
-	case kBuffer              :
-		strcpy(label, "forced buffer size");
-		break;
-	case kBufferTempoSync     :
-		strcpy(label, "forced buffer tempo sync");
-		break;
-	case kBufferInterrupt     :
-		strcpy(label, "stuck buffer");
-		break;
-	case kDivisorLFOrate      :
-		strcpy(label, "divisor LFO rate");
-		break;
-	case kDivisorLFOdepth     :
-		strcpy(label, "divisor LFO depth");
-		break;
-	case kDivisorLFOshape     :
-		strcpy(label, "divisor LFO shape");
-		break;
-	case kDivisorLFOtempoSync :
-		strcpy(label, "divisor LFO tempo sync");
-		break;
-	case kBufferLFOrate       :
-		strcpy(label, "buffer LFO rate");
-		break;
-	case kBufferLFOdepth      :
-		strcpy(label, "buffer LFO depth");
-		break;
-	case kBufferLFOshape      :
-		strcpy(label, "buffer LFO shape");
-		break;
-	case kBufferLFOtempoSync  :
-		strcpy(label, "buffer LFO tempo sync");
-		break;
-	case kSmooth              :
-		strcpy(label, "smooth");
-		break;
-	case kDryWetMix           :
-		strcpy(label, "dry/wet mix");
-		break;
-	case kPitchbend           :
-		strcpy(label, "pitchbend");
-		break;
-	case kMidiMode            :
-		strcpy(label, "MIDI mode");
-		break;
-	case kTempo               :
-		strcpy(label, "tempo");
-		break;
-	}
+	const BufferOverrideParameterInfo *info = getParameterInfo(index);
+	strcpy(label, (info != NULL) ? info->name : "");
 }
 
 //-------------------------------------------------------------------------
 // numerical display of each parameter's gradiations
+// (hosts ask for these over & over for their generic editors & automation lanes,
+// so each string only gets remade once the value that it shows has changed)
 
 void BufferOverride::getParameterDisplay(long index, char *text)
 {
-	switch (index) {
-	case kDivisor :
-		if (bufferDivisorScaled(fDivisor) < 2.0f)
-			sprintf(text, "%.3f", 1.0f);
-		else
-			sprintf(text, "%.3f", bufferDivisorScaled(fDivisor));
-		break;
-	case kBuffer :
-		if (onOffTest(fBufferTempoSync))
-			strcpy(text, tempoRateTable->getDisplay(fBuffer));
-		else
-			sprintf(text, "%.1f", forcedBufferSizeScaled(fBuffer));
-		break;
-	case kBufferTempoSync :
-		if (onOffTest(fBufferTempoSync))
-			strcpy(text, "yes");
-		else
-			strcpy(text, "no");
-		break;
-	case kBufferInterrupt :
-		if (onOffTest(fBufferInterrupt))
-			strcpy(text, "yes");
-		else
-			strcpy(text, "no");
-		break;
-	case kDivisorLFOrate :
-		if (onOffTest(divisorLFO->fTempoSync))
-			strcpy(text, tempoRateTable->getDisplay(divisorLFO->fRate));
-		else
-			sprintf(text, "%.1f", LFOrateScaled(divisorLFO->fRate));
-		break;
-	case kDivisorLFOdepth :
-		sprintf(text, "%ld %%", (long)(divisorLFO->fDepth * 100.0f));
-		break;
-	case kDivisorLFOshape :
-		divisorLFO->getShapeName(text);
-		break;
-	case kDivisorLFOtempoSync :
-		if (onOffTest(divisorLFO->fTempoSync))
-			strcpy(text, "yes");
-		else
-			strcpy(text, "no");
-		break;
-	case kBufferLFOrate :
-		if (onOffTest(bufferLFO->fTempoSync))
-			strcpy(text, tempoRateTable->getDisplay(bufferLFO->fRate));
+	const BufferOverrideParameterInfo *info = getParameterInfo(index);
+	if (info == NULL) {
+		strcpy(text, "");
+		return;
+	}
+
+	float value = d_getParameterValue(index);
+	float tempoSync = (info->tempoSyncParameter >= 0) ? d_getParameterValue(info->tempoSyncParameter) : 0.0f;
+	if ( displayCacheValid[index] && (value == displayCacheValue[index]) && (tempoSync == displayCacheTempoSync[index]) ) {
+		strcpy(text, displayCache[index]);
+		return;
+	}
+
+	char *display = displayCache[index];
+	float scaledValue = getParameterScaled(index, value);
+	switch (info->format) {
+	case kParamFormatDivisor :
+		snprintf(display, PARAMETER_DISPLAY_LENGTH, "%.3f", (scaledValue < 2.0f) ? 1.0f : scaledValue);
+		break;
+	case kParamFormatBufferSize :
+	case kParamFormatLFOrate :
+		if (onOffTest(tempoSync))
+			snprintf(display, PARAMETER_DISPLAY_LENGTH, "%s", TempoRateTable::getDisplay(value));
 		else
-			sprintf(text, "%.1f", LFOrateScaled(bufferLFO->fRate));
+			snprintf(display, PARAMETER_DISPLAY_LENGTH, "%.1f", scaledValue);
 		break;
-	case kBufferLFOdepth :
-		sprintf(text, "%ld %%", (long)(bufferLFO->fDepth * 100.0f));
+	case kParamFormatYesNo :
+		strcpy(display, onOffTest(value) ? "yes" : "no");
 		break;
-	case kBufferLFOshape :
-		bufferLFO->getShapeName(text);
+	case kParamFormatPercent :
+		snprintf(display, PARAMETER_DISPLAY_LENGTH, "%ld %%", (long)scaledValue);
 		break;
-	case kBufferLFOtempoSync :
-		if (onOffTest(bufferLFO->fTempoSync))
-			strcpy(text, "yes");
-		else
-			strcpy(text, "no");
+	case kParamFormatPercentFine :
+		snprintf(display, PARAMETER_DISPLAY_LENGTH, "%.1f %%", scaledValue);
 		break;
-	case kSmooth :
-		sprintf(text, "%.1f %%", (fSmooth*100.0f));
+	case kParamFormatLFOshape :
+		LFO::getShapeName((long)scaledValue, display);
 		break;
-	case kDryWetMix :
-		sprintf(text, "%ld %%", (long)(fDryWetMix*100.0f));
+	case kParamFormatPitchbend :
+		snprintf(display, PARAMETER_DISPLAY_LENGTH, "\xB1%.2f", scaledValue);
 		break;
-	case kPitchbend :
-		sprintf(text, "\xB1%.2f", fPitchbend*PITCHBEND_MAX);
+	case kParamFormatMidiMode :
+		strcpy(display, onOffTest(value) ? "trigger" : "nudge");
 		break;
-	case kMidiMode :
-		if (onOffTest(fMidiMode))
-			sprintf(text, "trigger");
+	case kParamFormatTempo :
+		if ( (value > 0.0f) || (hostCanDoTempo != 1) )
+			snprintf(display, PARAMETER_DISPLAY_LENGTH, "%.3f", scaledValue);
 		else
-			strcpy(text, "nudge");
+			strcpy(display, "auto");
 		break;
-	case kTempo :
-		if ( (fTempo > 0.0f) || (hostCanDoTempo != 1) )
-			sprintf(text, "%.3f", tempoScaled(fTempo));
-		else
-			strcpy(text, "auto");
+	default :
+		strcpy(display, "");
 		break;
 	}
+	displayCacheValue[index] = value;
+	displayCacheTempoSync[index] = tempoSync;
+	displayCacheValid[index] = true;
+	strcpy(text, display);
 }
 
 void BufferOverride::getParameterLabel(long index, char *label)
 {
-	switch (index) {
-	case kDivisor         :
-		strcpy(label, " ");
-		break;
-	case kBuffer :
-		if (onOffTest(fBufferTempoSync))
-			strcpy(label, "buffers/beat");
-		else
-			strcpy(label, "samples");
-		break;
-	case kBufferTempoSync     :
-		strcpy(label, " ");
-		break;
-	case kBufferInterrupt     :
-		strcpy(label, " ");
-		break;
-	case kDivisorLFOrate      :
-		strcpy(label, "Hz");
-		break;
-	case kDivisorLFOdepth     :
-		strcpy(label, " ");
-		break;
-	case kDivisorLFOshape     :
-		strcpy(label, " ");
-		break;
-	case kDivisorLFOtempoSync :
-		strcpy(label, " ");
-		break;
-	case kBufferLFOrate       :
-		strcpy(label, "Hz");
-		break;
-	case kBufferLFOdepth      :
+	const BufferOverrideParameterInfo *info = getParameterInfo(index);
+	if (info == NULL)
 		strcpy(label, " ");
-		break;
-	case kBufferLFOshape      :
-		strcpy(label, " ");
-		break;
-	case kBufferLFOtempoSync  :
-		strcpy(label, " ");
-		break;
-	case kSmooth              :
-		strcpy(label, " ");
-		break;
-	case kDryWetMix           :
-		strcpy(label, " ");
-		break;
-	case kPitchbend           :
-		strcpy(label, "semitones");
-		break;
-	case kMidiMode            :
-		strcpy(label, " ");
-		break;
-	case kTempo               :
-		strcpy(label, "bpm");
-		break;
-	default:
-		strcpy(label, " ");
-		break;
-	}
+	else if ( (info->tempoSyncParameter >= 0) && onOffTest(d_getParameterValue(info->tempoSyncParameter)) )
+		strcpy(label, info->tempoSyncUnit);
+	else
+		strcpy(label, info->unit);
 }
 
 Plugin* createPlugin()
 {
-	return new DistrhoPlugin3BandEQ();
+	return new BufferOverride();
 }
 
 END_NAMESPACE_DISTRHO
@@ -0,0 +1,755 @@
+#ifndef __bufferOverride
+#include "bufferOverride.hpp"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+
+START_NAMESPACE_DISTRHO
+
+
+// how many segments the input gets cut into for each thread (more than one, so that
+// a thread that gets through its segments quickly can pick up some of the others' work)
+#define OFFLINE_SEGMENTS_PER_THREAD 4
+// the size of the blocks that get fed through d_run() when rendering offline
+#define OFFLINE_BLOCK_SIZE 4096
+// how many forced buffers the log has room for to begin with (it grows as needed)
+#define FORCED_BUFFER_LOG_START_SIZE 1024
+// & the same for the segments in a segment list
+#define SEGMENT_LIST_START_SIZE 4096
+
+// how many engines each sweep thread runs over the input together
+#define SWEEP_ENGINES_PER_THREAD 8
+// the tiles that a sweep goes through the input in (small enough that the input tile & the output tile
+// for it stay in the L1 cache while each engine in the batch gets its turn)
+#define SWEEP_TILE_SIZE 2048
+// the longest path that a render cache file can have
+#define RENDER_CACHE_PATH_MAX 1024
+
+//-----------------------------------------------------------------------------
+// what each offline render thread gets
+struct OfflineRenderJob
+{
+	BufferOverride *engine;	// the copy of the engine that this thread renders with
+	float **inputs, **outputs;
+	int64_t numSamples;
+	BufferOverrideCheckpoint **segments;	// each segment starts at one of these & ends where the next one starts
+	long numSegments;
+	const BufferOverrideForcedBuffer *log;
+	long logSize;
+	std::atomic<long> *nextSegment;	// the threads take the segments in order, one at a time, from this
+};
+
+//-----------------------------------------------------------------------------
+// what each sweep thread gets
+struct SweepJob
+{
+	BufferOverride *source;	// the engine with the settings that the sweep starts from
+	float **inputs;	// (shared by all of the threads & only ever read)
+	int64_t numSamples;
+	const BufferOverrideSweepAxis *axes;
+	long numAxes;
+	long numPoints;
+	BufferOverrideSweepWriter writer;
+	void *userData;
+	std::atomic<long> *nextPoint;	// the threads take batches of points in order from this
+	std::atomic<long> *pointsDone;
+};
+
+//-----------------------------------------------------------------------------
+// what comes at the start of a render cache file, before the output audio
+// (all of the first channel, then all of the next, as native floats)
+struct RenderCacheHeader
+{
+	int32_t magic;	// RENDER_CACHE_MAGIC
+	int32_t version;	// BUFFEROVERRIDE_RENDER_VERSION
+	uint8_t renderKey[BLAKE3_DIGEST_SIZE];	// from getRenderKey(), all of it
+	int64_t numSamples;
+	int32_t numChannels;
+	int32_t reserved;	// always 0
+};
+
+
+#pragma mark _________rendering_________
+
+//-----------------------------------------------------------------------------
+void BufferOverride::renderOffline(float **inputs, float **outputs, int64_t numSamples, long numThreads)
+{
+	if (numSamples <= 0)
+		return;
+	// (the reference engine doesn't cut it up)
+	if ( (numThreads < 1) || referenceMode )
+		numThreads = 1;
+
+	// start from scratch (d_deactivate() gives the capture buffers back to the pool, & d_run() only
+	// takes spares from there, but this isn't real time, so they can be allocated if there are none)
+	// with the modulation matrix as setModulation() last left it
+	applyStagedModulation();
+	d_deactivate();
+	clearCheckpoints();
+	createAudioBuffers();
+	renderingOffline = true;
+	long savedCheckpointInterval = checkpointInterval;
+
+	if (numThreads > 1) {
+		// first go through the whole thing without any audio, just to work out where the forced buffers
+		// fall, keeping a checkpoint at the start of each segment & a log of every forced buffer
+		// (that's cheap, since it's just the LFOs & the buffer boundaries)
+		checkpointInterval = (long) (numSamples / (numThreads * OFFLINE_SEGMENTS_PER_THREAD));
+		if (checkpointInterval < 1)
+			checkpointInterval = 1;
+		forcedBufferLog = (BufferOverrideForcedBuffer*) malloc(FORCED_BUFFER_LOG_START_SIZE * sizeof(BufferOverrideForcedBuffer));
+		forcedBufferLogSize = 0;
+		forcedBufferLogCapacity = (forcedBufferLog == NULL) ? 0 : FORCED_BUFFER_LOG_START_SIZE;
+		if (forcedBufferLog) {
+			scheduleOnly = true;
+			renderRange(inputs, outputs, 0, numSamples);
+			scheduleOnly = false;
+		}
+		// the log is no longer being added to (& the workers musn't add checkpoints either)
+		const BufferOverrideForcedBuffer *log = forcedBufferLog;
+		long logSize = forcedBufferLogSize;
+		forcedBufferLog = NULL;
+		checkpointInterval = 0;
+
+		BufferOverrideCheckpoint **segments = NULL;
+		long numSegments = 0;
+		if ( log && (numCheckpoints > 1) && (firstCheckpoint->samplePosition == 0) )
+			segments = new(std::nothrow) BufferOverrideCheckpoint*[numCheckpoints];
+		if (segments) {
+			for (BufferOverrideCheckpoint *checkpoint = firstCheckpoint; checkpoint; checkpoint = checkpoint->next)
+				segments[numSegments++] = checkpoint;
+			if (numThreads > numSegments)
+				numThreads = numSegments;
+
+			// then render the segments in parallel, each worker with its own copy of the engine
+			// (this one is the first worker, & it runs on the calling thread)
+			std::atomic<long> nextSegment(0);
+			OfflineRenderJob *jobs = new OfflineRenderJob[numThreads];
+			pthread_t *threads = new pthread_t[numThreads];
+			bool *threadStarted = new bool[numThreads];
+			for (long t=0; t < numThreads; t++) {
+				jobs[t].engine = this;
+				jobs[t].inputs = inputs;
+				jobs[t].outputs = outputs;
+				jobs[t].numSamples = numSamples;
+				jobs[t].segments = segments;
+				jobs[t].numSegments = numSegments;
+				jobs[t].log = log;
+				jobs[t].logSize = logSize;
+				jobs[t].nextSegment = &nextSegment;
+				threadStarted[t] = false;
+				if (t == 0)
+					continue;
+				// if a worker can't be had, the others just end up with more segments each
+				BufferOverride *worker;
+				try {
+					worker = new BufferOverride;
+				} catch (std::bad_alloc&) {
+					continue;
+				}
+				worker->copySettings(this);
+				if (!worker->createAudioBuffers()) {
+					delete worker;
+					continue;
+				}
+				jobs[t].engine = worker;
+				if (pthread_create(&(threads[t]), NULL, renderOfflineThread, &(jobs[t])) == 0)
+					threadStarted[t] = true;
+			}
+			renderOfflineThread(&(jobs[0]));
+			for (long t=1; t < numThreads; t++) {
+				if (threadStarted[t])
+					pthread_join(threads[t], NULL);
+				if (jobs[t].engine != this)
+					delete jobs[t].engine;
+			}
+			delete[] threadStarted;
+			delete[] threads;
+			delete[] jobs;
+			delete[] segments;
+		}
+		if (log)
+			free((void*)log);
+		forcedBufferLogSize = forcedBufferLogCapacity = 0;
+		clearCheckpoints();
+
+		// if there was no way to cut it up, it still needs to be rendered
+		if (segments == NULL) {
+			d_deactivate();
+			createAudioBuffers();
+			renderRange(inputs, outputs, 0, numSamples);
+		}
+	}
+	else
+	{
+		checkpointInterval = 0;
+		renderRange(inputs, outputs, 0, numSamples);
+	}
+
+	checkpointInterval = savedCheckpointInterval;
+	renderingOffline = false;
+	d_deactivate();
+}
+
+//-----------------------------------------------------------------------------
+// a render thread; it keeps taking the next segment that nobody has yet & rendering it
+void * BufferOverride::renderOfflineThread(void *job)
+{
+	OfflineRenderJob *renderJob = (OfflineRenderJob*) job;
+	BufferOverride *engine = renderJob->engine;
+
+	while (true)
+	{
+		long segment = renderJob->nextSegment->fetch_add(1);
+		if (segment >= renderJob->numSegments)
+			break;
+		const BufferOverrideCheckpoint *checkpoint = renderJob->segments[segment];
+		int64_t start = checkpoint->samplePosition;
+		int64_t end = (segment+1 < renderJob->numSegments) ? renderJob->segments[segment+1]->samplePosition : renderJob->numSamples;
+
+		// find the forced buffer that starts here (every checkpoint is taken just as one does)
+		long low = 0, high = renderJob->logSize - 1;
+		while (low < high) {
+			long middle = (low + high) / 2;
+			if (renderJob->log[middle].start < start)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		engine->applyCheckpoint(checkpoint);
+		engine->rebuildHistory(renderJob->inputs, renderJob->log, low);
+		engine->renderRange(renderJob->inputs, renderJob->outputs, start, end);
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// runs the input from start up to end through d_run(), a block at a time,
+// overwriting the output (unless it's the schedule-only pass, which has none)
+void BufferOverride::renderRange(float **inputs, float **outputs, int64_t start, int64_t end)
+{
+#ifdef BUFFEROVERRIDE_STEREO
+	const long numChannels = 2;
+#else
+	const long numChannels = 1;
+#endif
+	float *blockInputs[2], *blockOutputs[2];
+
+	for (int64_t position = start; position < end; position += OFFLINE_BLOCK_SIZE)
+	{
+		long blockSize = ((end - position) < OFFLINE_BLOCK_SIZE) ? (long)(end - position) : OFFLINE_BLOCK_SIZE;
+		for (long ch=0; ch < numChannels; ch++) {
+			// (the schedule-only pass doesn't need any audio, so it might not have been given any)
+			if (scheduleOnly) {
+				blockInputs[ch] = blockOutputs[ch] = NULL;
+				continue;
+			}
+			blockInputs[ch] = inputs[ch] + position;
+			blockOutputs[ch] = outputs[ch] + position;
+			memset(blockOutputs[ch], 0, blockSize * sizeof(float));
+		}
+		d_run(blockInputs, blockOutputs, blockSize);
+	}
+}
+
+
+
+#pragma mark _________sweeps_________
+
+//-----------------------------------------------------------------------------
+bool BufferOverride::renderSweep(float **inputs, int64_t numSamples, const BufferOverrideSweepAxis *axes, long numAxes,
+								BufferOverrideSweepWriter writer, void *userData, long numThreads)
+{
+	long numPoints = 1;
+	for (long a=0; a < numAxes; a++)
+		numPoints *= (axes[a].numValues > 0) ? axes[a].numValues : 0;
+	if ( (numPoints <= 0) || (numSamples <= 0) )
+		return true;
+	// (there's no point in having threads with nothing to do)
+	long maxThreads = (numPoints + SWEEP_ENGINES_PER_THREAD - 1) / SWEEP_ENGINES_PER_THREAD;
+	if (numThreads > maxThreads)
+		numThreads = maxThreads;
+	if (numThreads < 1)
+		numThreads = 1;
+	// (the engines copy the modulation matrix from this one)
+	applyStagedModulation();
+
+	std::atomic<long> nextPoint(0), pointsDone(0);
+	SweepJob job;
+	job.source = this;
+	job.inputs = inputs;
+	job.numSamples = numSamples;
+	job.axes = axes;
+	job.numAxes = numAxes;
+	job.numPoints = numPoints;
+	job.writer = writer;
+	job.userData = userData;
+	job.nextPoint = &nextPoint;
+	job.pointsDone = &pointsDone;
+
+	// (the threads only need to be told where the job is, & they all get the same one)
+	pthread_t *threads = NULL;
+	bool *threadStarted = NULL;
+	try {
+		threads = new pthread_t[numThreads];
+		threadStarted = new bool[numThreads];
+	} catch (std::bad_alloc &) {
+		delete[] threads;
+		threads = NULL;
+		numThreads = 1;
+	}
+	for (long t=1; t < numThreads; t++)
+		threadStarted[t] = (pthread_create(&(threads[t]), NULL, renderSweepThread, &job) == 0);
+	renderSweepThread(&job);
+	for (long t=1; t < numThreads; t++) {
+		if (threadStarted[t])
+			pthread_join(threads[t], NULL);
+	}
+	delete[] threadStarted;
+	delete[] threads;
+
+	return (pointsDone.load() >= numPoints);
+}
+
+//-----------------------------------------------------------------------------
+// a sweep thread; it sets up its engines once & then keeps taking the next batch of points
+// that nobody has yet, running them all over the input together, a tile at a time
+void * BufferOverride::renderSweepThread(void *job)
+{
+	SweepJob *sweepJob = (SweepJob*) job;
+#ifdef BUFFEROVERRIDE_STEREO
+	const long numChannels = 2;
+#else
+	const long numChannels = 1;
+#endif
+	BufferOverride *engines[SWEEP_ENGINES_PER_THREAD];
+	float tileOutput[2][SWEEP_TILE_SIZE];
+	float *tileInputs[2], *tileOutputs[2] = { tileOutput[0], tileOutput[1] };
+
+	// the engines are this thread's own, so their memory gets set up by the thread that uses it
+	long numEngines = 0;
+	for (; numEngines < SWEEP_ENGINES_PER_THREAD; numEngines++)
+	{
+		try {
+			engines[numEngines] = new BufferOverride;
+		} catch (std::bad_alloc &) {
+			break;
+		}
+		engines[numEngines]->copySettings(sweepJob->source);
+		if (!engines[numEngines]->createAudioBuffers()) {
+			delete engines[numEngines];
+			break;
+		}
+	}
+
+	while (numEngines > 0)
+	{
+		long firstPoint = sweepJob->nextPoint->fetch_add(numEngines);
+		if (firstPoint >= sweepJob->numPoints)
+			break;
+		long batchSize = sweepJob->numPoints - firstPoint;
+		if (batchSize > numEngines)
+			batchSize = numEngines;
+
+		// set up each engine like the source, but at its point in the grid, & start it from scratch
+		for (long e=0; e < batchSize; e++)
+		{
+			BufferOverride *engine = engines[e];
+			engine->copySettings(sweepJob->source);
+			long remaining = firstPoint + e;
+			for (long a = sweepJob->numAxes - 1; a >= 0; a--) {
+				const BufferOverrideSweepAxis *axis = &(sweepJob->axes[a]);
+				engine->d_setParameterValue(axis->parameter, axis->values[remaining % axis->numValues]);
+				remaining /= axis->numValues;
+			}
+			engine->renderingOffline = true;
+			engine->d_deactivate();
+			// (which gave its capture buffers back, so it takes some again, from the pool if it can)
+			engine->createAudioBuffers();
+		}
+
+		for (int64_t position = 0; position < sweepJob->numSamples; position += SWEEP_TILE_SIZE)
+		{
+			long tileSize = ((sweepJob->numSamples - position) < SWEEP_TILE_SIZE) ? (long)(sweepJob->numSamples - position) : SWEEP_TILE_SIZE;
+			for (long ch=0; ch < numChannels; ch++)
+				tileInputs[ch] = sweepJob->inputs[ch] + position;
+			for (long e=0; e < batchSize; e++)
+			{
+				for (long ch=0; ch < numChannels; ch++)
+					memset(tileOutputs[ch], 0, tileSize * sizeof(float));
+				engines[e]->d_run(tileInputs, tileOutputs, tileSize);
+				sweepJob->writer(sweepJob->userData, firstPoint + e, position, tileOutputs, tileSize);
+			}
+		}
+		sweepJob->pointsDone->fetch_add(batchSize);
+	}
+
+	for (long e=0; e < numEngines; e++)
+		delete engines[e];
+	return NULL;
+}
+
+
+#pragma mark _________segments_________
+
+//-----------------------------------------------------------------------------
+// d_run() calls this when a new forced buffer has just been set up at samplePos (only while logging)
+void BufferOverride::logForcedBuffer(long samplePos)
+{
+	if (forcedBufferLogSize >= forcedBufferLogCapacity) {
+		long newCapacity = (forcedBufferLogCapacity < FORCED_BUFFER_LOG_START_SIZE) ? FORCED_BUFFER_LOG_START_SIZE : (forcedBufferLogCapacity * 2);
+		BufferOverrideForcedBuffer *newLog = (BufferOverrideForcedBuffer*) realloc(forcedBufferLog, newCapacity * sizeof(BufferOverrideForcedBuffer));
+		// without the whole log, the segments' captured audio couldn't be rebuilt, so stop logging
+		// (& then renderOffline() won't have any log to go on & will just render it all in one go)
+		if (newLog == NULL) {
+			free(forcedBufferLog);
+			forcedBufferLog = NULL;
+			forcedBufferLogSize = forcedBufferLogCapacity = 0;
+			return;
+		}
+		forcedBufferLog = newLog;
+		forcedBufferLogCapacity = newCapacity;
+	}
+
+	BufferOverrideForcedBuffer *entry = &(forcedBufferLog[forcedBufferLogSize]);
+	entry->start = renderPosition + samplePos;
+	entry->size = dsp.currentForcedBufferSize;
+	entry->maxSizeBefore = 0;
+	if (forcedBufferLogSize > 0) {
+		const BufferOverrideForcedBuffer *previous = &(forcedBufferLog[forcedBufferLogSize-1]);
+		entry->maxSizeBefore = (previous->size > previous->maxSizeBefore) ? previous->size : previous->maxSizeBefore;
+	}
+	forcedBufferLogSize++;
+}
+
+//-----------------------------------------------------------------------------
+// The checkpoints from the schedule pass have no audio in them, so this works out what the
+// capture buffers would have held when the forced buffer at forcedBufferIndex started.
+// Each spot in a capture buffer holds the input from the latest forced buffer that was long
+// enough to reach it, so this goes back through the earlier forced buffers from the latest,
+// filling in however far each one reached past the ones that came after it.
+void BufferOverride::rebuildHistory(float **inputs, const BufferOverrideForcedBuffer *log, long forcedBufferIndex)
+{
+	dsp.buffer1.clear();
+#ifdef BUFFEROVERRIDE_STEREO
+	dsp.buffer2.clear();
+#endif
+
+	long covered = 0;
+	long needed = log[forcedBufferIndex].maxSizeBefore;
+	for (long i = forcedBufferIndex - 1; (i >= 0) && (covered < needed); i--)
+	{
+		if (log[i].size <= covered)
+			continue;
+		dsp.buffer1.write(covered, inputs[0] + log[i].start + covered, log[i].size - covered);
+	#ifdef BUFFEROVERRIDE_STEREO
+		dsp.buffer2.write(covered, inputs[1] + log[i].start + covered, log[i].size - covered);
+	#endif
+		covered = log[i].size;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// sets up this (freshly made) engine to render just like source
+void BufferOverride::copySettings(BufferOverride *source)
+{
+	for (uint32_t i=0; i < NUM_PARAMETERS; i++)
+		d_setParameterValue(i, source->d_getParameterValue(i));
+
+	setCaptureFormat(source->captureFormat, source->int16Headroom);
+	d_sampleRateChanged(source->SAMPLERATE);
+	setLFOgranularity(source->LFOgranularity);
+
+	setNumExtraLayers(source->dsp.numExtraLayers);
+	for (long n=0; n < MAX_EXTRA_LAYERS; n++)
+	{
+		BufferOverrideLayer *layer = &(source->layers[n]);
+		setLayer(n, layer->fDivisor, layer->divisorLFO.fRate, layer->divisorLFO.fDepth,
+				layer->divisorLFO.fShape, layer->divisorLFO.fTempoSync, layer->fGain);
+	}
+	for (long slot=0; slot < NUM_MOD_SLOTS; slot++)
+		applyModulation(slot, source->modBank->destination[slot], source->modBank->fRate[slot],
+					source->modBank->fDepth[slot], source->modBank->fShape[slot], source->modBank->fTempoSync[slot]);
+
+	hostCanDoTempo = source->hostCanDoTempo;
+	renderingOffline = source->renderingOffline;
+	randomSeed = source->randomSeed;
+	setReferenceMode(source->referenceMode);
+}
+
+
+
+#pragma mark _________segment_lists_________
+
+//-----------------------------------------------------------------------------
+long BufferOverride::makeSegmentList(int64_t numSamples, BufferOverrideSegment **segments)
+{
+	*segments = NULL;
+	if (numSamples <= 0)
+		return 0;
+
+	// this goes just like renderOffline()'s schedule pass, but keeping every span instead of checkpoints
+	applyStagedModulation();
+	d_deactivate();
+	renderingOffline = true;
+	long savedCheckpointInterval = checkpointInterval;
+	checkpointInterval = 0;
+	segmentList = (BufferOverrideSegment*) malloc(SEGMENT_LIST_START_SIZE * sizeof(BufferOverrideSegment));
+	segmentListSize = 0;
+	segmentListCapacity = (segmentList == NULL) ? 0 : SEGMENT_LIST_START_SIZE;
+	if (segmentList) {
+		scheduleOnly = true;
+		renderRange(NULL, NULL, 0, numSamples);
+		scheduleOnly = false;
+	}
+
+	// (the list is gone if it couldn't grow)
+	long numSegments = (segmentList == NULL) ? -1 : segmentListSize;
+	*segments = segmentList;
+	segmentList = NULL;
+	segmentListSize = segmentListCapacity = 0;
+	checkpointInterval = savedCheckpointInterval;
+	renderingOffline = false;
+	d_deactivate();
+
+	return numSegments;
+}
+
+//-----------------------------------------------------------------------------
+// works out where a layer's read (& its overlap) in the current span come from in the input
+void BufferOverride::setSegmentRead(BufferOverrideSegmentRead *read, long readPos, long prevMinibufferSize, long smoothcount, long numSamples)
+{
+	// whatever's read from the current forced buffer was captured from the input since it started
+	read->source = forcedBufferStart + readPos;
+	// the overlap is, too, unless it reaches past where we're capturing now, in which case it's
+	// the previous forced buffer's audio (see processSpan())
+	long overlapPos = readPos + prevMinibufferSize;
+	read->overlapSource = ((overlapPos > dsp.writePos) ? lastForcedBufferStart : forcedBufferStart) + overlapPos;
+	read->fadeLength = (smoothcount < numSamples) ? smoothcount : numSamples;
+	if (read->fadeLength < 0)
+		read->fadeLength = 0;
+}
+
+//-----------------------------------------------------------------------------
+// skipSpan() calls this with each span while a segment list is being made
+void BufferOverride::logSegment(long offset, long numSamples)
+{
+	BufferOverrideSegment segment;
+	segment.start = renderPosition + offset;
+	segment.length = numSamples;
+	segment.wetGain = dsp.outputGain;
+	segment.dryGain = dsp.inputGain;
+	segment.numReads = 1 + dsp.numExtraLayers;
+
+	BufferOverrideSegmentRead *read = &(segment.reads[0]);
+	setSegmentRead(read, dsp.readPos, dsp.prevMinibufferSize, dsp.smoothcount, numSamples);
+	read->gain = 1.0f;
+	read->fadeInGain = dsp.fadeInGain;
+	read->fadeOutGain = dsp.fadeOutGain;
+	read->realFadePart = dsp.realFadePart;
+	read->imaginaryFadePart = dsp.imaginaryFadePart;
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		read = &(segment.reads[1+n]);
+		setSegmentRead(read, layer->readPos, layer->prevMinibufferSize, layer->smoothcount, numSamples);
+		read->gain = layer->fGain;
+		read->fadeInGain = layer->fadeInGain;
+		read->fadeOutGain = layer->fadeOutGain;
+		read->realFadePart = layer->realFadePart;
+		read->imaginaryFadePart = layer->imaginaryFadePart;
+	}
+
+	// most spans just carry on from the one before, with no smoothing, so they can go together
+	if (segmentListSize > 0) {
+		BufferOverrideSegment *previous = &(segmentList[segmentListSize-1]);
+		bool continues = ( (previous->start + previous->length == segment.start) && (previous->numReads == segment.numReads)
+						&& (previous->wetGain == segment.wetGain) && (previous->dryGain == segment.dryGain) );
+		for (long r = 0; continues && (r < segment.numReads); r++) {
+			continues = ( (segment.reads[r].fadeLength == 0) && (segment.reads[r].gain == previous->reads[r].gain)
+						&& (previous->reads[r].source + previous->length == segment.reads[r].source) );
+		}
+		if (continues) {
+			previous->length += numSamples;
+			return;
+		}
+	}
+
+	if (segmentListSize >= segmentListCapacity) {
+		long newCapacity = (segmentListCapacity < SEGMENT_LIST_START_SIZE) ? SEGMENT_LIST_START_SIZE : (segmentListCapacity * 2);
+		BufferOverrideSegment *newList = (BufferOverrideSegment*) realloc(segmentList, newCapacity * sizeof(BufferOverrideSegment));
+		if (newList == NULL) {
+			free(segmentList);
+			segmentList = NULL;
+			segmentListSize = segmentListCapacity = 0;
+			return;
+		}
+		segmentList = newList;
+		segmentListCapacity = newCapacity;
+	}
+	segmentList[segmentListSize++] = segment;
+}
+
+
+
+#pragma mark _________render_cache_________
+
+//-----------------------------------------------------------------------------
+// whether the random LFO shapes matter anywhere, in which case unseeded renders are never the same twice
+bool BufferOverride::usesRandomShapes()
+{
+	if ( (divisorLFO.shape == kRandomLFO) || (divisorLFO.shape == kRandomInterpolatingLFO) )
+		return true;
+	if ( (bufferLFO.shape == kRandomLFO) || (bufferLFO.shape == kRandomInterpolatingLFO) )
+		return true;
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		long whichShape = layers[n].divisorLFO.shape;
+		if ( (whichShape == kRandomLFO) || (whichShape == kRandomInterpolatingLFO) )
+			return true;
+	}
+	return modBank->usesRandomShapes();
+}
+
+//-----------------------------------------------------------------------------
+// this covers the same settings that copySettings() does, since those are what a render depends on
+void BufferOverride::getRenderKey(float **inputs, int64_t numSamples, uint8_t *key)
+{
+#ifdef BUFFEROVERRIDE_STEREO
+	const long numChannels = 2;
+#else
+	const long numChannels = 1;
+#endif
+	applyStagedModulation();	// (see renderOfflineCached())
+	BLAKE3hasher hasher;
+	int32_t version = BUFFEROVERRIDE_RENDER_VERSION;
+	uint32_t pluginVersion = d_getVersion();
+	int32_t channels = (int32_t) numChannels;
+	hasher.update(&version, sizeof(version));
+	hasher.update(&pluginVersion, sizeof(pluginVersion));
+	hasher.update(&channels, sizeof(channels));
+	hasher.update(&numSamples, sizeof(numSamples));
+	hasher.update(&SAMPLERATE, sizeof(SAMPLERATE));
+	// (without a seed, the random sequences don't depend on anything, so they don't go into the key)
+	uint32_t seed = usesRandomShapes() ? randomSeed : 0;
+	hasher.update(&seed, sizeof(seed));
+
+	for (uint32_t i=0; i < NUM_PARAMETERS; i++) {
+		float value = d_getParameterValue(i);
+		hasher.update(&value, sizeof(value));
+	}
+	int32_t settings[3] = { (int32_t)captureFormat, (int32_t)LFOgranularity, (int32_t)dsp.numExtraLayers };
+	hasher.update(settings, sizeof(settings));
+	hasher.update(&int16Headroom, sizeof(int16Headroom));
+	for (long n=0; n < dsp.numExtraLayers; n++)
+	{
+		BufferOverrideLayer *layer = &(layers[n]);
+		float layerSettings[6] = { layer->fDivisor, layer->divisorLFO.fRate, layer->divisorLFO.fDepth,
+									layer->divisorLFO.fShape, layer->divisorLFO.fTempoSync, layer->fGain };
+		hasher.update(layerSettings, sizeof(layerSettings));
+	}
+	for (long slot=0; slot < NUM_MOD_SLOTS; slot++)
+	{
+		// (the slots that aren't routed anywhere don't do anything)
+		int32_t destination = (int32_t) modBank->destination[slot];
+		hasher.update(&destination, sizeof(destination));
+		if (destination == kNoModDestination)
+			continue;
+		float slotSettings[4] = { modBank->fRate[slot], modBank->fDepth[slot], modBank->fShape[slot], modBank->fTempoSync[slot] };
+		hasher.update(slotSettings, sizeof(slotSettings));
+	}
+
+	for (long ch=0; ch < numChannels; ch++)
+		hasher.update(inputs[ch], numSamples * sizeof(float));
+	hasher.finish(key);
+}
+
+//-----------------------------------------------------------------------------
+// gets the whole render from a cache file into the outputs, as long as it's the one that's wanted
+static bool readRenderCache(const char *path, const uint8_t *renderKey, float **outputs, int64_t numSamples, long numChannels)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+
+	RenderCacheHeader header;
+	bool success = ( (fread(&header, sizeof(header), 1, file) == 1) && (header.magic == RENDER_CACHE_MAGIC)
+					&& (header.version == BUFFEROVERRIDE_RENDER_VERSION) && (memcmp(header.renderKey, renderKey, BLAKE3_DIGEST_SIZE) == 0)
+					&& (header.numSamples == numSamples) && (header.numChannels == numChannels) );
+	for (long ch=0; success && (ch < numChannels); ch++)
+		success = (fread(outputs[ch], sizeof(float), (size_t)numSamples, file) == (size_t)numSamples);
+	fclose(file);
+	return success;
+}
+
+//-----------------------------------------------------------------------------
+// writes a render into the cache; it goes into a file of its own first & then gets renamed into
+// place, so that nobody ever reads a partly-written one, even with several renders going at once
+static void writeRenderCache(const char *path, const uint8_t *renderKey, float **outputs, int64_t numSamples, long numChannels)
+{
+	char tempPath[RENDER_CACHE_PATH_MAX + 64];
+	snprintf(tempPath, sizeof(tempPath), "%s.%ld.%p.tmp", path, (long)getpid(), (void*)outputs);
+	FILE *file = fopen(tempPath, "wb");
+	if (file == NULL)
+		return;
+
+	RenderCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = RENDER_CACHE_MAGIC;
+	header.version = BUFFEROVERRIDE_RENDER_VERSION;
+	memcpy(header.renderKey, renderKey, BLAKE3_DIGEST_SIZE);
+	header.numSamples = numSamples;
+	header.numChannels = (int32_t) numChannels;
+	bool success = (fwrite(&header, sizeof(header), 1, file) == 1);
+	for (long ch=0; success && (ch < numChannels); ch++)
+		success = (fwrite(outputs[ch], sizeof(float), (size_t)numSamples, file) == (size_t)numSamples);
+	if (fclose(file) != 0)
+		success = false;
+
+	if ( !success || (rename(tempPath, path) != 0) )
+		remove(tempPath);
+}
+
+//-----------------------------------------------------------------------------
+bool BufferOverride::renderOfflineCached(const char *cacheDirectory, float **inputs, float **outputs, int64_t numSamples, long numThreads)
+{
+#ifdef BUFFEROVERRIDE_STEREO
+	const long numChannels = 2;
+#else
+	const long numChannels = 1;
+#endif
+	char path[RENDER_CACHE_PATH_MAX];
+	// (so that the key goes by the modulation matrix that renderOffline() uses)
+	applyStagedModulation();
+	bool cacheable = ( (numSamples > 0) && (cacheDirectory != NULL) && ((randomSeed != 0) || !usesRandomShapes()) );
+	uint8_t renderKey[BLAKE3_DIGEST_SIZE];
+	if (cacheable) {
+		// the file is named for the whole key, & the header has it all again to check against
+		getRenderKey(inputs, numSamples, renderKey);
+		char keyText[(BLAKE3_DIGEST_SIZE * 2) + 1];
+		for (long i=0; i < BLAKE3_DIGEST_SIZE; i++)
+			snprintf(keyText + (i * 2), 3, "%02x", renderKey[i]);
+		int pathLength = snprintf(path, sizeof(path), "%s/bufferoverride-%s.render", cacheDirectory, keyText);
+		cacheable = (pathLength > 0) && (pathLength < (int)sizeof(path));
+	}
+
+	if ( cacheable && readRenderCache(path, renderKey, outputs, numSamples, numChannels) ) {
+		// (leave the engine the way that renderOffline() would have)
+		d_deactivate();
+		return true;
+	}
+
+	renderOffline(inputs, outputs, numSamples, numThreads);
+	if (cacheable)
+		writeRenderCache(path, renderKey, outputs, numSamples, numChannels);
+	return false;
+}
+
+
+END_NAMESPACE_DISTRHO
@@ -4,6 +4,137 @@
 #include "bufferOverride.hpp"
 #endif
 
+#include <math.h>
+#include <string.h>
+
+START_NAMESPACE_DISTRHO
+
+//-----------------------------------------------------------------------------
+// works out everything that the instances need to know from the host's time info, for SharedTransport
+static void getTransportSnapshot(VstTimeInfo *timeInfo, TransportSnapshot *snapshot)
+{
+	snapshot->samplePos = timeInfo->samplePos;
+	snapshot->flags = (int32_t) timeInfo->flags;
+	snapshot->tempoBPS = (kVstTempoValid & timeInfo->flags) ? (timeInfo->tempo / 60.0) : 0.0;
+	snapshot->samplesToBar = samplesToNextBar(timeInfo);
+}
+
+//-----------------------------------------------------------------------------
+// How far into the forced buffer a layer (the main one or an extra one) might still read, as of the start
+// of one of its minibuffers at minibufferStart.  Besides this minibuffer & its smoothing, there are the
+// minibuffers still to come in this forced buffer, & then the next forced buffer smoothing out of this one's
+// last minibuffer.  Without buffer interrupt, the minibuffers keep their size until the last one, which
+// stretches to at most twice that, so 4 minibuffers' worth covers all of those.  With buffer interrupt, any
+// of them can grow, but never past the end of the forced buffer, so the limit is twice what's left of it.
+// Buffer interrupt can get switched on at any time, though, & what got skipped can't be captured later.
+// Once it's on, a minibuffer is at most half of the forced buffer (the divisor is at least 2), or else it's
+// the stretched last one, which only reads as far as what's left of the forced buffer, & at that point
+// everything up to there has already been written.  So the first half of the forced buffer always gets kept.
+// The next forced buffer's opening crossfade (if this one is divided) starts from the end of this one's last
+// minibuffer, which is at most twice this minibuffer (or what's left of the forced buffer, with buffer
+// interrupt), & goes on for at most maxNextSmooth (see getMaxNextSmooth()).
+static long getCaptureReach(long minibufferSize, long prevMinibufferSize, long smoothDur,
+							long minibufferStart, long forcedBufferSize, bool bufferInterrupt, long maxNextSmooth)
+{
+	// (an empty minibuffer still reads 1 sample)
+	long reach = (minibufferSize < 1) ? 1 : minibufferSize;
+	long lastMinibufferEnd;
+	if (bufferInterrupt) {
+		lastMinibufferEnd = forcedBufferSize - minibufferStart;
+		if (reach < lastMinibufferEnd * 2)
+			reach = lastMinibufferEnd * 2;
+	} else {
+		lastMinibufferEnd = reach * 2;
+		reach *= 4;
+		if (reach <= (forcedBufferSize / 2))
+			reach = (forcedBufferSize / 2) + 1;
+	}
+	// & the smoothing that's starting now (except at the start of a forced buffer, when it's the previous one's audio)
+	if ( (minibufferStart > 0) && ((prevMinibufferSize + smoothDur) > reach) )
+		reach = prevMinibufferSize + smoothDur;
+	// & the next forced buffer's
+	if ( (maxNextSmooth > 0) && (minibufferSize < forcedBufferSize) && ((lastMinibufferEnd + maxNextSmooth) > reach) )
+		reach = lastMinibufferEnd + maxNextSmooth;
+	return reach;
+}
+
+//-----------------------------------------------------------------------------
+// The longest that the next forced buffer's opening crossfade could be, with the settings as they are now.
+// That's the smoothing amount times the next forced buffer's first minibuffer (of any layer), which is at most
+// the whole forced buffer (when the divisor is under 2), with the buffer LFO at its peak.  Bar sync only ever
+// lengthens a forced buffer after its minibuffers' size has been picked, so it doesn't come into it, but
+// anything routed in the modulation matrix could take the size or the smoothing anywhere.  If the settings
+// change before then so that the crossfade would want more, it gets cut short at what was captured, just
+// like when the smoothing gets switched on partway through a forced buffer.
+long BufferOverride::getMaxNextSmooth()
+{
+	if (!canSmooth())
+		return 0;
+	float maxSmooth = modBank->isRouted(kSmooth) ? 1.0f : fSmooth;
+
+	double maxMinibufferSize = (double) SUPER_MAX_BUFFER;
+	if (!modBank->isRouted(kBuffer)) {
+		if ( onOffTest(fBufferTempoSync) && (currentTempoBPS > 0.0) ) {
+			long rateNumerator, rateDenominator;
+			TempoRateTable::getRatio(fBuffer, &rateNumerator, &rateDenominator);
+			maxMinibufferSize = (SAMPLERATE * (double)rateDenominator) / (currentTempoBPS * (double)rateNumerator);
+		} else
+			maxMinibufferSize = (double) forcedBufferSizeSamples(fBuffer);
+		// (& 1 more for the leftover fraction that tempo sync carries over)
+		maxMinibufferSize = (maxMinibufferSize * (1.0 + (double)bufferLFO.fDepth)) + 1.0;
+		if (maxMinibufferSize > (double)SUPER_MAX_BUFFER)
+			maxMinibufferSize = (double) SUPER_MAX_BUFFER;
+	}
+	return (long) (maxSmooth * (float)maxMinibufferSize) + 1;
+}
+
+//-----------------------------------------------------------------------------
+// takes care of the MIDI events up to samplePos in this block (see queueMidiEvent());
+// nothing happens from these until updateBuffer() picks the divisor
+void BufferOverride::heedBufferOverrideEvents(long samplePos)
+{
+	const MIDIevent *event;
+	while ( (event = midistuff->nextEvent(samplePos)) != NULL ) {
+		switch (event->status & 0xF0) {
+		case kMidiNoteOn :
+			// (a note-on with 0 velocity is really a note-off)
+			if (event->data2 > 0) {
+				midistuff->noteOn(event->data1);
+				lastNoteOn = event->data1;
+				// the note takes over the divisor from the parameter
+				divisorWasChangedByHand = false;
+				divisorWasChangedByMIDI = true;
+			} else
+				midistuff->noteOff(event->data1);
+			break;
+		case kMidiNoteOff :
+			midistuff->noteOff(event->data1);
+			break;
+		case kMidiPitchbend :
+			lastPitchbend = (event->data2 << 7) | event->data1;
+			pitchbend = getPitchbendScalar();
+			break;
+		case kMidiCC :
+			if (event->data1 == kMidiCCallNotesOff)
+				midistuff->removeAllNotes();
+			break;
+		default :
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// the divisor scalar for the last pitchbend, over the range that fPitchbend sets
+// (this only needs working out when one of those changes)
+double BufferOverride::getPitchbendScalar()
+{
+	if (lastPitchbend == kInvalidMidi)
+		return 1.0;
+	double bend = (double)(lastPitchbend - kMidiPitchbendCenter) / (double)kMidiPitchbendCenter;
+	return pow( 2.0, bend * (double)fPitchbend * (double)PITCHBEND_MAX / 12.0 );
+}
+
 //-----------------------------------------------------------------------------
 void BufferOverride::updateBuffer(long samplePos)
 {
@@ -15,67 +146,94 @@ void BufferOverride::updateBuffer(long samplePos)
 	// take care of MIDI
 	heedBufferOverrideEvents(samplePos);
 
-	readPos = 0;	// reset for starting a new minibuffer
-	prevMinibufferSize = minibufferSize;
-	prevForcedBufferSize = currentForcedBufferSize;
+	dsp.readPos = 0;	// reset for starting a new minibuffer
+	dsp.prevMinibufferSize = dsp.minibufferSize;
+	prevForcedBufferSize = dsp.currentForcedBufferSize;
 
 	//--------------------------PROCESS THE LFOs----------------------------
-	// update the LFOs' positions to the current position
-	divisorLFO->updatePosition(prevMinibufferSize);
-	bufferLFO->updatePosition(prevMinibufferSize);
-	// Then get the current output values of the LFOs, which also updates their positions once more.
+	// get the current control-rate output values of the LFOs, which d_run() rendered for this block.
 	// Scale the 0.0 - 1.0 LFO output values to 0.0 - 2.0 (oscillating around 1.0).
-	divisorLFOvalue = processLFOzero2two(divisorLFO);
-	bufferLFOvalue = 2.0f - processLFOzero2two(bufferLFO);	// inverting it makes more pitch sense
-	// & then update the stepSize for each LFO, in case the LFO parameters have changed
-	if (onOffTest(divisorLFO->fTempoSync))
-		divisorLFO->stepSize = currentTempoBPS * (tempoRateTable->getScalar(divisorLFO->fRate)) * numLFOpointsDivSR;
-	else
-		divisorLFO->stepSize = LFOrateScaled(divisorLFO->fRate) * numLFOpointsDivSR;
-	if (onOffTest(bufferLFO->fTempoSync))
-		bufferLFO->stepSize = currentTempoBPS * (tempoRateTable->getScalar(bufferLFO->fRate)) * numLFOpointsDivSR;
-	else
-		bufferLFO->stepSize = LFOrateScaled(bufferLFO->fRate) * numLFOpointsDivSR;
+	divisorLFOvalue = modValueZero2two(&divisorLFO, samplePos);
+	bufferLFOvalue = 2.0f - modValueZero2two(&bufferLFO, samplePos);	// inverting it makes more pitch sense
+	// & get the parameter values with the modulation matrix applied
+	float bufferParam = modulatedParameter(kBuffer, fBuffer, samplePos);
+	float divisorParam = modulatedParameter(kDivisor, fDivisor, samplePos);
+	float smoothParam = modulatedParameter(kSmooth, fSmooth, samplePos);
+	if (modBank->isRouted(kDryWetMix))
+		calculateDryWetGains( modulatedParameter(kDryWetMix, fDryWetMix, samplePos) );
 
 	//---------------------------CALCULATE FORCED BUFFER SIZE----------------------------
 	// check if it's the end of this forced buffer
-	if (writePos >= currentForcedBufferSize) {
-		writePos = 0;	// start up a new forced buffer
+	if (dsp.writePos >= dsp.currentForcedBufferSize) {
+		dsp.writePos = 0;	// start up a new forced buffer
+		lastForcedBufferSize = prevForcedBufferSize;	// the extra layers need to know this later on
+		lastCaptureEnd = dsp.captureEnd;	// (as does the smoothing)
+		dsp.captureEnd = 0;
 
 		// check on the previous forced & minibuffers; don't smooth if the last forced buffer wasn't divided
-		if (prevMinibufferSize >= currentForcedBufferSize)
+		if (dsp.prevMinibufferSize >= dsp.currentForcedBufferSize)
 			doSmoothing = false;
 		else
 			doSmoothing = true;
 
 		// now update the the size of the current force buffer
 		if ( onOffTest(fBufferTempoSync) &&	// the user wants to do tempo sync / beat division rate
-		     (currentTempoBPS > 0.0f) ) { // avoid division by zero
-			currentForcedBufferSize = (long) ( SAMPLERATE / (currentTempoBPS * tempoRateTable->getScalar(fBuffer)) );
+		     (currentTempoBPS > 0.0) ) { // avoid division by zero
+			// work out the exact length from the tempo rate ratio (with the buffer LFO applied)
+			// in 32.32 fixed-point samples, & carry the leftover fraction of a sample on into
+			// the next forced buffer, so that the forced buffers don't drift off of the tempo grid
+			long rateNumerator, rateDenominator;
+			TempoRateTable::getRatio(bufferParam, &rateNumerator, &rateDenominator);
+			double exactSize = (SAMPLERATE * (double)rateDenominator) / (currentTempoBPS * (double)rateNumerator);
+			exactSize *= (double)bufferLFOvalue;
+			if (exactSize > (double)SUPER_MAX_BUFFER)
+				exactSize = (double)SUPER_MAX_BUFFER;
+			uint64_t fixedSize = (uint64_t) (exactSize * FORCED_BUFFER_FIXED_ONE) + forcedBufferFraction;
+			dsp.currentForcedBufferSize = (long) (fixedSize >> 32);
+			forcedBufferFraction = (uint32_t) fixedSize;
 			// set this true so that we make sure to do the measure syncronisation later on
 			if (needResync)
 				barSync = true;
-		} else
-			currentForcedBufferSize = forcedBufferSizeSamples(fBuffer);
-		// apply the buffer LFO to the forced buffer size
-		currentForcedBufferSize = (long) ((float)currentForcedBufferSize * bufferLFOvalue);
+		} else {
+			dsp.currentForcedBufferSize = forcedBufferSizeSamples(bufferParam);
+			// apply the buffer LFO to the forced buffer size
+			dsp.currentForcedBufferSize = (long) ((float)dsp.currentForcedBufferSize * bufferLFOvalue);
+			forcedBufferFraction = 0;
+		}
 		// really low tempos & tempo rate values can cause huge forced buffer sizes,
 		// so prevent going outside of the allocated buffer space
-		if (currentForcedBufferSize > SUPER_MAX_BUFFER)
-			currentForcedBufferSize = SUPER_MAX_BUFFER;
-		if (currentForcedBufferSize < 2)
-			currentForcedBufferSize = 2;
+		// (& the leftover fraction doesn't mean anything anymore if we do)
+		if (dsp.currentForcedBufferSize > SUPER_MAX_BUFFER) {
+			dsp.currentForcedBufferSize = SUPER_MAX_BUFFER;
+			forcedBufferFraction = 0;
+		}
+		if (dsp.currentForcedBufferSize < 2) {
+			dsp.currentForcedBufferSize = 2;
+			forcedBufferFraction = 0;
+		}
 
 		// untrue this so that we don't do the measure sync calculations again unnecessarily
 		needResync = false;
 	}
 
 	//-----------------------CALCULATE THE DIVISOR-------------------------
-	currentBufferDivisor = bufferDivisorScaled(fDivisor);
-	// apply the divisor LFO to the divisor value if there's an "active" divisor (i.e. 2 or greater)
+	currentBufferDivisor = bufferDivisorScaled(divisorParam);
+	// MIDI notes get to pick the divisor unless it's been changed by hand since the last one
+	if (onOffTest(fMidiMode)) {
+		// trigger mode:  a held note picks it, & once they've all been let go, the effect is off
+		int note = midistuff->getLatestNote();
+		if (note != kInvalidMidi)
+			currentBufferDivisor = midistuff->getNoteDivisor(note);
+		else if (!divisorWasChangedByHand)
+			currentBufferDivisor = 1.0f;
+	} else if ( (lastNoteOn != kInvalidMidi) && !divisorWasChangedByHand ) {
+		// nudge mode:  the last note picks it, held or not
+		currentBufferDivisor = midistuff->getNoteDivisor(lastNoteOn);
+	}
+	// apply the divisor LFO & pitchbend to the divisor value if there's an "active" divisor (i.e. 2 or greater)
 	if (currentBufferDivisor >= 2.0f) {
-		currentBufferDivisor *= divisorLFOvalue;
-		// now it's possible that the LFO could make the divisor less than 2,
+		currentBufferDivisor *= divisorLFOvalue * (float)pitchbend;
+		// now it's possible that the LFO or pitchbend could make the divisor less than 2,
 		// which will essentially turn the effect off, so we stop the modulation at 2
 		if (currentBufferDivisor < 2.0f)
 			currentBufferDivisor = 2.0f;
@@ -83,44 +241,50 @@ void BufferOverride::updateBuffer(long samplePos)
 
 	//-----------------------CALCULATE THE MINIBUFFER SIZE-------------------------
 	// this is not a new forced buffer starting up
-	if (writePos > 0) {
+	if (dsp.writePos > 0) {
 		// if it's allowed, update the minibuffer size midway through this forced buffer
 		if (onOffTest(fBufferInterrupt))
-			minibufferSize = (long) ( (float)currentForcedBufferSize / currentBufferDivisor );
+			dsp.minibufferSize = (long) ( (float)dsp.currentForcedBufferSize / currentBufferDivisor );
 		// if it's the last minibuffer, then fill up the forced buffer to the end
 		// by extending this last minibuffer to fill up the end of the forced buffer
-		long remainingForcedBuffer = currentForcedBufferSize - writePos;
-		if ( (minibufferSize*2) >= remainingForcedBuffer )
-			minibufferSize = remainingForcedBuffer;
+		long remainingForcedBuffer = dsp.currentForcedBufferSize - dsp.writePos;
+		if ( (dsp.minibufferSize*2) >= remainingForcedBuffer )
+			dsp.minibufferSize = remainingForcedBuffer;
 	}
 	// this is a new forced buffer just beginning, act accordingly, do bar sync if necessary
 	else {
 		long samplesToBar;
 		if (barSync) {
-			samplesToBar = samplesToNextBar(timeInfo);
+			samplesToBar = hostSamplesToBar;
+			// the forced buffers are starting over from the bar, so forget about any leftover fraction
+			forcedBufferFraction = 0;
 			// do beat sync for each LFO if it ought to be done
-			if (onOffTest(divisorLFO->fTempoSync))
-				divisorLFO->syncToTheBeat(samplesToBar);
-			if (onOffTest(bufferLFO->fTempoSync))
-				bufferLFO->syncToTheBeat(samplesToBar);
+			if (onOffTest(divisorLFO.fTempoSync))
+				divisorLFO.syncToTheBeat(samplesToBar, samplePos);
+			if (onOffTest(bufferLFO.fTempoSync))
+				bufferLFO.syncToTheBeat(samplesToBar, samplePos);
+			for (long n = 0; n < dsp.numExtraLayers; n++) {
+				if (onOffTest(layers[n].divisorLFO.fTempoSync))
+					layers[n].divisorLFO.syncToTheBeat(samplesToBar, samplePos);
+			}
 		}
 		// because there isn't really any division (given my implementation) when the divisor is < 2
 		if (currentBufferDivisor < 2.0f) {
 			if (barSync)
-				minibufferSize = currentForcedBufferSize = samplesToBar % currentForcedBufferSize;
+				dsp.minibufferSize = dsp.currentForcedBufferSize = samplesToBar % dsp.currentForcedBufferSize;
 			else
-				minibufferSize = currentForcedBufferSize;
+				dsp.minibufferSize = dsp.currentForcedBufferSize;
 		} else {
-			minibufferSize = (long) ( (float)currentForcedBufferSize / currentBufferDivisor );
+			dsp.minibufferSize = (long) ( (float)dsp.currentForcedBufferSize / currentBufferDivisor );
 			if (barSync) {
 				// calculate how long this forced buffer needs to be
-				long countdown = samplesToBar % currentForcedBufferSize;
+				long countdown = samplesToBar % dsp.currentForcedBufferSize;
 				// update the forced buffer size & number of minibuffers so that
 				// the forced buffers sync up with the musical measures of the song
-				if ( countdown < (minibufferSize*2) )	// extend the buffer if it would be too short...
-					currentForcedBufferSize += countdown;
+				if ( countdown < (dsp.minibufferSize*2) )	// extend the buffer if it would be too short...
+					dsp.currentForcedBufferSize += countdown;
 				else	// ...otherwise chop it down to the length of the extra bit needed to sync with the next measure
-					currentForcedBufferSize = countdown;
+					dsp.currentForcedBufferSize = countdown;
 			}
 		}
 	}
@@ -128,159 +292,724 @@ void BufferOverride::updateBuffer(long samplePos)
 	//-----------------------CALCULATE SMOOTHING DURATION-------------------------
 	// no smoothing if the previous forced buffer wasn't divided
 	if (!doSmoothing)
-		smoothcount = smoothDur = 0;
+		dsp.smoothcount = smoothDur = 0;
 	else {
-		smoothDur = (long) (fSmooth * (float)minibufferSize);
+		smoothDur = (long) (smoothParam * (float)dsp.minibufferSize);
 		long maxSmoothDur;
-		// if we're just starting a new forced buffer,
-		// then the samples beyond the end of the previous one are not valid
-		if (writePos <= 0)
-			maxSmoothDur = prevForcedBufferSize - prevMinibufferSize;
+		// if we're just starting a new forced buffer, then the samples beyond the end
+		// of the previous one are not valid, & neither are any that it didn't capture
+		// (it captures everything that this could read, unless smoothing got switched on
+		// from nothing partway through it, so that's the only time that this comes up short)
+		if (dsp.writePos <= 0)
+			maxSmoothDur = ((lastCaptureEnd < prevForcedBufferSize) ? lastCaptureEnd : prevForcedBufferSize) - dsp.prevMinibufferSize;
 		// otherwise just make sure that we don't go outside of the allocated arrays
 		else
-			maxSmoothDur = SUPER_MAX_BUFFER - prevMinibufferSize;
+			maxSmoothDur = SUPER_MAX_BUFFER - dsp.prevMinibufferSize;
 		if (smoothDur > maxSmoothDur)
 			smoothDur = maxSmoothDur;
-		smoothcount = smoothDur;
+		if (smoothDur < 0)
+			smoothDur = 0;
+		dsp.smoothcount = smoothDur;
 		smoothStep = 1.0f / (float)(smoothDur+1);	// the gain increment for each smoothing step
 
 //		sqrtFadeIn = sqrtf(smoothStep);
 //		sqrtFadeOut = sqrtf(1.0f - smoothStep);
 //		smoothFract = smoothStep;
 
-		fadeOutGain = cosf(PI/(float)(4*smoothDur));
-		fadeInGain = sinf(PI/(float)(4*smoothDur));
-		realFadePart = (fadeOutGain * fadeOutGain) - (fadeInGain * fadeInGain);	// cosf(3.141592/2/n)
-		imaginaryFadePart = 2.0f * fadeOutGain * fadeInGain;	// sinf(3.141592/2/n)
+		// smoothDur can come out as 0 here, but then smoothcount is 0, too, & the gains go unused
+		if (smoothDur > 0)
+			sinCosQuarterPi(PI/(float)(4*smoothDur), &dsp.fadeInGain, &dsp.fadeOutGain);
+		dsp.realFadePart = (dsp.fadeOutGain * dsp.fadeOutGain) - (dsp.fadeInGain * dsp.fadeInGain);	// cosf(3.141592/2/n)
+		dsp.imaginaryFadePart = 2.0f * dsp.fadeOutGain * dsp.fadeInGain;	// sinf(3.141592/2/n)
 	}
+
+	captureReach = getCaptureReach(dsp.minibufferSize, dsp.prevMinibufferSize, dsp.smoothcount,
+								dsp.writePos, dsp.currentForcedBufferSize, onOffTest(fBufferInterrupt), getMaxNextSmooth());
+
+	//-----------------------TELL THE GUI ABOUT IT-------------------------
+	// this is a few stores & a fixed handful of captured samples, & it never waits on the GUI
+	// (if the ring is full, the record gets dropped)
+	BufferOverrideTelemetry record;
+	record.divisor = currentBufferDivisor;
+	record.minibufferSize = dsp.minibufferSize;
+	record.forcedBufferSize = dsp.currentForcedBufferSize;
+	record.divisorLFOvalue = divisorLFOvalue;
+	record.bufferLFOvalue = bufferLFOvalue;
+	summarizeCapture(&record);
+	telemetry.push(record);
+	// (the outline of the last forced buffer's audio is done with now)
+	if (dsp.writePos == 0)
+		resetCaptureBins();
 }
 
+//-----------------------------------------------------------------------------
+// This outlines what the minibuffer that just ended played back (the start of the forced buffer, up
+// to prevMinibufferSize) for the GUI.  It splits that into TELEMETRY_SUMMARY_POINTS even stretches & takes
+// the lowest & highest of the capture bins that each one covers, which binCapture() has been keeping up,
+// so it costs the same however long the minibuffer was & it doesn't read the capture buffers at all.
+void BufferOverride::summarizeCapture(BufferOverrideTelemetry *record)
+{
+	long length = dsp.prevMinibufferSize;
+	for (long point = 0; point < TELEMETRY_SUMMARY_POINTS; point++) {
+		long start = (length * point) / TELEMETRY_SUMMARY_POINTS;
+		long end = (length * (point + 1)) / TELEMETRY_SUMMARY_POINTS;
+		// (a minibuffer shorter than the summary repeats its samples over the points, & an empty one is silent)
+		if ( (end <= start) && (length > 0) )
+			end = start + 1;
+		float lowest = HUGE_VALF, highest = -HUGE_VALF;
+		if (end > start) {
+			long lastBin = (end - 1) / captureBinSize;
+			if (lastBin >= TELEMETRY_CAPTURE_BINS)
+				lastBin = TELEMETRY_CAPTURE_BINS - 1;
+			for (long bin = start / captureBinSize; bin <= lastBin; bin++) {
+				lowest = (captureBinMin[bin] < lowest) ? captureBinMin[bin] : lowest;
+				highest = (captureBinMax[bin] > highest) ? captureBinMax[bin] : highest;
+			}
+		}
+		// (none of it got captured)
+		if (lowest > highest)
+			lowest = highest = 0.0f;
+		record->summaryMin[point] = lowest;
+		record->summaryMax[point] = highest;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// keeps up the lowest & highest samples of each capture bin, for numSamples of input being captured
+// at the current write position (the last bin takes anything past the end, if the forced buffer got longer)
+void BufferOverride::binCapture(float **inputs, long offset, long numSamples)
+{
+	long position = dsp.writePos, end = dsp.writePos + numSamples;
+	while (position < end) {
+		long bin = position / captureBinSize;
+		long binEnd = (bin + 1) * captureBinSize;
+		if (bin >= (TELEMETRY_CAPTURE_BINS - 1)) {
+			bin = TELEMETRY_CAPTURE_BINS - 1;
+			binEnd = end;
+		} else if (binEnd > end)
+			binEnd = end;
+		float lowest = captureBinMin[bin], highest = captureBinMax[bin];
+		const float *input1 = inputs[0] + offset + (position - dsp.writePos);
+		for (long i = 0; i < (binEnd - position); i++) {
+			lowest = (input1[i] < lowest) ? input1[i] : lowest;
+			highest = (input1[i] > highest) ? input1[i] : highest;
+		}
+#ifdef BUFFEROVERRIDE_STEREO
+		const float *input2 = inputs[1] + offset + (position - dsp.writePos);
+		for (long i = 0; i < (binEnd - position); i++) {
+			lowest = (input2[i] < lowest) ? input2[i] : lowest;
+			highest = (input2[i] > highest) ? input2[i] : highest;
+		}
+#endif
+		captureBinMin[bin] = lowest;
+		captureBinMax[bin] = highest;
+		position = binEnd;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// empties the capture bins & spreads them over the current forced buffer
+void BufferOverride::resetCaptureBins()
+{
+	captureBinSize = (dsp.currentForcedBufferSize + TELEMETRY_CAPTURE_BINS - 1) / TELEMETRY_CAPTURE_BINS;
+	if (captureBinSize < 1)
+		captureBinSize = 1;
+	for (long bin = 0; bin < TELEMETRY_CAPTURE_BINS; bin++) {
+		captureBinMin[bin] = HUGE_VALF;
+		captureBinMax[bin] = -HUGE_VALF;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// This does for an extra stutter layer what updateBuffer() does for the main layer.
+// The layers don't have forced buffers of their own; they divide up whatever forced
+// buffer the main layer has going, so this gets called after updateBuffer() whenever
+// a new forced buffer starts, as well as at the end of each of the layer's minibuffers.
+// smoothParam is the smoothing parameter with the modulation matrix applied, as of samplePos.
+void BufferOverride::updateLayer(BufferOverrideLayer *layer, long samplePos, float smoothParam)
+{
+	bool doSmoothing = true;
+
+	layer->readPos = 0;
+	layer->prevMinibufferSize = layer->minibufferSize;
+
+	// don't smooth if the last forced buffer wasn't divided
+	if ( (dsp.writePos <= 0) && (layer->prevMinibufferSize >= lastForcedBufferSize) )
+		doSmoothing = false;
+
+	// calculate the divisor, with the layer's LFO applied just like the main one
+	layer->currentBufferDivisor = bufferDivisorScaled(layer->fDivisor);
+	if (layer->currentBufferDivisor >= 2.0f) {
+		layer->currentBufferDivisor *= modValueZero2two(&(layer->divisorLFO), samplePos);
+		if (layer->currentBufferDivisor < 2.0f)
+			layer->currentBufferDivisor = 2.0f;
+	}
+
+	// calculate the minibuffer size
+	long remainingForcedBuffer = dsp.currentForcedBufferSize - dsp.writePos;
+	if (layer->currentBufferDivisor < 2.0f)
+		layer->minibufferSize = remainingForcedBuffer;
+	else {
+		if ( (dsp.writePos <= 0) || onOffTest(fBufferInterrupt) )
+			layer->minibufferSize = (long) ( (float)dsp.currentForcedBufferSize / layer->currentBufferDivisor );
+		// stretch the last minibuffer out to the end of the forced buffer
+		if ( (dsp.writePos > 0) && ((layer->minibufferSize*2) >= remainingForcedBuffer) )
+			layer->minibufferSize = remainingForcedBuffer;
+	}
+	if (layer->minibufferSize < 1)
+		layer->minibufferSize = 1;
+
+	// calculate the smoothing duration
+	if (!doSmoothing)
+		layer->smoothcount = layer->smoothDur = 0;
+	else {
+		layer->smoothDur = (long) (smoothParam * (float)layer->minibufferSize);
+		long maxSmoothDur;
+		if (dsp.writePos <= 0)
+			maxSmoothDur = ((lastCaptureEnd < lastForcedBufferSize) ? lastCaptureEnd : lastForcedBufferSize) - layer->prevMinibufferSize;
+		else
+			maxSmoothDur = SUPER_MAX_BUFFER - layer->prevMinibufferSize;
+		if (layer->smoothDur > maxSmoothDur)
+			layer->smoothDur = maxSmoothDur;
+		if (layer->smoothDur < 0)
+			layer->smoothDur = 0;
+		layer->smoothcount = layer->smoothDur;
+		if (layer->smoothDur > 0)
+			sinCosQuarterPi(PI/(float)(4*layer->smoothDur), &(layer->fadeInGain), &(layer->fadeOutGain));
+		layer->realFadePart = (layer->fadeOutGain * layer->fadeOutGain) - (layer->fadeInGain * layer->fadeInGain);
+		layer->imaginaryFadePart = 2.0f * layer->fadeOutGain * layer->fadeInGain;
+	}
+
+	layer->captureReach = getCaptureReach(layer->minibufferSize, layer->prevMinibufferSize, layer->smoothcount,
+										dsp.writePos, dsp.currentForcedBufferSize, onOffTest(fBufferInterrupt), getMaxNextSmooth());
+}
+
+//-----------------------------------------------------------------------------
+// d_run() calls this after any of the layers has started a new minibuffer.  Each layer's reach holds
+// from its latest minibuffer start on, so the furthest of them is as far as anything will still read
+// from here on.  That only ever shrinks during a forced buffer (whatever got skipped is skipped),
+// so the limit only gets lowered, until a new forced buffer starts it over.
+void BufferOverride::updateCaptureLimit(bool newForcedBuffer)
+{
+	long limit = captureReach;
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		if (layers[n].captureReach > limit)
+			limit = layers[n].captureReach;
+	}
+	// (bar sync can make a forced buffer empty, but a sample still goes through it, just like an empty minibuffer)
+	long forcedBufferSize = (dsp.currentForcedBufferSize < 1) ? 1 : dsp.currentForcedBufferSize;
+	if (limit > forcedBufferSize)
+		limit = forcedBufferSize;
+	if ( newForcedBuffer || (limit < dsp.captureLimit) )
+		dsp.captureLimit = limit;
+}
+
+
+//-----------------------------------------------------------------------------
+// applies the modulation matrix to a 0.0 - 1.0 parameter value at a sample position in the current block
+float BufferOverride::modulatedParameter(long index, float baseValue, long samplePos)
+{
+	if (modBank->numActiveSlots <= 0)
+		return baseValue;
+	float value = baseValue + modBank->getModOffset(index, samplePos);
+	if (value < 0.0f)
+		value = 0.0f;
+	else if (value > 1.0f)
+		value = 1.0f;
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// calculate these scaler values to minimize calculations later during processOutput()
+void BufferOverride::calculateDryWetGains(float dryWetMix)
+{
+//	inputGain = 1.0f - dryWetMix;
+//	outputGain = dryWetMix;
+	dsp.inputGain = sqrtf(1.0f - dryWetMix);
+	dsp.outputGain = sqrtf(dryWetMix);
+}
 
 
 //---------------------------------------------------------------------------------------------------
+// this is what the host calls (nothing in here writes to the inputs, it's just that
+// the offline renderers & the audit hand d_run() their own buffers)
+void BufferOverride::d_run(const float** inputs, float** outputs, uint32_t frames)
+{
+	d_run(const_cast<float**>(inputs), outputs, frames);
+}
+
 //---------------------------------------------------------------------------------------------------
 void BufferOverride::d_run(float **inputs, float **outputs, uint32_t sampleFrames)
 {
+	// (in audit builds, nothing in here should allocate, lock or make syscalls, except when rendering offline)
+	RT_AUDIT_SCOPE(!renderingOffline);
+
 //-------------------------SAFETY CHECK----------------------
-	// there must have not been available memory or something (like WaveLab goofing up),
-	// so try to allocate buffers now
-	if ( (buffer1 == NULL)
-#ifdef BUFFEROVERRIDE_STEREO
-	     || (buffer2 == NULL)
-#endif
-	   )
-		createAudioBuffers();
-	// if the creation failed, then abort audio processing
-	if (buffer1 == NULL)
-		return;
-#ifdef BUFFEROVERRIDE_STEREO
-	if (buffer2 == NULL)
-		return;
-#endif
+	// an instance that's been getting silence for long enough doesn't need its capture buffers
+	// (see setIdleRelease()), so this block can just be scheduled
+	bool idleBlock = !renderingOffline && updateIdleState(inputs, (long)sampleFrames);
+	// otherwise the buffers should be here since d_activate(), unless there wasn't available memory
+	// or something (like WaveLab goofing up) or they went back to the pool while idle, so try to get them now,
+	// but only from the pool's spares, since nothing here can allocate; if there aren't any, then this block
+	// just gets the dry part of the mix (& the boundaries keep going), & we try again next time
+	bool dryOnlyBlock = !idleBlock && !leaseAudioBuffers();
 
 
 //-------------------------INITIALIZATIONS----------------------
+	// apply the modulation routing & any state chunk that got loaded while we were running
+	applyStagedModulation();
+	applyStagedState();
+
+	// the MIDI that came in for this block (the minibuffer boundaries take it from there)
+	midistuff->startBlock(sampleFrames);
+
 	// this is a handy value to have during LFO calculations & wasteful to recalculate at every sample
-	numLFOpointsDivSR = NUM_LFO_POINTS_FLOAT / SAMPLERATE;
-	divisorLFO->pickTheLFOwaveform();
-	bufferLFO->pickTheLFOwaveform();
+	LFOphaseRangeDivSR = (float) (LFO_PHASE_RANGE / SAMPLERATE);
 
 	// calculate this scaler value to minimize calculations later during processOutput()
-//	float inputGain = 1.0f - fDryWetMix;
-//	float outputGain = fDryWetMix;
-	float inputGain = sqrtf(1.0f - fDryWetMix);
-	float outputGain = sqrtf(fDryWetMix);
+	// (if the modulation matrix is on it, then updateBuffer() takes care of this)
+	if ( !modBank->isRouted(kDryWetMix) )
+		calculateDryWetGains(fDryWetMix);
 
 
 //-----------------------TEMPO STUFF---------------------------
 	// figure out the current tempo if we're doing tempo sync
+	// (a slower tempo can make for a longer crossfade into the next forced buffer, see d_setParameterValue())
+	long oldMaxNextSmooth = getMaxNextSmooth();
+	bool layersUseTempoSync = false;
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		if (onOffTest(layers[n].divisorLFO.fTempoSync))
+			layersUseTempoSync = true;
+	}
 	if ( onOffTest(fBufferTempoSync) ||
-	     (onOffTest(divisorLFO->fTempoSync) || onOffTest(bufferLFO->fTempoSync)) ) {
+	     (onOffTest(divisorLFO.fTempoSync) || onOffTest(bufferLFO.fTempoSync)) ||
+	     modBank->usesTempoSync() || layersUseTempoSync ) {
 		// calculate the tempo at the current processing buffer
-		if ( (fTempo > 0.0f) || (hostCanDoTempo != 1) ) {	// get the tempo from the user parameter
-			currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+		// (there's no host timeline to follow when rendering offline)
+		if ( (fTempo > 0.0f) || (hostCanDoTempo != 1) || renderingOffline ) {	// get the tempo from the user parameter
+			currentTempoBPS = tempoScaled(fTempo) / 60.0;
 			needResync = false;	// we don't want it true if we're not syncing to host tempo
-		} else {	// get the tempo from the host
-			timeInfo = getTimeInfo(kBeatSyncTimeInfoFlags);
-			if (timeInfo) {
-				if (kVstTempoValid & timeInfo->flags)
-					currentTempoBPS = (float)timeInfo->tempo / 60.0f;
-				else
-					currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+			hostPositionKnown = false;
+		} else {	// get the tempo from the host (or from whichever instance already asked it during this cycle)
+			TransportSnapshot transport;
+			bool gotTransport = hostPositionKnown && !referenceMode && SharedTransport::get()->read(nextHostSamplePos, &transport);
+			if (!gotTransport) {
+				VstTimeInfo *timeInfo = getTimeInfo(kBeatSyncTimeInfoFlags);
+				if (timeInfo) {
+					getTransportSnapshot(timeInfo, &transport);
+					if (!referenceMode)
+						SharedTransport::get()->publish(&transport);
+					gotTransport = true;
+				}
+			}
+			// (the snapshot for the next cycle will be wherever this block ends)
+			hostPositionKnown = gotTransport && (transport.flags & kVstTransportPlaying);
+			if (gotTransport) {
+				nextHostSamplePos = transport.samplePos + (double)sampleFrames;
+				hostSamplesToBar = transport.samplesToBar;
+				currentTempoBPS = transport.tempoBPS;
 //				currentTempoBPS = ((float)tempoAt(reportCurrentPosition())) / 600000.0f;
 				// but zero & negative tempos are bad, so get the user tempo value instead if that happens
-				if (currentTempoBPS <= 0.0f)
-					currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+				if (currentTempoBPS <= 0.0)
+					currentTempoBPS = tempoScaled(fTempo) / 60.0;
 				//
 				// check if audio playback has just restarted & reset buffer stuff if it has (for measure sync)
-				if (timeInfo->flags & kVstTransportChanged) {
+				if (transport.flags & kVstTransportChanged) {
 					needResync = true;
-					currentForcedBufferSize = 1;
-					writePos = 1;
-					minibufferSize = 1;
-					prevMinibufferSize = 0;
-					smoothcount = smoothDur = 0;
+					forcedBufferFraction = 0;
+					dsp.currentForcedBufferSize = 1;
+					dsp.writePos = 1;
+					dsp.minibufferSize = 1;
+					dsp.prevMinibufferSize = 0;
+					dsp.smoothcount = smoothDur = 0;
+					dsp.captureLimit = dsp.captureEnd = dsp.currentForcedBufferSize;
 				}
-			} else {	// do the same stuff as above if the timeInfo gets a null pointer
-				currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+			} else {	// do the same stuff as above if the host didn't give us any time info
+				currentTempoBPS = tempoScaled(fTempo) / 60.0;
 				needResync = false;	// we don't want it true if we're not syncing to host tempo
 			}
 		}
 	}
+	allowForNextSmooth(oldMaxNextSmooth);
+
+
+//-----------------------LFO STUFF---------------------------
+	// update the stepSize for each LFO, in case the LFO parameters or the tempo have changed
+	if (onOffTest(divisorLFO.fTempoSync))
+		divisorLFO.setStepSize(currentTempoBPS * (TempoRateTable::getScalar(divisorLFO.fRate)) * LFOphaseRangeDivSR);
+	else
+		divisorLFO.setStepSize(LFOrateScaled(divisorLFO.fRate) * LFOphaseRangeDivSR);
+	if (onOffTest(bufferLFO.fTempoSync))
+		bufferLFO.setStepSize(currentTempoBPS * (TempoRateTable::getScalar(bufferLFO.fRate)) * LFOphaseRangeDivSR);
+	else
+		bufferLFO.setStepSize(LFOrateScaled(bufferLFO.fRate) * LFOphaseRangeDivSR);
+	for (long slot = 0; slot < NUM_MOD_SLOTS; slot++) {
+		if (onOffTest(modBank->fTempoSync[slot]))
+			modBank->setStepSize(slot, currentTempoBPS * (TempoRateTable::getScalar(modBank->fRate[slot])) * LFOphaseRangeDivSR);
+		else
+			modBank->setStepSize(slot, LFOrateScaled(modBank->fRate[slot]) * LFOphaseRangeDivSR);
+	}
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		LFO *layerLFO = &(layers[n].divisorLFO);
+		if (onOffTest(layerLFO->fTempoSync))
+			layerLFO->setStepSize(currentTempoBPS * (TempoRateTable::getScalar(layerLFO->fRate)) * LFOphaseRangeDivSR);
+		else
+			layerLFO->setStepSize(LFOrateScaled(layerLFO->fRate) * LFOphaseRangeDivSR);
+	}
+	// the LFOs get rendered at control rate in chunks that fit into their modulation buffers
+	long modBlockSize = (LFO_MOD_BUFFER_SIZE - 1) * LFOgranularity;
 
 
 //-----------------------AUDIO STUFF---------------------------
-	// here we begin the audio output loop, which has two checkpoints at the beginning
-	for (long samplecount = 0; (samplecount < sampleFrames); samplecount++) {
-		// check if it's the end of this minibuffer
-		if (readPos >= minibufferSize)
-			updateBuffer(samplecount);
-
-		// store the latest input samples into the buffers
-		buffer1[writePos] = inputs[0][samplecount];
+	for (long modBlockStart = 0; (modBlockStart < sampleFrames); modBlockStart += modBlockSize) {
+		long modBlockEnd = modBlockStart + modBlockSize;
+		if (modBlockEnd > (long)sampleFrames)
+			modBlockEnd = sampleFrames;
+		divisorLFO.renderModBuffer(modBlockStart, modBlockEnd - modBlockStart);
+		bufferLFO.renderModBuffer(modBlockStart, modBlockEnd - modBlockStart);
+		modBank->renderModBuffers(modBlockStart, modBlockEnd - modBlockStart);
+		for (long n = 0; n < dsp.numExtraLayers; n++)
+			layers[n].divisorLFO.renderModBuffer(modBlockStart, modBlockEnd - modBlockStart);
+
+		// here we begin the audio output loop, which goes a run of samples at a time
+		// between the minibuffer boundaries
+		long samplecount = modBlockStart;
+		while (samplecount < modBlockEnd) {
+			// check if it's the end of this minibuffer
+			bool newMinibuffer = false, newForcedBuffer = false;
+			if (dsp.readPos >= dsp.minibufferSize) {
+				// a new forced buffer starting is where checkpoints go, if we're keeping them
+				newForcedBuffer = (dsp.writePos >= dsp.currentForcedBufferSize);
+				if ( (checkpointInterval > 0) && newForcedBuffer )
+					saveCheckpoint(samplecount);
+				updateBuffer(samplecount);
+				if (newForcedBuffer) {
+					lastForcedBufferStart = forcedBufferStart;
+					forcedBufferStart = renderPosition + samplecount;
+					if (forcedBufferLog != NULL)
+						logForcedBuffer(samplecount);
+				}
+				newMinibuffer = true;
+			}
+			// & the same for the extra layers; a new forced buffer starts every layer over, too
+			for (long n = 0; n < dsp.numExtraLayers; n++) {
+				if ( (layers[n].readPos >= layers[n].minibufferSize) || (dsp.writePos == 0) ) {
+					updateLayer(&(layers[n]), samplecount, modulatedParameter(kSmooth, fSmooth, samplecount));
+					newMinibuffer = true;
+				}
+			}
+			if (newMinibuffer)
+				updateCaptureLimit(newForcedBuffer);
+
+			// figure out how far we can go before the next boundary
+			long spanLength = modBlockEnd - samplecount;
+			if (spanLength > CAPTURE_SPAN_MAX)
+				spanLength = CAPTURE_SPAN_MAX;
+			if (spanLength > (dsp.minibufferSize - dsp.readPos))
+				spanLength = dsp.minibufferSize - dsp.readPos;
+			for (long n = 0; n < dsp.numExtraLayers; n++) {
+				if (spanLength > (layers[n].minibufferSize - layers[n].readPos))
+					spanLength = layers[n].minibufferSize - layers[n].readPos;
+			}
+			// (a minibuffer can come out empty, but we still need to move along,
+			// & the reference engine just goes a sample at a time anyway)
+			if ( (spanLength < 1) || referenceMode )
+				spanLength = 1;
+
+			// (silence in & nothing but silence captured means that an idle block has nothing to add to the outputs)
+			if (scheduleOnly || idleBlock)
+				skipSpan(samplecount, spanLength);
+			else if (dryOnlyBlock) {
+				skipSpan(samplecount, spanLength);
+				dsp.kernels->mixGain(outputs[0]+samplecount, inputs[0]+samplecount, dsp.inputGain, spanLength);
+#ifdef BUFFEROVERRIDE_STEREO
+				dsp.kernels->mixGain(outputs[1]+samplecount, inputs[1]+samplecount, dsp.inputGain, spanLength);
+#endif
+			} else
+				processSpan(inputs, outputs, samplecount, spanLength);
+			samplecount += spanLength;
+		}
+	}
+
+	renderPosition += sampleFrames;
+}
+
+//-----------------------------------------------------------------------------
+// Keeps track of how long the input has been silent, & once it's been long enough, gives the
+// capture buffers back to the pool.  Returns true if this block can be run without them.
+// That's exact:  a forced buffer can't be longer than SUPER_MAX_BUFFER, so after that much silence
+// twice over, the current & the previous forced buffers were captured entirely from silence, & those
+// are all that can be read back, so fresh (silent) buffers later on won't sound any different.
+bool BufferOverride::updateIdleState(float **inputs, long numSamples)
+{
+	if (idleReleaseSamples <= 0)
+		return false;
+
+	float peak = dsp.kernels->peak(inputs[0], numSamples, 0.0f);
+#ifdef BUFFEROVERRIDE_STEREO
+	peak = dsp.kernels->peak(inputs[1], numSamples, peak);
+#endif
+	if (peak > 0.0f) {
+		silentSamples = 0;
+		return false;
+	}
+	silentSamples += numSamples;
+
+	if ( (silentSamples < idleReleaseSamples) || (silentSamples < (int64_t)(2 * SUPER_MAX_BUFFER)) )
+		return false;
+	// (nothing can be freed here, so if the pool is full, the buffers just stay)
+	if (dsp.buffer1.isAllocated())
+		dsp.buffer1.releaseToPool();
+#ifdef BUFFEROVERRIDE_STEREO
+	if (dsp.buffer2.isAllocated())
+		dsp.buffer2.releaseToPool();
+	if (dsp.buffer2.isAllocated())
+		return false;
+#endif
+	return !dsp.buffer1.isAllocated();
+}
+
+//-----------------------------------------------------------------------------
+// steps the smoothing crossfade's gain recurrence through numSamples samples,
+// storing the gains to use for each sample
+static void renderFadeGains(float *fadeIn, float *fadeOut, long numSamples, float *fadeInGain, float *fadeOutGain,
+							float realFadePart, float imaginaryFadePart)
+{
+	float inGain = *fadeInGain, outGain = *fadeOutGain;
+	for (long i = 0; i < numSamples; i++) {
+		fadeIn[i] = inGain;
+		fadeOut[i] = outGain;
+		inGain = (outGain * imaginaryFadePart) + (inGain * realFadePart);
+		outGain = (realFadePart * outGain) - (imaginaryFadePart * inGain);
+	}
+	*fadeInGain = inGain;
+	*fadeOutGain = outGain;
+}
+
+//-----------------------------------------------------------------------------
+// Renders a run of samples that has no minibuffer boundaries in it (for any of the layers),
+// so that the capture, the readback & the mixing can each be done a whole run at a time.
+// numSamples can't be more than CAPTURE_SPAN_MAX.
+void BufferOverride::processSpan(float **inputs, float **outputs, long offset, long numSamples)
+{
+	float out1[CAPTURE_SPAN_MAX], overlap1[CAPTURE_SPAN_MAX], layerOut1[CAPTURE_SPAN_MAX];
+	float layerOverlap1[MAX_EXTRA_LAYERS][CAPTURE_SPAN_MAX];
+#ifdef BUFFEROVERRIDE_STEREO
+	float out2[CAPTURE_SPAN_MAX], overlap2[CAPTURE_SPAN_MAX], layerOut2[CAPTURE_SPAN_MAX];
+	float layerOverlap2[MAX_EXTRA_LAYERS][CAPTURE_SPAN_MAX];
+#endif
+	float fadeIn[CAPTURE_SPAN_MAX], fadeOut[CAPTURE_SPAN_MAX];
+	long layerSmooth[MAX_EXTRA_LAYERS];
+	long n;
+
+	// The smoothing crossfades with the audio past the end of the previous minibuffer.
+	// If that starts past where we're capturing now, then it's the previous forced buffer's
+	// audio that we want, so it has to be read before the new input gets written over it.
+	long numSmooth = (dsp.smoothcount < numSamples) ? dsp.smoothcount : numSamples;
+	bool overlapFirst = ( (dsp.readPos + dsp.prevMinibufferSize) > dsp.writePos );
+	if ( (numSmooth > 0) && overlapFirst ) {
+		dsp.buffer1.read(dsp.readPos+dsp.prevMinibufferSize, overlap1, numSmooth);
+#ifdef BUFFEROVERRIDE_STEREO
+		dsp.buffer2.read(dsp.readPos+dsp.prevMinibufferSize, overlap2, numSmooth);
+#endif
+	}
+	for (n = 0; n < dsp.numExtraLayers; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		layerSmooth[n] = (layer->smoothcount < numSamples) ? layer->smoothcount : numSamples;
+		if ( (layerSmooth[n] > 0) && ((layer->readPos + layer->prevMinibufferSize) > dsp.writePos) ) {
+			dsp.buffer1.read(layer->readPos+layer->prevMinibufferSize, layerOverlap1[n], layerSmooth[n]);
 #ifdef BUFFEROVERRIDE_STEREO
-		buffer2[writePos] = inputs[1][samplecount];
+			dsp.buffer2.read(layer->readPos+layer->prevMinibufferSize, layerOverlap2[n], layerSmooth[n]);
 #endif
+		}
+	}
 
-		// get the current output without any smoothing
-		float out1 = buffer1[readPos];
+	// store the latest input samples into the buffers, as far as anything will read them
+	// (the reference engine stores all of them, but it keeps track of the capture limit just the same,
+	// since the smoothing goes by that, so anything that gets read past the limit comes out differently);
+	// once capturing has stopped, raising the limit can't make up for what got skipped, so it stays stopped
+	long numCapture = (dsp.writePos == dsp.captureEnd) ? (dsp.captureLimit - dsp.writePos) : 0;
+	if (numCapture > numSamples)
+		numCapture = numSamples;
+	if (referenceMode) {
+		dsp.buffer1.write(dsp.writePos, inputs[0]+offset, numSamples);
 #ifdef BUFFEROVERRIDE_STEREO
-		float out2 = buffer2[readPos];
+		dsp.buffer2.write(dsp.writePos, inputs[1]+offset, numSamples);
 #endif
+	} else if (numCapture > 0) {
+		dsp.buffer1.write(dsp.writePos, inputs[0]+offset, numCapture);
+#ifdef BUFFEROVERRIDE_STEREO
+		dsp.buffer2.write(dsp.writePos, inputs[1]+offset, numCapture);
+#endif
+	}
+	if (numCapture > 0)
+		dsp.captureEnd = dsp.writePos + numCapture;
+	// & outline them for the GUI (as much as is there to be read back)
+	long numBinned = referenceMode ? numSamples : numCapture;
+	if (numBinned > 0)
+		binCapture(inputs, offset, numBinned);
 
-		// and if smoothing is taking place, get the smoothed audio output
-		if (smoothcount > 0) {
-			// crossfade between the current input & its corresponding overlap sample
-//			out1 *= 1.0f - (smoothStep * (float)smoothcount);	// current
-//			out1 += buffer1[readPos+prevMinibufferSize] * smoothStep*(float)smoothcount;	// + previous
-//			float smoothfract = smoothStep * (float)smoothcount;
-//			float newgain = sqrt(1.0f - smoothfract);
-//			float oldgain = sqrt(smoothfract);
-//			out1 = (out1 * newgain) + (buffer1[readPos+prevMinibufferSize] * oldgain);
-//			out1 = (out1 * sqrtFadeIn) + (buffer1[readPos+prevMinibufferSize] * sqrtFadeOut);
-			out1 = (out1 * fadeInGain) + (buffer1[readPos+prevMinibufferSize] * fadeOutGain);
+	// now the overlaps that include audio that we just captured
+	if ( (numSmooth > 0) && !overlapFirst ) {
+		dsp.buffer1.read(dsp.readPos+dsp.prevMinibufferSize, overlap1, numSmooth);
 #ifdef BUFFEROVERRIDE_STEREO
-//			out2 *= 1.0f - (smoothStep * (float)smoothcount);	// current
-//			out2 += buffer2[readPos+prevMinibufferSize] * smoothStep*(float)smoothcount;	// + previous
-//			out2 = (out2 * newgain) + (buffer2[readPos+prevMinibufferSize] * oldgain);
-//			out2 = (out2 * sqrtFadeIn) + (buffer2[readPos+prevMinibufferSize] * sqrtFadeOut);
-			out2 = (out2 * fadeInGain) + (buffer2[readPos+prevMinibufferSize] * fadeOutGain);
+		dsp.buffer2.read(dsp.readPos+dsp.prevMinibufferSize, overlap2, numSmooth);
+#endif
+	}
+	for (n = 0; n < dsp.numExtraLayers; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		if ( (layerSmooth[n] > 0) && ((layer->readPos + layer->prevMinibufferSize) <= dsp.writePos) ) {
+			dsp.buffer1.read(layer->readPos+layer->prevMinibufferSize, layerOverlap1[n], layerSmooth[n]);
+#ifdef BUFFEROVERRIDE_STEREO
+			dsp.buffer2.read(layer->readPos+layer->prevMinibufferSize, layerOverlap2[n], layerSmooth[n]);
 #endif
-			smoothcount--;
-//			smoothFract += smoothStep;
-//			sqrtFadeIn = 0.5f * (sqrtFadeIn + (smoothFract / sqrtFadeIn));
-//			sqrtFadeOut = 0.5f * (sqrtFadeOut + ((1.0f-smoothFract) / sqrtFadeOut));
-			fadeInGain = (fadeOutGain * imaginaryFadePart) + (fadeInGain * realFadePart);
-			fadeOutGain = (realFadePart * fadeOutGain) - (imaginaryFadePart * fadeInGain);
 		}
+	}
+
+	// get the current output without any smoothing
+	dsp.buffer1.read(dsp.readPos, out1, numSamples);
+#ifdef BUFFEROVERRIDE_STEREO
+	dsp.buffer2.read(dsp.readPos, out2, numSamples);
+#endif
+
+	// and if smoothing is taking place, crossfade between the current output & its corresponding overlap sample
+	// (the gain curve is a recurrence, so it gets worked out first & then the crossfade itself can be vectorized)
+	renderFadeGains(fadeIn, fadeOut, numSmooth, &dsp.fadeInGain, &dsp.fadeOutGain, dsp.realFadePart, dsp.imaginaryFadePart);
+	dsp.kernels->crossfade(out1, overlap1, fadeIn, fadeOut, numSmooth);
+#ifdef BUFFEROVERRIDE_STEREO
+	dsp.kernels->crossfade(out2, overlap2, fadeIn, fadeOut, numSmooth);
+#endif
+	dsp.smoothcount -= numSmooth;
+
+	// mix in the extra stutter layers, which all read from the same captured audio
+	for (n = 0; n < dsp.numExtraLayers; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		dsp.buffer1.read(layer->readPos, layerOut1, numSamples);
+#ifdef BUFFEROVERRIDE_STEREO
+		dsp.buffer2.read(layer->readPos, layerOut2, numSamples);
+#endif
+		renderFadeGains(fadeIn, fadeOut, layerSmooth[n], &(layer->fadeInGain), &(layer->fadeOutGain),
+						layer->realFadePart, layer->imaginaryFadePart);
+		dsp.kernels->crossfade(layerOut1, layerOverlap1[n], fadeIn, fadeOut, layerSmooth[n]);
+#ifdef BUFFEROVERRIDE_STEREO
+		dsp.kernels->crossfade(layerOut2, layerOverlap2[n], fadeIn, fadeOut, layerSmooth[n]);
+#endif
+		layer->smoothcount -= layerSmooth[n];
+
+		dsp.kernels->mixGain(out1, layerOut1, layer->fGain, numSamples);
+#ifdef BUFFEROVERRIDE_STEREO
+		dsp.kernels->mixGain(out2, layerOut2, layer->fGain, numSamples);
+#endif
+		layer->readPos += numSamples;
+	}
 
-		outputs[0][samplecount] += (out1 * outputGain) + (inputs[0][samplecount] * inputGain);
+	// mix the wet & dry
+	const float *in1 = inputs[0] + offset;
+	float *output1 = outputs[0] + offset;
 #ifdef BUFFEROVERRIDE_STEREO
-		outputs[1][samplecount] += (out2 * outputGain) + (inputs[1][samplecount] * inputGain);
+	const float *in2 = inputs[1] + offset;
+	float *output2 = outputs[1] + offset;
+	dsp.kernels->mixWetDry(output2, out2, in2, dsp.outputGain, dsp.inputGain, numSamples);
 #endif
+	dsp.kernels->mixWetDry(output1, out1, in1, dsp.outputGain, dsp.inputGain, numSamples);
 
-		// increment the position trackers
-		readPos++;
-		writePos++;
+	// increment the position trackers
+	dsp.readPos += numSamples;
+	dsp.writePos += numSamples;
+}
+
+//-----------------------------------------------------------------------------
+// This moves through a span just like processSpan() does, but without any audio,
+// for when only the boundaries & the LFOs are wanted (& maybe a segment list).
+void BufferOverride::skipSpan(long offset, long numSamples)
+{
+	float fadeIn[CAPTURE_SPAN_MAX], fadeOut[CAPTURE_SPAN_MAX];
+
+	if (segmentList != NULL)
+		logSegment(offset, numSamples);
+
+	// (the fade gains aren't used after the smoothing ends, but this keeps the state the same anyway)
+	long numSmooth = (dsp.smoothcount < numSamples) ? dsp.smoothcount : numSamples;
+	renderFadeGains(fadeIn, fadeOut, numSmooth, &dsp.fadeInGain, &dsp.fadeOutGain, dsp.realFadePart, dsp.imaginaryFadePart);
+	dsp.smoothcount -= numSmooth;
+
+	for (long n = 0; n < dsp.numExtraLayers; n++) {
+		BufferOverrideLayer *layer = &(layers[n]);
+		numSmooth = (layer->smoothcount < numSamples) ? layer->smoothcount : numSamples;
+		renderFadeGains(fadeIn, fadeOut, numSmooth, &(layer->fadeInGain), &(layer->fadeOutGain),
+						layer->realFadePart, layer->imaginaryFadePart);
+		layer->smoothcount -= numSmooth;
+		layer->readPos += numSamples;
 	}
+
+	// (nothing gets captured, but the next forced buffer's smoothing needs to know how far it would have gotten)
+	long numCapture = (dsp.writePos == dsp.captureEnd) ? (dsp.captureLimit - dsp.writePos) : 0;
+	if (numCapture > numSamples)
+		numCapture = numSamples;
+	if (numCapture > 0)
+		dsp.captureEnd = dsp.writePos + numCapture;
+
+	dsp.readPos += numSamples;
+	dsp.writePos += numSamples;
 }
+
+//-----------------------------------------------------------------------------
+// This plays back a segment list by gathering up the input that it points to, which is
+// all that processSpan() really ends up doing, but here there's no capturing or scheduling,
+// & the runs between smoothing can be as long as they get.  The mixing goes in the same order
+// as in processSpan(), so that the output comes out exactly the same.
+void BufferOverride::renderSegmentList(const BufferOverrideSegment *segments, long numSegments, float **inputs, float **outputs)
+{
+	float out[CAPTURE_SPAN_MAX], layerOut[CAPTURE_SPAN_MAX], overlap[CAPTURE_SPAN_MAX];
+	float fadeIn[CAPTURE_SPAN_MAX], fadeOut[CAPTURE_SPAN_MAX];
+	float fadeInGain[1+MAX_EXTRA_LAYERS], fadeOutGain[1+MAX_EXTRA_LAYERS];
+#ifdef BUFFEROVERRIDE_STEREO
+	const long numChannels = 2;
+#else
+	const long numChannels = 1;
+#endif
+
+	for (long s = 0; s < numSegments; s++)
+	{
+		const BufferOverrideSegment *segment = &(segments[s]);
+		for (long ch = 0; ch < numChannels; ch++)
+		{
+			for (long r = 0; r < segment->numReads; r++) {
+				fadeInGain[r] = segment->reads[r].fadeInGain;
+				fadeOutGain[r] = segment->reads[r].fadeOutGain;
+			}
+
+			for (long done = 0; done < segment->length; done += CAPTURE_SPAN_MAX)
+			{
+				long runLength = segment->length - done;
+				if (runLength > CAPTURE_SPAN_MAX)
+					runLength = CAPTURE_SPAN_MAX;
+
+				for (long r = 0; r < segment->numReads; r++) {
+					const BufferOverrideSegmentRead *read = &(segment->reads[r]);
+					float *readOut = (r == 0) ? out : layerOut;
+					// (both channels get stored the same way, so buffer1 can do the quantizing for either)
+					dsp.buffer1.quantize(readOut, inputs[ch] + read->source + done, runLength);
+					long numFade = read->fadeLength - done;
+					if (numFade > runLength)
+						numFade = runLength;
+					if (numFade > 0) {
+						dsp.buffer1.quantize(overlap, inputs[ch] + read->overlapSource + done, numFade);
+						renderFadeGains(fadeIn, fadeOut, numFade, &(fadeInGain[r]), &(fadeOutGain[r]),
+										read->realFadePart, read->imaginaryFadePart);
+						dsp.kernels->crossfade(readOut, overlap, fadeIn, fadeOut, numFade);
+					}
+					if (r > 0)
+						dsp.kernels->mixGain(out, layerOut, read->gain, runLength);
+				}
+
+				float *output = outputs[ch] + segment->start + done;
+				memset(output, 0, runLength * sizeof(float));
+				dsp.kernels->mixWetDry(output, out, inputs[ch] + segment->start + done, segment->wetGain, segment->dryGain, runLength);
+			}
+		}
+	}
+}
+
+END_NAMESPACE_DISTRHO
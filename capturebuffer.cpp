@@ -0,0 +1,448 @@
+#ifndef __capturebuffer
+#include "capturebuffer.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#pragma mark _________pool_________
+
+//-----------------------------------------------------------------------------
+// this goes in front of every block's data (it's a whole cache line, so that the data stays lined up)
+struct alignas(64) CapturePoolHeader
+{
+	size_t numBytes;	// the size of the data
+	int64_t deliveredAt;	// when the housekeeping thread allocated it for a request (0 if it didn't)
+};
+
+//-----------------------------------------------------------------------------
+static int64_t getMilliseconds()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000) + 1;	// (+1 so that it's never 0)
+}
+
+//-----------------------------------------------------------------------------
+CapturePool::CapturePool()
+{
+	for (long i = 0; i < CAPTURE_POOL_SLOTS; i++) {
+		slots[i].store(NULL);
+		requests[i].store(0);
+	}
+	numSpares.store(0);
+
+	pthread_mutex_init(&housekeepingUsersLock, NULL);
+	numHousekeepingUsers = 0;
+	pthread_mutex_init(&housekeeperLock, NULL);
+	pthread_condattr_t wakeAttributes;
+	pthread_condattr_init(&wakeAttributes);
+	pthread_condattr_setclock(&wakeAttributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&housekeeperWake, &wakeAttributes);
+	pthread_condattr_destroy(&wakeAttributes);
+	housekeeperStopping = false;
+}
+
+//-----------------------------------------------------------------------------
+CapturePool * CapturePool::get()
+{
+	// (this never gets destroyed, since instances can still be around during static destruction)
+	static CapturePool *pool = new CapturePool;
+	return pool;
+}
+
+//-----------------------------------------------------------------------------
+void * CapturePool::allocateBlock(size_t numBytes)
+{
+	// (nothing gets read back before it's written, so this doesn't need to be silence, but calloc
+	// can usually hand over fresh pages without touching them, so it doesn't cost anything until it's used)
+	CapturePoolHeader *header = (CapturePoolHeader*) calloc(1, sizeof(CapturePoolHeader) + numBytes);
+	if (header == NULL)
+		return NULL;
+	header->numBytes = numBytes;
+	return header + 1;
+}
+
+//-----------------------------------------------------------------------------
+void CapturePool::freeBlock(void *block)
+{
+	free((CapturePoolHeader*)block - 1);
+}
+
+//-----------------------------------------------------------------------------
+size_t CapturePool::getBlockSize(void *block)
+{
+	return ((CapturePoolHeader*)block - 1)->numBytes;
+}
+
+//-----------------------------------------------------------------------------
+void * CapturePool::take(size_t numBytes)
+{
+	for (long i = 0; (i < CAPTURE_POOL_SLOTS) && (numSpares.load(std::memory_order_relaxed) > 0); i++) {
+		if (slots[i].load(std::memory_order_relaxed) == NULL)
+			continue;
+		void *block = slots[i].exchange(NULL, std::memory_order_acquire);
+		if (block == NULL)
+			continue;
+		if (getBlockSize(block) == numBytes) {
+			numSpares.fetch_sub(1, std::memory_order_relaxed);
+			((CapturePoolHeader*)block - 1)->deliveredAt = 0;
+			return block;
+		}
+		// it's from an instance with another sample rate or format
+		putBack(i, block);
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+void CapturePool::putBack(long slot, void *block)
+{
+	// where it was, or anywhere else that's empty if somebody has given one back there in the meantime
+	void *empty = NULL;
+	if (slots[slot].compare_exchange_strong(empty, block, std::memory_order_release))
+		return;
+	for (long j = 0; j < CAPTURE_POOL_SLOTS; j++) {
+		empty = NULL;
+		if (slots[j].compare_exchange_strong(empty, block, std::memory_order_release))
+			return;
+	}
+	// (that could only happen if every other slot got filled during all of this)
+	freeBlock(block);
+	numSpares.fetch_sub(1, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+bool CapturePool::giveBack(void *block, long maxSpares)
+{
+	if (numSpares.load(std::memory_order_relaxed) >= maxSpares)
+		return false;
+	for (long i = 0; i < CAPTURE_POOL_SLOTS; i++) {
+		void *empty = NULL;
+		if (slots[i].compare_exchange_strong(empty, block, std::memory_order_release)) {
+			numSpares.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+void CapturePool::trim(long numToKeep)
+{
+	int64_t now = getMilliseconds();
+	for (long i = 0; (i < CAPTURE_POOL_SLOTS) && (numSpares.load(std::memory_order_relaxed) > numToKeep); i++) {
+		void *block = slots[i].exchange(NULL, std::memory_order_acquire);
+		if (block == NULL)
+			continue;
+		int64_t deliveredAt = ((CapturePoolHeader*)block - 1)->deliveredAt;
+		if ( (deliveredAt != 0) && ((now - deliveredAt) < CAPTURE_POOL_DELIVERY_MS) )
+			putBack(i, block);
+		else {
+			freeBlock(block);
+			numSpares.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+long CapturePool::request(size_t numBytes)
+{
+	for (long i = 0; i < CAPTURE_POOL_SLOTS; i++) {
+		size_t empty = 0;
+		if (requests[i].compare_exchange_strong(empty, numBytes, std::memory_order_release))
+			return i;
+	}
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+void CapturePool::runHousekeeping()
+{
+	// the extras go first, so that there's room for what gets allocated
+	trim(CAPTURE_POOL_SPARES);
+
+	for (long i = 0; i < CAPTURE_POOL_SLOTS; i++) {
+		size_t numBytes = requests[i].load(std::memory_order_acquire);
+		if (numBytes == 0)
+			continue;
+		void *block = allocateBlock(numBytes);
+		if (block != NULL) {
+			((CapturePoolHeader*)block - 1)->deliveredAt = getMilliseconds();
+			if ( !giveBack(block) )
+				freeBlock(block);
+		}
+		// (if that didn't work, asking again gets it tried again)
+		requests[i].store(0, std::memory_order_release);
+	}
+}
+
+//-----------------------------------------------------------------------------
+void * CapturePool::housekeepingThread(void *arg)
+{
+	CapturePool *pool = (CapturePool*)arg;
+	pthread_mutex_lock(&(pool->housekeeperLock));
+	while (!pool->housekeeperStopping) {
+		pthread_mutex_unlock(&(pool->housekeeperLock));
+		pool->runHousekeeping();
+		pthread_mutex_lock(&(pool->housekeeperLock));
+		if (pool->housekeeperStopping)
+			break;
+		timespec wakeTime;
+		clock_gettime(CLOCK_MONOTONIC, &wakeTime);
+		wakeTime.tv_nsec += CAPTURE_POOL_HOUSEKEEPING_MS * 1000000L;
+		if (wakeTime.tv_nsec >= 1000000000L) {
+			wakeTime.tv_sec++;
+			wakeTime.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&(pool->housekeeperWake), &(pool->housekeeperLock), &wakeTime);
+	}
+	pthread_mutex_unlock(&(pool->housekeeperLock));
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+void CapturePool::startHousekeeping()
+{
+	pthread_mutex_lock(&housekeepingUsersLock);
+	if (numHousekeepingUsers == 0) {
+		housekeeperStopping = false;
+		// (if the thread can't be started, then the pool just doesn't get looked after)
+		if (pthread_create(&housekeeper, NULL, housekeepingThread, this) == 0)
+			numHousekeepingUsers++;
+	} else
+		numHousekeepingUsers++;
+	pthread_mutex_unlock(&housekeepingUsersLock);
+}
+
+//-----------------------------------------------------------------------------
+void CapturePool::stopHousekeeping()
+{
+	pthread_mutex_lock(&housekeepingUsersLock);
+	if (numHousekeepingUsers > 0) {
+		numHousekeepingUsers--;
+		if (numHousekeepingUsers == 0) {
+			pthread_mutex_lock(&housekeeperLock);
+			housekeeperStopping = true;
+			pthread_cond_signal(&housekeeperWake);
+			pthread_mutex_unlock(&housekeeperLock);
+			pthread_join(housekeeper, NULL);
+		}
+	}
+	pthread_mutex_unlock(&housekeepingUsersLock);
+}
+
+
+#pragma mark _________buffer_________
+
+//-----------------------------------------------------------------------------
+CaptureBuffer::CaptureBuffer()
+{
+	data = NULL;
+	numSamples = highWater = 0;
+	requestTicket = -1;
+	format = kCaptureFloat32;
+	setInt16Headroom(CAPTURE_INT16_HEADROOM);
+	kernels = getDFXkernels();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::setInt16Headroom(float newHeadroom)
+{
+	// (this also catches NaNs)
+	if ( !(newHeadroom > 0.0f) )
+		newHeadroom = CAPTURE_INT16_HEADROOM;
+	headroom = newHeadroom;
+	scale = 32767.0f / headroom;
+	inverseScale = 1.0f / scale;
+}
+
+//-----------------------------------------------------------------------------
+CaptureBuffer::~CaptureBuffer()
+{
+	release();
+}
+
+//-----------------------------------------------------------------------------
+long CaptureBuffer::bytesPerSample(long whichFormat)
+{
+	if ( (whichFormat == kCaptureInt16) || (whichFormat == kCaptureBfloat16) )
+		return 2;
+	return sizeof(float);
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureBuffer::allocate(long newNumSamples, long newFormat)
+{
+	if ( (newFormat < 0) || (newFormat >= numCaptureFormats) )
+		newFormat = kCaptureFloat32;
+	// nothing to do if it's already like that
+	if ( (data != NULL) && (newNumSamples == numSamples) && (newFormat == format) )
+		return true;
+
+	release();
+	size_t numBytes = (size_t)newNumSamples * bytesPerSample(newFormat);
+	void *block = CapturePool::get()->take(numBytes);
+	if (block == NULL)
+		block = CapturePool::allocateBlock(numBytes);
+	return setBlock(block, newNumSamples, newFormat);
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureBuffer::allocateFromPool(long newNumSamples, long newFormat)
+{
+	if ( (newFormat < 0) || (newFormat >= numCaptureFormats) )
+		newFormat = kCaptureFloat32;
+	if ( (data != NULL) && (newNumSamples == numSamples) && (newFormat == format) )
+		return true;
+
+	// (a buffer of the wrong size can't be freed here, so it goes to the pool too)
+	if ( !releaseToPool() )
+		return false;
+	size_t numBytes = (size_t)newNumSamples * bytesPerSample(newFormat);
+	CapturePool *pool = CapturePool::get();
+	if ( setBlock(pool->take(numBytes), newNumSamples, newFormat) )
+		return true;
+	// (one request at a time, or there'd be a new one every block until it got dealt with)
+	if ( !pool->isPending(requestTicket, numBytes) )
+		requestTicket = pool->request(numBytes);
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureBuffer::setBlock(void *block, long newNumSamples, long newFormat)
+{
+	data = block;
+	if (data == NULL)
+		return false;
+	numSamples = newNumSamples;
+	// (whatever is in there from before reads back as silence from here on)
+	highWater = 0;
+	format = newFormat;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::release()
+{
+	if (data) {
+		if ( !CapturePool::get()->giveBack(data, CAPTURE_POOL_SPARES) )
+			CapturePool::freeBlock(data);
+	}
+	data = NULL;
+	numSamples = highWater = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureBuffer::releaseToPool()
+{
+	if (data == NULL)
+		return true;
+	if ( !CapturePool::get()->giveBack(data) )
+		return false;
+	data = NULL;
+	numSamples = highWater = 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::write(long position, const float *source, long runLength)
+{
+	// anything skipped over past the high water mark has to be silence now that it's below it
+	// (all of the formats are 0 for all bits 0)
+	if (position > highWater)
+		memset((char*)data + (highWater * bytesPerSample(format)), 0, (position - highWater) * bytesPerSample(format));
+	if ((position + runLength) > highWater)
+		highWater = position + runLength;
+	switch (format) {
+		case kCaptureInt16:
+			kernels->captureInt16((int16_t*)data + position, source, runLength, scale);
+			break;
+		case kCaptureBfloat16:
+			kernels->captureBfloat16((uint16_t*)data + position, source, runLength);
+			break;
+		default:
+			memcpy((float*)data + position, source, runLength * sizeof(float));
+			break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::read(long position, float *dest, long runLength)
+{
+	// only what's been written is really in there, & the rest is silence
+	long numWritten = highWater - position;
+	if (numWritten > runLength)
+		numWritten = runLength;
+	if (numWritten < 0)
+		numWritten = 0;
+	if (numWritten > 0)
+		fill(position, dest, numWritten);
+	if (numWritten < runLength)
+		memset(dest + numWritten, 0, (runLength - numWritten) * sizeof(float));
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::fill(long position, float *dest, long runLength)
+{
+	switch (format) {
+		case kCaptureInt16:
+			kernels->readbackInt16(dest, (int16_t*)data + position, runLength, inverseScale);
+			break;
+		case kCaptureBfloat16:
+			kernels->readbackBfloat16(dest, (uint16_t*)data + position, runLength);
+			break;
+		default:
+			memcpy(dest, (float*)data + position, runLength * sizeof(float));
+			break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::quantize(float *dest, const float *source, long runLength)
+{
+	uint16_t stored[CAPTURE_QUANTIZE_CHUNK];
+
+	if ( (format != kCaptureInt16) && (format != kCaptureBfloat16) ) {
+		if (dest != source)
+			memmove(dest, source, runLength * sizeof(float));
+		return;
+	}
+	for (long done = 0; done < runLength; done += CAPTURE_QUANTIZE_CHUNK) {
+		long chunkLength = runLength - done;
+		if (chunkLength > CAPTURE_QUANTIZE_CHUNK)
+			chunkLength = CAPTURE_QUANTIZE_CHUNK;
+		if (format == kCaptureInt16) {
+			kernels->captureInt16((int16_t*)stored, source + done, chunkLength, scale);
+			kernels->readbackInt16(dest + done, (int16_t*)stored, chunkLength, inverseScale);
+		} else {
+			kernels->captureBfloat16(stored, source + done, chunkLength);
+			kernels->readbackBfloat16(dest + done, stored, chunkLength);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::saveHistory(void *dest, long historyStart, long historyLength)
+{
+	long sampleSize = bytesPerSample(format);
+	long numWritten = highWater - historyStart;
+	if (numWritten > historyLength)
+		numWritten = historyLength;
+	if (numWritten < 0)
+		numWritten = 0;
+	memcpy(dest, (char*)data + (historyStart * sampleSize), numWritten * sampleSize);
+	memset((char*)dest + (numWritten * sampleSize), 0, (historyLength - numWritten) * sampleSize);
+}
+
+//-----------------------------------------------------------------------------
+void CaptureBuffer::restoreHistory(const void *source, long historyStart, long historyLength)
+{
+	long sampleSize = bytesPerSample(format);
+	// (everything past it goes back to being silence just by moving the high water mark, but before it has to be cleared)
+	memset(data, 0, historyStart * sampleSize);
+	memcpy((char*)data + (historyStart * sampleSize), source, historyLength * sampleSize);
+	highWater = historyStart + historyLength;
+}
@@ -0,0 +1,192 @@
+#ifndef __capturebuffer
+#define __capturebuffer
+
+#include <atomic>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfxkernels.h"
+
+
+//-----------------------------------------------------------------------------
+// the ways that captured audio can be stored
+enum {
+	kCaptureFloat32,	// full 32-bit float
+	kCaptureInt16,	// 16-bit integer with a fixed scale for the whole buffer (see setInt16Headroom())
+	kCaptureBfloat16,	// the top half of a 32-bit float (same range, 8 bits of precision)
+
+	numCaptureFormats
+};
+
+// how far past 0 dB the int16 format can go before it clips, by default (4.0 is +12 dB)
+#define CAPTURE_INT16_HEADROOM 4.0f
+// how many samples quantize() converts at a time
+#define CAPTURE_QUANTIZE_CHUNK 256
+// the most spare buffers that the CapturePool can hold
+#define CAPTURE_POOL_SLOTS 64
+// how many of them it hangs onto when a buffer gets released somewhere that it's okay to free memory
+#define CAPTURE_POOL_SPARES 8
+// how often the housekeeping thread goes through the pool, in milliseconds
+#define CAPTURE_POOL_HOUSEKEEPING_MS 10
+// how long a block that got allocated for a request stays safe from trim(), in milliseconds,
+// so that whoever asked for it gets a chance to take it
+#define CAPTURE_POOL_DELIVERY_MS 1000
+
+
+//-----------------------------------------------------------------------------
+// The capture buffer memory that nobody is using right now, shared by every instance in the
+// process, so that memory goes with the number of instances that are running rather than the
+// number that are loaded.  The spares sit in a fixed array of slots that only ever get swapped
+// atomically, so taking one & giving one back never wait, allocate or free anything, & they can
+// happen on the audio thread.  What's in the spares is whatever their last users left there
+// (CaptureBuffer only ever reads back what it's written since it got one, so nobody has to clear them).
+class CapturePool
+{
+public:
+	// the one for the whole process
+	static CapturePool * get();
+
+	// takes a spare of numBytes, or returns NULL if there isn't one
+	void * take(size_t numBytes);
+	// adds a block to the spares, unless there are already
+	// maxSpares of them; returns false if it didn't go in
+	bool giveBack(void *block, long maxSpares = CAPTURE_POOL_SLOTS);
+	// frees spares until there are no more than numToKeep of them, other than ones that were
+	// just allocated for a request (this isn't for the audio thread)
+	void trim(long numToKeep);
+	long getNumSpares() {
+		return numSpares.load(std::memory_order_relaxed);
+	}
+
+	// Asks for a block of numBytes to be allocated & added to the spares, for when there wasn't
+	// one to take; this doesn't wait, allocate or free anything either, so it's for the audio thread.
+	// Returns a ticket for isPending(), or -1 if there are too many requests waiting already.
+	long request(size_t numBytes);
+	// whether the request with that ticket still hasn't been dealt with
+	bool isPending(long ticket, size_t numBytes) {
+		return (ticket >= 0) && (ticket < CAPTURE_POOL_SLOTS) && (requests[ticket].load(std::memory_order_acquire) == numBytes);
+	}
+	// The housekeeping thread runs for as long as anybody wants it (these count the users, & they
+	// aren't for the audio thread).  Every CAPTURE_POOL_HOUSEKEEPING_MS, it frees the spares past
+	// CAPTURE_POOL_SPARES, so that buffers given back on the audio thread don't fill up the slots,
+	// & then it allocates whatever has been requested.
+	void startHousekeeping();
+	void stopHousekeeping();
+	// one round of that, on the calling thread
+	void runHousekeeping();
+
+	// makes a new block of numBytes or returns NULL, & frees one; the data
+	// comes after a header with the block size, which is how the pool tells them apart
+	static void * allocateBlock(size_t numBytes);
+	static void freeBlock(void *block);
+	static size_t getBlockSize(void *block);
+
+private:
+	CapturePool();
+	// puts a block that got taken out of slot back there, or anywhere else that's empty;
+	// if there's nowhere, it gets freed
+	void putBack(long slot, void *block);
+	static void * housekeepingThread(void *arg);
+
+	std::atomic<void*> slots[CAPTURE_POOL_SLOTS];
+	std::atomic<long> numSpares;
+	std::atomic<size_t> requests[CAPTURE_POOL_SLOTS];	// the size of each block that's been asked for (0 for none)
+
+	pthread_mutex_t housekeepingUsersLock;	// (held while the thread gets started or stopped)
+	long numHousekeepingUsers;
+	pthread_t housekeeper;
+	pthread_mutex_t housekeeperLock;	// (for sleeping between rounds & getting woken up to stop)
+	pthread_cond_t housekeeperWake;
+	bool housekeeperStopping;
+};
+
+
+//-----------------------------------------------------------------------------
+// A buffer of captured audio in one of the storage formats above.
+// Samples go in & come out as floats, a run at a time.
+class CaptureBuffer
+{
+public:
+	CaptureBuffer();
+	~CaptureBuffer();
+
+	// (re)allocates for numSamples in the given format, taking a spare from the CapturePool if it
+	// has one; returns false if that failed
+	bool allocate(long newNumSamples, long newFormat);
+	// like allocate(), but only with a spare from the CapturePool, so it never allocates or frees
+	// anything & it's okay on the audio thread; returns false (& leaves the buffer empty) if there isn't one,
+	// in which case it asks the pool for one to be allocated (see CapturePool::request())
+	bool allocateFromPool(long newNumSamples, long newFormat);
+	// gives the memory to the CapturePool, or frees it if the pool has enough spares already
+	void release();
+	// gives the memory to the CapturePool without freeing or touching anything, so it's okay on the
+	// audio thread; returns false (& keeps the memory) if the pool is full
+	bool releaseToPool();
+	bool isAllocated() {
+		return (data != NULL);
+	}
+	long getFormat() {
+		return format;
+	}
+	long getNumSamples() {
+		return numSamples;
+	}
+	// the number of bytes that one sample takes up in a format
+	static long bytesPerSample(long whichFormat);
+	// how much memory the buffer is taking up
+	size_t getAllocatedBytes() {
+		return (data != NULL) ? CapturePool::getBlockSize(data) : 0;
+	}
+	// The int16 format's scale is fixed, since audio gets read back while more is still being captured
+	// into the same buffer, so it can't follow the level of what comes in.  That makes it a tradeoff:
+	// anything louder than headroom (a linear gain, where 1.0 is 0 dB) clips, & the steps are
+	// headroom / 32767, so the noise floor sits about 90 dB below headroom no matter how quiet the input is
+	// (the default +12 dB leaves around 78 dB below 0 dB).  Set it for the material (2.0, say, for audio that's
+	// mastered to peak at 0 dB), & only while nothing's stored, since it changes how all of that reads back.
+	void setInt16Headroom(float headroom);
+	float getInt16Headroom() {
+		return headroom;
+	}
+	// the conversion loops default to getDFXkernels(), but they can be swapped for others
+	void setKernels(const DFXkernels *newKernels) {
+		kernels = newKernels;
+	}
+
+	// stores runLength samples from source starting at position
+	void write(long position, const float *source, long runLength);
+	// gets runLength samples starting at position into dest
+	void read(long position, float *dest, long runLength);
+	// gives what runLength samples would read back as after being stored in this format,
+	// without storing them anywhere (dest can be the same as source)
+	void quantize(float *dest, const float *source, long runLength);
+
+	// how far into the buffer anything has been written since it was allocated or cleared
+	// (everything past that reads back as silence, whatever is actually in the memory)
+	long getHighWater() {
+		return highWater;
+	}
+	// copies the historyLength samples from historyStart on out or back in, as they're stored (so it takes
+	// historyLength * bytesPerSample(format) bytes); restoring also silences everything around them
+	void saveHistory(void *dest, long historyStart, long historyLength);
+	void restoreHistory(const void *source, long historyStart, long historyLength);
+	// silences everything that's been written (which just forgets it, so it doesn't cost anything)
+	void clear() {
+		highWater = 0;
+	}
+
+private:
+	bool setBlock(void *block, long newNumSamples, long newFormat);
+	void fill(long position, float *dest, long runLength);
+
+	void *data;
+	long numSamples;
+	long highWater;
+	long requestTicket;	// from the last time that allocateFromPool() asked the pool for a block
+	long format;
+	float headroom, scale, inverseScale;	// for the int16 format
+	const DFXkernels *kernels;	// the conversion loops for this CPU
+};
+
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef __dfxhash
+#include "dfxhash.h"
+#endif
+
+#include <string.h>
+
+
+//-----------------------------------------------------------------------------
+static inline uint32_t rotateRight32(uint32_t x, int bits)
+{
+	return (x >> bits) | (x << (32 - bits));
+}
+
+#define BLAKE3_G(a, b, c, d, mx, my)   \
+	v[a] += v[b] + (mx);  v[d] = rotateRight32(v[d] ^ v[a], 16);   \
+	v[c] += v[d];  v[b] = rotateRight32(v[b] ^ v[c], 12);   \
+	v[a] += v[b] + (my);  v[d] = rotateRight32(v[d] ^ v[a], 8);   \
+	v[c] += v[d];  v[b] = rotateRight32(v[b] ^ v[c], 7);
+
+//-----------------------------------------------------------------------------
+// one block at a time, for the odd blocks that don't come in whole chunks (the last chunk, the
+// parent nodes & the root); the whole chunks get done by the hashChunks() kernel instead
+static void compressBLAKE3(const uint32_t *chainingValue, const uint32_t *message, uint64_t counter,
+						   uint32_t blockLength, uint32_t flags, uint32_t *output)
+{
+	uint32_t v[16];
+	for (long i = 0; i < 8; i++)
+		v[i] = chainingValue[i];
+	for (long i = 0; i < 4; i++)
+		v[8+i] = kBLAKE3iv[i];
+	v[12] = (uint32_t) counter;
+	v[13] = (uint32_t) (counter >> 32);
+	v[14] = blockLength;
+	v[15] = flags;
+	for (long round = 0; round < 7; round++) {
+		const uint8_t *s = kBLAKE3schedule[round];
+		BLAKE3_G(0, 4, 8, 12, message[s[0]], message[s[1]])
+		BLAKE3_G(1, 5, 9, 13, message[s[2]], message[s[3]])
+		BLAKE3_G(2, 6, 10, 14, message[s[4]], message[s[5]])
+		BLAKE3_G(3, 7, 11, 15, message[s[6]], message[s[7]])
+		BLAKE3_G(0, 5, 10, 15, message[s[8]], message[s[9]])
+		BLAKE3_G(1, 6, 11, 12, message[s[10]], message[s[11]])
+		BLAKE3_G(2, 7, 8, 13, message[s[12]], message[s[13]])
+		BLAKE3_G(3, 4, 9, 14, message[s[14]], message[s[15]])
+	}
+	for (long i = 0; i < 8; i++)
+		output[i] = v[i] ^ v[8+i];
+}
+
+#undef BLAKE3_G
+
+//-----------------------------------------------------------------------------
+// joins up two subtrees' chaining values (flags is kBLAKE3root for the very top, otherwise 0)
+static void compressParent(const uint32_t *left, const uint32_t *right, uint32_t flags, uint32_t *output)
+{
+	uint32_t message[16];
+	memcpy(message, left, 8 * sizeof(uint32_t));
+	memcpy(message + 8, right, 8 * sizeof(uint32_t));
+	compressBLAKE3(kBLAKE3iv, message, 0, BLAKE3_BLOCK_SIZE, kBLAKE3parent | flags, output);
+}
+
+
+#pragma mark _________BLAKE3hasher_________
+
+//-----------------------------------------------------------------------------
+BLAKE3hasher::BLAKE3hasher()
+{
+	kernels = getDFXkernels();
+	reset();
+}
+
+//-----------------------------------------------------------------------------
+void BLAKE3hasher::reset()
+{
+	stackSize = 0;
+	numChunks = 0;
+	chunkLength = 0;
+}
+
+//-----------------------------------------------------------------------------
+void BLAKE3hasher::update(const void *data, size_t numBytes)
+{
+	const uint8_t *bytes = (const uint8_t*) data;
+
+	// top up the waiting chunk first; it only gets hashed once there's more after it,
+	// since the last chunk might turn out to be the root, which gets hashed differently
+	if (chunkLength > 0) {
+		size_t numToCopy = BLAKE3_CHUNK_SIZE - chunkLength;
+		if (numToCopy > numBytes)
+			numToCopy = numBytes;
+		memcpy(chunk + chunkLength, bytes, numToCopy);
+		chunkLength += numToCopy;
+		bytes += numToCopy;
+		numBytes -= numToCopy;
+		if (numBytes == 0)
+			return;
+		uint32_t chainingValue[8];
+		kernels->hashChunks(chainingValue, chunk, 1, numChunks);
+		addChainingValue(chainingValue);
+		chunkLength = 0;
+	}
+
+	// then the whole chunks straight from the input, as many at a time as the kernel takes
+	// (always leaving at least 1 byte, for the same reason)
+	while (numBytes > BLAKE3_CHUNK_SIZE) {
+		size_t numToHash = (numBytes - 1) / BLAKE3_CHUNK_SIZE;
+		if (numToHash > DFX_HASH_CHUNKS_MAX)
+			numToHash = DFX_HASH_CHUNKS_MAX;
+		uint32_t chainingValues[DFX_HASH_CHUNKS_MAX][8];
+		kernels->hashChunks(chainingValues[0], bytes, (long)numToHash, numChunks);
+		for (size_t i = 0; i < numToHash; i++)
+			addChainingValue(chainingValues[i]);
+		bytes += numToHash * BLAKE3_CHUNK_SIZE;
+		numBytes -= numToHash * BLAKE3_CHUNK_SIZE;
+	}
+
+	memcpy(chunk, bytes, numBytes);
+	chunkLength = numBytes;
+}
+
+//-----------------------------------------------------------------------------
+// The tree is built as the chunks come in:  each time the chunk count reaches a multiple of 2,
+// the 2 latest subtrees of the same size get joined into 1 (a multiple of 4 joins again, & so on),
+// so the stack holds one subtree for each 1 bit of the chunk count.  None of those can be the root,
+// because there's always another chunk still to come.
+void BLAKE3hasher::addChainingValue(const uint32_t *chainingValue)
+{
+	uint32_t joined[8];
+	memcpy(joined, chainingValue, sizeof(joined));
+	numChunks++;
+	for (uint64_t count = numChunks; (count & 1) == 0; count >>= 1) {
+		stackSize--;
+		compressParent(stack[stackSize], joined, 0, joined);
+	}
+	memcpy(stack[stackSize], joined, sizeof(joined));
+	stackSize++;
+}
+
+//-----------------------------------------------------------------------------
+void BLAKE3hasher::finish(uint8_t *digest) const
+{
+	// the last chunk (which might be empty, or the only one) goes a block at a time, with the last block padded with zeros
+	long numBlocks = (chunkLength > 0) ? (long)((chunkLength + BLAKE3_BLOCK_SIZE - 1) / BLAKE3_BLOCK_SIZE) : 1;
+	uint32_t chainingValue[8], message[16];
+	memcpy(chainingValue, kBLAKE3iv, sizeof(chainingValue));
+	uint32_t output[8];
+	for (long block = 0; block < numBlocks; block++) {
+		uint8_t blockBytes[BLAKE3_BLOCK_SIZE];
+		size_t start = (size_t)block * BLAKE3_BLOCK_SIZE;
+		size_t blockLength = (chunkLength - start < BLAKE3_BLOCK_SIZE) ? (chunkLength - start) : BLAKE3_BLOCK_SIZE;
+		memset(blockBytes, 0, sizeof(blockBytes));
+		memcpy(blockBytes, chunk + start, blockLength);
+		for (long i = 0; i < 16; i++)
+			message[i] = loadLittleEndian32(blockBytes + (i * 4));
+		uint32_t flags = (block == 0) ? kBLAKE3chunkStart : 0;
+		if (block == (numBlocks - 1)) {
+			flags |= kBLAKE3chunkEnd;
+			if (stackSize == 0)
+				flags |= kBLAKE3root;
+		}
+		compressBLAKE3(chainingValue, message, numChunks, (uint32_t)blockLength, flags, output);
+		memcpy(chainingValue, output, sizeof(chainingValue));
+	}
+
+	// & then it gets joined up with the subtrees on the stack, from the smallest to the biggest
+	for (long i = stackSize - 1; i >= 0; i--)
+		compressParent(stack[i], chainingValue, (i == 0) ? kBLAKE3root : 0, chainingValue);
+
+	for (long i = 0; i < 8; i++) {
+		digest[i*4] = (uint8_t) chainingValue[i];
+		digest[i*4 + 1] = (uint8_t) (chainingValue[i] >> 8);
+		digest[i*4 + 2] = (uint8_t) (chainingValue[i] >> 16);
+		digest[i*4 + 3] = (uint8_t) (chainingValue[i] >> 24);
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef __dfxhash
+#define __dfxhash
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfxkernels.h"
+
+
+//-----------------------------------------------------------------------------
+// constants & macros
+
+#define BLAKE3_DIGEST_SIZE 32	// in bytes
+#define BLAKE3_BLOCK_SIZE 64
+#define BLAKE3_CHUNK_SIZE 1024
+// the most subtrees that can be waiting to be joined up (enough for 2^54 chunks, which is 2^64 bytes)
+#define BLAKE3_MAX_DEPTH 54
+
+enum {
+	kBLAKE3chunkStart = 1,
+	kBLAKE3chunkEnd = 2,
+	kBLAKE3parent = 4,
+	kBLAKE3root = 8
+};
+
+// the starting chaining value (which is the same as SHA-256's)
+static const uint32_t kBLAKE3iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+// which message word goes where in each of the 7 rounds (each row is the one before it permuted)
+static const uint8_t kBLAKE3schedule[7][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+	{ 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+	{ 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+	{ 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+	{ 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+	{ 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+};
+
+// the little-endian 32-bit word at bytes (this compiles to a plain load where that's what it is)
+inline uint32_t loadLittleEndian32(const uint8_t *bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+
+//-----------------------------------------------------------------------------
+// The BLAKE3 hash (the plain, unkeyed kind, with the standard 256-bit digest), for telling
+// whether two big piles of bytes are the same.  Feed it the bytes with update(), in pieces of
+// any size, & then get the digest with finish().  The whole 1 KB chunks get hashed several at
+// a time by the hashChunks() kernel, so it goes about as fast as memory can feed it.
+class BLAKE3hasher
+{
+public:
+	BLAKE3hasher();
+
+	// starts over, as if nothing had been hashed yet
+	void reset();
+	void update(const void *data, size_t numBytes);
+	// puts the digest of everything so far into digest (BLAKE3_DIGEST_SIZE bytes); this doesn't
+	// change anything, so more can be added with update() after it
+	void finish(uint8_t *digest) const;
+
+	// these default to getDFXkernels(), but they can be swapped for others
+	void setKernels(const DFXkernels *newKernels) {
+		kernels = newKernels;
+	}
+
+private:
+	void addChainingValue(const uint32_t *chainingValue);
+
+	const DFXkernels *kernels;
+	uint32_t stack[BLAKE3_MAX_DEPTH][8];	// the chaining values of the subtrees still waiting for their partners
+	long stackSize;
+	uint64_t numChunks;	// how many chunks have been hashed & added to the stack
+	uint8_t chunk[BLAKE3_CHUNK_SIZE];	// the latest chunk, which waits here until there's more after it
+	size_t chunkLength;
+};
+
+
+#endif
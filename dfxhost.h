@@ -0,0 +1,22 @@
+#ifndef __dfxhost
+#define __dfxhost
+
+// These are the bits of the old dfxmisc that work with the host's VST types, so they
+// need the host SDK's headers included before this (VstTimeInfo & the rest come from there).
+// Everything else in dfxmisc doesn't, so it builds with the DSP core on its own.
+
+
+//-----------------------------------------------------------------------------
+// constants & macros
+
+#define kBeatSyncTimeInfoFlags   (kVstTempoValid | kVstTransportChanged | kVstBarsValid | kVstPpqPosValid | kVstTimeSigValid)
+
+
+//-----------------------------------------------------------------------------
+// function prototypes
+
+long samplesToNextBar(VstTimeInfo *timeInfo);
+void processProgramChangeEvents(VstEvents *events, AudioEffectX *effect);
+
+
+#endif
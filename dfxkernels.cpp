@@ -0,0 +1,290 @@
+#ifndef __dfxkernels
+#include "dfxkernels.h"
+#endif
+
+#include <string.h>
+
+#include "dfxhash.h"
+
+// x86 gets a few versions to choose from at runtime; anything else just gets
+// whatever the compiler flags for that build allow (like NEON on ARM64)
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+	#define DFX_KERNELS_X86_DISPATCH
+#endif
+
+// the compilers would otherwise fuse multiplies & adds in the variants whose instruction sets
+// include FMA (AVX-512 does), & then the output would differ a little from one machine to another
+#if defined(__clang__)
+	#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+	#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#ifdef __GNUC__
+	#define KERNEL_BODY   static inline __attribute__((always_inline))
+#else
+	#define KERNEL_BODY   static inline
+#endif
+
+
+#pragma mark _________kernel_bodies_________
+
+// These are written once here & then compiled into each variant below.  They're plain
+// loops over runs of samples with no branches inside, so that they vectorize.
+
+//-----------------------------------------------------------------------------
+// clips to the range that the scale allows & rounds to the nearest step
+// (it's offset to be positive so that the truncating conversion rounds, & the
+// comparisons are written the way that compiles to vector min & max)
+KERNEL_BODY void captureInt16Body(int16_t *dest, const float *source, long numSamples, float scale)
+{
+	for (long i = 0; i < numSamples; i++) {
+		float value = (source[i] * scale) + 32768.5f;
+		value = (value < 65535.0f) ? value : 65535.0f;
+		value = (value > 1.0f) ? value : 1.0f;
+		dest[i] = (int16_t) ((int32_t)value - 32768);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// keeps the top 16 bits of each float, rounding to nearest (ties to even)
+KERNEL_BODY void captureBfloat16Body(uint16_t *dest, const float *source, long numSamples)
+{
+	for (long i = 0; i < numSamples; i++) {
+		uint32_t bits;
+		memcpy(&bits, &(source[i]), sizeof(bits));
+		bits += 0x7FFF + ((bits >> 16) & 1);
+		dest[i] = (uint16_t) (bits >> 16);
+	}
+}
+
+//-----------------------------------------------------------------------------
+KERNEL_BODY void readbackInt16Body(float *dest, const int16_t *source, long numSamples, float inverseScale)
+{
+	for (long i = 0; i < numSamples; i++)
+		dest[i] = (float)source[i] * inverseScale;
+}
+
+//-----------------------------------------------------------------------------
+KERNEL_BODY void readbackBfloat16Body(float *dest, const uint16_t *source, long numSamples)
+{
+	for (long i = 0; i < numSamples; i++) {
+		uint32_t bits = (uint32_t)source[i] << 16;
+		memcpy(&(dest[i]), &bits, sizeof(bits));
+	}
+}
+
+//-----------------------------------------------------------------------------
+KERNEL_BODY void crossfadeBody(float *output, const float *overlap, const float *fadeIn, const float *fadeOut, long numSamples)
+{
+	for (long i = 0; i < numSamples; i++)
+		output[i] = (output[i] * fadeIn[i]) + (overlap[i] * fadeOut[i]);
+}
+
+//-----------------------------------------------------------------------------
+KERNEL_BODY void mixGainBody(float *output, const float *source, float gain, long numSamples)
+{
+	for (long i = 0; i < numSamples; i++)
+		output[i] += source[i] * gain;
+}
+
+//-----------------------------------------------------------------------------
+KERNEL_BODY void mixWetDryBody(float *output, const float *wet, const float *dry, float wetGain, float dryGain, long numSamples)
+{
+	for (long i = 0; i < numSamples; i++)
+		output[i] += (wet[i] * wetGain) + (dry[i] * dryGain);
+}
+
+//-----------------------------------------------------------------------------
+// For positive floats, the bigger ones also have the bigger bit patterns, so this compares
+// them as integers (which vectorizes without needing -ffast-math).  With the sign bit cleared
+// they all fit in a signed int, which has vector max instructions where unsigned doesn't always,
+// & NaNs get masked to 0 rather than picked around, so the loop is just and, compare, and & max.
+KERNEL_BODY float peakBody(const float *source, long numSamples, float peak)
+{
+	int32_t peakBits;
+	memcpy(&peakBits, &peak, sizeof(peakBits));
+	for (long i = 0; i < numSamples; i++) {
+		int32_t bits;
+		memcpy(&bits, &(source[i]), sizeof(bits));
+		bits &= 0x7FFFFFFF;	// absolute value
+		bits &= -(int32_t)(bits <= 0x7F800000);	// NaN
+		peakBits = (bits > peakBits) ? bits : peakBits;
+	}
+	memcpy(&peak, &peakBits, sizeof(peak));
+	return peak;
+}
+
+//-----------------------------------------------------------------------------
+KERNEL_BODY void advancePhasesBody(uint32_t *position, const uint32_t *stepSize, uint32_t *cyclesEnded, long numPhases, long numSteps)
+{
+	for (long i = 0; i < numPhases; i++) {
+		uint64_t newPosition = (uint64_t)position[i] + ((uint64_t)stepSize[i] * (uint64_t)numSteps);
+		position[i] = (uint32_t)newPosition;
+		cyclesEnded[i] = (uint32_t)(newPosition >> 32);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The phases & the scaling are vector math, & the table reads get put together lane by lane.  The compiler
+// can't check at runtime whether table reads overlap the output like it does for the other loops, so it
+// has to be told that they don't, & the index has to be a signed 32-bit one (which the shift guarantees).
+KERNEL_BODY void renderLFOtableBody(float * __restrict output, const float * __restrict table, uint32_t position, uint32_t stepSize,
+									int tableShift, float offset, float depth, long numValues)
+{
+	for (long i = 0; i < numValues; i++) {
+		uint32_t phase = position + (stepSize * (uint32_t)i);
+		output[i] = (table[(int32_t)(phase >> tableShift)] - offset) * depth;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Each lane is a chunk of its own, so every step of the compression is the same for all of them &
+// the loops across the lanes become vector math.  The lanes past numChunks just hash the first
+// chunk over again (so that there's nothing to branch on), & those results get thrown away.
+#define HASH_LANES_G(a, b, c, d, mx, my)   \
+	for (long l = 0; l < DFX_HASH_CHUNKS_MAX; l++) {   \
+		v[a][l] += v[b][l] + m[mx][l];  v[d][l] = hashRotate(v[d][l] ^ v[a][l], 16);   \
+		v[c][l] += v[d][l];  v[b][l] = hashRotate(v[b][l] ^ v[c][l], 12);   \
+		v[a][l] += v[b][l] + m[my][l];  v[d][l] = hashRotate(v[d][l] ^ v[a][l], 8);   \
+		v[c][l] += v[d][l];  v[b][l] = hashRotate(v[b][l] ^ v[c][l], 7);   \
+	}
+
+KERNEL_BODY uint32_t hashRotate(uint32_t x, int bits)
+{
+	return (x >> bits) | (x << (32 - bits));
+}
+
+KERNEL_BODY void hashChunksBody(uint32_t *chainingValues, const uint8_t *input, long numChunks, uint64_t chunkCounter)
+{
+	uint32_t cv[8][DFX_HASH_CHUNKS_MAX], v[16][DFX_HASH_CHUNKS_MAX], m[16][DFX_HASH_CHUNKS_MAX];
+	uint32_t counterLow[DFX_HASH_CHUNKS_MAX], counterHigh[DFX_HASH_CHUNKS_MAX];
+	for (long l = 0; l < DFX_HASH_CHUNKS_MAX; l++) {
+		for (long w = 0; w < 8; w++)
+			cv[w][l] = kBLAKE3iv[w];
+		uint64_t counter = chunkCounter + (uint64_t)l;
+		counterLow[l] = (uint32_t) counter;
+		counterHigh[l] = (uint32_t) (counter >> 32);
+	}
+
+	for (long block = 0; block < (BLAKE3_CHUNK_SIZE / BLAKE3_BLOCK_SIZE); block++) {
+		uint32_t words[DFX_HASH_CHUNKS_MAX][16];
+		for (long l = 0; l < DFX_HASH_CHUNKS_MAX; l++) {
+			const uint8_t *blockBytes = input + (((l < numChunks) ? l : 0) * BLAKE3_CHUNK_SIZE) + (block * BLAKE3_BLOCK_SIZE);
+			for (long w = 0; w < 16; w++)
+				words[l][w] = loadLittleEndian32(blockBytes + (w * 4));
+		}
+		for (long w = 0; w < 16; w++) {
+			for (long l = 0; l < DFX_HASH_CHUNKS_MAX; l++)
+				m[w][l] = words[l][w];
+		}
+		uint32_t flags = (block == 0) ? kBLAKE3chunkStart : 0;
+		if (block == ((BLAKE3_CHUNK_SIZE / BLAKE3_BLOCK_SIZE) - 1))
+			flags |= kBLAKE3chunkEnd;
+		for (long l = 0; l < DFX_HASH_CHUNKS_MAX; l++) {
+			for (long w = 0; w < 8; w++)
+				v[w][l] = cv[w][l];
+			for (long w = 0; w < 4; w++)
+				v[8+w][l] = kBLAKE3iv[w];
+			v[12][l] = counterLow[l];
+			v[13][l] = counterHigh[l];
+			v[14][l] = BLAKE3_BLOCK_SIZE;
+			v[15][l] = flags;
+		}
+		for (long round = 0; round < 7; round++) {
+			const uint8_t *s = kBLAKE3schedule[round];
+			HASH_LANES_G(0, 4, 8, 12, s[0], s[1])
+			HASH_LANES_G(1, 5, 9, 13, s[2], s[3])
+			HASH_LANES_G(2, 6, 10, 14, s[4], s[5])
+			HASH_LANES_G(3, 7, 11, 15, s[6], s[7])
+			HASH_LANES_G(0, 5, 10, 15, s[8], s[9])
+			HASH_LANES_G(1, 6, 11, 12, s[10], s[11])
+			HASH_LANES_G(2, 7, 8, 13, s[12], s[13])
+			HASH_LANES_G(3, 4, 9, 14, s[14], s[15])
+		}
+		for (long w = 0; w < 8; w++) {
+			for (long l = 0; l < DFX_HASH_CHUNKS_MAX; l++)
+				cv[w][l] = v[w][l] ^ v[8+w][l];
+		}
+	}
+
+	for (long l = 0; l < numChunks; l++) {
+		for (long w = 0; w < 8; w++)
+			chainingValues[(l * 8) + w] = cv[w][l];
+	}
+}
+
+#undef HASH_LANES_G
+
+#pragma mark _________variants_________
+
+// defines a full set of kernels, with the given function attributes, & a table of them
+#define DEFINE_DFX_KERNELS(suffix, attributes, tableName)   \
+	static attributes void captureInt16_##suffix(int16_t *dest, const float *source, long numSamples, float scale)   \
+		{ captureInt16Body(dest, source, numSamples, scale); }   \
+	static attributes void captureBfloat16_##suffix(uint16_t *dest, const float *source, long numSamples)   \
+		{ captureBfloat16Body(dest, source, numSamples); }   \
+	static attributes void readbackInt16_##suffix(float *dest, const int16_t *source, long numSamples, float inverseScale)   \
+		{ readbackInt16Body(dest, source, numSamples, inverseScale); }   \
+	static attributes void readbackBfloat16_##suffix(float *dest, const uint16_t *source, long numSamples)   \
+		{ readbackBfloat16Body(dest, source, numSamples); }   \
+	static attributes void crossfade_##suffix(float *output, const float *overlap, const float *fadeIn, const float *fadeOut, long numSamples)   \
+		{ crossfadeBody(output, overlap, fadeIn, fadeOut, numSamples); }   \
+	static attributes void mixGain_##suffix(float *output, const float *source, float gain, long numSamples)   \
+		{ mixGainBody(output, source, gain, numSamples); }   \
+	static attributes void mixWetDry_##suffix(float *output, const float *wet, const float *dry, float wetGain, float dryGain, long numSamples)   \
+		{ mixWetDryBody(output, wet, dry, wetGain, dryGain, numSamples); }   \
+	static attributes float peak_##suffix(const float *source, long numSamples, float peak)   \
+		{ return peakBody(source, numSamples, peak); }   \
+	static attributes void advancePhases_##suffix(uint32_t *position, const uint32_t *stepSize, uint32_t *cyclesEnded, long numPhases, long numSteps)   \
+		{ advancePhasesBody(position, stepSize, cyclesEnded, numPhases, numSteps); }   \
+	static attributes void renderLFOtable_##suffix(float *output, const float *table, uint32_t position, uint32_t stepSize, int tableShift, float offset, float depth, long numValues)   \
+		{ renderLFOtableBody(output, table, position, stepSize, tableShift, offset, depth, numValues); }   \
+	static attributes void hashChunks_##suffix(uint32_t *chainingValues, const uint8_t *input, long numChunks, uint64_t chunkCounter)   \
+		{ hashChunksBody(chainingValues, input, numChunks, chunkCounter); }   \
+	static const DFXkernels tableName = {   \
+		#suffix,   \
+		captureInt16_##suffix, captureBfloat16_##suffix, readbackInt16_##suffix, readbackBfloat16_##suffix,   \
+		crossfade_##suffix, mixGain_##suffix, mixWetDry_##suffix, peak_##suffix,   \
+		advancePhases_##suffix, renderLFOtable_##suffix, hashChunks_##suffix   \
+	};
+
+// the baseline for the build (SSE2 on x86-64)
+DEFINE_DFX_KERNELS(generic, , genericKernels)
+
+#ifdef DFX_KERNELS_X86_DISPATCH
+DEFINE_DFX_KERNELS(avx2, __attribute__((target("avx2"))), avx2Kernels)
+DEFINE_DFX_KERNELS(avx512, __attribute__((target("avx512f,avx512bw"))), avx512Kernels)
+#endif
+
+
+#pragma mark _________dispatch_________
+
+//-----------------------------------------------------------------------------
+static const DFXkernels * chooseDFXkernels()
+{
+#ifdef DFX_KERNELS_X86_DISPATCH
+	// (these also check that the OS saves the bigger registers)
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") )
+		return &avx512Kernels;
+	if ( __builtin_cpu_supports("avx2") )
+		return &avx2Kernels;
+#endif
+	return &genericKernels;
+}
+
+//-----------------------------------------------------------------------------
+const DFXkernels * getDFXreferenceKernels()
+{
+	return &genericKernels;
+}
+
+//-----------------------------------------------------------------------------
+const DFXkernels * getDFXkernels()
+{
+	// this only gets worked out once, & it's thread-safe
+	static const DFXkernels *kernels = chooseDFXkernels();
+	return kernels;
+}
@@ -0,0 +1,53 @@
+#ifndef __dfxkernels
+#define __dfxkernels
+
+#include <stdint.h>
+
+
+// the most BLAKE3 chunks that hashChunks() does at once (one for each 32-bit lane of an AVX-512 register)
+#define DFX_HASH_CHUNKS_MAX 16
+
+//-----------------------------------------------------------------------------
+// The hot DSP loops, each compiled for a few instruction sets & picked once at load time
+// for whatever CPU we end up running on.  They all get called through one of these tables.
+// Every variant gives exactly the same results (no fused multiply-adds anywhere),
+// so output doesn't depend on the machine.
+struct DFXkernels
+{
+	const char *name;	// which instruction set these are for, for debugging
+
+	// captured audio storage (the float version is just memcpy, which is already dispatched by libc)
+	void (*captureInt16)(int16_t *dest, const float *source, long numSamples, float scale);
+	void (*captureBfloat16)(uint16_t *dest, const float *source, long numSamples);
+	void (*readbackInt16)(float *dest, const int16_t *source, long numSamples, float inverseScale);
+	void (*readbackBfloat16)(float *dest, const uint16_t *source, long numSamples);
+
+	// output = (output * fadeIn) + (overlap * fadeOut), with a gain for every sample
+	void (*crossfade)(float *output, const float *overlap, const float *fadeIn, const float *fadeOut, long numSamples);
+	// output += source * gain
+	void (*mixGain)(float *output, const float *source, float gain, long numSamples);
+	// output += (wet * wetGain) + (dry * dryGain)
+	void (*mixWetDry)(float *output, const float *wet, const float *dry, float wetGain, float dryGain, long numSamples);
+	// returns the larger of peak & the largest absolute value in source (NaNs are ignored)
+	float (*peak)(const float *source, long numSamples, float peak);
+
+	// steps LFO phase accumulators ahead numSteps samples & counts how many times each one wrapped around
+	void (*advancePhases)(uint32_t *position, const uint32_t *stepSize, uint32_t *cyclesEnded, long numPhases, long numSteps);
+	// renders an LFO waveform table at numValues phases stepSize apart, starting from position (the phases wrap
+	// around at 2^32 & the table index is the phase >> tableShift, which has to be at least 1):
+	// output = (table value - offset) * depth
+	void (*renderLFOtable)(float *output, const float *table, uint32_t position, uint32_t stepSize, int tableShift, float offset, float depth, long numValues);
+
+	// hashes numChunks (1 to DFX_HASH_CHUNKS_MAX) whole 1 KB BLAKE3 chunks that come one after another in input,
+	// numbered from chunkCounter on & none of them the root, into 8 chaining value words for each (see dfxhash.h)
+	void (*hashChunks)(uint32_t *chainingValues, const uint8_t *input, long numChunks, uint64_t chunkCounter);
+};
+
+// the best kernels for this CPU (they get chosen the first time that this is called)
+const DFXkernels * getDFXkernels();
+// the plain ones that every build has, which all of the others are meant to match
+// (for checking the others against)
+const DFXkernels * getDFXreferenceKernels();
+
+
+#endif
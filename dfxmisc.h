@@ -3,6 +3,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 //-----------------------------------------------------------------------------
 // constants & macros
@@ -29,6 +30,16 @@
 #define paramFrequencyScaled(value)   (20.0f * powf(2.0f, (value) * 9.965784284662088765571752446703612804412841796875f))
 #define paramFrequencyUnscaled(value)   ( (logf((value)/20.0f)/logf(2.0f)) / 9.965784284662088765571752446703612804412841796875f )
 
+// Newton's method square root that the compiler can work out, for constant data like factory presets
+// (it's slow, so don't use it for anything that gets calculated while running)
+constexpr double constexprSqrtIterate(double x, double guess, int iterations) {
+	return (iterations <= 0) ? guess : constexprSqrtIterate(x, 0.5 * (guess + (x / guess)), iterations - 1);
+}
+constexpr float constexprSqrt(double x) {
+	return (x <= 0.0) ? 0.0f : (float) constexprSqrtIterate(x, (x > 1.0) ? x : 1.0, 40);
+}
+#define paramRangeSquaredUnscaledConst(value,min,max)   ( constexprSqrt(((value)-(min)) / ((max)-(min))) )
+
 #define dBconvert(fvalue) ( 20.0f * log10f((fvalue)) )
 
 #ifndef PI
@@ -51,8 +62,6 @@ const float ONE_DIV_RAND_MAX = 1.0f / (float)RAND_MAX;
 //#define undenormalize(fvalue)  (((*(unsigned int*)&(fvalue))&0x7f800000)==0)?0.0f:(fvalue)
 #endif
 
-#define kBeatSyncTimeInfoFlags   (kVstTempoValid | kVstTransportChanged | kVstBarsValid | kVstPpqPosValid | kVstTimeSigValid)
-
 #define DESTROYFX_URL "http://www.smartelectronix.com/~destroyfx/"
 #define SMARTELECTRONIX_URL "http://www.smartelectronix.com/"
 
@@ -67,8 +76,7 @@ inline float magmax(float a, float b)
 //-----------------------------------------------------------------------------
 // function prototypes
 
-long samplesToNextBar(VstTimeInfo *timeInfo);
-void processProgramChangeEvents(VstEvents *events, AudioEffectX *effect);
+// (the ones that need the host's VST types are in dfxhost.h)
 
 double LambertW(double input);
 
@@ -112,6 +120,70 @@ inline float interpolateLinear2values(float point1, float point2, double address
 	return (point1 * (1.0f-posFract)) + (point2 * posFract);
 }
 
+//-----------------------------------------------------------------------------
+// a little xorshift random number generator that keeps its state wherever you want it,
+// so that its users don't disturb each other's sequences the way that they do with rand()
+// (the state must never be 0)
+inline uint32_t randomXorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// a random value from 0.0 to 1.0, like randFloat(), but from one of those states
+inline float randomFloatXorshift(uint32_t *state)
+{
+	return (float)(randomXorshift(state) >> 8) * (1.0f / 16777215.0f);
+}
+
+// a usable starting state for randomXorshift(), taken from rand()
+inline uint32_t randomSeedFromRand()
+{
+	uint32_t seed = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+	return (seed != 0) ? seed : 1;
+}
+
+// a usable starting state for randomXorshift() from a chosen seed, for reproducible sequences;
+// each stream number gives a different (& unrelated) sequence from the same seed
+// (the mixing is MurmurHash3's finalizer, so that nearby seeds don't give similar starts)
+inline uint32_t randomSeedFromValue(uint32_t seed, uint32_t stream)
+{
+	uint32_t x = seed ^ (stream * 0x9E3779B9);
+	x ^= x >> 16;
+	x *= 0x85EBCA6B;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35;
+	x ^= x >> 16;
+	return (x != 0) ? x : 1;
+}
+
+//-----------------------------------------------------------------------------
+// sine & cosine for 0 <= x <= PI/4, without calling libm
+// (the Taylor series out to x^9 & x^8 stays within 1 ulp of sinf() & cosf() over that range)
+inline void sinCosQuarterPi(float x, float *sinOut, float *cosOut)
+{
+	float x2 = x * x;
+	*sinOut = x * (1.0f - x2*(1.0f/6.0f - x2*(1.0f/120.0f - x2*(1.0f/5040.0f - x2*(1.0f/362880.0f)))));
+	*cosOut = 1.0f - x2*(0.5f - x2*(1.0f/24.0f - x2*(1.0f/720.0f - x2*(1.0f/40320.0f))));
+}
+
+//-----------------------------------------------------------------------------
+// fmodf() for a non-negative value & a positive modulus, but with just a truncation & a multiply
+inline float fmodfPositive(float value, float modulus)
+{
+	float result = value - ((float)((long)(value / modulus)) * modulus);
+	// rounding in the division can leave us one modulus off in either direction
+	if (result >= modulus)
+		result -= modulus;
+	else if (result < 0.0f)
+		result += modulus;
+	return result;
+}
+
 //-----------------------------------------------------------------------------
 // mutex stuff
 
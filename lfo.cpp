@@ -9,20 +9,29 @@
 #include <time.h>
 
 
+//------------------------------------------------------------------------
+float LFO::sineTable[NUM_LFO_POINTS];
+float LFO::triangleTable[NUM_LFO_POINTS];
+float LFO::squareTable[NUM_LFO_POINTS];
+float LFO::sawTable[NUM_LFO_POINTS];
+float LFO::reverseSawTable[NUM_LFO_POINTS];
+float LFO::thornTable[NUM_LFO_POINTS];
+
 //------------------------------------------------------------------------
 LFO::LFO()
 {
-	sineTable = new float[NUM_LFO_POINTS];
-	triangleTable = new float[NUM_LFO_POINTS];
-	squareTable = new float[NUM_LFO_POINTS];
-	sawTable = new float[NUM_LFO_POINTS];
-	reverseSawTable = new float[NUM_LFO_POINTS];
-	thornTable = new float[NUM_LFO_POINTS];
+	prepareLFOtables();
 
-	fillLFOtables();
-	table = sineTable;	// just to have it pointing to something at least
+	fShape = 0.0f;
+	pickTheLFOwaveform();	// just to have it pointing to something at least
+	kernels = getDFXkernels();
+	granularity = LFO_DEFAULT_GRANULARITY;
 
-	srand((unsigned int)time(NULL));	// sets a seed value for rand() from the system clock
+	// seed rand() from the system clock, but just the once:  every instance has a bunch of LFOs, &
+	// seeding it again for each of them made them all start from the same state within any one second
+	static bool randIsSeeded = (srand((unsigned int)time(NULL)), true);
+	(void)randIsSeeded;
+	randomState = randomSeedFromRand();
 
 	reset();
 }
@@ -30,29 +39,31 @@ LFO::LFO()
 //------------------------------------------------------------------------
 LFO::~LFO()
 {
-	if (sineTable)
-		delete[] sineTable;
-	if (triangleTable)
-		delete[] triangleTable;
-	if (squareTable)
-		delete[] squareTable;
-	if (sawTable)
-		delete[] sawTable;
-	if (reverseSawTable)
-		delete[] reverseSawTable;
-	if (thornTable)
-		delete[] thornTable;
+	// the waveform tables are shared, so there's nothing to free
 }
 
 //------------------------------------------------------------------------
 void LFO::reset()
 {
-	position = 0.0f;
-	stepSize = 1.0f;	// just to avoid anything really screwy
-	oldRandomNumber = (float)rand() / (float)RAND_MAX;
-	randomNumber = (float)rand() / (float)RAND_MAX;
+	position = 0;
+	stepSize = 1 << LFO_TABLE_SHIFT;	// one table point per sample, just to avoid anything really screwy
+	oldRandomNumber = randomFloatXorshift(&randomState);
+	randomNumber = randomFloatXorshift(&randomState);
 	smoothSamples = 0;
-	granularityCounter = 0;
+	granularityCounter = 0;	// update on the very next sample
+	currentValue = 0.0f;
+	modBlockStart = modBlockEnd = modFirstTick = 0;
+	modBuffer[0] = currentValue;
+}
+
+//-----------------------------------------------------------------------------------------
+// this fills the shared waveform tables the first time that it gets called
+// (the initialization of a local static is guaranteed to happen only once, even with threads)
+
+void LFO::prepareLFOtables()
+{
+	static bool tablesAreFilled = (fillLFOtables(), true);
+	(void)tablesAreFilled;
 }
 
 //-----------------------------------------------------------------------------------------
@@ -110,7 +121,13 @@ void LFO::fillLFOtables()
 //--------------------------------------------------------------------------------------
 void LFO::getShapeName(char *nameString)
 {
-	switch (LFOshapeScaled(fShape)) {
+	getShapeName(shape, nameString);
+}
+
+//--------------------------------------------------------------------------------------
+void LFO::getShapeName(long whichShape, char *nameString)
+{
+	switch (whichShape) {
 	case kSineLFO                :
 		strcpy(nameString, "sine");
 		break;
@@ -142,49 +159,200 @@ void LFO::getShapeName(char *nameString)
 
 
 //--------------------------------------------------------------------------------------
-// this function points the LFO table pointers to the correct waveform tables
+// gets the waveform table for a scaled LFO shape value (the random shapes don't have one)
 
-void LFO::pickTheLFOwaveform()
+float * LFO::getTable(long whichShape)
 {
-	switch (LFOshapeScaled(fShape)) {
+	switch (whichShape) {
 	case kSineLFO :
-		table = sineTable;
-		break;
+		return sineTable;
 	case kTriangleLFO :
-		table = triangleTable;
-		break;
+		return triangleTable;
 	case kSquareLFO :
-		table = squareTable;
-		break;
+		return squareTable;
 	case kSawLFO :
-		table = sawTable;
-		break;
+		return sawTable;
 	case kReverseSawLFO :
-		table = reverseSawTable;
-		break;
+		return reverseSawTable;
 	case kThornLFO :
-		table = thornTable;
+		return thornTable;
+	default :
+		return sineTable;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// this function points the LFO table pointers to the correct waveform tables
+// & picks the output function for the waveform, so call it whenever fShape changes
+
+void LFO::pickTheLFOwaveform()
+{
+	shape = LFOshapeScaled(fShape);
+
+	table = getTable(shape);
+
+	switch (shape) {
+	case kRandomLFO :
+		evaluate = &LFO::processRandom;
+		break;
+	case kRandomInterpolatingLFO :
+		evaluate = &LFO::processRandomInterpolating;
+		break;
+	default :
+		evaluate = &LFO::processTable;
+		break;
+	}
+
+	switch (shape) {
+	case kSquareLFO     :
+	case kSawLFO        :
+	case kReverseSawLFO :
+	case kRandomLFO     :
+		discontiguous = true;
 		break;
 	default :
-		table = sineTable;
+		discontiguous = false;
 		break;
 	}
 }
 
+//--------------------------------------------------------------------------------------
+// takes the step size in phase units per sample (i.e. cycles per sample * LFO_PHASE_RANGE)
+
+void LFO::setStepSize(float newStepSize)
+{
+	// anything more than 1 cycle per sample is meaningless anyway
+	if (newStepSize >= LFO_PHASE_RANGE)
+		stepSize = 0xFFFFFFFF;
+	else if (newStepSize <= 0.0f)
+		stepSize = 0;
+	else
+		stepSize = (uint32_t)newStepSize;
+}
+
+//--------------------------------------------------------------------------------------
+// sets the number of samples between control-rate LFO updates
+
+void LFO::setGranularity(long newGranularity)
+{
+	if (newGranularity < 1)
+		newGranularity = 1;
+	granularity = newGranularity;
+	// don't let a pending update wait longer than the new granularity
+	if (granularityCounter > granularity)
+		granularityCounter = granularity;
+}
+
+//--------------------------------------------------------------------------------------
+// Advances the LFO through the next numSamples samples of the processing block, updating
+// its output every granularity samples & storing each update in modBuffer.
+// The updates fall on the same samples no matter how the processing blocks are chopped up,
+// since granularityCounter carries the distance to the next update from one block to the next.
+// numSamples must not be more than (LFO_MOD_BUFFER_SIZE - 1) * granularity.
+
+void LFO::renderModBuffer(long blockStart, long numSamples)
+{
+	long remaining = numSamples;
+	long numValues = 0;
+
+	modBlockStart = blockStart;
+	modBlockEnd = blockStart + numSamples;
+	modFirstTick = granularityCounter;
+	// remember where this started from, in case somebody wants the state partway through
+	getState(&modBlockStartState);
+	// the output holds the value of the last update until the first new one
+	modBuffer[numValues++] = currentValue;
+
+	// The table waveforms only depend on the phase, so every update in the block can be rendered
+	// in one go, & then the phase (& the random numbers, for the cycles that ended) catch up all at
+	// once, which comes out the same as stepping update by update.  The random waveforms need
+	// their numbers as of each update, so they go the long way.
+	if (evaluate == &LFO::processTable) {
+		if (granularityCounter < numSamples) {
+			long numUpdates = 1 + ((numSamples - 1 - granularityCounter) / granularity);
+			uint32_t firstPhase = position + (stepSize * (uint32_t)granularityCounter);
+			kernels->renderLFOtable(&(modBuffer[numValues]), table, firstPhase, stepSize * (uint32_t)granularity,
+									LFO_TABLE_SHIFT, 0.0f, fDepth, numUpdates);
+			numValues += numUpdates;
+			currentValue = modBuffer[numValues-1];
+			long lastUpdate = granularityCounter + ((numUpdates - 1) * granularity);
+			granularityCounter = granularity - (numSamples - lastUpdate);
+		} else
+			granularityCounter -= numSamples;
+		updatePosition(numSamples);
+		return;
+	}
+
+	while (granularityCounter < remaining) {
+		updatePosition(granularityCounter);
+		remaining -= granularityCounter;
+		currentValue = processLFO();
+		modBuffer[numValues++] = currentValue;
+		granularityCounter = granularity;
+	}
+	// catch the phase up to the end of the block
+	updatePosition(remaining);
+	granularityCounter -= remaining;
+}
+
 //--------------------------------------------------------------------------------------
 // calculates the position within an LFO's cycle needed to sync to the song's beat
 
-void LFO::syncToTheBeat(long samplesToBar)
+void LFO::syncToTheBeat(long samplesToBar, long samplePos)
+{
+	// the LFO has already been rendered out to the end of the block, so work out
+	// the state that it should have at samplePos & render the rest of the block again
+	long samplesAhead = modBlockEnd - samplePos;
+	currentValue = getModValue(samplePos);
+	granularityCounter = (granularityCounter + samplesAhead) % granularity;
+
+	// we want the cycle to end exactly samplesToBar samples from samplePos, which means
+	// the phase needs to be that many steps back from the wrap-around point
+	// (the integer arithmetic does the wrapping for us)
+	position = 0 - (uint32_t)((uint64_t)samplesToBar * (uint64_t)stepSize);
+
+	renderModBuffer(samplePos, samplesAhead);
+}
+
+//--------------------------------------------------------------------------------------
+void LFO::getState(LFOstate *state)
+{
+	state->position = position;
+	state->randomState = randomState;
+	state->randomNumber = randomNumber;
+	state->oldRandomNumber = oldRandomNumber;
+	state->currentValue = currentValue;
+	state->granularityCounter = granularityCounter;
+	state->smoothSamples = smoothSamples;
+}
+
+//--------------------------------------------------------------------------------------
+// The LFO has already been rendered out to the end of the block by then, so this goes back
+// to the state that the block started from & steps a copy of the LFO up to samplePos.
+// (That comes out the same as having stopped there, since rendering doesn't depend on
+// how the blocks are chopped up.)
+
+void LFO::getStateAt(long samplePos, LFOstate *state)
 {
-	float countdown, cyclesize;
+	if (samplePos >= modBlockEnd) {
+		getState(state);
+		return;
+	}
+	LFO rewound = *this;
+	rewound.setState(&modBlockStartState);
+	rewound.renderModBuffer(modBlockStart, samplePos - modBlockStart);
+	rewound.getState(state);
+}
 
-	// calculate how many samples long the LFO cycle is
-	cyclesize = NUM_LFO_POINTS_FLOAT / stepSize;
-	// calculate many more samples it will take for this cycle to coincide with the beat
-	countdown = fmodf( (float)samplesToBar,  cyclesize);
-	// & convert that into the correct LFO position according to its table step size
-	position = (cyclesize - countdown) * stepSize;
-	// wrap around the new position if it is beyond the end of the LFO table
-	if (position >= NUM_LFO_POINTS_FLOAT)
-		position = fmodf(position, NUM_LFO_POINTS_FLOAT);
+//--------------------------------------------------------------------------------------
+void LFO::setState(const LFOstate *state)
+{
+	position = state->position;
+	randomState = state->randomState;
+	randomNumber = state->randomNumber;
+	oldRandomNumber = state->oldRandomNumber;
+	currentValue = state->currentValue;
+	granularityCounter = state->granularityCounter;
+	smoothSamples = state->smoothSamples;
+	modBuffer[0] = currentValue;
 }
@@ -5,9 +5,11 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "dfxmisc.h"
 #include "TempoRateTable.h"
+#include "dfxkernels.h"
 
 
 //-------------------------------------------------------------------------------------
@@ -32,15 +34,39 @@ enum {
 #define LFOshapeUnscaled(A)   (paramSteppedUnscaled((A), numLFOshapes))
 
 #define NUM_LFO_POINTS 512
-const float NUM_LFO_POINTS_FLOAT = (float)NUM_LFO_POINTS;	// to reduce casting later on
-const float LFO_TABLE_STEP = 1.0f / (float)NUM_LFO_POINTS;	// to reduce division & encourage multiplication
-const long SQUARE_HALF_POINT = NUM_LFO_POINTS / 2;	// the point in the table when the square waveform drops to zero
+// the LFO position is a 32-bit phase accumulator that wraps around by itself at the cycle end;
+// the top 9 bits of it are the table index (2^9 = NUM_LFO_POINTS)
+#define LFO_TABLE_SHIFT 23
+const float LFO_PHASE_RANGE = 4294967296.0f;	// 2^32, one full LFO cycle in phase units
+const float LFO_PHASE_STEP = 1.0f / LFO_PHASE_RANGE;	// to reduce division & encourage multiplication
+const uint32_t SQUARE_HALF_PHASE = 0x80000000;	// the phase when the square waveform drops to zero
+
+// the size of the control-rate modulation buffer that renderModBuffer() fills
+#define LFO_MOD_BUFFER_SIZE 64
+// how many samples there are between control-rate LFO updates unless someone says otherwise
+#define LFO_DEFAULT_GRANULARITY 32
 
 #define LFO_SMOOTH_DUR 48
 const float LFO_SMOOTH_STEP = 1.0f / (float)LFO_SMOOTH_DUR;
 
 // this scales the return of processLFO() from 0.0 - 1.0 output to 0.0 - 2.0 (oscillating around 1.0)
 #define processLFOzero2two(A)   ( ((A)->processLFO() * 2.0f) - (A)->fDepth + 1.0f );
+// & the same for the control-rate output at a sample position
+#define modValueZero2two(A,samplePos)   ( ((A)->getModValue(samplePos) * 2.0f) - (A)->fDepth + 1.0f )
+
+
+//-----------------------------------------------------------------------------
+// everything that decides what an LFO does from a given sample on, apart from its
+// parameters, so that it can be picked up again from there later
+struct LFOstate
+{
+	uint32_t position;
+	uint32_t randomState;
+	float randomNumber, oldRandomNumber;
+	float currentValue;
+	int32_t granularityCounter;
+	int32_t smoothSamples;
+};
 
 
 //-----------------------------------------------------------------------------
@@ -51,15 +77,36 @@ public:
 	~LFO();
 
 	void reset();
-	void fillLFOtables();
+	// starts the random sequence over from a chosen state (from randomSeedFromValue(), say)
+	void setRandomState(uint32_t newState) {
+		randomState = (newState != 0) ? newState : 1;
+	}
+	static void fillLFOtables();
+	static void prepareLFOtables();
+	static float * getTable(long whichShape);
 
 	void pickTheLFOwaveform();
 	void getShapeName(char *nameString);
+	static void getShapeName(long whichShape, char *nameString);
+
+	void setStepSize(float newStepSize);
+	void setGranularity(long newGranularity);
+	// the block rendering defaults to getDFXkernels(), but it can be swapped for others
+	void setKernels(const DFXkernels *newKernels) {
+		kernels = newKernels;
+	}
 
-	void syncToTheBeat(long samplesToBar);
+	void renderModBuffer(long blockStart, long numSamples);
+	void syncToTheBeat(long samplesToBar, long samplePos);
 
-	// the LFO waveform tables
-	float *sineTable, *triangleTable, *squareTable, *sawTable, *reverseSawTable, *thornTable;
+	// gets the state as it is now, or as of a sample position within the range of the last renderModBuffer()
+	void getState(LFOstate *state);
+	void getStateAt(long samplePos, LFOstate *state);
+	void setState(const LFOstate *state);
+
+	// the LFO waveform tables (these are the same for every LFO, so they are shared)
+	static float sineTable[NUM_LFO_POINTS], triangleTable[NUM_LFO_POINTS], squareTable[NUM_LFO_POINTS];
+	static float sawTable[NUM_LFO_POINTS], reverseSawTable[NUM_LFO_POINTS], thornTable[NUM_LFO_POINTS];
 
 	// the following are intended to be used as 0.0 - 1.0 VST parameter values:
 	float fOnOff;	// parameter value for turning the LFO on or off
@@ -70,71 +117,86 @@ public:
 	float fShape;	// parameter value for LFO shape
 
 	bool onOff;	// in case it's easier to have a bool version of fOnOff
-	float position;	// this tracks the position in the LFO table
-	float stepSize;	// size of the steps through the LFO table
+	uint32_t position;	// this tracks the phase of the LFO cycle
+	uint32_t stepSize;	// size of the steps through the LFO cycle, in phase units
+	long shape;	// the scaled value of fShape, as of the last pickTheLFOwaveform()
+	bool discontiguous;	// whether the waveform jumps at the cycle end & needs smoothing
 	float *table;	// pointer to the LFO table
+	float (LFO::*evaluate)();	// the output function specialized for the current waveform
 	float randomNumber;	// this stores random values for the random LFO waveforms
 	float oldRandomNumber;	// this stores previous random values for the random interpolating LFO waveform
+	uint32_t randomState;	// this LFO's own random number generator, so that its sequence can be picked up again
 	float cycleRate;	// the rate in Hz of the LFO (only used for first layer LFOs)
 	long smoothSamples;	// a counter for the position during a smoothing fade
 	long granularityCounter;	// a counter for implementing LFO processing on a block basis
 	long granularity;	// the number of samples to wait before processing
+	float currentValue;	// the output value from the latest control-rate update
+	const DFXkernels *kernels;	// for rendering the table waveforms a block at a time
+
+	// the control-rate output for the current processing block, as rendered by renderModBuffer()
+	float modBuffer[LFO_MOD_BUFFER_SIZE];
+	long modBlockStart, modBlockEnd;	// the sample range (within the processing block) that modBuffer covers
+	long modFirstTick;	// the offset from modBlockStart of the first update in modBuffer
+	LFOstate modBlockStartState;	// the state as of modBlockStart, for getStateAt()
 
 
 	//--------------------------------------------------------------------------------------
-	// This function wraps around the LFO table position when it passes the cycle end.
+	// This function advances the LFO phase, which wraps around by itself when it passes the cycle end.
 	// It also sets up the smoothing counter if a discontiguous LFO waveform is being used.
 	void updatePosition(long numSteps = 1) {
-		// increment the LFO position tracker
-		position += (stepSize * (float)numSteps);
-
-		if (position >= NUM_LFO_POINTS_FLOAT) {
-			// wrap around the position tracker if it has made it past the end of the LFO table
-			position = fmodf(position, NUM_LFO_POINTS_FLOAT);
-			// get new random LFO values, too
-			oldRandomNumber = randomNumber;
-			randomNumber = (float)rand() / (float)RAND_MAX;
+		uint32_t oldPosition = position;
+		// increment the LFO position tracker; the high word tells us if it made it past the end of the cycle
+		uint64_t newPosition = (uint64_t)position + ((uint64_t)stepSize * (uint64_t)numSteps);
+		position = (uint32_t)newPosition;
+
+		if (newPosition >> 32) {
+			// get new random LFO values, once for each cycle that went by, so that the
+			// random sequence doesn't depend on how the steps were chunked up
+			for (uint32_t cycles = (uint32_t)(newPosition >> 32); cycles > 0; cycles--) {
+				oldRandomNumber = randomNumber;
+				randomNumber = randomFloatXorshift(&randomState);
+			}
 			// set up the sample smoothing if a discontiguous waveform's cycle just ended
-			switch (LFOshapeScaled(fShape)) {
-			case kSquareLFO     :
-			case kSawLFO        :
-			case kReverseSawLFO :
-			case kRandomLFO     :
+			if (discontiguous)
 				smoothSamples = LFO_SMOOTH_DUR;
-			default:
-				break;
-			}
 		}
 
 		// special check for the square waveform - it also needs smoothing at the half point
-		else if (LFOshapeScaled(fShape) == kSquareLFO) {
+		else if (shape == kSquareLFO) {
 			// check to see if it has just passed the halfway point
-			if ( ((long)position >= SQUARE_HALF_POINT) &&
-			     ((long)(position - stepSize) < SQUARE_HALF_POINT) )
+			if ( (position >= SQUARE_HALF_PHASE) && (oldPosition < SQUARE_HALF_PHASE) )
 				smoothSamples = LFO_SMOOTH_DUR;
 		}
 	}
 
 	//--------------------------------------------------------------------------------------
-	// this function gets the current 0.0 - 1.0 output value of the LFO & increments its position
+	// this function gets the current 0.0 - 1.0 output value of the LFO
 	float processLFO() {
-		float randiScalar, outValue;
-		int shape = LFOshapeScaled(fShape);
-
-		if (shape == kRandomInterpolatingLFO) {
-			// calculate how far into this LFO cycle we are so far, scaled from 0.0 to 1.0
-			randiScalar = position * LFO_TABLE_STEP;
-			// interpolate between the previous random number & the new one
-			outValue = (randomNumber * randiScalar) + (oldRandomNumber * (1.0f-randiScalar));
-		}
-		//
-		else if (shape == kRandomLFO)
-			outValue = randomNumber;
-		//
-		else
-			outValue = table[(long)position];
-
-		return (outValue * fDepth);
+		return (this->*evaluate)() * fDepth;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// this function gets the control-rate 0.0 - 1.0 output value at a sample position
+	// within the range of the last renderModBuffer()
+	float getModValue(long samplePos) {
+		long offset = samplePos - modBlockStart;
+		if (offset < modFirstTick)
+			return modBuffer[0];
+		return modBuffer[1 + ((offset - modFirstTick) / granularity)];
+	}
+
+	// the waveform-specific output functions that pickTheLFOwaveform() chooses from
+	float processTable() {
+		return table[position >> LFO_TABLE_SHIFT];
+	}
+	float processRandom() {
+		return randomNumber;
+	}
+	float processRandomInterpolating() {
+		// calculate how far into this LFO cycle we are so far, scaled from 0.0 to 1.0
+		float randiScalar = (float)position * LFO_PHASE_STEP;
+		// interpolate between the previous random number & the new one
+		return (randomNumber * randiScalar) + (oldRandomNumber * (1.0f-randiScalar));
 	}
 
 };
@@ -0,0 +1,273 @@
+#ifndef __lfobank
+#include "lfobank.h"
+#endif
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------
+LFObank::LFObank()
+{
+	LFO::prepareLFOtables();
+	kernels = getDFXkernels();
+
+	for (long i = 0; i < NUM_MOD_SLOTS; i++) {
+		fRate[i] = 0.0f;
+		fDepth[i] = 0.0f;
+		fTempoSync[i] = 0.0f;
+		destination[i] = kNoModDestination;
+		stepSize[i] = 0;
+		setShape(i, 0.0f);
+		randomState[i] = randomSeedFromRand();
+	}
+	granularity = LFO_DEFAULT_GRANULARITY;
+	updateActiveSlots();
+
+	reset();
+}
+
+//------------------------------------------------------------------------
+LFObank::~LFObank()
+{
+}
+
+//------------------------------------------------------------------------
+void LFObank::reset()
+{
+	for (long i = 0; i < NUM_MOD_SLOTS; i++) {
+		position[i] = 0;
+		cyclesEnded[i] = 0;
+		oldRandomNumber[i] = randomFloatXorshift(&(randomState[i]));
+		randomNumber[i] = randomFloatXorshift(&(randomState[i]));
+		currentValue[i] = 0.0f;
+		modBuffer[i][0] = 0.0f;
+	}
+	granularityCounter = 0;	// update on the very next sample
+	modBlockStart = modBlockEnd = modFirstTick = 0;
+}
+
+//------------------------------------------------------------------------
+void LFObank::setGranularity(long newGranularity)
+{
+	if (newGranularity < 1)
+		newGranularity = 1;
+	granularity = newGranularity;
+	if (granularityCounter > granularity)
+		granularityCounter = granularity;
+}
+
+//------------------------------------------------------------------------
+void LFObank::setRandomSeed(uint32_t seed)
+{
+	for (long i = 0; i < NUM_MOD_SLOTS; i++)
+		randomState[i] = randomSeedFromValue(seed, (uint32_t)i);
+}
+
+//------------------------------------------------------------------------
+void LFObank::setRouting(long slot, long newDestination)
+{
+	if ( (slot < 0) || (slot >= NUM_MOD_SLOTS) )
+		return;
+	destination[slot] = newDestination;
+	updateActiveSlots();
+}
+
+//------------------------------------------------------------------------
+void LFObank::setDepth(long slot, float newDepth)
+{
+	if ( (slot < 0) || (slot >= NUM_MOD_SLOTS) )
+		return;
+	fDepth[slot] = newDepth;
+	updateActiveSlots();
+}
+
+//------------------------------------------------------------------------
+void LFObank::setShape(long slot, float newShape)
+{
+	if ( (slot < 0) || (slot >= NUM_MOD_SLOTS) )
+		return;
+	fShape[slot] = newShape;
+	shape[slot] = LFOshapeScaled(newShape);
+	table[slot] = LFO::getTable(shape[slot]);
+}
+
+//------------------------------------------------------------------------
+// takes the step size in phase units per sample, the same as LFO::setStepSize()
+void LFObank::setStepSize(long slot, float newStepSize)
+{
+	if ( (slot < 0) || (slot >= NUM_MOD_SLOTS) )
+		return;
+	if (newStepSize >= LFO_PHASE_RANGE)
+		stepSize[slot] = 0xFFFFFFFF;
+	else if (newStepSize <= 0.0f)
+		stepSize[slot] = 0;
+	else
+		stepSize[slot] = (uint32_t)newStepSize;
+}
+
+//------------------------------------------------------------------------
+bool LFObank::usesTempoSync()
+{
+	for (long n = 0; n < numActiveSlots; n++) {
+		if (onOffTest(fTempoSync[activeSlots[n]]))
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------
+bool LFObank::usesRandomShapes()
+{
+	for (long n = 0; n < numActiveSlots; n++) {
+		long whichShape = shape[activeSlots[n]];
+		if ( (whichShape == kRandomLFO) || (whichShape == kRandomInterpolatingLFO) )
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------
+bool LFObank::isRouted(long whichDestination)
+{
+	for (long n = 0; n < numActiveSlots; n++) {
+		if (destination[activeSlots[n]] == whichDestination)
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------
+// rebuilds the list of slots that need evaluating
+void LFObank::updateActiveSlots()
+{
+	numActiveSlots = 0;
+	for (long i = 0; i < NUM_MOD_SLOTS; i++) {
+		if ( (destination[i] != kNoModDestination) && (fDepth[i] > 0.0f) )
+			activeSlots[numActiveSlots++] = i;
+	}
+}
+
+//------------------------------------------------------------------------
+// steps every slot's phase together in one vectorized pass,
+// & then only the active slots get new random values for the cycles that ended
+void LFObank::advance(long numSteps)
+{
+	kernels->advancePhases(position, stepSize, cyclesEnded, NUM_MOD_SLOTS, numSteps);
+
+	for (long n = 0; n < numActiveSlots; n++) {
+		long i = activeSlots[n];
+		for (uint32_t cycles = cyclesEnded[i]; cycles > 0; cycles--) {
+			oldRandomNumber[i] = randomNumber[i];
+			randomNumber[i] = randomFloatXorshift(&(randomState[i]));
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+// gets the current output of each active slot, as a bipolar offset scaled by its depth
+void LFObank::evaluate()
+{
+	for (long n = 0; n < numActiveSlots; n++) {
+		long i = activeSlots[n];
+		float value;
+		if (shape[i] == kRandomInterpolatingLFO) {
+			float randiScalar = (float)position[i] * LFO_PHASE_STEP;
+			value = (randomNumber[i] * randiScalar) + (oldRandomNumber[i] * (1.0f-randiScalar));
+		}
+		else if (shape[i] == kRandomLFO)
+			value = randomNumber[i];
+		else
+			value = table[i][position[i] >> LFO_TABLE_SHIFT];
+		currentValue[i] = (value - 0.5f) * fDepth[i];
+	}
+}
+
+//------------------------------------------------------------------------
+// This works just like LFO::renderModBuffer(), but for every active slot at once.
+// numSamples must not be more than (LFO_MOD_BUFFER_SIZE - 1) * granularity.
+void LFObank::renderModBuffers(long blockStart, long numSamples)
+{
+	long remaining = numSamples;
+	long numValues = 0;
+	long n;
+
+	modBlockStart = blockStart;
+	modBlockEnd = blockStart + numSamples;
+	modFirstTick = granularityCounter;
+	getState(&modBlockStartState);
+	for (n = 0; n < numActiveSlots; n++)
+		modBuffer[activeSlots[n]][numValues] = currentValue[activeSlots[n]];
+	numValues++;
+
+	// (as with LFO::renderModBuffer(), the table waveforms get every update rendered in one go)
+	if (!usesRandomShapes()) {
+		if (granularityCounter < numSamples) {
+			long numUpdates = 1 + ((numSamples - 1 - granularityCounter) / granularity);
+			for (n = 0; n < numActiveSlots; n++) {
+				long i = activeSlots[n];
+				uint32_t firstPhase = position[i] + (stepSize[i] * (uint32_t)granularityCounter);
+				kernels->renderLFOtable(&(modBuffer[i][numValues]), table[i], firstPhase, stepSize[i] * (uint32_t)granularity,
+										LFO_TABLE_SHIFT, 0.5f, fDepth[i], numUpdates);
+				currentValue[i] = modBuffer[i][numValues + numUpdates - 1];
+			}
+			long lastUpdate = granularityCounter + ((numUpdates - 1) * granularity);
+			granularityCounter = granularity - (numSamples - lastUpdate);
+		} else
+			granularityCounter -= numSamples;
+		advance(numSamples);
+		return;
+	}
+
+	while (granularityCounter < remaining) {
+		advance(granularityCounter);
+		remaining -= granularityCounter;
+		evaluate();
+		for (n = 0; n < numActiveSlots; n++)
+			modBuffer[activeSlots[n]][numValues] = currentValue[activeSlots[n]];
+		numValues++;
+		granularityCounter = granularity;
+	}
+	advance(remaining);
+	granularityCounter -= remaining;
+}
+
+//------------------------------------------------------------------------
+void LFObank::getState(LFObankState *state)
+{
+	for (long i = 0; i < NUM_MOD_SLOTS; i++) {
+		state->position[i] = position[i];
+		state->randomState[i] = randomState[i];
+		state->randomNumber[i] = randomNumber[i];
+		state->oldRandomNumber[i] = oldRandomNumber[i];
+		state->currentValue[i] = currentValue[i];
+	}
+	state->granularityCounter = granularityCounter;
+}
+
+//------------------------------------------------------------------------
+// This works just like LFO::getStateAt(), going back to the start of the block & stepping a copy forward.
+void LFObank::getStateAt(long samplePos, LFObankState *state)
+{
+	if (samplePos >= modBlockEnd) {
+		getState(state);
+		return;
+	}
+	LFObank rewound = *this;
+	rewound.setState(&modBlockStartState);
+	rewound.renderModBuffers(modBlockStart, samplePos - modBlockStart);
+	rewound.getState(state);
+}
+
+//------------------------------------------------------------------------
+void LFObank::setState(const LFObankState *state)
+{
+	for (long i = 0; i < NUM_MOD_SLOTS; i++) {
+		position[i] = state->position[i];
+		randomState[i] = state->randomState[i];
+		randomNumber[i] = state->randomNumber[i];
+		oldRandomNumber[i] = state->oldRandomNumber[i];
+		currentValue[i] = state->currentValue[i];
+		modBuffer[i][0] = currentValue[i];
+	}
+	granularityCounter = state->granularityCounter;
+}
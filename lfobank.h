@@ -0,0 +1,120 @@
+#ifndef __lfobank
+#define __lfobank
+
+#include <stdint.h>
+
+#include "lfo.h"
+#include "dfxkernels.h"
+
+
+//-------------------------------------------------------------------------------------
+// constants & macros
+
+// the number of modulator slots in a bank
+#define NUM_MOD_SLOTS 8
+
+// the destination value for a slot that isn't routed anywhere
+const long kNoModDestination = -1;
+
+
+//-----------------------------------------------------------------------------
+// what LFOstate is for an LFO, but for a whole bank
+struct LFObankState
+{
+	uint32_t position[NUM_MOD_SLOTS];
+	uint32_t randomState[NUM_MOD_SLOTS];
+	float randomNumber[NUM_MOD_SLOTS], oldRandomNumber[NUM_MOD_SLOTS];
+	float currentValue[NUM_MOD_SLOTS];
+	int32_t granularityCounter;
+};
+
+
+//-----------------------------------------------------------------------------
+// A bank of LFOs that modulate parameters.  The oscillator state is stored as
+// structure-of-arrays so that every slot gets stepped together in one pass,
+// & only the slots that are routed somewhere get evaluated.
+// Each slot's output is a bipolar offset in 0.0 - 1.0 parameter units.
+class LFObank
+{
+public:
+	LFObank();
+	~LFObank();
+
+	void reset();
+	void setGranularity(long newGranularity);
+	// starts every slot's random sequence over from a seed (each slot gets its own stream of it)
+	void setRandomSeed(uint32_t seed);
+	// the phase stepping defaults to getDFXkernels(), but it can be swapped for others
+	void setKernels(const DFXkernels *newKernels) {
+		kernels = newKernels;
+	}
+
+	void setRouting(long slot, long newDestination);
+	void setDepth(long slot, float newDepth);
+	void setShape(long slot, float newShape);
+	void setStepSize(long slot, float newStepSize);
+	bool usesTempoSync();
+	bool usesRandomShapes();
+	bool isRouted(long whichDestination);
+
+	void renderModBuffers(long blockStart, long numSamples);
+
+	// gets the state as it is now, or as of a sample position within the range of the last renderModBuffers()
+	void getState(LFObankState *state);
+	void getStateAt(long samplePos, LFObankState *state);
+	void setState(const LFObankState *state);
+
+	//--------------------------------------------------------------------------------------
+	// this function sums up the offsets of all of the slots routed to a destination, at a sample
+	// position within the range of the last renderModBuffers()
+	float getModOffset(long whichDestination, long samplePos) {
+		long offset = samplePos - modBlockStart;
+		long index = (offset < modFirstTick) ? 0 : 1 + ((offset - modFirstTick) / granularity);
+		float sum = 0.0f;
+		for (long n = 0; n < numActiveSlots; n++) {
+			if (destination[activeSlots[n]] == whichDestination)
+				sum += modBuffer[activeSlots[n]][index];
+		}
+		return sum;
+	}
+
+	// the following are intended to be used as 0.0 - 1.0 parameter values, one per slot
+	// (use the set functions above for the ones that have them)
+	float fRate[NUM_MOD_SLOTS];	// parameter value for LFO rate (in Hz or cycles per beat)
+	float fDepth[NUM_MOD_SLOTS];	// parameter value for LFO depth
+	float fShape[NUM_MOD_SLOTS];	// parameter value for LFO shape
+	float fTempoSync[NUM_MOD_SLOTS];	// parameter value for toggling tempo sync
+	long destination[NUM_MOD_SLOTS];	// the parameter index that each slot modulates
+
+	// the oscillator state, one array per field
+	uint32_t position[NUM_MOD_SLOTS];	// the phase of each slot's cycle
+	uint32_t stepSize[NUM_MOD_SLOTS];	// the phase increment per sample
+	uint32_t cyclesEnded[NUM_MOD_SLOTS];	// how many cycles ended during the last advance()
+	long shape[NUM_MOD_SLOTS];	// the scaled value of fShape
+	float *table[NUM_MOD_SLOTS];	// the waveform table for each slot
+	float randomNumber[NUM_MOD_SLOTS], oldRandomNumber[NUM_MOD_SLOTS];	// for the random waveforms
+	uint32_t randomState[NUM_MOD_SLOTS];	// each slot's own random number generator
+	float currentValue[NUM_MOD_SLOTS];	// the output from the latest control-rate update
+
+	long activeSlots[NUM_MOD_SLOTS];	// the indices of the slots that are routed somewhere
+	long numActiveSlots;
+
+	long granularityCounter;	// the samples to go until the next control-rate update
+	long granularity;	// the number of samples between control-rate updates
+
+	// the control-rate output for the current processing block, as rendered by renderModBuffers()
+	float modBuffer[NUM_MOD_SLOTS][LFO_MOD_BUFFER_SIZE];
+	long modBlockStart, modBlockEnd;	// the sample range (within the processing block) that modBuffer covers
+	long modFirstTick;	// the offset from modBlockStart of the first update in modBuffer
+	LFObankState modBlockStartState;	// the state as of modBlockStart, for getStateAt()
+
+private:
+	const DFXkernels *kernels;	// for stepping the phases
+
+	void advance(long numSteps);
+	void evaluate();
+	void updateActiveSlots();
+};
+
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __midiqueue
+#include "midiqueue.h"
+#endif
+
+#include <math.h>
+
+
+//------------------------------------------------------------------------
+MIDIqueue::MIDIqueue()
+{
+	for (int note = 0; note < 128; note++)
+		noteDivisors[note] = powf(2.0f, (float)(note - MIDI_DIVISOR_ROOT_NOTE) / 12.0f);
+	numBlockEvents = nextBlockEvent = 0;
+	numHeldNotes = 0;
+}
+
+//------------------------------------------------------------------------
+bool MIDIqueue::push(uint32_t frame, uint8_t status, uint8_t data1, uint8_t data2)
+{
+	MIDIevent event;
+	event.frame = frame;
+	event.status = status;
+	event.data1 = data1 & 0x7F;
+	event.data2 = data2 & 0x7F;
+	return queue.push(event);
+}
+
+//------------------------------------------------------------------------
+void MIDIqueue::startBlock(uint32_t numFrames)
+{
+	// the leftovers from the last block go first, right at the start
+	long numLeftOver = numBlockEvents - nextBlockEvent;
+	for (long i = 0; i < numLeftOver; i++) {
+		blockEvents[i] = blockEvents[nextBlockEvent + i];
+		blockEvents[i].frame = 0;
+	}
+	numBlockEvents = numLeftOver;
+	nextBlockEvent = 0;
+
+	// (if the list is full, the rest wait in the ring for the next block)
+	uint32_t lastFrame = (numFrames > 0) ? (numFrames - 1) : 0;
+	MIDIevent event;
+	while ( (numBlockEvents < MIDI_QUEUE_SIZE) && queue.pop(&event) ) {
+		if (event.frame > lastFrame)
+			event.frame = lastFrame;
+		// keep them in order (hosts send them that way anyway, so this hardly ever has to move anything)
+		long i = numBlockEvents;
+		while ( (i > 0) && (blockEvents[i-1].frame > event.frame) ) {
+			blockEvents[i] = blockEvents[i-1];
+			i--;
+		}
+		blockEvents[i] = event;
+		numBlockEvents++;
+	}
+}
+
+//------------------------------------------------------------------------
+void MIDIqueue::noteOn(int note)
+{
+	// (a note that's already held just moves up to being the latest)
+	noteOff(note);
+	if (numHeldNotes < 128)
+		heldNotes[numHeldNotes++] = note;
+}
+
+//------------------------------------------------------------------------
+void MIDIqueue::noteOff(int note)
+{
+	for (long i = 0; i < numHeldNotes; i++) {
+		if (heldNotes[i] == note) {
+			for (long j = i + 1; j < numHeldNotes; j++)
+				heldNotes[j-1] = heldNotes[j];
+			numHeldNotes--;
+			return;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+void MIDIqueue::reset()
+{
+	MIDIevent event;
+	while (queue.pop(&event))
+		;
+	numBlockEvents = nextBlockEvent = 0;
+	removeAllNotes();
+}
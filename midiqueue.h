@@ -0,0 +1,99 @@
+#ifndef __midiqueue
+#define __midiqueue
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "spscring.h"
+
+
+//-------------------------------------------------------------------------------------
+// constants & macros
+
+// the most MIDI events that can be waiting for the next block (any more than that get dropped)
+#define MIDI_QUEUE_SIZE 256
+// the widest pitchbend range, in semitones
+#define PITCHBEND_MAX 36
+// the note that gives a divisor of 1 (each octave above it doubles the divisor)
+#define MIDI_DIVISOR_ROOT_NOTE 36
+
+// the note or pitchbend value for when there hasn't been one
+const int kInvalidMidi = -3;
+// the middle of the pitchbend range
+const int kMidiPitchbendCenter = 0x2000;
+
+enum {
+	kMidiNoteOff = 0x80,
+	kMidiNoteOn = 0x90,
+	kMidiCC = 0xB0,
+	kMidiPitchbend = 0xE0,
+
+	kMidiCCallNotesOff = 0x7B
+};
+
+
+//-----------------------------------------------------------------------------
+struct MIDIevent
+{
+	uint32_t frame;	// where in its block it happens
+	uint8_t status, data1, data2;
+};
+
+
+//-----------------------------------------------------------------------------
+// The MIDI that's coming in, on its way to the audio thread.  The host's thread pushes events
+// for the next block into a wait-free ring, d_run() moves them into this block's list at the
+// start of the block, & then they get taken from there in order as the minibuffer boundaries
+// reach them.  Whatever the boundaries don't get to by the end of the block happens right at
+// the start of the next one.  This also keeps track of the notes being held, for trigger mode.
+// Nothing here allocates or locks after the constructor.
+class MIDIqueue
+{
+public:
+	MIDIqueue();
+
+	// only one thread (the one that the host sends MIDI from) can call this;
+	// returns false if the event got dropped because the queue is full
+	bool push(uint32_t frame, uint8_t status, uint8_t data1, uint8_t data2);
+
+	// the rest are for the audio thread
+	// takes in everything that's been pushed since the last block (in order, & inside of this block)
+	void startBlock(uint32_t numFrames);
+	// the next of this block's events at or before frame (NULL once there aren't any more that far)
+	const MIDIevent * nextEvent(long frame) {
+		if ( (nextBlockEvent < numBlockEvents) && ((long)(blockEvents[nextBlockEvent].frame) <= frame) )
+			return &(blockEvents[nextBlockEvent++]);
+		return NULL;
+	}
+
+	void noteOn(int note);
+	void noteOff(int note);
+	void removeAllNotes() {
+		numHeldNotes = 0;
+	}
+	// the most recent of the notes still being held (kInvalidMidi if none are)
+	int getLatestNote() {
+		return (numHeldNotes > 0) ? heldNotes[numHeldNotes-1] : kInvalidMidi;
+	}
+	// the buffer divisor that a note asks for
+	float getNoteDivisor(int note) {
+		return noteDivisors[note & 0x7F];
+	}
+
+	// forgets about the held notes & all of the events, including the ones still in the ring
+	// (so this can't be going on at the same time as push() or d_run())
+	void reset();
+
+private:
+	SPSCring<MIDIevent, MIDI_QUEUE_SIZE> queue;
+	MIDIevent blockEvents[MIDI_QUEUE_SIZE];
+	long numBlockEvents, nextBlockEvent;
+
+	int heldNotes[128];	// in the order that they started
+	long numHeldNotes;
+
+	float noteDivisors[128];	// (worked out ahead of time, so the audio thread doesn't need powf())
+};
+
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	// for RTLD_NEXT
+#endif
+
+#ifndef __rtaudit
+#include "rtaudit.h"
+#endif
+
+#ifdef BUFFEROVERRIDE_RT_AUDIT
+
+#include <atomic>
+#include <new>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// the most stack frames that a violation's trace shows
+#define RT_AUDIT_MAX_FRAMES 48
+
+// glibc's own allocator, which the wrappers pass everything on to
+extern "C" {
+	void * __libc_malloc(size_t size);
+	void * __libc_calloc(size_t count, size_t size);
+	void * __libc_realloc(void *ptr, size_t size);
+	void * __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void *ptr);
+}
+
+static thread_local long auditDepth = 0;	// how many audit scopes are open on this thread
+static thread_local bool reporting = false;	// (so that the reporting itself doesn't count)
+static std::atomic<long> numViolations(0);
+static std::atomic<bool> fatal(false);
+static std::atomic<bool> backtracePrimed(false);
+
+
+#pragma mark _________scopes_________
+
+//-----------------------------------------------------------------------------
+void rtAuditEnter()
+{
+	// the first backtrace() loads libgcc & allocates, so get that out of the way before it matters
+	if (!backtracePrimed.exchange(true)) {
+		void *frames[1];
+		backtrace(frames, 1);
+	}
+	auditDepth++;
+}
+
+//-----------------------------------------------------------------------------
+void rtAuditLeave()
+{
+	auditDepth--;
+}
+
+//-----------------------------------------------------------------------------
+long rtAuditGetViolations()
+{
+	return numViolations.load();
+}
+
+//-----------------------------------------------------------------------------
+void rtAuditSetFatal(bool newFatal)
+{
+	fatal.store(newFatal);
+}
+
+//-----------------------------------------------------------------------------
+// every wrapper calls this first; it only does anything inside of an audit scope
+static void rtAuditViolation(const char *what)
+{
+	if ( (auditDepth <= 0) || reporting )
+		return;
+	reporting = true;
+	long count = ++numViolations;
+	// (this goes straight to the file descriptor, since stdio could allocate or lock)
+	char message[160];
+	int length = snprintf(message, sizeof(message), "real-time audit:  %s on the audio path (violation %ld)\n", what, count);
+	if (length > 0)
+		write(STDERR_FILENO, message, length);
+	void *frames[RT_AUDIT_MAX_FRAMES];
+	int numFrames = backtrace(frames, RT_AUDIT_MAX_FRAMES);
+	backtrace_symbols_fd(frames, numFrames, STDERR_FILENO);
+	if (fatal.load())
+		abort();
+	reporting = false;
+}
+
+//-----------------------------------------------------------------------------
+// looks up the next definition of a function (the real one, past these wrappers)
+static void * rtAuditFindReal(const char *name)
+{
+	return dlsym(RTLD_NEXT, name);
+}
+
+
+#pragma mark _________allocation_________
+
+//-----------------------------------------------------------------------------
+extern "C" void * malloc(size_t size)
+{
+	rtAuditViolation("malloc");
+	return __libc_malloc(size);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" void * calloc(size_t count, size_t size)
+{
+	rtAuditViolation("calloc");
+	return __libc_calloc(count, size);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" void * realloc(void *ptr, size_t size)
+{
+	rtAuditViolation("realloc");
+	return __libc_realloc(ptr, size);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+	rtAuditViolation("posix_memalign");
+	// the alignment has to be a power of 2 multiple of the size of a pointer
+	if ( (alignment % sizeof(void*)) || (alignment & (alignment - 1)) || (alignment == 0) )
+		return EINVAL;
+	void *newPtr = __libc_memalign(alignment, size);
+	if (newPtr == NULL)
+		return ENOMEM;
+	*ptr = newPtr;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+extern "C" void free(void *ptr)
+{
+	if (ptr != NULL)
+		rtAuditViolation("free");
+	__libc_free(ptr);
+}
+
+//-----------------------------------------------------------------------------
+// (these go straight to glibc, too, so that a new doesn't count as a malloc as well)
+void * operator new(size_t size)
+{
+	rtAuditViolation("operator new");
+	void *ptr = __libc_malloc((size > 0) ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void * operator new[](size_t size)
+{
+	rtAuditViolation("operator new[]");
+	void *ptr = __libc_malloc((size > 0) ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	rtAuditViolation("operator new");
+	return __libc_malloc((size > 0) ? size : 1);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	rtAuditViolation("operator new[]");
+	return __libc_malloc((size > 0) ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	if (ptr != NULL)
+		rtAuditViolation("operator delete");
+	__libc_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	if (ptr != NULL)
+		rtAuditViolation("operator delete[]");
+	__libc_free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	if (ptr != NULL)
+		rtAuditViolation("operator delete");
+	__libc_free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	if (ptr != NULL)
+		rtAuditViolation("operator delete[]");
+	__libc_free(ptr);
+}
+
+
+#pragma mark _________locks_________
+
+//-----------------------------------------------------------------------------
+extern "C" int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+	static int (*real)(pthread_mutex_t*) = NULL;
+	if (real == NULL)
+		real = (int (*)(pthread_mutex_t*)) rtAuditFindReal("pthread_mutex_lock");
+	rtAuditViolation("pthread_mutex_lock");
+	return real(mutex);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" int pthread_cond_wait(pthread_cond_t *condition, pthread_mutex_t *mutex)
+{
+	static int (*real)(pthread_cond_t*, pthread_mutex_t*) = NULL;
+	if (real == NULL)
+		real = (int (*)(pthread_cond_t*, pthread_mutex_t*)) rtAuditFindReal("pthread_cond_wait");
+	rtAuditViolation("pthread_cond_wait");
+	return real(condition, mutex);
+}
+
+
+#pragma mark _________random numbers_________
+
+//-----------------------------------------------------------------------------
+// glibc keeps one state for rand() & random() between all of the threads & locks it for each call,
+// with its own internal lock rather than pthread_mutex_lock(), so these get wrapped as themselves
+extern "C" int rand()
+{
+	static int (*real)() = NULL;
+	if (real == NULL)
+		real = (int (*)()) rtAuditFindReal("rand");
+	rtAuditViolation("rand");
+	return real();
+}
+
+//-----------------------------------------------------------------------------
+extern "C" void srand(unsigned int seed)
+{
+	static void (*real)(unsigned int) = NULL;
+	if (real == NULL)
+		real = (void (*)(unsigned int)) rtAuditFindReal("srand");
+	rtAuditViolation("srand");
+	real(seed);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" long random()
+{
+	static long (*real)() = NULL;
+	if (real == NULL)
+		real = (long (*)()) rtAuditFindReal("random");
+	rtAuditViolation("random");
+	return real();
+}
+
+//-----------------------------------------------------------------------------
+extern "C" void srandom(unsigned int seed)
+{
+	static void (*real)(unsigned int) = NULL;
+	if (real == NULL)
+		real = (void (*)(unsigned int)) rtAuditFindReal("srandom");
+	rtAuditViolation("srandom");
+	real(seed);
+}
+
+
+#pragma mark _________syscalls_________
+
+//-----------------------------------------------------------------------------
+extern "C" int open(const char *path, int flags, ...)
+{
+	static int (*real)(const char*, int, ...) = NULL;
+	if (real == NULL)
+		real = (int (*)(const char*, int, ...)) rtAuditFindReal("open");
+	rtAuditViolation("open");
+	// (the mode is only there when a file might get created)
+	mode_t mode = 0;
+	if (flags & O_CREAT) {
+		va_list args;
+		va_start(args, flags);
+		mode = va_arg(args, int);
+		va_end(args);
+	}
+	return real(path, flags, mode);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" int close(int fd)
+{
+	static int (*real)(int) = NULL;
+	if (real == NULL)
+		real = (int (*)(int)) rtAuditFindReal("close");
+	rtAuditViolation("close");
+	return real(fd);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" ssize_t read(int fd, void *buffer, size_t count)
+{
+	static ssize_t (*real)(int, void*, size_t) = NULL;
+	if (real == NULL)
+		real = (ssize_t (*)(int, void*, size_t)) rtAuditFindReal("read");
+	rtAuditViolation("read");
+	return real(fd, buffer, count);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" ssize_t write(int fd, const void *buffer, size_t count)
+{
+	static ssize_t (*real)(int, const void*, size_t) = NULL;
+	if (real == NULL)
+		real = (ssize_t (*)(int, const void*, size_t)) rtAuditFindReal("write");
+	rtAuditViolation("write");
+	return real(fd, buffer, count);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" int nanosleep(const struct timespec *duration, struct timespec *remaining)
+{
+	static int (*real)(const struct timespec*, struct timespec*) = NULL;
+	if (real == NULL)
+		real = (int (*)(const struct timespec*, struct timespec*)) rtAuditFindReal("nanosleep");
+	rtAuditViolation("nanosleep");
+	return real(duration, remaining);
+}
+
+//-----------------------------------------------------------------------------
+extern "C" int usleep(useconds_t duration)
+{
+	static int (*real)(useconds_t) = NULL;
+	if (real == NULL)
+		real = (int (*)(useconds_t)) rtAuditFindReal("usleep");
+	rtAuditViolation("usleep");
+	return real(duration);
+}
+
+#endif
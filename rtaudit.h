@@ -0,0 +1,52 @@
+#ifndef __rtaudit
+#define __rtaudit
+
+
+//-----------------------------------------------------------------------------
+// A debug build mode for proving that the audio thread is real-time safe.
+// Build with BUFFEROVERRIDE_RT_AUDIT defined & malloc/calloc/realloc/free, new/delete,
+// pthread mutex locking & condition waits, rand() & random() (which lock glibc's shared
+// state), & the usual blocking syscalls (open, close, read, write, sleeping) get wrapped,
+// so that any of them that happens while an audit scope is open on the same thread
+// counts as a violation & prints a stack trace.
+// The wrappers only take the place of the real ones when they're linked into the
+// executable (like a test host) or LD_PRELOADed, since a plugin's own copies don't
+// interpose anything.  This is for glibc on Linux.
+// Without BUFFEROVERRIDE_RT_AUDIT, none of this costs anything.
+
+#ifdef BUFFEROVERRIDE_RT_AUDIT
+
+// marks the calling thread as being on the audio path (these nest)
+void rtAuditEnter();
+void rtAuditLeave();
+// how many violations there have been so far, on any thread
+long rtAuditGetViolations();
+// if this is on, a violation aborts (for tests) instead of only getting logged
+void rtAuditSetFatal(bool newFatal);
+
+// opens an audit scope for as long as it's around (if active is false, it doesn't do anything)
+class RTauditScope
+{
+public:
+	RTauditScope(bool active = true) : isActive(active) {
+		if (isActive)
+			rtAuditEnter();
+	}
+	~RTauditScope() {
+		if (isActive)
+			rtAuditLeave();
+	}
+private:
+	bool isActive;
+};
+
+#define RT_AUDIT_SCOPE(active)   RTauditScope rtAuditScope(active)
+
+#else
+
+#define RT_AUDIT_SCOPE(active)
+
+#endif
+
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __sharedtransport
+#include "sharedtransport.h"
+#endif
+
+
+//-----------------------------------------------------------------------------
+SharedTransport::SharedTransport()
+{
+	sequence.store(0);
+	// (nothing is ever at a negative position, so this doesn't match anybody until there's a real snapshot)
+	samplePos.store(-1.0);
+	flags.store(0);
+	tempoBPS.store(0.0);
+	samplesToBar.store(0);
+}
+
+//-----------------------------------------------------------------------------
+SharedTransport * SharedTransport::get()
+{
+	// this gets made the first time that somebody asks for it, & that's thread-safe
+	static SharedTransport transport;
+	return &transport;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedTransport::read(double expectedSamplePos, TransportSnapshot *snapshot)
+{
+	uint32_t before = sequence.load(std::memory_order_acquire);
+	if (before & 1)
+		return false;
+	snapshot->samplePos = samplePos.load(std::memory_order_relaxed);
+	snapshot->flags = flags.load(std::memory_order_relaxed);
+	snapshot->tempoBPS = tempoBPS.load(std::memory_order_relaxed);
+	snapshot->samplesToBar = samplesToBar.load(std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (sequence.load(std::memory_order_relaxed) != before)
+		return false;
+	return (snapshot->samplePos == expectedSamplePos);
+}
+
+//-----------------------------------------------------------------------------
+void SharedTransport::publish(const TransportSnapshot *snapshot)
+{
+	// whoever else is publishing right now has the same cycle's snapshot, so there's no need to wait for them
+	uint32_t current = sequence.load(std::memory_order_relaxed);
+	if ( (current & 1) || !sequence.compare_exchange_strong(current, current + 1, std::memory_order_acquire) )
+		return;
+	std::atomic_thread_fence(std::memory_order_release);
+	samplePos.store(snapshot->samplePos, std::memory_order_relaxed);
+	flags.store(snapshot->flags, std::memory_order_relaxed);
+	tempoBPS.store(snapshot->tempoBPS, std::memory_order_relaxed);
+	samplesToBar.store(snapshot->samplesToBar, std::memory_order_relaxed);
+	sequence.store(current + 2, std::memory_order_release);
+}
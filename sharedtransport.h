@@ -0,0 +1,50 @@
+#ifndef __sharedtransport
+#define __sharedtransport
+
+#include <atomic>
+#include <stdint.h>
+
+
+//-----------------------------------------------------------------------------
+// what the host's transport says at the start of a processing cycle
+struct TransportSnapshot
+{
+	double samplePos;	// the host's timeline position at the start of the cycle
+	int32_t flags;	// the host's VstTimeInfo flags
+	double tempoBPS;	// tempo in beats per second (0 if the host didn't give a usable one)
+	long samplesToBar;	// from the start of the cycle to the next bar, as samplesToNextBar() works it out
+};
+
+
+//-----------------------------------------------------------------------------
+// The transport, worked out once per host processing cycle & shared by every instance
+// in the process.  There's no way to tell which cycle it is without asking the host,
+// so a snapshot is known by where on the host's timeline it was taken:  while the
+// transport is playing, an instance knows where its next block will start, & if
+// somebody has already published a snapshot for there, it can use that instead of
+// asking the host again.  It's a seqlock, so reading never blocks & never allocates,
+// & publishing is skipped if somebody else is publishing at the same moment.
+class SharedTransport
+{
+public:
+	// the one for the whole process
+	static SharedTransport * get();
+
+	// gets the latest snapshot, but only if it's the one for the host timeline position
+	// expectedSamplePos; returns false if it isn't (or if it's in the middle of changing)
+	bool read(double expectedSamplePos, TransportSnapshot *snapshot);
+	void publish(const TransportSnapshot *snapshot);
+
+private:
+	SharedTransport();
+
+	std::atomic<uint32_t> sequence;	// odd while a snapshot is being written
+	// (the fields are atomic, too, so that a read that overlaps a write is only ever thrown away)
+	std::atomic<double> samplePos;
+	std::atomic<int32_t> flags;
+	std::atomic<double> tempoBPS;
+	std::atomic<long> samplesToBar;
+};
+
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef __spscring
+#define __spscring
+
+#include <atomic>
+#include <stdint.h>
+
+
+//-----------------------------------------------------------------------------
+// A wait-free ring buffer for handing records from one thread to one other thread
+// (like from the audio thread to the GUI).  Neither side ever waits on the other:
+// if the reader falls behind & the ring fills up, new records just get dropped.
+// size must be a power of 2.
+template <typename T, uint32_t size>
+class SPSCring
+{
+public:
+	SPSCring() : writeIndex(0), readIndex(0) {}
+
+	// only the writing thread can call this; returns false if the record got dropped
+	bool push(const T &record) {
+		uint32_t w = writeIndex.load(std::memory_order_relaxed);
+		if ( (w - readIndex.load(std::memory_order_acquire)) >= size )
+			return false;
+		records[w & (size-1)] = record;
+		writeIndex.store(w + 1, std::memory_order_release);
+		return true;
+	}
+
+	// only the reading thread can call this; returns false if there was nothing new
+	bool pop(T *record) {
+		uint32_t r = readIndex.load(std::memory_order_relaxed);
+		if ( r == writeIndex.load(std::memory_order_acquire) )
+			return false;
+		*record = records[r & (size-1)];
+		readIndex.store(r + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static_assert( (size > 0) && ((size & (size-1)) == 0), "SPSCring size must be a power of 2" );
+
+	// the indices just count up & wrap around; the padding keeps the two threads
+	// from fighting over the same cache line
+	std::atomic<uint32_t> writeIndex;
+	char writePadding[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint32_t> readIndex;
+	char readPadding[64 - sizeof(std::atomic<uint32_t>)];
+	T records[size];
+};
+
+
+#endif
@@ -0,0 +1,775 @@
+// the original per-sample engine, frozen (see baselineengine.h); everything from "copied as it was"
+// on down is the code as it used to be, so leave it alone
+
+#ifndef __baselineengine
+#include "baselineengine.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "dfxhost.h"
+#include "dfxmisc.h"
+#include "TempoRateTable.h"
+
+
+namespace BufferOverrideBaseline
+{
+
+//-----------------------------------------------------------------------------
+// constants & macros (copied as they were)
+
+#define DIVISOR_MIN 1.92f
+#define DIVISOR_MAX 222.0f
+#define bufferDivisorScaled(A) ( paramRangeSquaredScaled((A), DIVISOR_MIN, DIVISOR_MAX) )
+#define bufferDivisorUnscaled(A) ( paramRangeSquaredUnscaled((A), DIVISOR_MIN, DIVISOR_MAX) )
+
+#define BUFFER_MIN 1.0f
+#define BUFFER_MAX 999.0f
+#define forcedBufferSizeScaled(A) ( paramRangeSquaredScaled((1.0f-(A)), BUFFER_MIN, BUFFER_MAX) )
+#define forcedBufferSizeUnscaled(A) ( 1.0f - paramRangeSquaredUnscaled((A), BUFFER_MIN, BUFFER_MAX) )
+#define forcedBufferSizeSamples(A) ( (long)(forcedBufferSizeScaled((A)) * SAMPLERATE * 0.001f) )
+
+#define TEMPO_MIN 57.0f
+#define TEMPO_MAX 480.0f
+#define tempoScaled(A)   ( paramRangeScaled((A), TEMPO_MIN, TEMPO_MAX) )
+#define tempoUnscaled(A)   ( paramRangeUnscaled((A), TEMPO_MIN, TEMPO_MAX) )
+
+#define LFO_RATE_MIN 0.03f
+#define LFO_RATE_MAX 21.0f
+#define LFOrateScaled(A)   ( paramRangeSquaredScaled((A), LFO_RATE_MIN, LFO_RATE_MAX) )
+#define LFOrateUnscaled(A)   ( paramRangeSquaredUnscaled((A), LFO_RATE_MIN, LFO_RATE_MAX) )
+
+// you need this stuff to get some maximum buffer size & allocate for that
+// this is 42 bpm - should be sufficient
+#define MIN_ALLOWABLE_BPS 0.7f
+
+#define NUM_LFO_POINTS 512
+#define LFO_SMOOTH_DUR 48
+#define LFOshapeScaled(A)   (paramSteppedScaled((A), numLFOshapes))
+
+// this scales the return of processLFO() from 0.0 - 1.0 output to 0.0 - 2.0 (oscillating around 1.0)
+#define processLFOzero2two(A)   ( ((A)->processLFO() * 2.0f) - (A)->fDepth + 1.0f );
+
+
+#pragma mark _________LFO_________
+
+//-------------------------------------------------------------------------------------
+// these are the 8 LFO waveforms:
+enum {
+    kSineLFO,
+    kTriangleLFO,
+    kSquareLFO,
+    kSawLFO,
+    kReverseSawLFO,
+    kThornLFO,
+    kRandomLFO,
+    kRandomInterpolatingLFO,
+
+    numLFOshapes
+};
+
+//-------------------------------------------------------------------------------------
+// constants & macros
+
+const float NUM_LFO_POINTS_FLOAT = (float)NUM_LFO_POINTS;	// to reduce casting later on
+const float LFO_TABLE_STEP = 1.0f / (float)NUM_LFO_POINTS;	// to reduce division & encourage multiplication
+const long SQUARE_HALF_POINT = NUM_LFO_POINTS / 2;	// the point in the table when the square waveform drops to zero
+
+const float LFO_SMOOTH_STEP = 1.0f / (float)LFO_SMOOTH_DUR;
+
+
+
+//-----------------------------------------------------------------------------
+class LFO
+{
+public:
+	LFO();
+	~LFO();
+
+	void reset();
+	void fillLFOtables();
+
+	void pickTheLFOwaveform();
+
+	void syncToTheBeat(long samplesToBar);
+
+	// the LFO waveform tables
+	float *sineTable, *triangleTable, *squareTable, *sawTable, *reverseSawTable, *thornTable;
+
+	// the following are intended to be used as 0.0 - 1.0 VST parameter values:
+	float fOnOff;	// parameter value for turning the LFO on or off
+	float fTempoSync;	// parameter value for toggling tempo sync
+	float fRate;	// parameter value for LFO rate (in Hz)
+	float fTempoRate;	// parameter value for LFO rate (in cycles per beat)
+	float fDepth;	// parameter value LFO depth
+	float fShape;	// parameter value for LFO shape
+
+	bool onOff;	// in case it's easier to have a bool version of fOnOff
+	float position;	// this tracks the position in the LFO table
+	float stepSize;	// size of the steps through the LFO table
+	float *table;	// pointer to the LFO table
+	float randomNumber;	// this stores random values for the random LFO waveforms
+	float oldRandomNumber;	// this stores previous random values for the random interpolating LFO waveform
+	float cycleRate;	// the rate in Hz of the LFO (only used for first layer LFOs)
+	long smoothSamples;	// a counter for the position during a smoothing fade
+	long granularityCounter;	// a counter for implementing LFO processing on a block basis
+	long granularity;	// the number of samples to wait before processing
+
+
+	//--------------------------------------------------------------------------------------
+	// This function wraps around the LFO table position when it passes the cycle end.
+	// It also sets up the smoothing counter if a discontiguous LFO waveform is being used.
+	void updatePosition(long numSteps = 1) {
+		// increment the LFO position tracker
+		position += (stepSize * (float)numSteps);
+
+		if (position >= NUM_LFO_POINTS_FLOAT) {
+			// wrap around the position tracker if it has made it past the end of the LFO table
+			position = fmodf(position, NUM_LFO_POINTS_FLOAT);
+			// get new random LFO values, too
+			oldRandomNumber = randomNumber;
+			randomNumber = (float)rand() / (float)RAND_MAX;
+			// set up the sample smoothing if a discontiguous waveform's cycle just ended
+			switch (LFOshapeScaled(fShape)) {
+			case kSquareLFO     :
+			case kSawLFO        :
+			case kReverseSawLFO :
+			case kRandomLFO     :
+				smoothSamples = LFO_SMOOTH_DUR;
+			default:
+				break;
+			}
+		}
+
+		// special check for the square waveform - it also needs smoothing at the half point
+		else if (LFOshapeScaled(fShape) == kSquareLFO) {
+			// check to see if it has just passed the halfway point
+			if ( ((long)position >= SQUARE_HALF_POINT) &&
+			     ((long)(position - stepSize) < SQUARE_HALF_POINT) )
+				smoothSamples = LFO_SMOOTH_DUR;
+		}
+	}
+
+	//--------------------------------------------------------------------------------------
+	// this function gets the current 0.0 - 1.0 output value of the LFO & increments its position
+	float processLFO() {
+		float randiScalar, outValue;
+		int shape = LFOshapeScaled(fShape);
+
+		if (shape == kRandomInterpolatingLFO) {
+			// calculate how far into this LFO cycle we are so far, scaled from 0.0 to 1.0
+			randiScalar = position * LFO_TABLE_STEP;
+			// interpolate between the previous random number & the new one
+			outValue = (randomNumber * randiScalar) + (oldRandomNumber * (1.0f-randiScalar));
+		}
+		//
+		else if (shape == kRandomLFO)
+			outValue = randomNumber;
+		//
+		else
+			outValue = table[(long)position];
+
+		return (outValue * fDepth);
+	}
+
+};
+
+
+//------------------------------------------------------------------------
+LFO::LFO()
+{
+	sineTable = new float[NUM_LFO_POINTS];
+	triangleTable = new float[NUM_LFO_POINTS];
+	squareTable = new float[NUM_LFO_POINTS];
+	sawTable = new float[NUM_LFO_POINTS];
+	reverseSawTable = new float[NUM_LFO_POINTS];
+	thornTable = new float[NUM_LFO_POINTS];
+
+	fillLFOtables();
+	table = sineTable;	// just to have it pointing to something at least
+
+	srand((unsigned int)time(NULL));	// sets a seed value for rand() from the system clock
+
+	reset();
+}
+
+//------------------------------------------------------------------------
+LFO::~LFO()
+{
+	if (sineTable)
+		delete[] sineTable;
+	if (triangleTable)
+		delete[] triangleTable;
+	if (squareTable)
+		delete[] squareTable;
+	if (sawTable)
+		delete[] sawTable;
+	if (reverseSawTable)
+		delete[] reverseSawTable;
+	if (thornTable)
+		delete[] thornTable;
+}
+
+//------------------------------------------------------------------------
+void LFO::reset()
+{
+	position = 0.0f;
+	stepSize = 1.0f;	// just to avoid anything really screwy
+	oldRandomNumber = (float)rand() / (float)RAND_MAX;
+	randomNumber = (float)rand() / (float)RAND_MAX;
+	smoothSamples = 0;
+	granularityCounter = 0;
+}
+
+//-----------------------------------------------------------------------------------------
+// this function creates tables for mapping out the sine, triangle, & saw LFO shapes
+
+void LFO::fillLFOtables()
+{
+	long i, n;
+
+
+	// fill the sine waveform table (oscillates from 0 to 1 & back to 0)
+	for (i = 0; (i < NUM_LFO_POINTS); i++)
+		sineTable[i] = (sinf( ( ((float)i/(float)NUM_LFO_POINTS)-0.25f ) * 2.0f * PI ) + 1.0f) * 0.5f;
+
+	// fill the triangle waveform table
+	// ramp from 0 to 1 for the first half
+	for (i = 0; (i < NUM_LFO_POINTS/2); i++)
+		triangleTable[i] = (float)i / (float)(NUM_LFO_POINTS/2);
+	// & ramp from 1 to 0 for the second half
+	for (n = 0; (i < NUM_LFO_POINTS); n++) {
+		triangleTable[i] = 1.0f - ((float)n / (float)(NUM_LFO_POINTS/2));
+		i++;
+	}
+
+	// fill the square waveform table
+	// stay at 1 for the first half
+	for (i = 0; (i < NUM_LFO_POINTS/2); i++)
+		squareTable[i] = 1.0f;
+	// & 0 for the second half
+	for (n = 0; (i < NUM_LFO_POINTS); n++) {
+		squareTable[i] = 0.0f;
+		i++;
+	}
+
+	// fill the sawtooth waveform table (ramps from 0 to 1)
+	for (i = 0; (i < NUM_LFO_POINTS); i++)
+		sawTable[i] = (float)i / (float)(NUM_LFO_POINTS-1);
+
+	// fill the reverse sawtooth waveform table (ramps from 1 to 0)
+	for (i = 0; (i < NUM_LFO_POINTS); i++)
+		reverseSawTable[i] = (float)(NUM_LFO_POINTS-i-1) / (float)(NUM_LFO_POINTS-1);
+
+	// fill the thorn waveform table
+	// exponentially slope up from 0 to 1 for the first half
+	for (i = 0; (i < NUM_LFO_POINTS/2); i++)
+		thornTable[i] = powf( ((float)i / (float)(NUM_LFO_POINTS/2)), 2.0f );
+	// & exponentially slope down from 1 to 0 for the second half
+	for (n = 0; (i < NUM_LFO_POINTS); n++) {
+		thornTable[i] = powf( (1.0f - ((float)n / (float)(NUM_LFO_POINTS/2))), 2.0f );
+		i++;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// this function points the LFO table pointers to the correct waveform tables
+
+void LFO::pickTheLFOwaveform()
+{
+	switch (LFOshapeScaled(fShape)) {
+	case kSineLFO :
+		table = sineTable;
+		break;
+	case kTriangleLFO :
+		table = triangleTable;
+		break;
+	case kSquareLFO :
+		table = squareTable;
+		break;
+	case kSawLFO :
+		table = sawTable;
+		break;
+	case kReverseSawLFO :
+		table = reverseSawTable;
+		break;
+	case kThornLFO :
+		table = thornTable;
+		break;
+	default :
+		table = sineTable;
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// calculates the position within an LFO's cycle needed to sync to the song's beat
+
+void LFO::syncToTheBeat(long samplesToBar)
+{
+	float countdown, cyclesize;
+
+	// calculate how many samples long the LFO cycle is
+	cyclesize = NUM_LFO_POINTS_FLOAT / stepSize;
+	// calculate many more samples it will take for this cycle to coincide with the beat
+	countdown = fmodf( (float)samplesToBar,  cyclesize);
+	// & convert that into the correct LFO position according to its table step size
+	position = (cyclesize - countdown) * stepSize;
+	// wrap around the new position if it is beyond the end of the LFO table
+	if (position >= NUM_LFO_POINTS_FLOAT)
+		position = fmodf(position, NUM_LFO_POINTS_FLOAT);
+}
+
+//-----------------------------------------------------------------------------
+// (this part is new:  it's what updateBuffer() does with an LFO, if every minibuffer were a sample long)
+void renderLFO(float fRate, float fTempoSync, float fDepth, float fShape, float tempoBPS, float sampleRate,
+				long numSamples, float *values)
+{
+	LFO lfo;
+	lfo.fRate = fRate;
+	lfo.fTempoSync = fTempoSync;
+	lfo.fDepth = fDepth;
+	lfo.fShape = fShape;
+	lfo.pickTheLFOwaveform();
+	float numLFOpointsDivSR = NUM_LFO_POINTS_FLOAT / sampleRate;
+	for (long i = 0; i < numSamples; i++) {
+		// (the first minibuffer after a reset comes after one that's 0 samples long)
+		lfo.updatePosition((i > 0) ? 1 : 0);
+		values[i] = processLFOzero2two(&lfo);
+		if (onOffTest(lfo.fTempoSync))
+			lfo.stepSize = tempoBPS * (TempoRateTable::getScalar(lfo.fRate)) * numLFOpointsDivSR;
+		else
+			lfo.stepSize = LFOrateScaled(lfo.fRate) * numLFOpointsDivSR;
+	}
+}
+
+
+#pragma mark _________engine_________
+
+// (samplesToNextBar() is the one in dfxhost, which is the same as it was)
+
+//-----------------------------------------------------------------------------
+// (this part is new:  it's what the constructor, d_activate() & d_sampleRateChanged() used to do between them)
+BufferOverride::BufferOverride(double sampleRate, long newHostCanDoTempo)
+{
+	SAMPLERATE = (float) sampleRate;
+	if (SAMPLERATE <= 0.0f)
+		SAMPLERATE = 44100.0f;
+	SUPER_MAX_BUFFER = (long) ((SAMPLERATE / MIN_ALLOWABLE_BPS) * 4.0f);
+	buffer1 = (float*) calloc(SUPER_MAX_BUFFER, sizeof(float));
+#ifdef BUFFEROVERRIDE_STEREO
+	buffer2 = (float*) calloc(SUPER_MAX_BUFFER, sizeof(float));
+#endif
+
+	divisorLFO = new LFO;
+	bufferLFO = new LFO;
+	hostTimeInfo = timeInfo = NULL;
+	hostCanDoTempo = newHostCanDoTempo;
+
+	// the old default program
+	d_setParameterValue(kDivisor, 0.0f);
+	d_setParameterValue(kBuffer, forcedBufferSizeUnscaled(90.0f));
+	d_setParameterValue(kBufferTempoSync, 0.0f);
+	d_setParameterValue(kBufferInterrupt, 1.0f);
+	d_setParameterValue(kDivisorLFOrate, LFOrateUnscaled(0.3f));
+	d_setParameterValue(kDivisorLFOdepth, 0.0f);
+	d_setParameterValue(kDivisorLFOshape, 0.0f);
+	d_setParameterValue(kDivisorLFOtempoSync, 0.0f);
+	d_setParameterValue(kBufferLFOrate, LFOrateUnscaled(3.0f));
+	d_setParameterValue(kBufferLFOdepth, 0.0f);
+	d_setParameterValue(kBufferLFOshape, 0.0f);
+	d_setParameterValue(kBufferLFOtempoSync, 0.0f);
+	d_setParameterValue(kSmooth, 0.09f);
+	d_setParameterValue(kDryWetMix, 1.0f);
+	d_setParameterValue(kPitchbend, 0.0f);
+	d_setParameterValue(kMidiMode, 0.0f);
+	d_setParameterValue(kTempo, 0.0f);
+	currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+	needResync = false;
+	currentBufferDivisor = 2.0f;
+
+	d_deactivate();
+	d_activate();
+}
+
+//-------------------------------------------------------------------------
+BufferOverride::~BufferOverride()
+{
+	free(buffer1);
+#ifdef BUFFEROVERRIDE_STEREO
+	free(buffer2);
+#endif
+	delete divisorLFO;
+	delete bufferLFO;
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::d_deactivate()
+{
+	// setting the values like this will restart the forced buffer in the next process()
+	currentForcedBufferSize = 1;
+	writePos = readPos = 1;
+	minibufferSize = 1;
+	prevMinibufferSize = 0;
+	smoothcount = smoothDur = 0;
+	sqrtFadeIn = sqrtFadeOut = 1.0f;
+
+	divisorLFO->reset();
+	bufferLFO->reset();
+}
+
+//-----------------------------------------------------------------------------
+// (the buffers are already there, & there's no MIDI to want)
+void BufferOverride::d_activate()
+{
+	needResync = true;	// some hosts may call resume when restarting playback
+}
+
+//-------------------------------------------------------------------------
+void BufferOverride::d_setParameterValue(uint32_t index, float value)
+{
+	switch (index) {
+	case kDivisor :
+		fDivisor = value;
+		break;
+
+	case kBuffer:
+		// make sure the cycles match up if the tempo rate has changed
+		if (TempoRateTable::getScalar(fBuffer) != TempoRateTable::getScalar(value))
+			needResync = true;
+		fBuffer = value;
+		break;
+
+	case kBufferTempoSync :
+		// set needResync true if tempo sync mode has just been switched on
+		if ( onOffTest(value) && !onOffTest(fBufferTempoSync) )
+			needResync = true;
+		fBufferTempoSync = value;
+		break;
+
+	case kBufferInterrupt     :
+		fBufferInterrupt = value;
+		break;
+	case kDivisorLFOrate      :
+		divisorLFO->fRate = value;
+		break;
+	case kDivisorLFOdepth     :
+		divisorLFO->fDepth = value;
+		break;
+	case kDivisorLFOshape     :
+		divisorLFO->fShape = value;
+		break;
+	case kDivisorLFOtempoSync :
+		divisorLFO->fTempoSync = value;
+		break;
+	case kBufferLFOrate       :
+		bufferLFO->fRate = value;
+		break;
+	case kBufferLFOdepth      :
+		bufferLFO->fDepth = value;
+		break;
+	case kBufferLFOshape      :
+		bufferLFO->fShape = value;
+		break;
+	case kBufferLFOtempoSync  :
+		bufferLFO->fTempoSync = value;
+		break;
+	case kSmooth              :
+		fSmooth = value;
+		break;
+	case kDryWetMix           :
+		fDryWetMix = value;
+		break;
+	case kPitchbend           :
+		fPitchbend = value;
+		break;
+	case kMidiMode :
+		fMidiMode = value;
+		break;
+	case kTempo               :
+		fTempo = value;
+		break;
+
+	default :
+		break;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+void BufferOverride::updateBuffer(long samplePos)
+{
+	bool doSmoothing = true;	// but in some situations, we shouldn't
+	bool barSync = false;	// true if we need to sync up with the next bar start
+	float divisorLFOvalue, bufferLFOvalue;	// the current output values of the LFOs
+	long prevForcedBufferSize;	// the previous forced buffer size
+
+	readPos = 0;	// reset for starting a new minibuffer
+	prevMinibufferSize = minibufferSize;
+	prevForcedBufferSize = currentForcedBufferSize;
+
+	//--------------------------PROCESS THE LFOs----------------------------
+	// update the LFOs' positions to the current position
+	divisorLFO->updatePosition(prevMinibufferSize);
+	bufferLFO->updatePosition(prevMinibufferSize);
+	// Then get the current output values of the LFOs, which also updates their positions once more.
+	// Scale the 0.0 - 1.0 LFO output values to 0.0 - 2.0 (oscillating around 1.0).
+	divisorLFOvalue = processLFOzero2two(divisorLFO);
+	bufferLFOvalue = 2.0f - processLFOzero2two(bufferLFO);	// inverting it makes more pitch sense
+	// & then update the stepSize for each LFO, in case the LFO parameters have changed
+	if (onOffTest(divisorLFO->fTempoSync))
+		divisorLFO->stepSize = currentTempoBPS * (TempoRateTable::getScalar(divisorLFO->fRate)) * numLFOpointsDivSR;
+	else
+		divisorLFO->stepSize = LFOrateScaled(divisorLFO->fRate) * numLFOpointsDivSR;
+	if (onOffTest(bufferLFO->fTempoSync))
+		bufferLFO->stepSize = currentTempoBPS * (TempoRateTable::getScalar(bufferLFO->fRate)) * numLFOpointsDivSR;
+	else
+		bufferLFO->stepSize = LFOrateScaled(bufferLFO->fRate) * numLFOpointsDivSR;
+
+	//---------------------------CALCULATE FORCED BUFFER SIZE----------------------------
+	// check if it's the end of this forced buffer
+	if (writePos >= currentForcedBufferSize) {
+		writePos = 0;	// start up a new forced buffer
+
+		// check on the previous forced & minibuffers; don't smooth if the last forced buffer wasn't divided
+		if (prevMinibufferSize >= currentForcedBufferSize)
+			doSmoothing = false;
+		else
+			doSmoothing = true;
+
+		// now update the the size of the current force buffer
+		if ( onOffTest(fBufferTempoSync) &&	// the user wants to do tempo sync / beat division rate
+		     (currentTempoBPS > 0.0f) ) { // avoid division by zero
+			currentForcedBufferSize = (long) ( SAMPLERATE / (currentTempoBPS * TempoRateTable::getScalar(fBuffer)) );
+			// set this true so that we make sure to do the measure syncronisation later on
+			if (needResync)
+				barSync = true;
+		} else
+			currentForcedBufferSize = forcedBufferSizeSamples(fBuffer);
+		// apply the buffer LFO to the forced buffer size
+		currentForcedBufferSize = (long) ((float)currentForcedBufferSize * bufferLFOvalue);
+		// really low tempos & tempo rate values can cause huge forced buffer sizes,
+		// so prevent going outside of the allocated buffer space
+		if (currentForcedBufferSize > SUPER_MAX_BUFFER)
+			currentForcedBufferSize = SUPER_MAX_BUFFER;
+		if (currentForcedBufferSize < 2)
+			currentForcedBufferSize = 2;
+
+		// untrue this so that we don't do the measure sync calculations again unnecessarily
+		needResync = false;
+	}
+
+	//-----------------------CALCULATE THE DIVISOR-------------------------
+	currentBufferDivisor = bufferDivisorScaled(fDivisor);
+	// apply the divisor LFO to the divisor value if there's an "active" divisor (i.e. 2 or greater)
+	if (currentBufferDivisor >= 2.0f) {
+		currentBufferDivisor *= divisorLFOvalue;
+		// now it's possible that the LFO could make the divisor less than 2,
+		// which will essentially turn the effect off, so we stop the modulation at 2
+		if (currentBufferDivisor < 2.0f)
+			currentBufferDivisor = 2.0f;
+	}
+
+	//-----------------------CALCULATE THE MINIBUFFER SIZE-------------------------
+	// this is not a new forced buffer starting up
+	if (writePos > 0) {
+		// if it's allowed, update the minibuffer size midway through this forced buffer
+		if (onOffTest(fBufferInterrupt))
+			minibufferSize = (long) ( (float)currentForcedBufferSize / currentBufferDivisor );
+		// if it's the last minibuffer, then fill up the forced buffer to the end
+		// by extending this last minibuffer to fill up the end of the forced buffer
+		long remainingForcedBuffer = currentForcedBufferSize - writePos;
+		if ( (minibufferSize*2) >= remainingForcedBuffer )
+			minibufferSize = remainingForcedBuffer;
+	}
+	// this is a new forced buffer just beginning, act accordingly, do bar sync if necessary
+	else {
+		long samplesToBar;
+		if (barSync) {
+			samplesToBar = samplesToNextBar(timeInfo);
+			// do beat sync for each LFO if it ought to be done
+			if (onOffTest(divisorLFO->fTempoSync))
+				divisorLFO->syncToTheBeat(samplesToBar);
+			if (onOffTest(bufferLFO->fTempoSync))
+				bufferLFO->syncToTheBeat(samplesToBar);
+		}
+		// because there isn't really any division (given my implementation) when the divisor is < 2
+		if (currentBufferDivisor < 2.0f) {
+			if (barSync)
+				minibufferSize = currentForcedBufferSize = samplesToBar % currentForcedBufferSize;
+			else
+				minibufferSize = currentForcedBufferSize;
+		} else {
+			minibufferSize = (long) ( (float)currentForcedBufferSize / currentBufferDivisor );
+			if (barSync) {
+				// calculate how long this forced buffer needs to be
+				long countdown = samplesToBar % currentForcedBufferSize;
+				// update the forced buffer size & number of minibuffers so that
+				// the forced buffers sync up with the musical measures of the song
+				if ( countdown < (minibufferSize*2) )	// extend the buffer if it would be too short...
+					currentForcedBufferSize += countdown;
+				else	// ...otherwise chop it down to the length of the extra bit needed to sync with the next measure
+					currentForcedBufferSize = countdown;
+			}
+		}
+	}
+
+	//-----------------------CALCULATE SMOOTHING DURATION-------------------------
+	// no smoothing if the previous forced buffer wasn't divided
+	if (!doSmoothing)
+		smoothcount = smoothDur = 0;
+	else {
+		smoothDur = (long) (fSmooth * (float)minibufferSize);
+		long maxSmoothDur;
+		// if we're just starting a new forced buffer,
+		// then the samples beyond the end of the previous one are not valid
+		if (writePos <= 0)
+			maxSmoothDur = prevForcedBufferSize - prevMinibufferSize;
+		// otherwise just make sure that we don't go outside of the allocated arrays
+		else
+			maxSmoothDur = SUPER_MAX_BUFFER - prevMinibufferSize;
+		if (smoothDur > maxSmoothDur)
+			smoothDur = maxSmoothDur;
+		smoothcount = smoothDur;
+		smoothStep = 1.0f / (float)(smoothDur+1);	// the gain increment for each smoothing step
+
+//		sqrtFadeIn = sqrtf(smoothStep);
+//		sqrtFadeOut = sqrtf(1.0f - smoothStep);
+//		smoothFract = smoothStep;
+
+		fadeOutGain = cosf(PI/(float)(4*smoothDur));
+		fadeInGain = sinf(PI/(float)(4*smoothDur));
+		realFadePart = (fadeOutGain * fadeOutGain) - (fadeInGain * fadeInGain);	// cosf(3.141592/2/n)
+		imaginaryFadePart = 2.0f * fadeOutGain * fadeInGain;	// sinf(3.141592/2/n)
+	}
+}
+
+
+
+//---------------------------------------------------------------------------------------------------
+//---------------------------------------------------------------------------------------------------
+void BufferOverride::d_run(float **inputs, float **outputs, uint32_t sampleFrames)
+{
+//-------------------------SAFETY CHECK----------------------
+	// (the buffers get made in the constructor now)
+	// if the creation failed, then abort audio processing
+	if (buffer1 == NULL)
+		return;
+#ifdef BUFFEROVERRIDE_STEREO
+	if (buffer2 == NULL)
+		return;
+#endif
+
+
+//-------------------------INITIALIZATIONS----------------------
+	// this is a handy value to have during LFO calculations & wasteful to recalculate at every sample
+	numLFOpointsDivSR = NUM_LFO_POINTS_FLOAT / SAMPLERATE;
+	divisorLFO->pickTheLFOwaveform();
+	bufferLFO->pickTheLFOwaveform();
+
+	// calculate this scaler value to minimize calculations later during processOutput()
+//	float inputGain = 1.0f - fDryWetMix;
+//	float outputGain = fDryWetMix;
+	float inputGain = sqrtf(1.0f - fDryWetMix);
+	float outputGain = sqrtf(fDryWetMix);
+
+
+//-----------------------TEMPO STUFF---------------------------
+	// figure out the current tempo if we're doing tempo sync
+	if ( onOffTest(fBufferTempoSync) ||
+	     (onOffTest(divisorLFO->fTempoSync) || onOffTest(bufferLFO->fTempoSync)) ) {
+		// calculate the tempo at the current processing buffer
+		if ( (fTempo > 0.0f) || (hostCanDoTempo != 1) ) {	// get the tempo from the user parameter
+			currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+			needResync = false;	// we don't want it true if we're not syncing to host tempo
+		} else {	// get the tempo from the host
+			timeInfo = getTimeInfo(kBeatSyncTimeInfoFlags);
+			if (timeInfo) {
+				if (kVstTempoValid & timeInfo->flags)
+					currentTempoBPS = (float)timeInfo->tempo / 60.0f;
+				else
+					currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+//				currentTempoBPS = ((float)tempoAt(reportCurrentPosition())) / 600000.0f;
+				// but zero & negative tempos are bad, so get the user tempo value instead if that happens
+				if (currentTempoBPS <= 0.0f)
+					currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+				//
+				// check if audio playback has just restarted & reset buffer stuff if it has (for measure sync)
+				if (timeInfo->flags & kVstTransportChanged) {
+					needResync = true;
+					currentForcedBufferSize = 1;
+					writePos = 1;
+					minibufferSize = 1;
+					prevMinibufferSize = 0;
+					smoothcount = smoothDur = 0;
+				}
+			} else {	// do the same stuff as above if the timeInfo gets a null pointer
+				currentTempoBPS = tempoScaled(fTempo) / 60.0f;
+				needResync = false;	// we don't want it true if we're not syncing to host tempo
+			}
+		}
+	}
+
+
+//-----------------------AUDIO STUFF---------------------------
+	// here we begin the audio output loop, which has two checkpoints at the beginning
+	for (long samplecount = 0; (samplecount < sampleFrames); samplecount++) {
+		// check if it's the end of this minibuffer
+		if (readPos >= minibufferSize)
+			updateBuffer(samplecount);
+
+		// store the latest input samples into the buffers
+		buffer1[writePos] = inputs[0][samplecount];
+#ifdef BUFFEROVERRIDE_STEREO
+		buffer2[writePos] = inputs[1][samplecount];
+#endif
+
+		// get the current output without any smoothing
+		float out1 = buffer1[readPos];
+#ifdef BUFFEROVERRIDE_STEREO
+		float out2 = buffer2[readPos];
+#endif
+
+		// and if smoothing is taking place, get the smoothed audio output
+		if (smoothcount > 0) {
+			// crossfade between the current input & its corresponding overlap sample
+//			out1 *= 1.0f - (smoothStep * (float)smoothcount);	// current
+//			out1 += buffer1[readPos+prevMinibufferSize] * smoothStep*(float)smoothcount;	// + previous
+//			float smoothfract = smoothStep * (float)smoothcount;
+//			float newgain = sqrt(1.0f - smoothfract);
+//			float oldgain = sqrt(smoothfract);
+//			out1 = (out1 * newgain) + (buffer1[readPos+prevMinibufferSize] * oldgain);
+//			out1 = (out1 * sqrtFadeIn) + (buffer1[readPos+prevMinibufferSize] * sqrtFadeOut);
+			out1 = (out1 * fadeInGain) + (buffer1[readPos+prevMinibufferSize] * fadeOutGain);
+#ifdef BUFFEROVERRIDE_STEREO
+//			out2 *= 1.0f - (smoothStep * (float)smoothcount);	// current
+//			out2 += buffer2[readPos+prevMinibufferSize] * smoothStep*(float)smoothcount;	// + previous
+//			out2 = (out2 * newgain) + (buffer2[readPos+prevMinibufferSize] * oldgain);
+//			out2 = (out2 * sqrtFadeIn) + (buffer2[readPos+prevMinibufferSize] * sqrtFadeOut);
+			out2 = (out2 * fadeInGain) + (buffer2[readPos+prevMinibufferSize] * fadeOutGain);
+#endif
+			smoothcount--;
+//			smoothFract += smoothStep;
+//			sqrtFadeIn = 0.5f * (sqrtFadeIn + (smoothFract / sqrtFadeIn));
+//			sqrtFadeOut = 0.5f * (sqrtFadeOut + ((1.0f-smoothFract) / sqrtFadeOut));
+			fadeInGain = (fadeOutGain * imaginaryFadePart) + (fadeInGain * realFadePart);
+			fadeOutGain = (realFadePart * fadeOutGain) - (imaginaryFadePart * fadeInGain);
+		}
+
+		outputs[0][samplecount] += (out1 * outputGain) + (inputs[0][samplecount] * inputGain);
+#ifdef BUFFEROVERRIDE_STEREO
+		outputs[1][samplecount] += (out2 * outputGain) + (inputs[1][samplecount] * inputGain);
+#endif
+
+		// increment the position trackers
+		readPos++;
+		writePos++;
+	}
+}
+
+}	// namespace BufferOverrideBaseline
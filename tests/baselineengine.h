@@ -0,0 +1,121 @@
+#ifndef __baselineengine
+#define __baselineengine
+
+// The per-sample engine as it was before any of the optimization work, frozen here so that the
+// engine tests have something to hold the real one up against that doesn't share any of its code.
+// updateBuffer(), d_run(), d_deactivate(), d_setParameterValue() & the LFO are copied as they were
+// (see baselineengine.cpp), apart from these:
+//    - it's all in its own namespace, so that the names can stay the same
+//    - there's no MIDI (that was never hooked up), so heedBufferOverrideEvents() & midistuff are gone
+//    - the tempo rate table is the shared one (the scalars are the same floats as before)
+//    - getTimeInfo() & canHostDo() are whatever the test says, rather than a host
+//    - the capture buffers are cleared when they're made (they used to start out as whatever was in memory)
+//    - renderLFO() runs an LFO on its own, the way updateBuffer() does
+// Don't "fix" anything in here:  the whole point is that it stays how it was.
+
+#include <stdint.h>
+
+#include "DistrhoPlugin.hpp"
+
+
+namespace BufferOverrideBaseline
+{
+
+class LFO;
+
+//-----------------------------------------------------------------------------
+class BufferOverride
+{
+public:
+	// hostCanDoTempo is what canHostDo("sendVstTimeInfo") would have said
+	BufferOverride(double sampleRate, long hostCanDoTempo);
+	~BufferOverride();
+
+	enum Parameters {
+	    kDivisor = 0,
+	    kBuffer,
+	    kBufferTempoSync,
+	    kBufferInterrupt,
+
+	    kDivisorLFOrate,
+	    kDivisorLFOdepth,
+	    kDivisorLFOshape,
+	    kDivisorLFOtempoSync,
+	    kBufferLFOrate,
+	    kBufferLFOdepth,
+	    kBufferLFOshape,
+	    kBufferLFOtempoSync,
+
+	    kSmooth,
+	    kDryWetMix,
+
+	    kPitchbend,
+	    kMidiMode,
+
+	    kTempo,
+
+	    NUM_PARAMETERS
+	};
+
+	void d_deactivate();
+	void d_activate();
+	void d_setParameterValue(uint32_t index, float value);
+	void d_run(float **inputs, float **outputs, uint32_t sampleFrames);
+
+	// what getTimeInfo() gives from here on (NULL is a host that doesn't have any)
+	void setTimeInfo(VstTimeInfo *newTimeInfo) {
+		hostTimeInfo = newTimeInfo;
+	}
+
+protected:
+	void updateBuffer(long samplePos);
+	VstTimeInfo * getTimeInfo(long filter) {
+		(void)filter;
+		return hostTimeInfo;
+	}
+
+	// the parameters
+	float fDivisor, fBuffer, fBufferTempoSync, fBufferInterrupt, fSmooth, fDryWetMix, fPitchbend, fMidiMode, fTempo;
+
+	long currentForcedBufferSize;	// the size of the larger, imposed buffer
+	// these store the forced buffer
+	float *buffer1;
+#ifdef BUFFEROVERRIDE_STEREO
+	float *buffer2;
+#endif
+	long writePos;	// the current sample position within the forced buffer
+
+	long minibufferSize;	// the current size of the divided "mini" buffer
+	long prevMinibufferSize;	// the previous size
+	long readPos;	// the current sample position within the minibuffer
+	float currentBufferDivisor;	// the current value of the divisor with LFO possibly applied
+
+	float numLFOpointsDivSR;	// the number of LFO table points divided by the sampling rate
+
+	VstTimeInfo *timeInfo;
+	VstTimeInfo *hostTimeInfo;	// (what getTimeInfo() gives)
+	float currentTempoBPS;	// tempo in beats per second
+	long hostCanDoTempo;	// my semi-booly dude who knows something about the host's VstTimeInfo implementation
+	bool needResync;
+
+	long SUPER_MAX_BUFFER;
+	float SAMPLERATE;
+
+	long smoothDur, smoothcount;	// total duration & sample counter for the minibuffer transition smoothing period
+	float smoothStep;	// the gain increment for each sample "step" during the smoothing period
+	float sqrtFadeIn, sqrtFadeOut;	// square root of the smoothing gains, for equal power crossfading
+
+	LFO *divisorLFO, *bufferLFO;
+
+	float fadeOutGain, fadeInGain, realFadePart, imaginaryFadePart;	// for trig crossfading
+};
+
+// numSamples of the 0.0 - 2.0 values that updateBuffer() would get from an LFO with these parameter
+// values, if every minibuffer were a sample long
+void renderLFO(float fRate, float fTempoSync, float fDepth, float fShape, float tempoBPS, float sampleRate,
+				long numSamples, float *values);
+
+}	// namespace BufferOverrideBaseline
+
+
+#endif
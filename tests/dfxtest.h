@@ -0,0 +1,56 @@
+#ifndef __dfxtest
+#define __dfxtest
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+
+//-----------------------------------------------------------------------------
+// Just enough of a test framework for these:  a failed check prints where it was & the test
+// carries on, so that one run shows everything that's wrong, & main() returns DFX_TEST_RESULT.
+
+static long dfxTestFailures = 0;
+
+#define DFX_CHECK(condition)   \
+	do {   \
+		if ( !(condition) ) {   \
+			fprintf(stderr, "%s:%d:  check failed:  %s\n", __FILE__, __LINE__, #condition);   \
+			dfxTestFailures++;   \
+		}   \
+	} while (0)
+
+// the same, but with a printf-style message about what went wrong
+#define DFX_CHECK_MSG(condition, ...)   \
+	do {   \
+		if ( !(condition) ) {   \
+			fprintf(stderr, "%s:%d:  check failed:  %s:  ", __FILE__, __LINE__, #condition);   \
+			fprintf(stderr, __VA_ARGS__);   \
+			fprintf(stderr, "\n");   \
+			dfxTestFailures++;   \
+		}   \
+	} while (0)
+
+#define DFX_TEST_RESULT   ( (dfxTestFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE )
+
+// a little LCG for test data, so that every run gets the same
+struct DFXtestRandom
+{
+	uint64_t state;
+	DFXtestRandom(uint64_t seed) : state(seed) {}
+	uint32_t next() {
+		state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+		return (uint32_t)(state >> 32);
+	}
+	// 0.0 - 1.0
+	float nextFloat() {
+		return (float)(next() >> 8) * (1.0f / 16777215.0f);
+	}
+	// 0 to range-1
+	long nextLong(long range) {
+		return (long)(next() % (uint32_t)range);
+	}
+};
+
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef __DistrhoPlugin_teststub
+#define __DistrhoPlugin_teststub
+
+// Just enough of the old DPF plugin API (& of the VST types that came along with it) to build the
+// engine without a host, for the engine tests.  The d_ functions are protected in the real thing, so
+// the tests go through the same public wrappers that a host would (activate(), run() & the rest), &
+// the host's side of things (its transport & what it says it can do) is whatever the test sets up
+// in getTestHost().
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+
+#define START_NAMESPACE_DISTRHO   namespace DISTRHO {
+#define END_NAMESPACE_DISTRHO   }
+
+
+//-----------------------------------------------------------------------------
+// the VST types
+
+struct VstTimeInfo
+{
+	double samplePos;
+	double sampleRate;
+	double ppqPos;
+	double tempo;
+	double barStartPos;
+	int32_t timeSigNumerator;
+	int32_t timeSigDenominator;
+	int32_t flags;
+};
+
+enum {
+	kVstTransportChanged = 1,
+	kVstTransportPlaying = 1 << 1,
+	kVstPpqPosValid = 1 << 9,
+	kVstTempoValid = 1 << 10,
+	kVstBarsValid = 1 << 11,
+	kVstTimeSigValid = 1 << 13
+};
+
+enum {
+	kVstMidiType = 1
+};
+
+struct VstEvent
+{
+	int32_t type;
+	int32_t byteSize;
+	int32_t deltaFrames;
+	int32_t flags;
+	char data[16];
+};
+
+struct VstEvents
+{
+	int32_t numEvents;
+	VstEvent *events[2];	// (really as many as numEvents says)
+};
+
+struct VstMidiEvent
+{
+	int32_t type;
+	int32_t byteSize;
+	int32_t deltaFrames;
+	int32_t flags;
+	int32_t noteLength;
+	int32_t noteOffset;
+	char midiData[4];
+	char detune;
+	char noteOffVelocity;
+	char reserved1, reserved2;
+};
+
+class AudioEffectX
+{
+public:
+	virtual ~AudioEffectX() {}
+	virtual void setProgram(long program) {
+		(void)program;
+	}
+};
+
+
+START_NAMESPACE_DISTRHO
+
+//-----------------------------------------------------------------------------
+// the plugin framework types
+
+struct d_string
+{
+	const char *text;
+	d_string() : text("") {}
+	d_string& operator=(const char *newText) {
+		text = newText;
+		return *this;
+	}
+};
+
+enum {
+	kParameterIsAutomable = 1 << 0,
+	kParameterIsBoolean = 1 << 1,
+	kParameterIsInteger = 1 << 2,
+	kParameterIsLogarithmic = 1 << 3,
+	kParameterIsOutput = 1 << 4
+};
+
+struct ParameterRanges
+{
+	float def, min, max;
+	ParameterRanges() : def(0.0f), min(0.0f), max(1.0f) {}
+};
+
+struct Parameter
+{
+	uint32_t hints;
+	d_string name, symbol, unit;
+	ParameterRanges ranges;
+	Parameter() : hints(0) {}
+};
+
+static inline constexpr int32_t d_cconst(int a, int b, int c, int d)
+{
+	return (a << 24) | (b << 16) | (c << 8) | d;
+}
+
+//-----------------------------------------------------------------------------
+// the host, as far as the plugin can tell (one for the whole test, set up however the test wants;
+// it's inline rather than static so that every source file gets the same one)
+struct TestHost
+{
+	long canDoTimeInfo;	// what canHostDo("sendVstTimeInfo") says (1 for yes, 0 for don't know, -1 for no)
+	VstTimeInfo *timeInfo;	// what getTimeInfo() gives (NULL is a host that doesn't have any right now)
+	long timeInfoCalls;	// how many times getTimeInfo() has been called
+	TestHost() : canDoTimeInfo(0), timeInfo(NULL), timeInfoCalls(0) {}
+};
+
+inline TestHost& getTestHost()
+{
+	static TestHost testHost;
+	return testHost;
+}
+
+//-----------------------------------------------------------------------------
+class Plugin
+{
+public:
+	Plugin(uint32_t parameterCount, uint32_t programCount, uint32_t stateCount)
+		: curProgram(0), numParameters(parameterCount), numPrograms(programCount), numStates(stateCount) {}
+	virtual ~Plugin() {}
+
+	// what a host calls
+	void activate() {
+		d_activate();
+	}
+	void deactivate() {
+		d_deactivate();
+	}
+	void run(const float** inputs, float** outputs, uint32_t frames) {
+		d_run(inputs, outputs, frames);
+	}
+	float getParameterValue(uint32_t index) const {
+		return d_getParameterValue(index);
+	}
+	void setParameterValue(uint32_t index, float value) {
+		d_setParameterValue(index, value);
+	}
+	void setProgram(uint32_t index) {
+		d_setProgram(index);
+	}
+	void setSampleRate(double newSampleRate) {
+		d_sampleRateChanged(newSampleRate);
+	}
+	void setState(const char* key, const char* value) {
+		d_setState(key, value);
+	}
+
+protected:
+	uint32_t curProgram;
+
+	VstTimeInfo * getTimeInfo(long filter) {
+		(void)filter;
+		getTestHost().timeInfoCalls++;
+		return getTestHost().timeInfo;
+	}
+	long canHostDo(const char *text) {
+		return (strcmp(text, "sendVstTimeInfo") == 0) ? getTestHost().canDoTimeInfo : 0;
+	}
+	long tempoAt(long position) {
+		(void)position;
+		VstTimeInfo *timeInfo = getTestHost().timeInfo;
+		return (timeInfo && (timeInfo->flags & kVstTempoValid)) ? (long)(timeInfo->tempo * 10000.0) : 0;
+	}
+	void setNumInputs(long numInputs) {
+		(void)numInputs;
+	}
+	void setNumOutputs(long numOutputs) {
+		(void)numOutputs;
+	}
+	void setUniqueID(long uniqueID) {
+		(void)uniqueID;
+	}
+	void canProcessReplacing() {}
+	void canMono() {}
+	void wantEvents() {}
+
+	virtual const char* d_getLabel() const noexcept = 0;
+	virtual const char* d_getMaker() const noexcept = 0;
+	virtual const char* d_getLicense() const noexcept = 0;
+	virtual uint32_t d_getVersion() const noexcept = 0;
+	virtual long d_getUniqueId() const noexcept = 0;
+
+	virtual void d_initParameter(uint32_t index, Parameter& parameter) = 0;
+	virtual void d_initProgramName(uint32_t index, d_string& programName) = 0;
+	virtual void d_initStateKey(uint32_t index, d_string& stateKey) = 0;
+
+	virtual float d_getParameterValue(uint32_t index) const = 0;
+	virtual void d_setParameterValue(uint32_t index, float value) = 0;
+	virtual void d_setProgram(uint32_t index) = 0;
+	virtual void d_setState(const char* key, const char* value) = 0;
+
+	virtual void d_activate() {}
+	virtual void d_deactivate() {}
+	virtual void d_run(const float** inputs, float** outputs, uint32_t frames) = 0;
+	virtual void d_sampleRateChanged(double newSampleRate) {
+		(void)newSampleRate;
+	}
+
+private:
+	uint32_t numParameters, numPrograms, numStates;
+};
+
+END_NAMESPACE_DISTRHO
+
+
+#endif
@@ -0,0 +1,75 @@
+// runs the engine through the real-time audit (see rtaudit.h), with every factory program, MIDI &
+// automation, & checks that nothing on the audio path allocates, locks or makes a blocking syscall
+// (& first that the audit does catch those when they happen)
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "bufferOverride.hpp"
+#include "dfxtest.h"
+
+using namespace DISTRHO;
+
+
+//-----------------------------------------------------------------------------
+// one of each of the things that the audit is there to catch, on purpose, in an audit scope
+// (each one prints its stack trace), & then again outside of one, where they don't count
+static void testAuditCatches()
+{
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	for (long scoped = 1; scoped >= 0; scoped--) {
+		long expected = rtAuditGetViolations();
+		if (scoped)
+			rtAuditEnter();
+		void * volatile memory = malloc(64);
+		DFX_CHECK_MSG( rtAuditGetViolations() == (expected += scoped), "malloc (scoped %ld)", scoped );
+		free(memory);
+		DFX_CHECK_MSG( rtAuditGetViolations() == (expected += scoped), "free (scoped %ld)", scoped );
+		long * volatile object = new long;
+		DFX_CHECK_MSG( rtAuditGetViolations() == (expected += scoped), "new (scoped %ld)", scoped );
+		delete object;
+		DFX_CHECK_MSG( rtAuditGetViolations() == (expected += scoped), "delete (scoped %ld)", scoped );
+		pthread_mutex_lock(&mutex);
+		DFX_CHECK_MSG( rtAuditGetViolations() == (expected += scoped), "pthread_mutex_lock (scoped %ld)", scoped );
+		pthread_mutex_unlock(&mutex);
+		volatile int randomNumber = rand();
+		(void)randomNumber;
+		DFX_CHECK_MSG( rtAuditGetViolations() == (expected += scoped), "rand (scoped %ld)", scoped );
+		if (scoped)
+			rtAuditLeave();
+	}
+	pthread_mutex_destroy(&mutex);
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+	testAuditCatches();
+
+	// a host that knows its tempo, for the programs that follow it
+	VstTimeInfo timeInfo;
+	memset(&timeInfo, 0, sizeof(timeInfo));
+	timeInfo.sampleRate = 44100.0;
+	timeInfo.tempo = 133.0;
+	timeInfo.timeSigNumerator = timeInfo.timeSigDenominator = 4;
+	timeInfo.flags = kVstTempoValid | kVstPpqPosValid | kVstBarsValid | kVstTimeSigValid | kVstTransportPlaying;
+	getTestHost().canDoTimeInfo = 1;
+	getTestHost().timeInfo = &timeInfo;
+
+	BufferOverride *engine = new BufferOverride;
+	engine->setSampleRate(44100.0);
+	long violations = engine->auditRealTimeSafety(44100 * 4);
+	DFX_CHECK_MSG( violations == 0, "%ld real-time violations (the stack traces are above)", violations );
+
+	// & again with everything else that can be going on turned on
+	engine->setNumExtraLayers(MAX_EXTRA_LAYERS);
+	engine->setModulation(0, BufferOverride::kDivisor, 0.3f, 0.4f, 0.5f, 0.0f);
+	engine->setModulation(1, BufferOverride::kDryWetMix, 0.6f, 0.2f, 0.9f, 1.0f);
+	engine->setIdleRelease(4096);
+	violations = engine->auditRealTimeSafety(44100 * 2);
+	DFX_CHECK_MSG( violations == 0, "%ld real-time violations with the extra layers & modulation", violations );
+
+	delete engine;
+	getTestHost().timeInfo = NULL;
+	return DFX_TEST_RESULT;
+}
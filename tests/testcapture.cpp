@@ -0,0 +1,196 @@
+// checks the capture buffers in each storage format & the pool that they share
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "capturebuffer.h"
+#include "dfxtest.h"
+
+
+//-----------------------------------------------------------------------------
+// what goes in comes back out as what quantize() says that it will, in runs of any length
+static void testRoundTrip(long format, DFXtestRandom *random, float headroom = CAPTURE_INT16_HEADROOM)
+{
+	const long numSamples = 5000;
+	CaptureBuffer buffer;
+	buffer.setInt16Headroom(headroom);
+	DFX_CHECK( buffer.allocate(numSamples, format) );
+	DFX_CHECK( buffer.getFormat() == format );
+	DFX_CHECK( buffer.getHighWater() == 0 );
+
+	std::vector<float> source(numSamples), expected(numSamples), readBack(numSamples);
+	for (long i = 0; i < numSamples; i++)
+		source[i] = ((random->nextFloat() * 2.0f) - 1.0f) * ((i % 100 == 0) ? 6.0f : 1.0f);
+	buffer.quantize(&expected[0], &source[0], numSamples);
+
+	for (long position = 0; position < numSamples; ) {
+		long runLength = 1 + random->nextLong(300);
+		if (runLength > (numSamples - position))
+			runLength = numSamples - position;
+		buffer.write(position, &source[position], runLength);
+		position += runLength;
+		DFX_CHECK( buffer.getHighWater() == position );
+	}
+	for (long position = 0; position < numSamples; ) {
+		long runLength = 1 + random->nextLong(300);
+		if (runLength > (numSamples - position))
+			runLength = numSamples - position;
+		buffer.read(position, &readBack[position], runLength);
+		position += runLength;
+	}
+	DFX_CHECK_MSG( memcmp(&expected[0], &readBack[0], numSamples * sizeof(float)) == 0, "format %ld", format );
+
+	// & how close that is to what went in
+	double maxError = 0.0;
+	for (long i = 0; i < numSamples; i++) {
+		if (fabsf(source[i]) <= 1.0f)
+			maxError = fmax(maxError, fabs((double)readBack[i] - (double)source[i]));
+	}
+	if (format == kCaptureFloat32)
+		DFX_CHECK(maxError == 0.0);
+	else if (format == kCaptureInt16) {
+		DFX_CHECK_MSG( maxError <= (0.51 * headroom / 32767.0), "int16 error %g", maxError );	// (half a step, plus the float rounding around the offset)
+		// & the loud ones clip at the headroom
+		DFX_CHECK( fabsf(readBack[0]) <= headroom );
+		DFX_CHECK( fabsf(fabsf(readBack[100]) - fminf(fabsf(source[100]), headroom)) <= (headroom / 32767.0f) );
+	} else
+		DFX_CHECK_MSG( maxError <= (1.0 / 256.0), "bfloat16 error %g", maxError );
+
+	// the history comes back exactly, & everything around it goes back to silence
+	long historyStart = 321, historyLength = 1234;
+	std::vector<char> history(historyLength * CaptureBuffer::bytesPerSample(format));
+	buffer.saveHistory(&history[0], historyStart, historyLength);
+	buffer.write(0, &source[numSamples - historyLength], historyLength);
+	buffer.restoreHistory(&history[0], historyStart, historyLength);
+	DFX_CHECK( buffer.getHighWater() == (historyStart + historyLength) );
+	buffer.read(0, &readBack[0], numSamples);
+	DFX_CHECK( memcmp(&expected[historyStart], &readBack[historyStart], historyLength * sizeof(float)) == 0 );
+	bool silent = true;
+	for (long i = 0; i < numSamples; i++) {
+		if ( (i < historyStart) || (i >= (historyStart + historyLength)) )
+			silent = silent && (readBack[i] == 0.0f);
+	}
+	DFX_CHECK(silent);
+}
+
+//-----------------------------------------------------------------------------
+// buffers go back to the pool as they are, & the next one of the same size comes back from there
+// reading as silence, without anything having cleared it
+static void testPool()
+{
+	CapturePool *pool = CapturePool::get();
+	pool->trim(0);
+	DFX_CHECK( pool->getNumSpares() == 0 );
+
+	const long numSamples = 4096;
+	float noise[numSamples];
+	for (long i = 0; i < numSamples; i++)
+		noise[i] = (float)((i * 7919) % 200) * 0.01f - 1.0f;
+
+	void *firstData = NULL;
+	{
+		CaptureBuffer buffer;
+		DFX_CHECK( buffer.allocate(numSamples, kCaptureFloat32) );
+		buffer.write(0, noise, numSamples);
+		float check;
+		buffer.read(17, &check, 1);
+		DFX_CHECK( check == noise[17] );
+		DFX_CHECK( buffer.releaseToPool() );
+		DFX_CHECK( !buffer.isAllocated() );
+		DFX_CHECK( pool->getNumSpares() == 1 );
+		// (a different size doesn't get that one)
+		DFX_CHECK( pool->take(12345) == NULL );
+		DFX_CHECK( pool->getNumSpares() == 1 );
+		firstData = pool->take(numSamples * sizeof(float));
+		DFX_CHECK( firstData != NULL );
+		DFX_CHECK( pool->giveBack(firstData) );
+	}
+
+	CaptureBuffer buffer;
+	DFX_CHECK( buffer.allocate(numSamples, kCaptureFloat32) );
+	DFX_CHECK( pool->getNumSpares() == 0 );
+	DFX_CHECK( buffer.getAllocatedBytes() == numSamples * sizeof(float) );
+	std::vector<float> readBack(numSamples);
+	buffer.read(0, &readBack[0], numSamples);
+	bool silent = true;
+	for (long i = 0; i < numSamples; i++)
+		silent = silent && (readBack[i] == 0.0f);
+	DFX_CHECK_MSG( silent, "a buffer from the pool wasn't silent" );
+
+	// writing past the high water mark silences what got skipped over, & clearing just forgets
+	buffer.write(100, noise, 10);
+	buffer.read(0, &readBack[0], 120);
+	silent = true;
+	for (long i = 0; i < 100; i++)
+		silent = silent && (readBack[i] == 0.0f);
+	DFX_CHECK_MSG( silent, "the gap before a write wasn't silent" );
+	DFX_CHECK( memcmp(&readBack[100], noise, 10 * sizeof(float)) == 0 );
+	DFX_CHECK( readBack[110] == 0.0f );
+	buffer.clear();
+	DFX_CHECK( buffer.getHighWater() == 0 );
+	buffer.read(95, &readBack[0], 20);
+	silent = true;
+	for (long i = 0; i < 20; i++)
+		silent = silent && (readBack[i] == 0.0f);
+	DFX_CHECK_MSG( silent, "a cleared buffer wasn't silent" );
+
+	// allocating only from the pool never makes a new one
+	CaptureBuffer fromPool;
+	DFX_CHECK( !fromPool.allocateFromPool(numSamples, kCaptureFloat32) );
+	DFX_CHECK( !fromPool.isAllocated() );
+	buffer.write(0, noise, numSamples);
+	DFX_CHECK( buffer.releaseToPool() );
+	DFX_CHECK( fromPool.allocateFromPool(numSamples, kCaptureFloat32) );
+	DFX_CHECK( pool->getNumSpares() == 0 );
+	DFX_CHECK( fromPool.getHighWater() == 0 );
+	fromPool.read(0, &readBack[0], numSamples);
+	silent = true;
+	for (long i = 0; i < numSamples; i++)
+		silent = silent && (readBack[i] == 0.0f);
+	DFX_CHECK_MSG( silent, "a buffer taken from the pool wasn't silent" );
+	fromPool.release();
+	pool->trim(0);
+
+	// the pool holds as many as it has slots for, & no more
+	std::vector<void*> blocks;
+	for (long i = 0; i < CAPTURE_POOL_SLOTS + 2; i++)
+		blocks.push_back(CapturePool::allocateBlock(64));
+	long numGivenBack = 0;
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (pool->giveBack(blocks[i]))
+			numGivenBack++;
+		else
+			CapturePool::freeBlock(blocks[i]);
+	}
+	DFX_CHECK( numGivenBack == CAPTURE_POOL_SLOTS );
+	pool->trim(CAPTURE_POOL_SPARES);
+	DFX_CHECK( pool->getNumSpares() == CAPTURE_POOL_SPARES );
+	pool->trim(0);
+	DFX_CHECK( pool->getNumSpares() == 0 );
+
+	// a buffer that can't get one from the pool asks for one (just the once), & housekeeping allocates it,
+	// which trim() leaves alone for a while, so that it gets the chance to take it
+	DFX_CHECK( !fromPool.allocateFromPool(numSamples, kCaptureFloat32) );
+	DFX_CHECK( !fromPool.allocateFromPool(numSamples, kCaptureFloat32) );
+	pool->runHousekeeping();
+	DFX_CHECK( pool->getNumSpares() == 1 );
+	pool->trim(0);
+	DFX_CHECK( pool->getNumSpares() == 1 );
+	DFX_CHECK( fromPool.allocateFromPool(numSamples, kCaptureFloat32) );
+	DFX_CHECK( pool->getNumSpares() == 0 );
+	fromPool.release();
+	pool->trim(0);
+	DFX_CHECK( pool->getNumSpares() == 0 );
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+	DFXtestRandom random(2);
+	for (long format = 0; format < numCaptureFormats; format++)
+		testRoundTrip(format, &random);
+	testRoundTrip(kCaptureInt16, &random, 1.5f);
+	testPool();
+	return DFX_TEST_RESULT;
+}
@@ -0,0 +1,1344 @@
+// runs the whole engine, through the same calls that a host makes, & checks its fast paths against
+// its own reference mode, offline rendering against real time, resuming from a checkpoint, segment lists,
+// sweeps & the render cache, & all of it against the original per-sample engine (see baselineengine.h) under
+// random settings, automation, transport jumps & block sizes, its saved state, what it tells the GUI,
+// what it shows for its parameters, sharing the host's transport between instances, & giving its capture buffers back while it's idle
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "bufferOverride.hpp"
+#include "baselineengine.h"
+#include "dfxtest.h"
+
+using namespace DISTRHO;
+
+// How far the engine is allowed to be from the original one, as a sample value.  They can't come out
+// bit-exact:  the crossfade gains come from sinCosQuarterPi() rather than cosf() & sinf(), & the kernels
+// add up the wet & dry parts in a different order, which is an ulp or so here & there (it comes to
+// at most about 5e-7 in practice, & a boundary landing on a different sample would be off by far more).
+const float kBaselineTolerance = 1.0e-5f;
+
+
+//-----------------------------------------------------------------------------
+// a host's timeline, with the tempo & bar info that samplesToNextBar() wants
+struct TestTimeline
+{
+	VstTimeInfo timeInfo;
+
+	TestTimeline(double sampleRate, double tempo) {
+		memset(&timeInfo, 0, sizeof(timeInfo));
+		timeInfo.sampleRate = sampleRate;
+		timeInfo.tempo = tempo;
+		timeInfo.timeSigNumerator = timeInfo.timeSigDenominator = 4;
+		jump(0.0);
+	}
+	// moves to somewhere else, like a host that's just started playing or gotten a new position
+	void jump(double samplePos) {
+		timeInfo.flags = kVstTempoValid | kVstPpqPosValid | kVstBarsValid | kVstTimeSigValid | kVstTransportPlaying | kVstTransportChanged;
+		setPosition(samplePos);
+	}
+	void stop() {
+		timeInfo.flags = (timeInfo.flags & ~kVstTransportPlaying) | kVstTransportChanged;
+	}
+	// after a block:  the position only moves along if it's playing
+	void advance(long numSamples) {
+		timeInfo.flags &= ~kVstTransportChanged;
+		if (timeInfo.flags & kVstTransportPlaying)
+			setPosition(timeInfo.samplePos + (double)numSamples);
+	}
+	void setPosition(double samplePos) {
+		timeInfo.samplePos = samplePos;
+		timeInfo.ppqPos = (samplePos / timeInfo.sampleRate) * (timeInfo.tempo / 60.0);
+		timeInfo.barStartPos = floor(timeInfo.ppqPos / 4.0) * 4.0;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// a mono test signal, with some silence in it now & then
+static void makeInput(std::vector<float> *input, DFXtestRandom *random)
+{
+	float frequency = 0.002f + (random->nextFloat() * 0.05f);
+	for (size_t i = 0; i < input->size(); i++) {
+		float noise = (random->nextFloat() * 2.0f) - 1.0f;
+		(*input)[i] = (0.7f * sinf((float)i * frequency)) + (0.2f * noise);
+		if ( ((i / 20000) % 7) == 3 )
+			(*input)[i] = 0.0f;
+	}
+}
+
+static void runBlock(BufferOverride *engine, std::vector<float> *input, std::vector<float> *output, long start, long numSamples)
+{
+	const float *inputs[1] = { &(*input)[start] };
+	float *outputs[1] = { &(*output)[start] };
+	memset(outputs[0], 0, numSamples * sizeof(float));	// (the engine adds to what's there)
+	engine->run(inputs, outputs, numSamples);
+}
+
+static long countDifferences(std::vector<float> *a, std::vector<float> *b, long *first)
+{
+	long numDifferences = 0;
+	*first = -1;
+	for (size_t i = 0; i < a->size(); i++) {
+		if ((*a)[i] != (*b)[i]) {
+			if (*first < 0)
+				*first = (long)i;
+			numDifferences++;
+		}
+	}
+	return numDifferences;
+}
+
+
+#pragma mark _________block_sizes_________
+
+//-----------------------------------------------------------------------------
+// the same settings & input, run in random block sizes, come out the same as in one fixed block size
+// (the LFOs stay off the random shapes, since those don't start over with each engine)
+static void testBlockSizes(uint64_t seed)
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(seed);
+	std::vector<float> input(512 * 172), fixedOutput(input.size()), randomOutput(input.size());
+	makeInput(&input, &random);
+
+	BufferOverride *engines[2];
+	for (long e = 0; e < 2; e++) {
+		engines[e] = new BufferOverride;
+		engines[e]->setSampleRate(44100.0);
+	}
+	long numSettings = 1 + random.nextLong(5);
+	for (long i = 0; i < numSettings; i++) {
+		long index = random.nextLong(BufferOverride::kDryWetMix + 1);
+		if ( (index == BufferOverride::kDivisorLFOshape) || (index == BufferOverride::kBufferLFOshape) )
+			continue;
+		float value = random.nextFloat();
+		for (long e = 0; e < 2; e++)
+			engines[e]->setParameterValue(index, value);
+	}
+	for (long e = 0; e < 2; e++) {
+		engines[e]->setParameterValue(BufferOverride::kTempo, 0.5f);
+		engines[e]->deactivate();
+		engines[e]->activate();
+	}
+
+	for (long start = 0; start < (long)input.size(); start += 512)
+		runBlock(engines[0], &input, &fixedOutput, start, 512);
+	for (long start = 0; start < (long)input.size(); ) {
+		long numSamples = 1 + random.nextLong(1024);
+		if (numSamples > ((long)input.size() - start))
+			numSamples = (long)input.size() - start;
+		runBlock(engines[1], &input, &randomOutput, start, numSamples);
+		start += numSamples;
+	}
+	DFX_CHECK_MSG( memcmp(&fixedOutput[0], &randomOutput[0], input.size() * sizeof(float)) == 0, "seed %llu", (unsigned long long)seed );
+	for (long e = 0; e < 2; e++)
+		delete engines[e];
+}
+
+
+#pragma mark _________reference_mode_________
+
+//-----------------------------------------------------------------------------
+// everything random, for the engine & for one in reference mode
+static void setUpEngine(BufferOverride *engine, uint64_t seed, bool referenceMode)
+{
+	DFXtestRandom random(seed);
+	engine->setSampleRate((random.nextLong(2) == 0) ? 44100.0 : 96000.0);
+	engine->setProgram(random.nextLong(8));
+	for (long i = 0; i < 6; i++) {
+		long index = random.nextLong(BufferOverride::kMidiMode);
+		engine->setParameterValue(index, random.nextFloat());
+	}
+	engine->setParameterValue(BufferOverride::kMidiMode, (float)random.nextLong(2));
+	// (the host's tempo half the time)
+	engine->setParameterValue(BufferOverride::kTempo, (random.nextLong(2) == 0) ? 0.0f : random.nextFloat());
+	long numLayers = random.nextLong(MAX_EXTRA_LAYERS + 1);
+	engine->setNumExtraLayers(numLayers);
+	for (long n = 0; n < numLayers; n++)
+		engine->setLayer(n, random.nextFloat(), random.nextFloat(), random.nextFloat() * 0.5f, random.nextFloat(), random.nextFloat(), random.nextFloat());
+	if (random.nextLong(2) == 0) {
+		long destinations[4] = { BufferOverride::kDivisor, BufferOverride::kBuffer, BufferOverride::kSmooth, BufferOverride::kDryWetMix };
+		engine->setModulation(0, destinations[random.nextLong(4)], random.nextFloat(), random.nextFloat() * 0.5f, random.nextFloat(), random.nextFloat());
+	}
+	if (random.nextLong(3) == 0)
+		engine->setLFOgranularity(1 + random.nextLong(64));
+	engine->setCaptureFormat(random.nextLong(numCaptureFormats));
+	engine->setRandomSeed(1 + (uint32_t)seed);
+	engine->setReferenceMode(referenceMode);
+	engine->deactivate();
+	engine->activate();
+}
+
+//-----------------------------------------------------------------------------
+// the fast paths have to come out exactly the same as the reference engine, in real time & offline
+static void testReferenceMode(uint64_t seed)
+{
+	DFXtestRandom random(seed * 7919);
+	TestTimeline timeline(44100.0, 60.0 + (random.nextFloat() * 120.0));
+	getTestHost().canDoTimeInfo = (random.nextLong(4) == 0) ? 0 : 1;
+	getTestHost().timeInfo = &(timeline.timeInfo);
+
+	BufferOverride *engine = new BufferOverride;
+	BufferOverride *reference = new BufferOverride;
+	setUpEngine(engine, seed, false);
+	setUpEngine(reference, seed, true);
+
+	const long numSamples = 150000;
+	std::vector<float> input(numSamples), output(numSamples), referenceOutput(numSamples);
+	makeInput(&input, &random);
+
+	for (long position = 0; position < numSamples; ) {
+		long numFrames = 1 + random.nextLong( (random.nextLong(4) == 0) ? 16 : 1024 );
+		if (numFrames > (numSamples - position))
+			numFrames = numSamples - position;
+		// automation
+		if (random.nextLong(4) == 0) {
+			long index = random.nextLong(BufferOverride::kMidiMode);
+			float value = random.nextFloat();
+			engine->setParameterValue(index, value);
+			reference->setParameterValue(index, value);
+		}
+		// & MIDI
+		if (random.nextLong(8) == 0) {
+			const uint8_t statuses[] = { kMidiNoteOn, kMidiNoteOff, kMidiPitchbend };
+			uint32_t frame = random.nextLong(numFrames + 8);	// (some of them late)
+			uint8_t status = statuses[random.nextLong(3)];
+			uint8_t data1 = 24 + random.nextLong(80), data2 = random.nextLong(128);
+			engine->queueMidiEvent(frame, status, data1, data2);
+			reference->queueMidiEvent(frame, status, data1, data2);
+		}
+		// & the transport jumping around
+		long transport = random.nextLong(200);
+		if (transport == 0)
+			timeline.jump(floor(random.nextFloat() * 1.0e6f));
+		else if (transport == 1)
+			timeline.stop();
+		else if (transport == 2)
+			timeline.jump(timeline.timeInfo.samplePos);
+		runBlock(engine, &input, &output, position, numFrames);
+		runBlock(reference, &input, &referenceOutput, position, numFrames);
+		timeline.advance(numFrames);
+		position += numFrames;
+	}
+	long first;
+	long numDifferences = countDifferences(&output, &referenceOutput, &first);
+	DFX_CHECK_MSG( numDifferences == 0, "seed %lu:  %ld samples differ from the reference engine in real time, starting at %ld",
+				(unsigned long)seed, numDifferences, first );
+
+	// offline, with however many threads, comes out the same as the reference engine offline
+	// (which is just the one thread) & as real time with no host timeline
+	std::vector<float> offlineOutput(numSamples), referenceOfflineOutput(numSamples);
+	float *inputs[1] = { &input[0] };
+	float *outputs[1] = { &offlineOutput[0] };
+	engine->renderOffline(inputs, outputs, numSamples, 1 + random.nextLong(4));
+	outputs[0] = &referenceOfflineOutput[0];
+	reference->renderOffline(inputs, outputs, numSamples, 4);
+	numDifferences = countDifferences(&offlineOutput, &referenceOfflineOutput, &first);
+	DFX_CHECK_MSG( numDifferences == 0, "seed %lu:  %ld samples differ from the reference engine offline, starting at %ld",
+				(unsigned long)seed, numDifferences, first );
+
+	getTestHost().timeInfo = NULL;
+	engine->activate();
+	for (long position = 0; position < numSamples; ) {
+		long numFrames = 1 + random.nextLong(1024);
+		if (numFrames > (numSamples - position))
+			numFrames = numSamples - position;
+		runBlock(engine, &input, &output, position, numFrames);
+		position += numFrames;
+	}
+	numDifferences = countDifferences(&offlineOutput, &output, &first);
+	DFX_CHECK_MSG( numDifferences == 0, "seed %lu:  %ld samples differ between offline & real time, starting at %ld",
+				(unsigned long)seed, numDifferences, first );
+
+	delete engine;
+	delete reference;
+}
+
+
+#pragma mark _________offline_________
+
+//-----------------------------------------------------------------------------
+// rendering on from a restored checkpoint comes out exactly the same as the render did from there
+// (going back further & further, since restoring forgets about the later ones)
+static void testCheckpointResume(uint64_t seed)
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(seed * 6151);
+	BufferOverride *engine = new BufferOverride;
+	setUpEngine(engine, seed, false);
+	engine->setCheckpointInterval(1 + random.nextLong(8192));
+
+	const long numSamples = 400000;
+	std::vector<float> input(numSamples), output(numSamples), resumedOutput(numSamples);
+	makeInput(&input, &random);
+	for (long position = 0; position < numSamples; ) {
+		long numFrames = 1 + random.nextLong(1024);
+		if (numFrames > (numSamples - position))
+			numFrames = numSamples - position;
+		runBlock(engine, &input, &output, position, numFrames);
+		position += numFrames;
+	}
+	// (there's always the one at the start, & some settings don't get to another forced buffer for seconds)
+	DFX_CHECK( engine->getNumCheckpoints() > 0 );
+
+	int64_t editPosition = numSamples;
+	long numResumes = 0;
+	for (long trial = 0; (trial < 4) && (editPosition > 0); trial++) {
+		editPosition = random.nextLong((long)editPosition);
+		long numCheckpoints = engine->getNumCheckpoints();
+		int64_t resumePosition = engine->restoreCheckpoint(editPosition);
+		if (resumePosition < 0)
+			break;
+		numResumes++;
+		DFX_CHECK( resumePosition <= editPosition );
+		DFX_CHECK( engine->getNumCheckpoints() <= numCheckpoints );
+		for (long position = (long)resumePosition; position < numSamples; ) {
+			long numFrames = 1 + random.nextLong(1024);
+			if (numFrames > (numSamples - position))
+				numFrames = numSamples - position;
+			runBlock(engine, &input, &resumedOutput, position, numFrames);
+			position += numFrames;
+		}
+		long numDifferences = 0;
+		for (long i = (long)resumePosition; i < numSamples; i++) {
+			if (resumedOutput[i] != output[i])
+				numDifferences++;
+		}
+		DFX_CHECK_MSG( numDifferences == 0, "seed %lu:  %ld samples differ after resuming from %ld",
+					(unsigned long)seed, numDifferences, (long)resumePosition );
+		editPosition = resumePosition;
+	}
+	DFX_CHECK_MSG( numResumes > 0, "seed %lu:  never resumed", (unsigned long)seed );
+	delete engine;
+}
+
+//-----------------------------------------------------------------------------
+// a segment list renders exactly what renderOffline() does
+static void testSegmentList(uint64_t seed)
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(seed * 4127);
+	BufferOverride *engine = new BufferOverride;
+	setUpEngine(engine, seed, false);
+
+	const long numSamples = 150000;
+	std::vector<float> input(numSamples), output(numSamples), segmentOutput(numSamples);
+	makeInput(&input, &random);
+	float *inputs[1] = { &input[0] };
+	float *outputs[1] = { &output[0] };
+	engine->renderOffline(inputs, outputs, numSamples, 1 + random.nextLong(4));
+
+	BufferOverrideSegment *segments;
+	long numSegments = engine->makeSegmentList(numSamples, &segments);
+	DFX_CHECK( numSegments > 0 );
+	if (numSegments > 0) {
+		outputs[0] = &segmentOutput[0];
+		engine->renderSegmentList(segments, numSegments, inputs, outputs);
+		free(segments);
+	}
+	long first;
+	long numDifferences = countDifferences(&output, &segmentOutput, &first);
+	DFX_CHECK_MSG( numDifferences == 0, "seed %lu:  %ld samples differ from renderOffline() in the segment list render, starting at %ld",
+				(unsigned long)seed, numDifferences, first );
+	delete engine;
+}
+
+//-----------------------------------------------------------------------------
+// (each point's output, from the sweep's writer)
+static void writeSweepTile(void *userData, long pointIndex, int64_t position, float **outputs, long numSamples)
+{
+	std::vector<float> *pointOutput = &((std::vector<float>*)userData)[pointIndex];
+	memcpy(&(*pointOutput)[position], outputs[0], numSamples * sizeof(float));
+}
+
+//-----------------------------------------------------------------------------
+// every point of a sweep comes out exactly as renderOffline() does with that point's settings
+static void testSweep(uint64_t seed)
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(seed * 2713);
+	BufferOverride *engine = new BufferOverride;
+	setUpEngine(engine, seed, false);
+
+	const long numSamples = 60000;
+	std::vector<float> input(numSamples), output(numSamples);
+	makeInput(&input, &random);
+	float *inputs[1] = { &input[0] };
+	float *outputs[1] = { &output[0] };
+
+	long otherParameters[4] = { BufferOverride::kBuffer, BufferOverride::kSmooth, BufferOverride::kDryWetMix, BufferOverride::kDivisorLFOrate };
+	float divisors[3], others[2];
+	for (long i = 0; i < 3; i++)
+		divisors[i] = random.nextFloat();
+	for (long i = 0; i < 2; i++)
+		others[i] = random.nextFloat();
+	BufferOverrideSweepAxis axes[2] = {
+		{ BufferOverride::kDivisor, divisors, 3 },
+		{ otherParameters[random.nextLong(4)], others, 2 }
+	};
+	const long numPoints = 3 * 2;
+	std::vector<float> pointOutputs[numPoints];
+	for (long p = 0; p < numPoints; p++)
+		pointOutputs[p].resize(numSamples);
+	DFX_CHECK( engine->renderSweep(inputs, numSamples, axes, 2, writeSweepTile, pointOutputs, 1 + random.nextLong(4)) );
+
+	for (long p = 0; p < numPoints; p++) {
+		engine->setParameterValue(axes[0].parameter, divisors[p / 2]);
+		engine->setParameterValue(axes[1].parameter, others[p % 2]);
+		engine->renderOffline(inputs, outputs, numSamples, 1);
+		long first;
+		long numDifferences = countDifferences(&output, &pointOutputs[p], &first);
+		DFX_CHECK_MSG( numDifferences == 0, "seed %lu:  %ld samples of sweep point %ld differ from renderOffline(), starting at %ld",
+					(unsigned long)seed, numDifferences, p, first );
+	}
+	delete engine;
+}
+
+
+#pragma mark _________render_cache_________
+
+//-----------------------------------------------------------------------------
+// a render comes back out of the cache as it went in, but only for the very same key
+static void testRenderCache()
+{
+	char directory[] = "/tmp/bufferoverride-test-XXXXXX";
+	if (mkdtemp(directory) == NULL) {
+		DFX_CHECK_MSG( false, "couldn't make a directory for the render cache" );
+		return;
+	}
+	BufferOverride *engine = new BufferOverride;
+	setUpEngine(engine, 3, false);
+	DFXtestRandom random(3);
+	std::vector<float> input(30000), output(input.size()), cachedOutput(input.size());
+	makeInput(&input, &random);
+	float *inputs[1] = { &input[0] };
+	float *outputs[1] = { &output[0] };
+	float *cachedOutputs[1] = { &cachedOutput[0] };
+
+	DFX_CHECK( !engine->renderOfflineCached(directory, inputs, outputs, (int64_t)input.size(), 2) );
+	DFX_CHECK( engine->renderOfflineCached(directory, inputs, cachedOutputs, (int64_t)input.size(), 2) );
+	long first;
+	DFX_CHECK( countDifferences(&output, &cachedOutput, &first) == 0 );
+
+	// any change to the input changes the key, which is all there in the file's name & in its header
+	uint8_t key[BLAKE3_DIGEST_SIZE], otherKey[BLAKE3_DIGEST_SIZE];
+	engine->getRenderKey(inputs, (int64_t)input.size(), key);
+	input[input.size() / 2] += 1.0e-3f;
+	engine->getRenderKey(inputs, (int64_t)input.size(), otherKey);
+	input[input.size() / 2] -= 1.0e-3f;
+	DFX_CHECK( memcmp(key, otherKey, BLAKE3_DIGEST_SIZE) != 0 );
+	char path[512];
+	int pathLength = snprintf(path, sizeof(path), "%s/bufferoverride-", directory);
+	for (long i = 0; i < BLAKE3_DIGEST_SIZE; i++)
+		pathLength += snprintf(path + pathLength, sizeof(path) - pathLength, "%02x", key[i]);
+	snprintf(path + pathLength, sizeof(path) - pathLength, ".render");
+	// (a file whose header has a different key doesn't get used, even with the right name)
+	FILE *file = fopen(path, "r+b");
+	DFX_CHECK( file != NULL );
+	if (file != NULL) {
+		uint8_t headerKey[BLAKE3_DIGEST_SIZE];
+		fseek(file, 2 * sizeof(int32_t), SEEK_SET);
+		DFX_CHECK( fread(headerKey, 1, sizeof(headerKey), file) == sizeof(headerKey) );
+		DFX_CHECK( memcmp(headerKey, key, BLAKE3_DIGEST_SIZE) == 0 );
+		headerKey[BLAKE3_DIGEST_SIZE - 1] ^= 1;
+		fseek(file, 2 * sizeof(int32_t), SEEK_SET);
+		fwrite(headerKey, 1, sizeof(headerKey), file);
+		fclose(file);
+		DFX_CHECK( !engine->renderOfflineCached(directory, inputs, cachedOutputs, (int64_t)input.size(), 2) );
+		DFX_CHECK( countDifferences(&output, &cachedOutput, &first) == 0 );
+	}
+
+	remove(path);
+	rmdir(directory);
+	delete engine;
+}
+
+
+#pragma mark _________modulation_________
+
+//-----------------------------------------------------------------------------
+// the modulation matrix only takes the parameters that do something with it
+static void testModulationRouting()
+{
+	getTestHost().timeInfo = NULL;
+	BufferOverride *engine = new BufferOverride;
+	for (long index = 0; index < BufferOverride::NUM_PARAMETERS; index++) {
+		bool supported = (index == BufferOverride::kDivisor) || (index == BufferOverride::kBuffer)
+						|| (index == BufferOverride::kSmooth) || (index == BufferOverride::kDryWetMix);
+		DFX_CHECK( engine->setModulation(1, index, 0.5f, 0.5f, 0.0f, 0.0f) == supported );
+	}
+	DFX_CHECK( !engine->setModulation(1, BufferOverride::NUM_PARAMETERS, 0.5f, 0.5f, 0.0f, 0.0f) );
+	DFX_CHECK( !engine->setModulation(NUM_MOD_SLOTS, BufferOverride::kDivisor, 0.5f, 0.5f, 0.0f, 0.0f) );
+	// (a rejected one leaves the slot routed where it was, & the routing only changes at the next block)
+	DFX_CHECK( engine->setModulation(1, BufferOverride::kSmooth, 0.5f, 0.5f, 0.0f, 0.0f) );
+	DFX_CHECK( !engine->setModulation(1, BufferOverride::kTempo, 0.5f, 0.5f, 0.0f, 0.0f) );
+	engine->setSampleRate(44100.0);
+	engine->activate();
+	std::vector<float> input(256, 0.25f), output(input.size());
+	runBlock(engine, &input, &output, 0, (long)input.size());
+	DFX_CHECK( engine->isModulated(BufferOverride::kSmooth) );
+	DFX_CHECK( engine->setModulation(1, kNoModDestination, 0.5f, 0.5f, 0.0f, 0.0f) );
+	DFX_CHECK( engine->isModulated(BufferOverride::kSmooth) );
+	runBlock(engine, &input, &output, 0, (long)input.size());
+	DFX_CHECK( !engine->isModulated(BufferOverride::kSmooth) );
+	delete engine;
+}
+
+
+//-----------------------------------------------------------------------------
+// the extra layers crossfade by the smoothing with the modulation matrix applied, just like the main layer
+// (so with the parameter at 0, any of it that they do has to come from there)
+static void testLayerSmoothing()
+{
+	getTestHost().timeInfo = NULL;
+	BufferOverride *engine = new BufferOverride;
+	engine->setSampleRate(44100.0);
+	engine->setParameterValue(BufferOverride::kBufferTempoSync, 0.0f);
+	engine->setParameterValue(BufferOverride::kDivisor, bufferDivisorUnscaled(8.0f));
+	engine->setParameterValue(BufferOverride::kSmooth, 0.0f);
+	engine->setNumExtraLayers(1);
+	engine->setLayer(0, bufferDivisorUnscaled(5.0f), 0.0f, 0.0f, 0.0f, 0.0f, 0.5f);
+	engine->setModulation(0, BufferOverride::kSmooth, 0.6f, 0.6f, 0.0f, 0.0f);
+	BufferOverrideSegment *segments;
+	long numSegments = engine->makeSegmentList(44100 * 4, &segments);
+	long numMainFades = 0, numLayerFades = 0;
+	for (long i = 0; i < numSegments; i++) {
+		DFX_CHECK( segments[i].numReads == 2 );
+		if (segments[i].reads[0].fadeLength > 0)
+			numMainFades++;
+		if (segments[i].reads[1].fadeLength > 0)
+			numLayerFades++;
+	}
+	free(segments);
+	DFX_CHECK( numMainFades > 0 );
+	DFX_CHECK_MSG( numLayerFades > 0, "the layer never crossfaded" );
+	delete engine;
+}
+
+
+#pragma mark _________state_________
+
+//-----------------------------------------------------------------------------
+// sets up everything that the state chunk holds, at random
+static void setUpState(BufferOverride *engine, DFXtestRandom *random)
+{
+	for (long p = 0; p < 4; p++) {
+		engine->setProgram(random->nextLong(NUM_PROGRAMS));
+		for (long i = 0; i < 4; i++)
+			engine->setParameterValue(random->nextLong(BufferOverride::kMidiMode), random->nextFloat());
+	}
+	long destinations[4] = { BufferOverride::kDivisor, BufferOverride::kBuffer, BufferOverride::kSmooth, BufferOverride::kDryWetMix };
+	for (long slot = 0; slot < 2; slot++)
+		engine->setModulation(random->nextLong(NUM_MOD_SLOTS), destinations[random->nextLong(4)], random->nextFloat(), random->nextFloat() * 0.5f, random->nextFloat(), random->nextFloat());
+	long numLayers = 1 + random->nextLong(MAX_EXTRA_LAYERS);
+	engine->setNumExtraLayers(numLayers);
+	for (long n = 0; n < numLayers; n++)
+		engine->setLayer(n, random->nextFloat(), random->nextFloat(), random->nextFloat() * 0.5f, random->nextFloat(), random->nextFloat(), random->nextFloat());
+	engine->setCaptureFormat(1 + random->nextLong(numCaptureFormats - 1), 1.0f + random->nextFloat());
+}
+
+//-----------------------------------------------------------------------------
+// The state, encoded & given to a new engine through setState(), goes in at d_activate() & comes
+// back out the same, & the new engine sounds just like the old one.  One that's already running
+// takes it at its next block, except for the capture format, which waits for d_activate().
+// A chunk that's no good leaves everything alone.
+static void testStateRoundTrip(uint64_t seed)
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(seed);
+	std::vector<float> input(44100 * 3), originalOutput(input.size()), restoredOutput(input.size());
+	makeInput(&input, &random);
+
+	BufferOverride *original = new BufferOverride;
+	original->setSampleRate(44100.0);
+	original->setRandomSeed((uint32_t)seed);
+	setUpState(original, &random);
+	original->deactivate();
+	original->activate();
+	BufferOverrideStateChunk originalChunk, chunk;
+	original->getStateChunk(&originalChunk);
+	std::vector<char> text(STATE_CHUNK_TEXT_SIZE);
+	encodeStateChunk(&originalChunk, &text[0]);
+	DFX_CHECK( strlen(&text[0]) == (STATE_CHUNK_TEXT_SIZE - 1) );
+
+	BufferOverride *restored = new BufferOverride;
+	restored->setSampleRate(44100.0);
+	restored->setRandomSeed((uint32_t)seed);
+	restored->setState(STATE_CHUNK_KEY, &text[0]);
+	restored->getStateChunk(&chunk);
+	DFX_CHECK_MSG( memcmp(&chunk, &originalChunk, sizeof(chunk)) != 0, "seed %llu:  the state went in before d_activate()", (unsigned long long)seed );
+	restored->deactivate();
+	restored->activate();
+	restored->getStateChunk(&chunk);
+	DFX_CHECK_MSG( memcmp(&chunk, &originalChunk, sizeof(chunk)) == 0, "seed %llu:  the state didn't come back the same", (unsigned long long)seed );
+
+	for (long start = 0; start < (long)input.size(); start += 512) {
+		long numSamples = (start + 512 <= (long)input.size()) ? 512 : ((long)input.size() - start);
+		runBlock(original, &input, &originalOutput, start, numSamples);
+		runBlock(restored, &input, &restoredOutput, start, numSamples);
+	}
+	long first;
+	long numDifferences = countDifferences(&originalOutput, &restoredOutput, &first);
+	DFX_CHECK_MSG( numDifferences == 0, "seed %llu:  %ld samples differ after the state round trip, starting at %ld", (unsigned long long)seed, numDifferences, first );
+
+	// loaded while running (& a slot only keeps its own copy once it's been changed from the factory preset,
+	// apart from the current one, which always has one)
+	BufferOverride *running = new BufferOverride;
+	running->setSampleRate(44100.0);
+	size_t freshUsage = running->getMemoryUsage();
+	running->setProgram(1);
+	DFX_CHECK( running->getMemoryUsage() == freshUsage );
+	running->setParameterValue(BufferOverride::kDivisor, 0.77f);
+	DFX_CHECK( running->getMemoryUsage() == freshUsage );
+	running->setProgram(2);
+	DFX_CHECK( running->getMemoryUsage() == (freshUsage + sizeof(BufferOverrideProgram)) );
+	running->deactivate();
+	running->activate();
+	runBlock(running, &input, &restoredOutput, 0, 512);
+	running->setState(STATE_CHUNK_KEY, &text[0]);
+	runBlock(running, &input, &restoredOutput, 512, 512);
+	running->getStateChunk(&chunk);
+	DFX_CHECK( memcmp(&chunk, &originalChunk, sizeof(chunk)) == 0 );
+	DFX_CHECK( running->getCaptureFormat() == kCaptureFloat32 );
+	running->deactivate();
+	running->activate();
+	DFX_CHECK( running->getCaptureFormat() == originalChunk.captureFormat );
+	running->getStateChunk(&chunk);
+	DFX_CHECK( memcmp(&chunk, &originalChunk, sizeof(chunk)) == 0 );
+
+	// bad ones
+	BufferOverrideStateChunk badChunk = originalChunk;
+	badChunk.modDestination[0] = BufferOverride::kTempo;
+	DFX_CHECK( !restored->setStateChunk(&badChunk) );
+	badChunk = originalChunk;
+	badChunk.layerGain[1] = -1.0f;
+	DFX_CHECK( !restored->setStateChunk(&badChunk) );
+	badChunk = originalChunk;
+	badChunk.version = STATE_CHUNK_VERSION - 1;
+	DFX_CHECK( !restored->setStateChunk(&badChunk) );
+	text[7] = 'x';
+	restored->setProgram(0);
+	restored->setState(STATE_CHUNK_KEY, &text[0]);
+	restored->deactivate();
+	restored->activate();
+	restored->getStateChunk(&chunk);
+	DFX_CHECK( chunk.currentProgram == 0 );
+
+	delete original;
+	delete restored;
+	delete running;
+}
+
+
+#pragma mark _________telemetry_________
+
+//-----------------------------------------------------------------------------
+// the GUI gets an outline of what each minibuffer played back, which (for input that flips between
+// +0.5 & -0.5 every sample) is the whole swing wherever there's more than one sample
+static void testTelemetry()
+{
+	getTestHost().timeInfo = NULL;
+	BufferOverride *engine = new BufferOverride;
+	engine->setSampleRate(44100.0);
+	engine->setParameterValue(BufferOverride::kBufferTempoSync, 0.0f);
+	engine->setParameterValue(BufferOverride::kDivisor, 0.4f);
+	engine->deactivate();
+	engine->activate();
+
+	std::vector<float> input(44100), output(input.size());
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = (i & 1) ? -0.5f : 0.5f;
+	long numRecords = 0, numFullSwings = 0;
+	BufferOverrideTelemetry record;
+	for (long start = 0; (start + 256) <= (long)input.size(); start += 256) {
+		runBlock(engine, &input, &output, start, 256);
+		while (engine->readTelemetry(&record)) {
+			numRecords++;
+			for (long point = 0; point < TELEMETRY_SUMMARY_POINTS; point++) {
+				DFX_CHECK( record.summaryMin[point] <= record.summaryMax[point] );
+				DFX_CHECK( (record.summaryMin[point] >= -0.51f) && (record.summaryMax[point] <= 0.51f) );
+				if ( (record.summaryMin[point] < -0.49f) && (record.summaryMax[point] > 0.49f) )
+					numFullSwings++;
+			}
+		}
+	}
+	DFX_CHECK( numRecords > 0 );
+	DFX_CHECK( numFullSwings > 0 );
+	delete engine;
+
+	// & a short spike every 50 samples shows up in (nearly) every point that has captured audio in it, since
+	// the capture keeps the peaks of all of it (only the few points from the 1-sample forced buffer at the
+	// start, & from wherever a point is narrower than the spikes' spacing, can go without)
+	engine = new BufferOverride;
+	engine->setSampleRate(44100.0);
+	engine->setParameterValue(BufferOverride::kBufferTempoSync, 0.0f);
+	engine->setParameterValue(BufferOverride::kDivisor, bufferDivisorUnscaled(2.0f));
+	engine->deactivate();
+	engine->activate();
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = ((i % 50) == 17) ? 0.9f : 0.1f;
+	long numCapturedPoints = 0, numSpikes = 0;
+	for (long start = 0; (start + 256) <= (long)input.size(); start += 256) {
+		runBlock(engine, &input, &output, start, 256);
+		while (engine->readTelemetry(&record)) {
+			for (long point = 0; point < TELEMETRY_SUMMARY_POINTS; point++) {
+				if (record.summaryMax[point] == 0.0f)
+					continue;
+				numCapturedPoints++;
+				DFX_CHECK( record.summaryMin[point] == 0.1f );
+				if (record.summaryMax[point] == 0.9f)
+					numSpikes++;
+			}
+		}
+	}
+	DFX_CHECK( numCapturedPoints > 100 );
+	DFX_CHECK_MSG( numSpikes >= (numCapturedPoints * 95 / 100), "%ld of %ld points caught the spikes", numSpikes, numCapturedPoints );
+	delete engine;
+}
+
+
+#pragma mark _________capture_reach_________
+
+//-----------------------------------------------------------------------------
+// At divisor 16 with the default smoothing, less of each forced buffer gets captured than with all of
+// the smoothing, where the next forced buffer's crossfade could read all the way to the end of it.
+// (What was captured shows up in the history that each checkpoint saves.)
+static void testCaptureReach()
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(5);
+	std::vector<float> input(44100 * 4), output(input.size());
+	makeInput(&input, &random);
+
+	const float smoothValues[2] = { 0.09f, 1.0f };
+	size_t historyBytes[2];
+	for (long s = 0; s < 2; s++) {
+		BufferOverride *engine = new BufferOverride;
+		engine->setSampleRate(44100.0);
+		engine->setParameterValue(BufferOverride::kDivisor, bufferDivisorUnscaled(16.0f));
+		engine->setParameterValue(BufferOverride::kSmooth, smoothValues[s]);
+		engine->deactivate();
+		engine->activate();
+		engine->setCheckpointInterval(1);
+		for (long start = 0; start < (long)input.size(); start += 441)
+			runBlock(engine, &input, &output, start, 441);
+		long numCheckpoints = engine->getNumCheckpoints();
+		DFX_CHECK( numCheckpoints > 10 );
+		size_t usage = engine->getMemoryUsage();
+		engine->setCheckpointInterval(0);
+		historyBytes[s] = usage - engine->getMemoryUsage() - (numCheckpoints * (sizeof(BufferOverrideCheckpoint) + 1));
+		delete engine;
+	}
+	DFX_CHECK_MSG( (historyBytes[0] * 4) < (historyBytes[1] * 3), "%lu bytes of history with the default smoothing, %lu with all of it",
+				(unsigned long)historyBytes[0], (unsigned long)historyBytes[1] );
+}
+
+
+#pragma mark _________idle_release_________
+
+//-----------------------------------------------------------------------------
+// An instance that gives its capture buffers back while the input is silent comes out the same as one that
+// keeps them, when it gets them back from the pool's spares.  If the spares have been freed by then, it
+// only gets the dry part of the mix until the housekeeping thread has allocated some for it, & that
+// doesn't take long.  Idle instances past the number of slots in the pool all get to let go of theirs too.
+static void testIdleRelease()
+{
+	getTestHost().timeInfo = NULL;
+	const double sampleRate = 8000.0;	// (so that the idle stretches don't take forever)
+	const long blockSize = 512;
+	const long burstLength = 40 * blockSize;
+	// (2 * SUPER_MAX_BUFFER, & then some, in whole blocks)
+	const long idleLength = (((2 * (long)((sampleRate / MIN_ALLOWABLE_BPS) * 4.0f)) / blockSize) + 4) * blockSize;
+	CapturePool *pool = CapturePool::get();
+
+	BufferOverride *engines[2];
+	for (long e = 0; e < 2; e++) {
+		engines[e] = new BufferOverride;
+		engines[e]->setSampleRate(sampleRate);
+		engines[e]->setParameterValue(BufferOverride::kTempo, 0.5f);
+		engines[e]->deactivate();
+		engines[e]->activate();
+	}
+	engines[1]->setIdleRelease(blockSize);
+	const size_t activeUsage = engines[1]->getMemoryUsage();
+
+	// a burst, silence, another burst, more silence, & then the last burst, after the pool has been emptied
+	DFXtestRandom random(11);
+	std::vector<float> burst(burstLength);
+	makeInput(&burst, &random);
+	std::vector<float> input;
+	for (long section = 0; section < 5; section++) {
+		if (section & 1)
+			input.insert(input.end(), idleLength, 0.0f);
+		else
+			input.insert(input.end(), burst.begin(), burst.end());
+	}
+	const long lastBurstStart = (long)input.size() - burstLength;
+	std::vector<float> keptOutput(input.size()), releasedOutput(input.size());
+
+	bool released = false;
+	long numStarvedBlocks = 0;
+	for (long start = 0; start < (long)input.size(); start += blockSize) {
+		if (start == lastBurstStart) {
+			DFX_CHECK( memcmp(&keptOutput[0], &releasedOutput[0], start * sizeof(float)) == 0 );
+			DFX_CHECK( engines[1]->getMemoryUsage() < activeUsage );
+			pool->trim(0);
+		}
+		runBlock(engines[0], &input, &keptOutput, start, blockSize);
+		runBlock(engines[1], &input, &releasedOutput, start, blockSize);
+		if (engines[1]->getMemoryUsage() < activeUsage) {
+			released = true;
+			if (start >= lastBurstStart) {
+				numStarvedBlocks++;
+				// (give the housekeeping thread a chance to get to it)
+				usleep(2 * CAPTURE_POOL_HOUSEKEEPING_MS * 1000);
+			}
+		}
+	}
+	DFX_CHECK( released );
+	DFX_CHECK_MSG( (numStarvedBlocks >= 1) && (numStarvedBlocks <= 10), "%ld starved blocks", numStarvedBlocks );
+	DFX_CHECK( engines[1]->getMemoryUsage() == activeUsage );
+	for (long e = 0; e < 2; e++)
+		delete engines[e];
+
+	// more idle instances than the pool has slots
+	const long numInstances = CAPTURE_POOL_SLOTS + CAPTURE_POOL_SPARES;
+	std::vector<BufferOverride*> instances(numInstances);
+	for (long i = 0; i < numInstances; i++) {
+		instances[i] = new BufferOverride;
+		instances[i]->setSampleRate(sampleRate);
+		instances[i]->setIdleRelease(blockSize);
+		instances[i]->deactivate();
+		instances[i]->activate();
+	}
+	std::vector<float> silence(4096), output(silence.size());
+	long numStillHolding = numInstances;
+	for (long round = 0; (round < 1000) && (numStillHolding > 0); round++) {
+		numStillHolding = 0;
+		for (long i = 0; i < numInstances; i++) {
+			runBlock(instances[i], &silence, &output, 0, (long)silence.size());
+			if (instances[i]->getMemoryUsage() >= activeUsage)
+				numStillHolding++;
+		}
+		if ( (round * (long)silence.size()) > idleLength )
+			usleep(2 * CAPTURE_POOL_HOUSEKEEPING_MS * 1000);
+	}
+	DFX_CHECK_MSG( numStillHolding == 0, "%ld idle instances kept their buffers", numStillHolding );
+	// (the last of them only just gave theirs back, so the housekeeping thread might not have trimmed the pool yet)
+	for (long wait = 0; (wait < 100) && (pool->getNumSpares() > (CAPTURE_POOL_SPARES + 1)); wait++)
+		usleep(CAPTURE_POOL_HOUSEKEEPING_MS * 1000);
+	DFX_CHECK_MSG( pool->getNumSpares() <= (CAPTURE_POOL_SPARES + 1), "%ld spares", (long)pool->getNumSpares() );
+	for (long i = 0; i < numInstances; i++)
+		delete instances[i];
+	DFX_CHECK( pool->getNumSpares() <= CAPTURE_POOL_SPARES );
+}
+
+
+#pragma mark _________parameter_display_________
+
+//-----------------------------------------------------------------------------
+// What getParameterDisplay() caches is always what it would have worked out from scratch:  it goes
+// along with each new value, & with the tempo sync switching the rates between numbers & tempo rates
+// (along with their units), & back.
+static void testDisplayCache()
+{
+	getTestHost().timeInfo = NULL;
+	DFXtestRandom random(11);
+	BufferOverride *engine = new BufferOverride;
+	char text[PARAMETER_DISPLAY_LENGTH], expected[PARAMETER_DISPLAY_LENGTH];
+	for (long trial = 0; trial < 300; trial++) {
+		long index = random.nextLong(BufferOverride::NUM_PARAMETERS);
+		// (the same value again some of the time, which is when the cache gets used)
+		if (random.nextLong(3) != 0)
+			engine->setParameterValue(index, random.nextFloat());
+		engine->getParameterDisplay(index, text);
+		BufferOverride *fresh = new BufferOverride;
+		for (long i = 0; i < BufferOverride::NUM_PARAMETERS; i++)
+			fresh->setParameterValue(i, engine->getParameterValue(i));
+		fresh->getParameterDisplay(index, expected);
+		DFX_CHECK_MSG( strcmp(text, expected) == 0, "parameter %ld:  the cache said \"%s\" instead of \"%s\"", index, text, expected );
+		delete fresh;
+	}
+
+	for (long index = 0; index < BufferOverride::NUM_PARAMETERS; index++) {
+		const BufferOverrideParameterInfo *info = BufferOverride::getParameterInfo(index);
+		if (info->tempoSyncParameter < 0)
+			continue;
+		char numberText[PARAMETER_DISPLAY_LENGTH], label[PARAMETER_DISPLAY_LENGTH];
+		engine->setParameterValue(index, 0.3f);
+		engine->setParameterValue(info->tempoSyncParameter, 0.0f);
+		engine->getParameterDisplay(index, numberText);
+		engine->getParameterLabel(index, label);
+		DFX_CHECK( strcmp(label, info->unit) == 0 );
+		engine->setParameterValue(info->tempoSyncParameter, 1.0f);
+		engine->getParameterDisplay(index, text);
+		engine->getParameterLabel(index, label);
+		DFX_CHECK_MSG( strcmp(text, TempoRateTable::getDisplay(0.3f)) == 0, "parameter %ld shows \"%s\" in tempo sync", index, text );
+		DFX_CHECK( strcmp(text, numberText) != 0 );
+		DFX_CHECK( strcmp(label, info->tempoSyncUnit) == 0 );
+		engine->setParameterValue(info->tempoSyncParameter, 0.0f);
+		engine->getParameterDisplay(index, text);
+		DFX_CHECK_MSG( strcmp(text, numberText) == 0, "parameter %ld shows \"%s\" out of tempo sync", index, text );
+	}
+	delete engine;
+}
+
+
+#pragma mark _________shared_transport_________
+
+//-----------------------------------------------------------------------------
+// Two instances in the same host cycles:  once the transport is rolling, the first one to run asks the
+// host & the second one takes what it found out from SharedTransport, until the transport jumps or stops.
+// Both come out the same as an instance in reference mode, which always asks the host.
+static void testSharedTransport()
+{
+	TestTimeline timeline(44100.0, 123.0);
+	getTestHost().canDoTimeInfo = 1;
+	getTestHost().timeInfo = &(timeline.timeInfo);
+	DFXtestRandom random(9);
+
+	BufferOverride *engines[3];	// (the first, the second, & the reference)
+	for (long e = 0; e < 3; e++) {
+		engines[e] = new BufferOverride;
+		engines[e]->setSampleRate(44100.0);
+		engines[e]->setParameterValue(BufferOverride::kBufferTempoSync, 1.0f);
+		engines[e]->setParameterValue(BufferOverride::kBuffer, 0.6f);
+		engines[e]->setParameterValue(BufferOverride::kDivisor, 0.4f);
+		engines[e]->setParameterValue(BufferOverride::kTempo, 0.0f);	// (the host's)
+		engines[e]->setReferenceMode(e == 2);
+		engines[e]->deactivate();
+		engines[e]->activate();
+	}
+
+	const long blockSize = 512, numCycles = 240;
+	std::vector<float> input(blockSize * numCycles);
+	std::vector<float> outputs[3];
+	for (long e = 0; e < 3; e++)
+		outputs[e].resize(input.size());
+	makeInput(&input, &random);
+	long numSharedCycles = 0;
+	bool wasPlaying = false;
+	for (long cycle = 0; cycle < numCycles; cycle++) {
+		bool jumped = (cycle == 90) || (cycle == 200);
+		if (jumped)
+			timeline.jump(floor(random.nextFloat() * 1.0e6f));
+		else if (cycle == 150)
+			timeline.stop();
+		bool steady = wasPlaying && !(timeline.timeInfo.flags & kVstTransportChanged);
+		long hostCalls[3];
+		for (long e = 0; e < 3; e++) {
+			long callsBefore = getTestHost().timeInfoCalls;
+			runBlock(engines[e], &input, &outputs[e], cycle * blockSize, blockSize);
+			hostCalls[e] = getTestHost().timeInfoCalls - callsBefore;
+		}
+		if (steady) {
+			DFX_CHECK_MSG( (hostCalls[0] == 1) && (hostCalls[1] == 0), "cycle %ld:  the instances asked the host %ld & %ld times",
+						cycle, hostCalls[0], hostCalls[1] );
+			numSharedCycles++;
+		}
+		// (after a jump, the snapshot that the first one publishes isn't where the second one expects to be,
+		// so it asks for itself)
+		if (jumped)
+			DFX_CHECK_MSG( hostCalls[1] == 1, "cycle %ld:  the second instance didn't ask the host after a jump", cycle );
+		DFX_CHECK( hostCalls[2] == 1 );
+		wasPlaying = (timeline.timeInfo.flags & kVstTransportPlaying);
+		timeline.advance(blockSize);
+	}
+	DFX_CHECK( numSharedCycles > (numCycles / 2) );
+	for (long e = 0; e < 2; e++) {
+		long first;
+		long numDifferences = countDifferences(&outputs[e], &outputs[2], &first);
+		DFX_CHECK_MSG( numDifferences == 0, "instance %ld:  %ld samples differ from the reference, starting at %ld", e, numDifferences, first );
+	}
+	for (long e = 0; e < 3; e++)
+		delete engines[e];
+	getTestHost().timeInfo = NULL;
+}
+
+
+#pragma mark _________baseline_________
+
+//-----------------------------------------------------------------------------
+// The original engine can't do everything that this one can, & some of what it did do has changed on
+// purpose, so here's everywhere that the two are allowed to differ, & how far:
+//    - the crossfade gains & the order that things get added up in (see kBaselineTolerance)
+//    - MIDI, which was never hooked up in the original.  With no MIDI coming in, the pitchbend range &
+//      nudge mode change nothing, & they get automated along with everything else.  Trigger mode with
+//      no note held turns the effect off until the divisor gets changed by hand, which is the original
+//      with its divisor at 0, so that's what the original gets for that stretch.  The notes & the
+//      pitchbend themselves only have this engine's reference mode to go by (see testReferenceMode()).
+//    - the forced buffer sizes are worked out in double precision, & in tempo sync they carry their
+//      fractions over.  Each one is within a sample of the original's (& where the original drifts
+//      off of the tempo by the fraction that it drops every time, these stay within a sample of it),
+//      which testBaselineBufferSizes() checks for any buffer size, tempo & sampling rate.  Everywhere
+//      else, the buffer size sticks to the ones that come out the same (see pickBufferValue()).
+//    - the LFOs have a different phase accumulator & a different random number generator, & they're
+//      only worked out at control rate.  testBaselineLFOs() holds the values that they feed into the
+//      divisor & forced buffer size up against the original's, with their depths turned up;
+//      everywhere else, the depths stay at 0.
+// The original also captured all of every forced buffer, so the next one's opening crossfade could always
+// go as long as it liked.  This one stops capturing where that crossfade can't reach with the settings as they
+// are (see getMaxNextSmooth()), so if automation lengthens it after capturing has stopped, it gets cut short.
+// A second engine has the buffer size & smoothing routed in the modulation matrix at a depth far too small to
+// change them (kCaptureAllDepth), but it keeps it capturing everything, & that one is what gets held to the original.  The
+// engine as it is only differs from that one in those cut-short crossfades:  each one is a run of samples
+// no longer than the longest forced buffer, & there's at most one of them after each change to the buffer
+// size, the tempo sync or the smoothing.
+
+const double kBaselineSampleRates[] = { 44100.0, 48000.0, 96000.0 };
+const long kNumBaselineSampleRates = sizeof(kBaselineSampleRates) / sizeof(kBaselineSampleRates[0]);
+const float kCaptureAllDepth = 1.0e-30f;
+// tempos in BPM that come out exact in beats per second
+const double kBaselineTempos[] = { 60.0, 90.0, 120.0, 150.0, 180.0, 240.0 };
+const long kNumBaselineTempos = sizeof(kBaselineTempos) / sizeof(kBaselineTempos[0]);
+
+// a kBuffer value for the current tempo sync mode & tempo where both engines get the same forced buffer size
+static float pickBufferValue(DFXtestRandom *random, bool tempoSync, double tempoBPS, double sampleRate)
+{
+	while (true) {
+		float value = random->nextFloat();
+		if (tempoSync) {
+			long numerator, denominator;
+			TempoRateTable::getRatio(value, &numerator, &denominator);
+			double cycles = sampleRate * (double)denominator / (tempoBPS * (double)numerator);
+			long floatSize = (long) ( (float)sampleRate / ((float)tempoBPS * TempoRateTable::getScalar(value)) );
+			if ( (cycles == floor(cycles)) && ((double)floatSize == cycles) && (floatSize <= sampleRate * 4.0) )
+				return value;
+		} else {
+			float floatSampleRate = (float)sampleRate;
+			long floatSize = (long) (forcedBufferSizeScaled(value) * floatSampleRate * 0.001f);
+			long doubleSize = (long) (forcedBufferSizeScaled(value) * sampleRate * 0.001f);
+			if (floatSize == doubleSize)
+				return value;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+static void testAgainstBaseline(uint64_t seed)
+{
+	DFXtestRandom random(seed * 104729);
+	// the host's tempo, or the user's at its top (which is 480 BPM, also exact)
+	bool userTempo = (random.nextLong(4) == 0);
+	double tempo = userTempo ? tempoScaled(1.0f) : kBaselineTempos[random.nextLong(kNumBaselineTempos)];
+	double sampleRate = kBaselineSampleRates[random.nextLong(kNumBaselineSampleRates)];
+	TestTimeline timeline(sampleRate, tempo);
+	getTestHost().canDoTimeInfo = userTempo ? 0 : 1;
+	getTestHost().timeInfo = &(timeline.timeInfo);
+
+	BufferOverride *engines[2];	// (the engine, & the one that captures everything)
+	for (long e = 0; e < 2; e++) {
+		engines[e] = new BufferOverride;
+		engines[e]->setSampleRate(sampleRate);
+	}
+	engines[1]->setModulation(0, BufferOverride::kBuffer, 0.5f, kCaptureAllDepth, 0.0f, 0.0f);
+	engines[1]->setModulation(1, BufferOverride::kSmooth, 0.5f, kCaptureAllDepth, 0.0f, 0.0f);
+	BufferOverrideBaseline::BufferOverride *baseline = new BufferOverrideBaseline::BufferOverride(sampleRate, getTestHost().canDoTimeInfo);
+	baseline->setTimeInfo(&(timeline.timeInfo));
+
+	// (the two Parameters enums are the same)
+	float parameters[BufferOverride::NUM_PARAMETERS];
+	bool tempoSync = (random.nextLong(2) == 0);
+	parameters[BufferOverride::kDivisor] = random.nextFloat();
+	parameters[BufferOverride::kBuffer] = pickBufferValue(&random, tempoSync, tempo / 60.0, sampleRate);
+	parameters[BufferOverride::kBufferTempoSync] = tempoSync ? 1.0f : 0.0f;
+	parameters[BufferOverride::kBufferInterrupt] = (float)random.nextLong(2);
+	parameters[BufferOverride::kDivisorLFOrate] = random.nextFloat();
+	parameters[BufferOverride::kDivisorLFOdepth] = 0.0f;
+	parameters[BufferOverride::kDivisorLFOshape] = random.nextFloat();
+	parameters[BufferOverride::kDivisorLFOtempoSync] = (float)random.nextLong(2);
+	parameters[BufferOverride::kBufferLFOrate] = random.nextFloat();
+	parameters[BufferOverride::kBufferLFOdepth] = 0.0f;
+	parameters[BufferOverride::kBufferLFOshape] = random.nextFloat();
+	parameters[BufferOverride::kBufferLFOtempoSync] = (float)random.nextLong(2);
+	parameters[BufferOverride::kSmooth] = random.nextFloat();
+	parameters[BufferOverride::kDryWetMix] = random.nextFloat();
+	parameters[BufferOverride::kPitchbend] = random.nextFloat();
+	parameters[BufferOverride::kMidiMode] = (float)random.nextLong(2);
+	parameters[BufferOverride::kTempo] = userTempo ? 1.0f : 0.0f;
+	for (long i = 0; i < BufferOverride::NUM_PARAMETERS; i++) {
+		for (long e = 0; e < 2; e++)
+			engines[e]->setParameterValue(i, parameters[i]);
+		baseline->d_setParameterValue(i, parameters[i]);
+	}
+	for (long e = 0; e < 2; e++) {
+		engines[e]->deactivate();
+		engines[e]->activate();
+	}
+	// (activating forgets about the divisor having been changed by hand, so trigger mode starts out holding it off)
+	bool divisorHeldOff = onOffTest(parameters[BufferOverride::kMidiMode]);
+	if (divisorHeldOff)
+		baseline->d_setParameterValue(BufferOverride::kDivisor, 0.0f);
+	baseline->d_deactivate();
+	baseline->d_activate();
+
+	const long numSamples = 200000;
+	std::vector<float> input(numSamples), output(numSamples), fullOutput(numSamples), baselineOutput(numSamples);
+	makeInput(&input, &random);
+	long numLengtheningChanges = 0, longestForcedBuffer = 0;
+	BufferOverrideTelemetry record;
+
+	for (long position = 0; position < numSamples; ) {
+		long numFrames = 1 + random.nextLong( (random.nextLong(4) == 0) ? 16 : 1024 );
+		if (numFrames > (numSamples - position))
+			numFrames = numSamples - position;
+		// automation, of whatever the two are supposed to agree on
+		if (random.nextLong(3) == 0) {
+			long index = random.nextLong(BufferOverride::kTempo);
+			float value = random.nextFloat();
+			if ( (index == BufferOverride::kDivisorLFOdepth) || (index == BufferOverride::kBufferLFOdepth) )
+				value = 0.0f;
+			else if ( (index == BufferOverride::kBufferTempoSync) || (index == BufferOverride::kBufferInterrupt)
+						|| (index == BufferOverride::kDivisorLFOtempoSync) || (index == BufferOverride::kBufferLFOtempoSync)
+						|| (index == BufferOverride::kMidiMode) )
+				value = (float)random.nextLong(2);
+			// (the buffer size has to stay one that works in the current sync mode)
+			if ( (index == BufferOverride::kBuffer) || (index == BufferOverride::kBufferTempoSync) ) {
+				parameters[index] = value;
+				for (long e = 0; e < 2; e++)
+					engines[e]->setParameterValue(index, value);
+				baseline->d_setParameterValue(index, value);
+				index = BufferOverride::kBuffer;
+				value = pickBufferValue(&random, onOffTest(parameters[BufferOverride::kBufferTempoSync]), tempo / 60.0, sampleRate);
+			}
+			if ( (index == BufferOverride::kBuffer) || (index == BufferOverride::kSmooth) )
+				numLengtheningChanges++;
+			// (switching into trigger mode holds the divisor off again, & changing it by hand lets it go)
+			if (index == BufferOverride::kMidiMode)
+				divisorHeldOff = onOffTest(value) && (divisorHeldOff || !onOffTest(parameters[index]));
+			else if (index == BufferOverride::kDivisor)
+				divisorHeldOff = false;
+			parameters[index] = value;
+			for (long e = 0; e < 2; e++)
+				engines[e]->setParameterValue(index, value);
+			baseline->d_setParameterValue(index, value);
+			if ( (index == BufferOverride::kMidiMode) || (index == BufferOverride::kDivisor) )
+				baseline->d_setParameterValue(BufferOverride::kDivisor, divisorHeldOff ? 0.0f : parameters[BufferOverride::kDivisor]);
+		}
+		if ( !userTempo && (random.nextLong(150) == 0) )
+			timeline.jump(floor(random.nextFloat() * 1.0e6f));
+
+		runBlock(engines[0], &input, &output, position, numFrames);
+		runBlock(engines[1], &input, &fullOutput, position, numFrames);
+		while (engines[0]->readTelemetry(&record)) {
+			if (record.forcedBufferSize > longestForcedBuffer)
+				longestForcedBuffer = record.forcedBufferSize;
+		}
+		float *inputs[1] = { &input[position] };
+		float *outputs[1] = { &baselineOutput[position] };
+		memset(outputs[0], 0, numFrames * sizeof(float));
+		baseline->d_run(inputs, outputs, numFrames);
+		timeline.advance(numFrames);
+		position += numFrames;
+	}
+
+	float maxDifference = 0.0f;
+	long first = -1;
+	double energy = 0.0;
+	for (long i = 0; i < numSamples; i++) {
+		float difference = fabsf(fullOutput[i] - baselineOutput[i]);
+		if ( (difference > kBaselineTolerance) && (first < 0) )
+			first = i;
+		maxDifference = fmaxf(difference, maxDifference);
+		energy += fabs(baselineOutput[i]);
+	}
+	DFX_CHECK_MSG( maxDifference <= kBaselineTolerance, "seed %lu:  off from the original engine by as much as %g, starting at %ld",
+				(unsigned long)seed, maxDifference, first );
+	DFX_CHECK( energy > 0.0 );
+
+	// & the cut-short crossfades
+	long numRuns = 0, longestRun = 0;
+	for (long i = 0; i < numSamples; ) {
+		if (output[i] == fullOutput[i]) {
+			i++;
+			continue;
+		}
+		long runStart = i;
+		while ( (i < numSamples) && (output[i] != fullOutput[i]) )
+			i++;
+		numRuns++;
+		if ((i - runStart) > longestRun)
+			longestRun = i - runStart;
+	}
+	DFX_CHECK_MSG( (numRuns <= numLengtheningChanges) && (longestRun <= longestForcedBuffer),
+				"seed %lu:  %ld cut-short crossfades (up to %ld samples) for %ld changes (& forced buffers up to %ld samples)",
+				(unsigned long)seed, numRuns, longestRun, numLengtheningChanges, longestForcedBuffer );
+
+	for (long e = 0; e < 2; e++)
+		delete engines[e];
+	delete baseline;
+}
+
+//-----------------------------------------------------------------------------
+// the forced buffer sizes for any buffer size, against the original's way of working them out
+static void testBaselineBufferSizes(uint64_t seed)
+{
+	DFXtestRandom random(seed * 15485863);
+	double sampleRate = kBaselineSampleRates[random.nextLong(kNumBaselineSampleRates)];
+	double tempo = 60.0 + (random.nextFloat() * 180.0f);	// (nowhere in particular)
+	double tempoBPS = tempo / 60.0;
+	bool tempoSync = (random.nextLong(2) == 0);
+	float value;
+	double exactSize;
+	long originalSize;
+	do {
+		value = random.nextFloat();
+		if (tempoSync) {
+			long numerator, denominator;
+			TempoRateTable::getRatio(value, &numerator, &denominator);
+			exactSize = sampleRate * (double)denominator / (tempoBPS * (double)numerator);
+			originalSize = (long) ( (float)sampleRate / ((float)tempoBPS * TempoRateTable::getScalar(value)) );
+		} else {
+			exactSize = floor(forcedBufferSizeScaled(value) * sampleRate * 0.001f);
+			originalSize = (long) (forcedBufferSizeScaled(value) * (float)sampleRate * 0.001f);
+		}
+	// (long enough that a block's worth of them fits in the telemetry ring)
+	} while ( (exactSize < 16.0) || (exactSize > (sampleRate * 2.0)) );
+
+	TestTimeline timeline(sampleRate, tempo);
+	getTestHost().canDoTimeInfo = 1;
+	getTestHost().timeInfo = &(timeline.timeInfo);
+	BufferOverride *engine = new BufferOverride;
+	engine->setSampleRate(sampleRate);
+	engine->setParameterValue(BufferOverride::kDivisor, 0.0f);	// (so that each forced buffer is one minibuffer)
+	engine->setParameterValue(BufferOverride::kBuffer, value);
+	engine->setParameterValue(BufferOverride::kBufferTempoSync, tempoSync ? 1.0f : 0.0f);
+	engine->deactivate();
+	engine->activate();
+
+	// (the first one is cut down to meet the next bar, so the run starts after it)
+	const long numForcedBuffers = 40;
+	std::vector<float> input(256), output(256);
+	makeInput(&input, &random);
+	BufferOverrideTelemetry record;
+	long numRecords = 0, largestError = 0;
+	double total = 0.0, largestDrift = 0.0;
+	while (numRecords <= numForcedBuffers) {
+		runBlock(engine, &input, &output, 0, (long)input.size());
+		timeline.advance((long)input.size());
+		while (engine->readTelemetry(&record)) {
+			if (numRecords++ == 0)
+				continue;
+			if (labs((long)record.forcedBufferSize - originalSize) > largestError)
+				largestError = labs((long)record.forcedBufferSize - originalSize);
+			total += (double)record.forcedBufferSize;
+			largestDrift = fmax(largestDrift, fabs(total - (exactSize * (double)(numRecords - 1))));
+		}
+	}
+	DFX_CHECK_MSG( largestError <= 1, "seed %lu:  forced buffers %ld samples off from the original's %ld",
+				(unsigned long)seed, largestError, originalSize );
+	DFX_CHECK_MSG( largestDrift < 1.0, "seed %lu:  forced buffers of %g samples drifted by %g",
+				(unsigned long)seed, exactSize, largestDrift );
+	delete engine;
+}
+
+//-----------------------------------------------------------------------------
+// The LFOs, with their depths turned up.  This one's values only change at control rate, it smooths
+// over the jumps in the waveforms that have them, & its phase doesn't drift the way that the original's
+// floating point one does, so each value that it puts out at a sample is somewhere in the range of what
+// the original's put out from a control-rate update & a smoothing fade before then (with kLFOphaseSlack
+// table points' worth of drift either way), give or take however far the waveform can go in between two
+// of the original's samples.  The random ones don't have any numbers in common with the original's,
+// only the range that they stay in.
+const long kLFOphaseSlack = 4;
+
+static void testBaselineLFOs(uint64_t seed)
+{
+	DFXtestRandom random(seed * 32452843);
+	double sampleRate = kBaselineSampleRates[random.nextLong(kNumBaselineSampleRates)];
+	float tempoBPS = (60.0f + (random.nextFloat() * 180.0f)) / 60.0f;
+	long shape = random.nextLong(numLFOshapes);
+	LFO lfo;
+	lfo.fShape = LFOshapeUnscaled(shape);
+	lfo.fRate = random.nextFloat();
+	lfo.fTempoSync = (float)random.nextLong(2);
+	lfo.fDepth = random.nextFloat();
+	lfo.pickTheLFOwaveform();
+	float LFOphaseRangeDivSR = (float) (LFO_PHASE_RANGE / sampleRate);
+	if (onOffTest(lfo.fTempoSync))
+		lfo.setStepSize(tempoBPS * (TempoRateTable::getScalar(lfo.fRate)) * LFOphaseRangeDivSR);
+	else
+		lfo.setStepSize(LFOrateScaled(lfo.fRate) * LFOphaseRangeDivSR);
+
+	const long numSamples = (long)sampleRate * 4;
+	std::vector<float> values(numSamples), originalValues(numSamples);
+	BufferOverrideBaseline::renderLFO(lfo.fRate, lfo.fTempoSync, lfo.fDepth, lfo.fShape, tempoBPS, (float)sampleRate,
+										numSamples, &originalValues[0]);
+	long maxBlock = (LFO_MOD_BUFFER_SIZE - 1) * lfo.granularity;
+	for (long done = 0; done < numSamples; done += maxBlock) {
+		long blockSize = (maxBlock < (numSamples - done)) ? maxBlock : (numSamples - done);
+		lfo.renderModBuffer(0, blockSize);
+		for (long i = 0; i < blockSize; i++)
+			values[done + i] = modValueZero2two(&lfo, i);
+	}
+
+	long numOutside = 0, firstOutside = -1;
+	if ( (shape == kRandomLFO) || (shape == kRandomInterpolatingLFO) ) {
+		for (long i = 0; i < numSamples; i++) {
+			if ( (fabsf(values[i] - 1.0f) > lfo.fDepth) && (numOutside++ == 0) )
+				firstOutside = i;
+		}
+	} else {
+		// (the samples that the drift comes to, & the most that the waveform moves between two samples,
+		// apart from the square one's jumps, which the original can't step past any part of)
+		double pointsPerSample = (double)lfo.stepSize / ((double)LFO_PHASE_RANGE / (double)NUM_LFO_POINTS);
+		long drift = (long) ceil( (double)kLFOphaseSlack / pointsPerSample );
+		long lag = lfo.granularity + LFO_SMOOTH_DUR + drift;
+		float tableStep = 0.0f;
+		float *table = LFO::getTable(shape);
+		for (long n = 0; (n < (NUM_LFO_POINTS - 1)) && (shape != kSquareLFO); n++)
+			tableStep = fmaxf(tableStep, fabsf(table[n + 1] - table[n]));
+		float tolerance = kBaselineTolerance + (2.0f * lfo.fDepth * tableStep * (float)ceil(fmax(pointsPerSample, 1.0)));
+		for (long i = 0; i < (numSamples - drift); i++) {
+			bool inside = false;
+			float low = originalValues[i], high = originalValues[i];
+			for (long j = (i > lag) ? (i - lag) : 0; (j <= (i + drift)) && !inside; j++) {
+				low = fminf(low, originalValues[j]);
+				high = fmaxf(high, originalValues[j]);
+				inside = (low <= (values[i] + tolerance)) && (high >= (values[i] - tolerance));
+			}
+			if ( !inside && (numOutside++ == 0) )
+				firstOutside = i;
+		}
+	}
+	DFX_CHECK_MSG( numOutside == 0, "seed %lu:  %ld LFO values (shape %ld) out of the original's range, starting at %ld",
+				(unsigned long)seed, numOutside, shape, firstOutside );
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+	for (uint64_t seed = 1; seed <= 24; seed++)
+		testReferenceMode(seed);
+	for (uint64_t seed = 1; seed <= 40; seed++)
+		testAgainstBaseline(seed);
+	for (uint64_t seed = 1; seed <= 40; seed++)
+		testBaselineBufferSizes(seed);
+	for (uint64_t seed = 1; seed <= 40; seed++)
+		testBaselineLFOs(seed);
+	for (uint64_t seed = 1; seed <= 12; seed++)
+		testBlockSizes(seed);
+	for (uint64_t seed = 1; seed <= 12; seed++)
+		testCheckpointResume(seed);
+	for (uint64_t seed = 1; seed <= 12; seed++)
+		testSegmentList(seed);
+	for (uint64_t seed = 1; seed <= 8; seed++)
+		testSweep(seed);
+	testRenderCache();
+	testModulationRouting();
+	testLayerSmoothing();
+	for (uint64_t seed = 1; seed <= 6; seed++)
+		testStateRoundTrip(seed);
+	testTelemetry();
+	testCaptureReach();
+	testIdleRelease();
+	testDisplayCache();
+	testSharedTransport();
+
+	getTestHost().timeInfo = NULL;
+	return DFX_TEST_RESULT;
+}
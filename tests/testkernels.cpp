@@ -0,0 +1,302 @@
+// checks that the DSP kernels picked for this CPU give exactly what the plain reference ones do,
+// & that the BLAKE3 hashing built on them gives the published digests
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "dfxkernels.h"
+#include "dfxhash.h"
+#include "dfxtest.h"
+
+
+//-----------------------------------------------------------------------------
+// odd lengths & offsets, so that the vector loops' leftovers & unaligned starts get covered
+static const long testLengths[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 33, 64, 127, 128, 255, 1000 };
+static const long numTestLengths = sizeof(testLengths) / sizeof(testLengths[0]);
+#define TEST_MAX_LENGTH 1000
+#define TEST_MAX_OFFSET 3
+
+static bool sameBits(const void *a, const void *b, size_t numBytes)
+{
+	return (memcmp(a, b, numBytes) == 0);
+}
+
+// audio with some of everything:  ordinary levels, overs, denormals, signed zeros, infinities & NaNs
+static void fillTestSignal(float *data, long numSamples, DFXtestRandom *random)
+{
+	for (long i = 0; i < numSamples; i++) {
+		float value = (random->nextFloat() * 2.0f) - 1.0f;
+		switch (random->nextLong(40)) {
+			case 0:  value *= 8.0f;  break;
+			case 1:  value = 1.0e-40f;  break;
+			case 2:  value = -0.0f;  break;
+			case 3:  value = INFINITY;  break;
+			case 4:  value = -INFINITY;  break;
+			case 5:  value = NAN;  break;
+			default:  break;
+		}
+		data[i] = value;
+	}
+}
+
+//-----------------------------------------------------------------------------
+static void testConversions(const DFXkernels *fast, const DFXkernels *reference, DFXtestRandom *random)
+{
+	std::vector<float> source(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+	std::vector<int16_t> int16a(TEST_MAX_LENGTH + TEST_MAX_OFFSET), int16b(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+	std::vector<uint16_t> bf16a(TEST_MAX_LENGTH + TEST_MAX_OFFSET), bf16b(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+	std::vector<float> floata(TEST_MAX_LENGTH + TEST_MAX_OFFSET), floatb(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+
+	for (long t = 0; t < numTestLengths; t++) {
+		long n = testLengths[t];
+		long offset = t % (TEST_MAX_OFFSET + 1);
+		fillTestSignal(&source[0], (long)source.size(), random);
+		// (NaNs don't have an int16 version, so that one gets them taken out)
+		std::vector<float> finite(source);
+		for (size_t i = 0; i < finite.size(); i++)
+			finite[i] = isnan(finite[i]) ? 0.0f : finite[i];
+
+		fast->captureInt16(&int16a[offset], &finite[offset], n, 8191.75f);
+		reference->captureInt16(&int16b[offset], &finite[offset], n, 8191.75f);
+		DFX_CHECK_MSG( sameBits(&int16a[offset], &int16b[offset], n * sizeof(int16_t)), "captureInt16, %ld samples", n );
+		fast->readbackInt16(&floata[offset], &int16a[offset], n, 1.0f / 8191.75f);
+		reference->readbackInt16(&floatb[offset], &int16a[offset], n, 1.0f / 8191.75f);
+		DFX_CHECK_MSG( sameBits(&floata[offset], &floatb[offset], n * sizeof(float)), "readbackInt16, %ld samples", n );
+
+		fast->captureBfloat16(&bf16a[offset], &source[offset], n);
+		reference->captureBfloat16(&bf16b[offset], &source[offset], n);
+		DFX_CHECK_MSG( sameBits(&bf16a[offset], &bf16b[offset], n * sizeof(uint16_t)), "captureBfloat16, %ld samples", n );
+		fast->readbackBfloat16(&floata[offset], &bf16a[offset], n);
+		reference->readbackBfloat16(&floatb[offset], &bf16a[offset], n);
+		DFX_CHECK_MSG( sameBits(&floata[offset], &floatb[offset], n * sizeof(float)), "readbackBfloat16, %ld samples", n );
+	}
+
+	// int16 clips at the edges of the scale's range, & rounds to the nearest step inside of it
+	const float edges[] = { 4.0f, 100.0f, -4.0f, -100.0f, 0.0f, 0.49f / 8191.75f, 0.51f / 8191.75f };
+	int16_t stored[7];
+	reference->captureInt16(stored, edges, 7, 8191.75f);
+	DFX_CHECK(stored[0] == 32767);
+	DFX_CHECK(stored[1] == 32767);
+	DFX_CHECK(stored[2] == -32767);
+	DFX_CHECK(stored[3] == -32767);
+	DFX_CHECK(stored[4] == 0);
+	DFX_CHECK(stored[5] == 0);
+	DFX_CHECK(stored[6] == 1);
+}
+
+//-----------------------------------------------------------------------------
+static void testMixing(const DFXkernels *fast, const DFXkernels *reference, DFXtestRandom *random)
+{
+	std::vector<float> a(TEST_MAX_LENGTH + TEST_MAX_OFFSET), b(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+	std::vector<float> output(TEST_MAX_LENGTH + TEST_MAX_OFFSET), fadeIn(TEST_MAX_LENGTH + TEST_MAX_OFFSET), fadeOut(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+
+	for (long t = 0; t < numTestLengths; t++) {
+		long n = testLengths[t];
+		long offset = (t * 2) % (TEST_MAX_OFFSET + 1);
+		for (size_t i = 0; i < a.size(); i++) {
+			a[i] = (random->nextFloat() * 2.0f) - 1.0f;
+			b[i] = (random->nextFloat() * 2.0f) - 1.0f;
+			output[i] = (random->nextFloat() * 2.0f) - 1.0f;
+			fadeIn[i] = random->nextFloat();
+			fadeOut[i] = random->nextFloat();
+		}
+		std::vector<float> fastOutput(output), referenceOutput(output);
+
+		fast->crossfade(&fastOutput[offset], &a[offset], &fadeIn[offset], &fadeOut[offset], n);
+		reference->crossfade(&referenceOutput[offset], &a[offset], &fadeIn[offset], &fadeOut[offset], n);
+		DFX_CHECK_MSG( sameBits(&fastOutput[0], &referenceOutput[0], output.size() * sizeof(float)), "crossfade, %ld samples", n );
+
+		fast->mixGain(&fastOutput[offset], &b[offset], 0.7071f, n);
+		reference->mixGain(&referenceOutput[offset], &b[offset], 0.7071f, n);
+		DFX_CHECK_MSG( sameBits(&fastOutput[0], &referenceOutput[0], output.size() * sizeof(float)), "mixGain, %ld samples", n );
+
+		fast->mixWetDry(&fastOutput[offset], &a[offset], &b[offset], 0.8f, 0.6f, n);
+		reference->mixWetDry(&referenceOutput[offset], &a[offset], &b[offset], 0.8f, 0.6f, n);
+		DFX_CHECK_MSG( sameBits(&fastOutput[0], &referenceOutput[0], output.size() * sizeof(float)), "mixWetDry, %ld samples", n );
+	}
+}
+
+//-----------------------------------------------------------------------------
+static void testPeak(const DFXkernels *fast, const DFXkernels *reference, DFXtestRandom *random)
+{
+	std::vector<float> source(TEST_MAX_LENGTH + TEST_MAX_OFFSET);
+
+	for (long t = 0; t < numTestLengths; t++) {
+		long n = testLengths[t];
+		long offset = t % (TEST_MAX_OFFSET + 1);
+		fillTestSignal(&source[0], (long)source.size(), random);
+		float fastPeak = fast->peak(&source[offset], n, 0.125f);
+		float referencePeak = reference->peak(&source[offset], n, 0.125f);
+		DFX_CHECK_MSG( sameBits(&fastPeak, &referencePeak, sizeof(float)), "peak, %ld samples", n );
+
+		// & it has to be what it says that it is:  the largest magnitude, ignoring NaNs
+		float expected = 0.125f;
+		for (long i = 0; i < n; i++) {
+			if ( !isnan(source[offset+i]) && (fabsf(source[offset+i]) > expected) )
+				expected = fabsf(source[offset+i]);
+		}
+		DFX_CHECK_MSG( referencePeak == expected, "peak, %ld samples:  %g instead of %g", n, referencePeak, expected );
+	}
+
+	const float allNaN[5] = { NAN, -NAN, NAN, NAN, NAN };
+	DFX_CHECK( fast->peak(allNaN, 5, 0.0f) == 0.0f );
+	const float denormal[2] = { -1.0e-40f, 0.0f };
+	DFX_CHECK( fast->peak(denormal, 2, 0.0f) == 1.0e-40f );
+}
+
+//-----------------------------------------------------------------------------
+static void testAdvancePhases(const DFXkernels *fast, const DFXkernels *reference, DFXtestRandom *random)
+{
+	const long numPhases = 13;
+	uint32_t positionA[numPhases], positionB[numPhases], stepSize[numPhases];
+	uint32_t cyclesA[numPhases], cyclesB[numPhases];
+	uint32_t startPosition[numPhases];
+
+	for (long round = 0; round < 50; round++) {
+		for (long i = 0; i < numPhases; i++) {
+			positionA[i] = positionB[i] = startPosition[i] = random->next();
+			stepSize[i] = (i == 0) ? 0xFFFFFFFF : (random->next() >> random->nextLong(32));
+		}
+		long numSteps = 1 + random->nextLong(5000);
+		fast->advancePhases(positionA, stepSize, cyclesA, numPhases, numSteps);
+		reference->advancePhases(positionB, stepSize, cyclesB, numPhases, numSteps);
+		DFX_CHECK( sameBits(positionA, positionB, sizeof(positionA)) );
+		DFX_CHECK( sameBits(cyclesA, cyclesB, sizeof(cyclesA)) );
+		for (long i = 0; i < numPhases; i++) {
+			uint64_t expected = (uint64_t)startPosition[i] + ((uint64_t)stepSize[i] * (uint64_t)numSteps);
+			DFX_CHECK( (positionB[i] == (uint32_t)expected) && (cyclesB[i] == (uint32_t)(expected >> 32)) );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+static void testRenderLFOtable(const DFXkernels *fast, const DFXkernels *reference, DFXtestRandom *random)
+{
+	const long tableSize = 512, maxValues = 70;
+	float table[tableSize], outputA[maxValues], outputB[maxValues];
+	for (long i = 0; i < tableSize; i++)
+		table[i] = random->nextFloat();
+
+	for (long round = 0; round < 50; round++) {
+		uint32_t position = random->next();
+		uint32_t stepSize = (round == 0) ? 0xFFFFFFFF : (random->next() >> random->nextLong(32));
+		float offset = (random->nextLong(2) == 0) ? 0.0f : 0.5f, depth = random->nextFloat();
+		long numValues = 1 + random->nextLong(maxValues);
+		fast->renderLFOtable(outputA, table, position, stepSize, 23, offset, depth, numValues);
+		reference->renderLFOtable(outputB, table, position, stepSize, 23, offset, depth, numValues);
+		DFX_CHECK( sameBits(outputA, outputB, numValues * sizeof(float)) );
+		for (long i = 0; i < numValues; i++) {
+			uint32_t phase = (uint32_t) ((uint64_t)position + ((uint64_t)stepSize * (uint64_t)i));
+			DFX_CHECK( outputB[i] == (table[phase >> 23] - offset) * depth );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+static void testHashChunks(const DFXkernels *fast, const DFXkernels *reference, DFXtestRandom *random)
+{
+	std::vector<uint8_t> input((DFX_HASH_CHUNKS_MAX * BLAKE3_CHUNK_SIZE) + TEST_MAX_OFFSET);
+	uint32_t outputA[DFX_HASH_CHUNKS_MAX * 8], outputB[DFX_HASH_CHUNKS_MAX * 8];
+	for (long round = 0; round < 40; round++) {
+		for (size_t i = 0; i < input.size(); i++)
+			input[i] = (uint8_t) random->next();
+		long numChunks = 1 + random->nextLong(DFX_HASH_CHUNKS_MAX);
+		long offset = random->nextLong(TEST_MAX_OFFSET + 1);
+		// (sometimes with the counter crossing over into its high word)
+		uint64_t chunkCounter = (round & 1) ? (0xFFFFFFFFULL - (uint64_t)random->nextLong(DFX_HASH_CHUNKS_MAX)) : (uint64_t)random->nextLong(1000);
+		memset(outputA, 0, sizeof(outputA));
+		memset(outputB, 0, sizeof(outputB));
+		fast->hashChunks(outputA, &input[offset], numChunks, chunkCounter);
+		reference->hashChunks(outputB, &input[offset], numChunks, chunkCounter);
+		DFX_CHECK( sameBits(outputA, outputB, sizeof(outputA)) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// the official test vectors' input (bytes counting up from 0 to 250 & starting over), all at once
+// & in random pieces, for lengths that cover each way that the chunks & the tree can end up
+static void testBLAKE3(const DFXkernels *kernels, DFXtestRandom *random)
+{
+	struct { long length; const char *digest; } vectors[] = {
+		{ 0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262" },
+		{ 1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213" },
+		{ 1023, "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11" },
+		{ 1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7" },
+		{ 1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444" },
+		{ 2048, "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a" },
+		{ 2049, "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030" },
+		{ 3072, "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2" },
+		{ 4097, "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995" },
+		{ 8193, "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b" },
+		{ 16384, "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4" },
+		{ 16385, "1dabe216be2578830263b049de1639f39f05a4da616b9b78c7a5e4e41662fd1f" },
+		{ 31744, "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47" },
+		{ 102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085" },
+		{ 1048577, "2f053cd7472cf0cd2f9adaf45c1180255b91b9a865404a63671a0ee5f792ed33" }
+	};
+	const long numVectors = sizeof(vectors) / sizeof(vectors[0]);
+	std::vector<uint8_t> input(1048577);
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = (uint8_t) (i % 251);
+
+	BLAKE3hasher hasher;
+	hasher.setKernels(kernels);
+	for (long v = 0; v < numVectors; v++) {
+		uint8_t digest[BLAKE3_DIGEST_SIZE];
+		char hex[(BLAKE3_DIGEST_SIZE * 2) + 1];
+		for (long pass = 0; pass < 2; pass++) {
+			hasher.reset();
+			if (pass == 0) {
+				hasher.update(&input[0], vectors[v].length);
+			} else {
+				for (long done = 0; done < vectors[v].length; ) {
+					long pieceSize = 1 + random->nextLong((random->nextLong(4) == 0) ? 40000 : 1500);
+					if (pieceSize > (vectors[v].length - done))
+						pieceSize = vectors[v].length - done;
+					hasher.update(&input[done], pieceSize);
+					done += pieceSize;
+				}
+			}
+			hasher.finish(digest);
+			for (long i = 0; i < BLAKE3_DIGEST_SIZE; i++)
+				snprintf(hex + (i * 2), 3, "%02x", digest[i]);
+			DFX_CHECK_MSG( strcmp(hex, vectors[v].digest) == 0, "BLAKE3 of %ld bytes (%s kernels, %s):  %s", vectors[v].length,
+						   kernels->name, (pass == 0) ? "all at once" : "in pieces", hex );
+		}
+	}
+
+	// (finish() doesn't get in the way of carrying on)
+	hasher.reset();
+	uint8_t digestA[BLAKE3_DIGEST_SIZE], digestB[BLAKE3_DIGEST_SIZE];
+	hasher.update(&input[0], 3);
+	hasher.finish(digestA);
+	hasher.update(&input[3], 4094);
+	hasher.finish(digestA);
+	BLAKE3hasher straight;
+	straight.update(&input[0], 4097);
+	straight.finish(digestB);
+	DFX_CHECK( sameBits(digestA, digestB, sizeof(digestA)) );
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+	const DFXkernels *fast = getDFXkernels();
+	const DFXkernels *reference = getDFXreferenceKernels();
+	DFXtestRandom random(1);
+	printf("kernels:  %s (reference:  %s)\n", fast->name, reference->name);
+
+	testConversions(fast, reference, &random);
+	testMixing(fast, reference, &random);
+	testPeak(fast, reference, &random);
+	testAdvancePhases(fast, reference, &random);
+	testRenderLFOtable(fast, reference, &random);
+	testHashChunks(fast, reference, &random);
+	testBLAKE3(fast, &random);
+	testBLAKE3(reference, &random);
+	// the reference kernels have to hold up to the same checks against themselves
+	testPeak(reference, reference, &random);
+
+	return DFX_TEST_RESULT;
+}
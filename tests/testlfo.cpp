@@ -0,0 +1,268 @@
+// checks that the control-rate LFOs don't depend on how the processing blocks are chopped up (or on
+// rendering a block at a time), that their states can be picked up again from anywhere, & the tempo
+// rate table & telemetry ring
+// (the random waveforms get their generators seeded the same way for each render)
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "lfo.h"
+#include "lfobank.h"
+#include "spscring.h"
+#include "TempoRateTable.h"
+#include "dfxtest.h"
+
+
+//-----------------------------------------------------------------------------
+// every output value of an LFO over numSamples, rendered in blocks of the given sizes
+static std::vector<float> renderLFO(LFO *lfo, long numSamples, DFXtestRandom *blockSizes)
+{
+	std::vector<float> output;
+	long maxBlock = (LFO_MOD_BUFFER_SIZE - 1) * lfo->granularity;
+	for (long done = 0; done < numSamples; ) {
+		long blockSize = (blockSizes == NULL) ? maxBlock : (1 + blockSizes->nextLong(maxBlock));
+		if (blockSize > (numSamples - done))
+			blockSize = numSamples - done;
+		lfo->renderModBuffer(0, blockSize);
+		for (long i = 0; i < blockSize; i++)
+			output.push_back(lfo->getModValue(i));
+		done += blockSize;
+	}
+	return output;
+}
+
+static void setUpLFO(LFO *lfo, long shape, long granularity)
+{
+	lfo->fShape = LFOshapeUnscaled(shape);
+	lfo->fDepth = 0.8f;
+	lfo->pickTheLFOwaveform();
+	lfo->setGranularity(granularity);
+	srand(99 + (unsigned int)shape);
+	lfo->randomState = randomSeedFromRand();
+	lfo->reset();
+	lfo->setStepSize(3.7f * LFO_PHASE_RANGE / 44100.0f);
+}
+
+//-----------------------------------------------------------------------------
+static void testLFOblocks(DFXtestRandom *random)
+{
+	const long numSamples = 20000;
+	for (long shape = 0; shape < numLFOshapes; shape++) {
+		const long granularities[] = { 1, 7, 32 };
+		for (long g = 0; g < 3; g++) {
+			LFO one, chopped;
+			setUpLFO(&one, shape, granularities[g]);
+			setUpLFO(&chopped, shape, granularities[g]);
+			std::vector<float> a = renderLFO(&one, numSamples, NULL);
+			std::vector<float> b = renderLFO(&chopped, numSamples, random);
+			DFX_CHECK_MSG( memcmp(&a[0], &b[0], numSamples * sizeof(float)) == 0, "shape %ld, granularity %ld", shape, granularities[g] );
+			DFX_CHECK( one.position == chopped.position );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// rendering a block at a time (which the table waveforms do with the renderLFOtable() kernel) comes
+// out the same as stepping the LFO along one update at a time, output & state alike
+static void testLFOupdates(DFXtestRandom *random)
+{
+	const long numSamples = 20000;
+	for (long shape = 0; shape < numLFOshapes; shape++) {
+		const long granularities[] = { 1, 7, 32 };
+		for (long g = 0; g < 3; g++) {
+			LFO rendered, stepped;
+			setUpLFO(&rendered, shape, granularities[g]);
+			setUpLFO(&stepped, shape, granularities[g]);
+			std::vector<float> a = renderLFO(&rendered, numSamples, random);
+			std::vector<float> b(numSamples);
+			float value = stepped.currentValue;
+			long lastUpdate = 0;
+			for (long i = 0; i < numSamples; i++) {
+				if ( (i % granularities[g]) == 0 ) {
+					stepped.updatePosition(i - lastUpdate);
+					lastUpdate = i;
+					value = stepped.processLFO();
+				}
+				b[i] = value;
+			}
+			stepped.updatePosition(numSamples - lastUpdate);
+			DFX_CHECK_MSG( memcmp(&a[0], &b[0], numSamples * sizeof(float)) == 0, "shape %ld, granularity %ld", shape, granularities[g] );
+			DFX_CHECK( (rendered.position == stepped.position) && (rendered.randomState == stepped.randomState) );
+			DFX_CHECK( (rendered.randomNumber == stepped.randomNumber) && (rendered.smoothSamples == stepped.smoothSamples) );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// the state partway through a block is the state that stopping there would have given
+static void testLFOstate(DFXtestRandom *random)
+{
+	for (long trial = 0; trial < 20; trial++) {
+		long shape = trial % numLFOshapes;
+		LFO ahead, stopped;
+		setUpLFO(&ahead, shape, 1 + random->nextLong(40));
+		setUpLFO(&stopped, shape, ahead.granularity);
+		long before = random->nextLong(5000);
+		renderLFO(&ahead, before, NULL);
+		renderLFO(&stopped, before, NULL);
+
+		long blockSize = 1 + random->nextLong((LFO_MOD_BUFFER_SIZE - 1) * ahead.granularity);
+		long samplePos = random->nextLong(blockSize);
+		ahead.renderModBuffer(0, blockSize);
+		if (samplePos > 0)
+			stopped.renderModBuffer(0, samplePos);
+		LFOstate aheadState, stoppedState;
+		ahead.getStateAt(samplePos, &aheadState);
+		stopped.getState(&stoppedState);
+		DFX_CHECK( memcmp(&aheadState, &stoppedState, sizeof(LFOstate)) == 0 );
+
+		// & carrying on from a restored state gives the same as carrying on from there
+		LFO restored;
+		setUpLFO(&restored, shape, ahead.granularity);
+		restored.setState(&aheadState);
+		std::vector<float> a = renderLFO(&restored, 3000, NULL);
+		std::vector<float> b = renderLFO(&stopped, 3000, NULL);
+		DFX_CHECK( memcmp(&a[0], &b[0], 3000 * sizeof(float)) == 0 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+static void testLFObank(DFXtestRandom *random)
+{
+	LFObank one, chopped;
+	LFObank *banks[2] = { &one, &chopped };
+	for (long b = 0; b < 2; b++) {
+		srand(7);
+		for (long slot = 0; slot < NUM_MOD_SLOTS; slot++)
+			banks[b]->randomState[slot] = randomSeedFromRand();
+		banks[b]->setGranularity(16);
+		for (long slot = 0; slot < NUM_MOD_SLOTS; slot++) {
+			banks[b]->setRouting(slot, slot % 3);
+			banks[b]->setShape(slot, LFOshapeUnscaled(slot % numLFOshapes));
+			banks[b]->setDepth(slot, 0.1f * (float)(slot + 1));
+			banks[b]->setStepSize(slot, (float)(slot + 1) * 0.9f * LFO_PHASE_RANGE / 44100.0f);
+		}
+		banks[b]->reset();
+	}
+
+	const long numSamples = 30000;
+	const long maxBlock = (LFO_MOD_BUFFER_SIZE - 1) * 16;
+	std::vector<float> a, c;
+	for (long done = 0; done < numSamples; done += maxBlock) {
+		one.renderModBuffers(0, maxBlock);
+		for (long i = 0; i < maxBlock; i++)
+			a.push_back(one.getModOffset(0, i) + (one.getModOffset(1, i) * 3.0f) + (one.getModOffset(2, i) * 9.0f));
+	}
+	for (long done = 0; done < numSamples; ) {
+		long blockSize = 1 + random->nextLong(maxBlock);
+		if (blockSize > (numSamples - done))
+			blockSize = numSamples - done;
+		if (done + blockSize > (long)a.size())
+			blockSize = (long)a.size() - done;
+		chopped.renderModBuffers(0, blockSize);
+		for (long i = 0; i < blockSize; i++)
+			c.push_back(chopped.getModOffset(0, i) + (chopped.getModOffset(1, i) * 3.0f) + (chopped.getModOffset(2, i) * 9.0f));
+		done += blockSize;
+	}
+	DFX_CHECK( (a.size() >= c.size()) && (memcmp(&a[0], &c[0], c.size() * sizeof(float)) == 0) );
+	DFX_CHECK( one.isRouted(2) && !one.isRouted(3) );
+}
+
+//-----------------------------------------------------------------------------
+// a bank with only table waveforms renders them a block at a time, & one with a random waveform
+// in it too goes update by update, but the table slots have to come out the same either way
+static void testLFObankUpdates(DFXtestRandom *random)
+{
+	LFObank tables, mixed;
+	LFObank *banks[2] = { &tables, &mixed };
+	for (long b = 0; b < 2; b++) {
+		srand(11);
+		for (long slot = 0; slot < NUM_MOD_SLOTS; slot++)
+			banks[b]->randomState[slot] = randomSeedFromRand();
+		banks[b]->setGranularity(1 + random->nextLong(32));
+		for (long slot = 0; slot < NUM_MOD_SLOTS - 1; slot++) {
+			banks[b]->setRouting(slot, slot % 3);
+			banks[b]->setShape(slot, LFOshapeUnscaled(slot % kRandomLFO));
+			banks[b]->setDepth(slot, 0.1f * (float)(slot + 1));
+			banks[b]->setStepSize(slot, (float)(slot + 1) * 1.7f * LFO_PHASE_RANGE / 44100.0f);
+		}
+	}
+	mixed.setGranularity(tables.granularity);
+	// (this one goes somewhere that doesn't get looked at)
+	mixed.setRouting(NUM_MOD_SLOTS - 1, 5);
+	mixed.setShape(NUM_MOD_SLOTS - 1, LFOshapeUnscaled(kRandomInterpolatingLFO));
+	mixed.setDepth(NUM_MOD_SLOTS - 1, 0.5f);
+	mixed.setStepSize(NUM_MOD_SLOTS - 1, 20.0f * LFO_PHASE_RANGE / 44100.0f);
+	tables.reset();
+	mixed.reset();
+	DFX_CHECK( !tables.usesRandomShapes() && mixed.usesRandomShapes() );
+
+	const long maxBlock = (LFO_MOD_BUFFER_SIZE - 1) * tables.granularity;
+	bool same = true;
+	for (long done = 0; done < 30000; ) {
+		long blockSize = 1 + random->nextLong(maxBlock);
+		tables.renderModBuffers(0, blockSize);
+		mixed.renderModBuffers(0, blockSize);
+		for (long i = 0; i < blockSize; i++) {
+			for (long destination = 0; destination < 3; destination++)
+				same = same && (tables.getModOffset(destination, i) == mixed.getModOffset(destination, i));
+		}
+		done += blockSize;
+	}
+	DFX_CHECK( same );
+	DFX_CHECK( memcmp(tables.position, mixed.position, (NUM_MOD_SLOTS - 1) * sizeof(uint32_t)) == 0 );
+	DFX_CHECK( memcmp(tables.randomState, mixed.randomState, (NUM_MOD_SLOTS - 1) * sizeof(uint32_t)) == 0 );
+}
+
+//-----------------------------------------------------------------------------
+static void testTempoRates()
+{
+	for (long i = 0; i < NUM_TEMPO_RATES; i++) {
+		float value = paramSteppedUnscaled(i, NUM_TEMPO_RATES);
+		long numerator, denominator;
+		TempoRateTable::getRatio(value, &numerator, &denominator);
+		DFX_CHECK( (numerator > 0) && (denominator > 0) );
+		DFX_CHECK( TempoRateTable::getScalar(value) == (float)numerator / (float)denominator );
+		DFX_CHECK( TempoRateTable::getDisplay(value) != NULL );
+	}
+	// the ends of the range are the first & last rates
+	long numerator, denominator;
+	TempoRateTable::getRatio(0.0f, &numerator, &denominator);
+	DFX_CHECK( (numerator == 1) && (denominator > 1) );
+	TempoRateTable::getRatio(1.0f, &numerator, &denominator);
+	DFX_CHECK( (numerator > 1) && (denominator == 1) );
+}
+
+//-----------------------------------------------------------------------------
+static void testRing()
+{
+	SPSCring<long, 8> *ring = new SPSCring<long, 8>;
+	long value;
+	DFX_CHECK( !ring->pop(&value) );
+	for (long i = 0; i < 8; i++)
+		DFX_CHECK( ring->push(i) );
+	DFX_CHECK( !ring->push(8) );	// full, so that one gets dropped
+	for (long i = 0; i < 5; i++)
+		DFX_CHECK( ring->pop(&value) && (value == i) );
+	for (long i = 8; i < 13; i++)
+		DFX_CHECK( ring->push(i) );
+	for (long i = 5; i < 13; i++)
+		DFX_CHECK( ring->pop(&value) && (value == i) );
+	DFX_CHECK( !ring->pop(&value) );
+	delete ring;
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+	DFXtestRandom random(3);
+	testLFOblocks(&random);
+	testLFOupdates(&random);
+	testLFOstate(&random);
+	testLFObank(&random);
+	testLFObankUpdates(&random);
+	testTempoRates();
+	testRing();
+	return DFX_TEST_RESULT;
+}